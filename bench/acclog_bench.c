@@ -0,0 +1,141 @@
+/*****************************************************************************
+ * ARCHIVO: acclog_bench.c
+ * DESCRIPCION: Microbenchmark del log de accesos. De 1 a BENCH_MAX_THREADS
+ * hilos escriben registros a la vez en un fichero pequenio, de modo que la
+ * medida incluye la reserva de bloques y las rotaciones. Muestra el tiempo
+ * de CPU medio por registro de cada hilo, que debe quedar muy por debajo de
+ * 1 us, y los registros por segundo de todos los hilos juntos.
+ *
+ * USO: ./acclog_bench [registros_por_hilo] [fichero]
+ *
+ * FECHA CREACION: 19 Octubre de 2026
+ * AUTORES: Javier Mateos Najari, Adrian Sebastian Gil
+ *****************************************************************************/
+#include <pthread.h>
+#include <stdio.h>  // printf
+#include <stdlib.h> // atoi
+#include <string.h> // memset
+#include <time.h>   // clock_gettime
+
+#include "acclog.h"
+
+#define BENCH_DEFAULT_OPS 1000000 // Registros por hilo por defecto
+#define BENCH_MAX_THREADS 16      // Maximo de hilos escritores
+#define BENCH_FILE_SIZE (8 * 1024 * 1024) // Fichero que rota a menudo
+#define BENCH_KEEP 1                      // Rotados que se conservan
+
+// Argumento de un hilo escritor
+typedef struct bench_arg {
+    size_t ops;     // Registros que escribe
+    size_t failed;  // Registros que no se han podido escribir
+    double elapsed; // Tiempo de CPU del hilo (ns)
+} bench_arg_t;
+
+/*******************************************************************************
+ * FUNCION: static double bench_now(clockid_t clock)
+ * ARGS_IN: clockid_t clock - reloj que se lee.
+ * DESCRIPCION: Obtiene el instante actual de un reloj.
+ * ARGS_OUT: double - instante actual (ns).
+ ******************************************************************************/
+static double bench_now(clockid_t clock);
+
+/*******************************************************************************
+ * FUNCION: static void* bench_writer(void* arg)
+ * ARGS_IN: void* arg - argumento del hilo (bench_arg_t*).
+ * DESCRIPCION: Escribe registros como los de una peticion GET.
+ ******************************************************************************/
+static void* bench_writer(void* arg);
+
+int main(int argc, char** argv)
+{
+    size_t ops = argc > 1 ? (size_t)atoi(argv[1]) : BENCH_DEFAULT_OPS;
+    const char* path = argc > 2 ? argv[2] : "/tmp/acclog_bench.log";
+    char rotated[256];
+    acclog_opts_t opts = { 0 };
+    bench_arg_t args[BENCH_MAX_THREADS];
+    pthread_t threads[BENCH_MAX_THREADS];
+    double total, start, wall;
+    size_t failed;
+    int n, i;
+
+    opts.path = path;
+    opts.max_size = BENCH_FILE_SIZE;
+    opts.keep = BENCH_KEEP;
+    if (acclog_init(&opts)) {
+        fprintf(stderr, "Error iniciando el log de accesos en %s\n", path);
+        return EXIT_FAILURE;
+    }
+
+    printf("Log de accesos: %zu registros por hilo, ficheros de %d MB\n",
+           ops,
+           BENCH_FILE_SIZE / (1024 * 1024));
+    printf("%8s %14s %14s %12s\n",
+           "hilos",
+           "ns/registro",
+           "registros/s",
+           "fallidos");
+    for (n = 1; n <= BENCH_MAX_THREADS; n *= 2) {
+        start = bench_now(CLOCK_MONOTONIC);
+        for (i = 0; i < n; i++) {
+            args[i].ops = ops;
+            args[i].failed = 0;
+            pthread_create(&threads[i], NULL, bench_writer, &args[i]);
+        }
+        total = 0;
+        failed = 0;
+        for (i = 0; i < n; i++) {
+            pthread_join(threads[i], NULL);
+            total += args[i].elapsed;
+            failed += args[i].failed;
+        }
+        wall = bench_now(CLOCK_MONOTONIC) - start;
+        printf("%8d %14.1f %14.0f %12zu\n",
+               n,
+               total / (n * (double)ops),
+               n * (double)ops / wall * 1e9,
+               failed);
+    }
+
+    acclog_destroy();
+    remove(path);
+    snprintf(rotated, sizeof(rotated), "%s.1", path);
+    remove(rotated);
+
+    return EXIT_SUCCESS;
+}
+
+static double bench_now(clockid_t clock)
+{
+    struct timespec ts;
+
+    clock_gettime(clock, &ts);
+
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void* bench_writer(void* arg)
+{
+    bench_arg_t* bench = (bench_arg_t*)arg;
+    acclog_record_t record;
+    double start;
+    size_t i;
+
+    memset(&record, 0, sizeof(record));
+    record.status = 200;
+    record.method = ACCLOG_GET;
+    record.version = 1;
+    record.path_len = strlen("/index.html");
+    memcpy(record.path, "/index.html", record.path_len);
+
+    start = bench_now(CLOCK_THREAD_CPUTIME_ID);
+    for (i = 0; i < bench->ops; i++) {
+        record.time_us = i + 1;
+        record.bytes = i;
+        if (!acclog_write(&record)) {
+            bench->failed++;
+        }
+    }
+    bench->elapsed = bench_now(CLOCK_THREAD_CPUTIME_ID) - start;
+
+    return NULL;
+}
@@ -0,0 +1,111 @@
+#!/bin/bash
+###############################################################################
+# ARCHIVO: bench.sh
+# DESCRIPCION: Banco de pruebas de carga del servidor (make bench). Genera en
+# un directorio temporal un corpus de ficheros de distintos tamanios y los
+# scripts de ejemplo, arranca ./server con una copia de server.ini que
+# escucha en BENCH_PORT y le lanza varias pruebas con bench/loadgen. Los
+# resultados de todas las pruebas se guardan juntos en un JSON con fecha en
+# bench/results para comparar ejecuciones a lo largo del tiempo.
+#
+# VARIABLES: BENCH_PORT (3499), BENCH_DURATION (5 s), BENCH_WARMUP (1 s),
+# BENCH_CONNS (32), BENCH_THREADS (2), BENCH_RATE (1000 peticiones/s en la
+# prueba en bucle abierto), BENCH_IO_MODE (el de server.ini), BENCH_SERVER
+# (./server) y BENCH_OUT (bench/results).
+#
+# FECHA CREACION: 19 Octubre de 2026
+# AUTORES: Javier Mateos Najari, Adrian Sebastian Gil
+###############################################################################
+set -eu
+
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+PORT=${BENCH_PORT:-3499}
+DURATION=${BENCH_DURATION:-5}
+WARMUP=${BENCH_WARMUP:-1}
+CONNS=${BENCH_CONNS:-32}
+THREADS=${BENCH_THREADS:-2}
+RATE=${BENCH_RATE:-1000}
+IO_MODE=${BENCH_IO_MODE:-}
+OUT_DIR=${BENCH_OUT:-$ROOT/bench/results}
+LOADGEN=$ROOT/bench/loadgen
+SERVER=${BENCH_SERVER:-$ROOT/server}
+RUN=$(mktemp -d /tmp/server-bench.XXXXXX)
+PID=
+
+cleanup() {
+    if [ -n "$PID" ] && kill -0 "$PID" 2>/dev/null; then
+        kill -INT "$PID"
+        wait "$PID" || true
+    fi
+    rm -rf "$RUN"
+}
+trap cleanup EXIT
+
+# Corpus: ficheros estaticos de 1 KB a 1 MB y los scripts de ejemplo
+mkdir -p "$RUN/www/bench" "$RUN/www/scripts"
+for spec in 1k.html:1024 16k.html:16384 256k.jpg:262144 1m.pdf:1048576; do
+    yes "perico bench corpus" | head -c "${spec#*:}" > "$RUN/www/bench/${spec%%:*}"
+done
+cp "$ROOT/www/scripts/test.py" "$RUN/www/scripts/"
+
+# Configuracion: la del repositorio en primer plano, sin puerto de metricas y
+# con el log en un fichero para no mezclarlo con los resultados
+sed -e "s/^listen_port *=.*/listen_port = $PORT/" \
+    -e "s/^daemon *=.*/daemon = 0/" \
+    -e "s/^debug *=.*/debug = 0/" \
+    -e "s/^;file *=/file =/" \
+    -e "s/^admin_port *=/;admin_port =/" \
+    -e "s/^server_root *=.*/server_root = www/" \
+    "$ROOT/server.ini" > "$RUN/server.ini"
+if [ -n "$IO_MODE" ]; then
+    sed -i "s/^io_mode *=.*/io_mode = $IO_MODE/" "$RUN/server.ini"
+fi
+IO_MODE=$(sed -n "s/^io_mode *= *//p" "$RUN/server.ini")
+
+(cd "$RUN" && exec "$SERVER" > server.out 2>&1) &
+PID=$!
+for _ in $(seq 50); do
+    if (exec 3<> "/dev/tcp/127.0.0.1/$PORT") 2>/dev/null; then
+        break
+    fi
+    sleep 0.1
+done
+
+# Prueba: nombre, opciones de loadgen y paths
+run() {
+    local label=$1
+    shift
+    echo "> $label" >&2
+    "$LOADGEN" -p "$PORT" -t "$THREADS" -d "$DURATION" -w "$WARMUP" \
+               -l "$label" "$@"
+}
+
+RESULTS=$(
+    run static-1k -c "$CONNS" /bench/1k.html
+    run static-mixed -c "$CONNS" /bench/1k.html /bench/16k.html \
+        /bench/256k.jpg /bench/1m.pdf
+    run static-1k-open -c "$CONNS" -r "$RATE" /bench/1k.html
+    run static-1k-close -c "$CONNS" -k 0 /bench/1k.html
+    run scripts -c 4 -r 20 "/scripts/test.py?bench=1" "POST:/scripts/test.py"
+)
+
+mkdir -p "$OUT_DIR"
+STAMP=$(date -u +%Y-%m-%dT%H:%M:%SZ)
+OUT="$OUT_DIR/bench-$(date -u +%Y%m%dT%H%M%SZ).json"
+COMMIT=$(git -C "$ROOT" rev-parse --short HEAD 2>/dev/null || echo unknown)
+{
+    printf '{"timestamp":"%s","commit":"%s","host":"%s","cpus":%s,' \
+           "$STAMP" "$COMMIT" "$(uname -n)" "$(nproc)"
+    printf '"server":"%s","io_mode":"%s","scenarios":[\n' \
+           "$(basename "$SERVER")" "$IO_MODE"
+    echo "$RESULTS" | sed '$!s/$/,/'
+    printf ']}\n'
+} > "$OUT"
+
+printf '%-16s %10s %10s %10s %10s %8s\n' prueba req/s p50_us p99_us p999_us errores
+echo "$RESULTS" | sed -E 's/.*"label":"([^"]*)".*"rps":([0-9.]+).*"errors":\{"connect":([0-9]+),"read":([0-9]+),"timeout":([0-9]+),"parse":([0-9]+)\}.*"p50":([0-9]+),"p90":[0-9]+,"p99":([0-9]+),"p999":([0-9]+).*/\1 \2 \7 \8 \9 \3 \4 \5 \6/' |
+    while read -r label rps p50 p99 p999 e1 e2 e3 e4; do
+        printf '%-16s %10s %10s %10s %10s %8s\n' \
+               "$label" "$rps" "$p50" "$p99" "$p999" $((e1 + e2 + e3 + e4))
+    done
+echo "Resultados en $OUT"
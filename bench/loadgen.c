@@ -0,0 +1,924 @@
+/*****************************************************************************
+ * ARCHIVO: loadgen.c
+ * DESCRIPCION: Generador de carga HTTP/1.1. Cada hilo lleva un grupo de
+ * conexiones no bloqueantes sobre su propio epoll. Las conexiones se
+ * reutilizan (keep-alive) salvo con -k 0 y pueden tener hasta -P peticiones
+ * en vuelo (pipelining). Al terminar escribe un objeto JSON con las
+ * peticiones por segundo, los errores y los percentiles de latencia.
+ *
+ * Sin -r la carga es en bucle cerrado: cada conexion envia en cuanto tiene
+ * sitio y la latencia se mide desde el envio. Con -r la carga es en bucle
+ * abierto: las peticiones se programan a ritmo fijo y la latencia se mide
+ * desde el instante programado, no desde el envio real. Asi, si el servidor
+ * se atasca, las peticiones que deberian haber salido mientras tanto cuentan
+ * toda su espera (correccion de la omision coordinada). Las programadas que
+ * no llegan a enviarse antes del final se cuentan en "backlog".
+ *
+ * USO: ./loadgen [-h host] [-p puerto] [-c conexiones] [-t hilos]
+ *                [-d segundos] [-w segundos_calentamiento] [-r peticiones/s]
+ *                [-P profundidad] [-k 0|1] [-T timeout_ms] [-l etiqueta]
+ *                path ...
+ *      Cada path se pide por turnos. Con el prefijo "POST:" se envia un
+ *      POST con un cuerpo fijo en lugar de un GET.
+ *
+ * FECHA CREACION: 19 Octubre de 2026
+ * AUTORES: Javier Mateos Najari, Adrian Sebastian Gil
+ *****************************************************************************/
+#include <errno.h>       // errno
+#include <netdb.h>       // getaddrinfo
+#include <netinet/in.h>  // IPPROTO_TCP
+#include <netinet/tcp.h> // TCP_NODELAY
+#include <pthread.h>
+#include <stdbool.h>     // bool
+#include <stdint.h>      // uint64_t
+#include <stdio.h>       // printf
+#include <stdlib.h>      // calloc
+#include <string.h>      // memmove
+#include <strings.h>     // strncasecmp
+#include <sys/epoll.h>   // epoll_wait
+#include <sys/socket.h>  // connect
+#include <time.h>        // clock_gettime
+#include <unistd.h>      // getopt
+
+#include "picohttpparser.h"
+
+#define LG_MAX_THREADS 64     // Maximo de hilos
+#define LG_MAX_PATHS 64       // Maximo de paths
+#define LG_MAX_DEPTH 64       // Maximo de peticiones en vuelo por conexion
+#define LG_REQ_SIZE 1024      // Tamanio maximo de una peticion
+#define LG_IN_SIZE 16384      // Buffer de lectura de una conexion
+#define LG_MAX_HEADERS 32     // Cabeceras de una respuesta
+#define LG_MAX_EVENTS 256     // Eventos por llamada a epoll_wait
+#define LG_RETRY_NS 10000000  // Espera tras un connect fallido (10 ms)
+#define LG_CHECK_NS 10000000  // Periodo de comprobacion de timeouts (10 ms)
+#define LG_POST_BODY "bench=1" // Cuerpo de las peticiones POST
+
+// Histograma logaritmico: 32 subintervalos por potencia de 2 (error < 3.2%)
+#define LG_SUB_BITS 5
+#define LG_SUB (1 << LG_SUB_BITS)
+#define LG_MAX_EXP 40 // 2^40 us, mas que cualquier prueba
+#define LG_BUCKETS ((LG_MAX_EXP - LG_SUB_BITS + 2) * LG_SUB)
+
+// Peticion preparada
+typedef struct lg_request {
+    char data[LG_REQ_SIZE]; // Bytes de la peticion
+    size_t len;             // Longitud de la peticion
+} lg_request_t;
+
+// Resultados de un hilo
+typedef struct lg_stats {
+    uint64_t hist[LG_BUCKETS]; // Latencias (us)
+    uint64_t count;            // Respuestas medidas
+    uint64_t sum;              // Suma de las latencias (us)
+    uint64_t max;              // Latencia maxima (us)
+    uint64_t bytes;            // Bytes recibidos
+    uint64_t status[6];        // Respuestas por clase (1xx ... 5xx)
+    uint64_t err_connect;      // Conexiones fallidas
+    uint64_t err_read;         // Peticiones perdidas por un cierre
+    uint64_t err_timeout;      // Respuestas que no llegan a tiempo
+    uint64_t err_parse;        // Respuestas mal formadas
+    uint64_t backlog;          // Programadas sin enviar al terminar
+} lg_stats_t;
+
+// Conexion
+typedef struct lg_conn {
+    int fd;                          // Socket (-1: cerrado)
+    bool connected;                  // connect completado
+    uint32_t events;                 // Eventos registrados en epoll
+    uint64_t opened;                 // Inicio del connect (ns)
+    uint64_t retry;                  // No reconectar antes de (ns)
+    uint64_t next;                   // Siguiente envio programado (ns)
+    uint64_t ref[LG_MAX_DEPTH];      // Referencia de la latencia (ns)
+    uint64_t sent[LG_MAX_DEPTH];     // Envio real, para el timeout (ns)
+    size_t head;                     // Primera peticion en vuelo
+    size_t num;                      // Peticiones en vuelo
+    size_t turn;                     // Siguiente path
+    const lg_request_t* out;         // Peticion a medio escribir
+    size_t out_off;                  // Bytes escritos de out
+    bool body;                       // Se esta leyendo un cuerpo
+    uint64_t body_left;              // Bytes que faltan del cuerpo
+    int status;                      // Codigo de la respuesta en curso
+    bool close;                      // El servidor cierra tras la respuesta
+    size_t in_len;                   // Bytes en in
+    char in[LG_IN_SIZE];             // Datos recibidos sin procesar
+} lg_conn_t;
+
+// Hilo generador
+typedef struct lg_thread {
+    pthread_t thread;  // Hilo
+    int epfd;          // epoll del hilo
+    lg_conn_t* conns;  // Conexiones del hilo
+    size_t num_conns;  // Numero de conexiones
+    size_t first;      // Indice global de la primera conexion
+    lg_stats_t stats;  // Resultados
+} lg_thread_t;
+
+// Configuracion de la prueba
+static struct {
+    struct sockaddr_storage addr;          // Direccion del servidor
+    socklen_t addr_len;                    // Longitud de addr
+    const char* host;                      // Host del servidor
+    const char* port;                      // Puerto del servidor
+    const char* label;                     // Nombre de la prueba
+    size_t conns;                          // Conexiones
+    size_t threads;                        // Hilos
+    double duration;                       // Duracion medida (s)
+    double warmup;                         // Calentamiento (s)
+    double rate;                           // Peticiones/s (0: bucle cerrado)
+    size_t depth;                          // Peticiones en vuelo
+    bool keepalive;                        // Reutiliza las conexiones
+    uint64_t timeout;                      // Timeout de respuesta (ns)
+    uint64_t interval;                     // Periodo de cada conexion (ns)
+    uint64_t start;                        // Inicio de la prueba (ns)
+    uint64_t measure;                      // Fin del calentamiento (ns)
+    uint64_t end;                          // Fin de los envios (ns)
+    const char* paths[LG_MAX_PATHS];       // Paths pedidos
+    lg_request_t requests[LG_MAX_PATHS];   // Peticiones de cada path
+    size_t num_paths;                      // Numero de paths
+} lg;
+
+/*******************************************************************************
+ * FUNCION: static uint64_t lg_now()
+ * DESCRIPCION: Obtiene el instante actual en el reloj monotono.
+ * ARGS_OUT: uint64_t - instante actual (ns).
+ ******************************************************************************/
+static uint64_t lg_now();
+
+/*******************************************************************************
+ * FUNCION: static size_t lg_bucket(uint64_t us)
+ * ARGS_IN: uint64_t us - latencia (us).
+ * DESCRIPCION: Calcula el subintervalo del histograma de una latencia.
+ * ARGS_OUT: size_t - indice del subintervalo.
+ ******************************************************************************/
+static size_t lg_bucket(uint64_t us);
+
+/*******************************************************************************
+ * FUNCION: static uint64_t lg_bucket_high(size_t bucket)
+ * ARGS_IN: size_t bucket - indice del subintervalo.
+ * DESCRIPCION: Calcula el mayor valor que cae en un subintervalo.
+ * ARGS_OUT: uint64_t - limite superior del subintervalo (us).
+ ******************************************************************************/
+static uint64_t lg_bucket_high(size_t bucket);
+
+/*******************************************************************************
+ * FUNCION: static uint64_t lg_percentile(const lg_stats_t* stats, double q)
+ * ARGS_IN: const lg_stats_t* stats - resultados acumulados.
+ *          double q - percentil (0-100).
+ * DESCRIPCION: Obtiene la latencia de un percentil del histograma.
+ * ARGS_OUT: uint64_t - latencia (us).
+ ******************************************************************************/
+static uint64_t lg_percentile(const lg_stats_t* stats, double q);
+
+/*******************************************************************************
+ * FUNCION: static int lg_prepare(const char* spec, lg_request_t* request)
+ * ARGS_IN: const char* spec - path, con "POST:" delante para un POST.
+ *          lg_request_t* request - peticion que se rellena.
+ * DESCRIPCION: Construye los bytes de la peticion de un path.
+ * ARGS_OUT: int - 0 o -1 si no cabe.
+ ******************************************************************************/
+static int lg_prepare(const char* spec, lg_request_t* request);
+
+/*******************************************************************************
+ * FUNCION: static void lg_watch(lg_thread_t* t, lg_conn_t* c, uint32_t events)
+ * ARGS_IN: lg_thread_t* t - hilo de la conexion.
+ *          lg_conn_t* c - conexion.
+ *          uint32_t events - eventos que se esperan.
+ * DESCRIPCION: Cambia los eventos de la conexion en epoll si hace falta.
+ ******************************************************************************/
+static void lg_watch(lg_thread_t* t, lg_conn_t* c, uint32_t events);
+
+/*******************************************************************************
+ * FUNCION: static void lg_open(lg_thread_t* t, lg_conn_t* c, uint64_t now)
+ * ARGS_IN: lg_thread_t* t - hilo de la conexion.
+ *          lg_conn_t* c - conexion cerrada.
+ *          uint64_t now - instante actual (ns).
+ * DESCRIPCION: Empieza un connect no bloqueante.
+ ******************************************************************************/
+static void lg_open(lg_thread_t* t, lg_conn_t* c, uint64_t now);
+
+/*******************************************************************************
+ * FUNCION: static void lg_close(lg_thread_t* t, lg_conn_t* c, uint64_t* lost)
+ * ARGS_IN: lg_thread_t* t - hilo de la conexion.
+ *          lg_conn_t* c - conexion.
+ *          uint64_t* lost - (opcional) contador de error de las peticiones
+ *                           que quedan en vuelo.
+ * DESCRIPCION: Cierra la conexion y descarta sus peticiones en vuelo.
+ ******************************************************************************/
+static void lg_close(lg_thread_t* t, lg_conn_t* c, uint64_t* lost);
+
+/*******************************************************************************
+ * FUNCION: static int lg_send(lg_thread_t* t, lg_conn_t* c, uint64_t now)
+ * ARGS_IN: lg_thread_t* t - hilo de la conexion.
+ *          lg_conn_t* c - conexion establecida.
+ *          uint64_t now - instante actual (ns).
+ * DESCRIPCION: Escribe la peticion a medias y las que tocan segun el modo
+ *              de carga, hasta llenar las peticiones en vuelo.
+ * ARGS_OUT: int - 0 o -1 si la conexion falla.
+ ******************************************************************************/
+static int lg_send(lg_thread_t* t, lg_conn_t* c, uint64_t now);
+
+/*******************************************************************************
+ * FUNCION: static int lg_recv(lg_thread_t* t, lg_conn_t* c, uint64_t now)
+ * ARGS_IN: lg_thread_t* t - hilo de la conexion.
+ *          lg_conn_t* c - conexion establecida.
+ *          uint64_t now - instante actual (ns).
+ * DESCRIPCION: Lee lo disponible y registra las respuestas completas.
+ * ARGS_OUT: int - 0, 1 si hay que cerrar sin error o -1 si hay error.
+ ******************************************************************************/
+static int lg_recv(lg_thread_t* t, lg_conn_t* c, uint64_t now);
+
+/*******************************************************************************
+ * FUNCION: static void lg_complete(lg_thread_t* t, lg_conn_t* c, uint64_t now)
+ * ARGS_IN: lg_thread_t* t - hilo de la conexion.
+ *          lg_conn_t* c - conexion.
+ *          uint64_t now - instante actual (ns).
+ * DESCRIPCION: Registra la respuesta de la primera peticion en vuelo.
+ ******************************************************************************/
+static void lg_complete(lg_thread_t* t, lg_conn_t* c, uint64_t now);
+
+/*******************************************************************************
+ * FUNCION: static void* lg_run(void* arg)
+ * ARGS_IN: void* arg - hilo generador (lg_thread_t).
+ * DESCRIPCION: Bucle de eventos de un hilo hasta el final de la prueba.
+ ******************************************************************************/
+static void* lg_run(void* arg);
+
+/*******************************************************************************
+ * FUNCION: static void lg_report(const lg_stats_t* stats, double elapsed)
+ * ARGS_IN: const lg_stats_t* stats - resultados de todos los hilos.
+ *          double elapsed - tiempo medido (s).
+ * DESCRIPCION: Escribe los resultados como un objeto JSON en stdout.
+ ******************************************************************************/
+static void lg_report(const lg_stats_t* stats, double elapsed);
+
+/*******************************************************************************
+ * FUNCION: static void lg_usage(const char* name)
+ * ARGS_IN: const char* name - nombre del programa.
+ * DESCRIPCION: Muestra el uso del programa.
+ ******************************************************************************/
+static void lg_usage(const char* name);
+
+int main(int argc, char** argv)
+{
+    int opt;
+    size_t i, j;
+    struct addrinfo hints, *res;
+    lg_thread_t* threads;
+    lg_stats_t total;
+
+    lg.host = "127.0.0.1";
+    lg.port = "3490";
+    lg.label = "";
+    lg.conns = 32;
+    lg.threads = 2;
+    lg.duration = 10;
+    lg.depth = 1;
+    lg.keepalive = true;
+    lg.timeout = 2000000000ULL;
+
+    while ((opt = getopt(argc, argv, "h:p:c:t:d:w:r:P:k:T:l:")) != -1) {
+        switch (opt) {
+        case 'h':
+            lg.host = optarg;
+            break;
+        case 'p':
+            lg.port = optarg;
+            break;
+        case 'c':
+            lg.conns = strtoul(optarg, NULL, 10);
+            break;
+        case 't':
+            lg.threads = strtoul(optarg, NULL, 10);
+            break;
+        case 'd':
+            lg.duration = atof(optarg);
+            break;
+        case 'w':
+            lg.warmup = atof(optarg);
+            break;
+        case 'r':
+            lg.rate = atof(optarg);
+            break;
+        case 'P':
+            lg.depth = strtoul(optarg, NULL, 10);
+            break;
+        case 'k':
+            lg.keepalive = atoi(optarg) != 0;
+            break;
+        case 'T':
+            lg.timeout = strtoull(optarg, NULL, 10) * 1000000ULL;
+            break;
+        case 'l':
+            lg.label = optarg;
+            break;
+        default:
+            lg_usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (optind == argc || lg.conns == 0 || lg.threads == 0 ||
+        lg.duration <= 0 || lg.warmup < 0 || lg.rate < 0 || lg.depth == 0 ||
+        lg.depth > LG_MAX_DEPTH || lg.timeout == 0) {
+        lg_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (lg.threads > LG_MAX_THREADS) {
+        lg.threads = LG_MAX_THREADS;
+    }
+    if (lg.threads > lg.conns) {
+        lg.threads = lg.conns;
+    }
+    // Sin keep-alive cada conexion lleva una sola peticion
+    if (!lg.keepalive) {
+        lg.depth = 1;
+    }
+
+    for (; optind < argc && lg.num_paths < LG_MAX_PATHS; optind++) {
+        lg.paths[lg.num_paths] = argv[optind];
+        if (lg_prepare(argv[optind], &lg.requests[lg.num_paths])) {
+            fprintf(stderr, "Path demasiado largo: %s\n", argv[optind]);
+            return EXIT_FAILURE;
+        }
+        lg.num_paths++;
+    }
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(lg.host, lg.port, &hints, &res)) {
+        fprintf(stderr, "No se puede resolver %s:%s\n", lg.host, lg.port);
+        return EXIT_FAILURE;
+    }
+    memcpy(&lg.addr, res->ai_addr, res->ai_addrlen);
+    lg.addr_len = res->ai_addrlen;
+    freeaddrinfo(res);
+
+    threads = (lg_thread_t*)calloc(lg.threads, sizeof(lg_thread_t));
+    if (!threads) {
+        return EXIT_FAILURE;
+    }
+    if (lg.rate > 0) {
+        lg.interval = (uint64_t)(1e9 * lg.conns / lg.rate);
+        if (!lg.interval) {
+            lg.interval = 1;
+        }
+    }
+    lg.start = lg_now();
+    lg.measure = lg.start + (uint64_t)(lg.warmup * 1e9);
+    lg.end = lg.measure + (uint64_t)(lg.duration * 1e9);
+
+    // Las conexiones se reparten a partes iguales entre los hilos
+    for (i = 0, j = 0; i < lg.threads; i++) {
+        threads[i].first = j;
+        threads[i].num_conns =
+          lg.conns / lg.threads + (i < lg.conns % lg.threads ? 1 : 0);
+        j += threads[i].num_conns;
+        threads[i].conns =
+          (lg_conn_t*)calloc(threads[i].num_conns, sizeof(lg_conn_t));
+        threads[i].epfd = epoll_create1(EPOLL_CLOEXEC);
+        if (!threads[i].conns || threads[i].epfd == -1 ||
+            pthread_create(&threads[i].thread, NULL, lg_run, &threads[i])) {
+            fprintf(stderr, "No se pueden crear los hilos\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    memset(&total, 0, sizeof(total));
+    for (i = 0; i < lg.threads; i++) {
+        pthread_join(threads[i].thread, NULL);
+        for (j = 0; j < LG_BUCKETS; j++) {
+            total.hist[j] += threads[i].stats.hist[j];
+        }
+        for (j = 0; j < 6; j++) {
+            total.status[j] += threads[i].stats.status[j];
+        }
+        total.count += threads[i].stats.count;
+        total.sum += threads[i].stats.sum;
+        if (threads[i].stats.max > total.max) {
+            total.max = threads[i].stats.max;
+        }
+        total.bytes += threads[i].stats.bytes;
+        total.err_connect += threads[i].stats.err_connect;
+        total.err_read += threads[i].stats.err_read;
+        total.err_timeout += threads[i].stats.err_timeout;
+        total.err_parse += threads[i].stats.err_parse;
+        total.backlog += threads[i].stats.backlog;
+        close(threads[i].epfd);
+        free(threads[i].conns);
+    }
+    free(threads);
+
+    lg_report(&total, lg.duration);
+
+    return EXIT_SUCCESS;
+}
+
+static uint64_t lg_now()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static size_t lg_bucket(uint64_t us)
+{
+    int exp;
+    size_t bucket;
+
+    if (us < LG_SUB) {
+        return (size_t)us;
+    }
+
+    exp = 63 - __builtin_clzll(us);
+    bucket = (size_t)(exp - LG_SUB_BITS + 1) * LG_SUB +
+             (size_t)((us >> (exp - LG_SUB_BITS)) & (LG_SUB - 1));
+
+    return bucket < LG_BUCKETS ? bucket : LG_BUCKETS - 1;
+}
+
+static uint64_t lg_bucket_high(size_t bucket)
+{
+    int shift;
+
+    if (bucket < LG_SUB) {
+        return bucket;
+    }
+
+    shift = (int)(bucket / LG_SUB) - 1;
+
+    return (((uint64_t)(LG_SUB + bucket % LG_SUB) + 1) << shift) - 1;
+}
+
+static uint64_t lg_percentile(const lg_stats_t* stats, double q)
+{
+    size_t i;
+    uint64_t seen = 0, rank, high;
+
+    if (!stats->count) {
+        return 0;
+    }
+
+    rank = (uint64_t)(q / 100 * stats->count + 0.5);
+    if (rank < 1) {
+        rank = 1;
+    }
+    for (i = 0; i < LG_BUCKETS; i++) {
+        seen += stats->hist[i];
+        if (seen >= rank) {
+            high = lg_bucket_high(i);
+            return high < stats->max ? high : stats->max;
+        }
+    }
+
+    return stats->max;
+}
+
+static int lg_prepare(const char* spec, lg_request_t* request)
+{
+    int len;
+    const char* connection = lg.keepalive ? "" : "Connection: close\r\n";
+
+    if (!strncmp(spec, "POST:", 5)) {
+        len = snprintf(request->data,
+                       sizeof(request->data),
+                       "POST %s HTTP/1.1\r\nHost: %s\r\n%sContent-Type: "
+                       "application/x-www-form-urlencoded\r\nContent-Length: "
+                       "%zu\r\n\r\n%s",
+                       spec + 5,
+                       lg.host,
+                       connection,
+                       strlen(LG_POST_BODY),
+                       LG_POST_BODY);
+    } else {
+        len = snprintf(request->data,
+                       sizeof(request->data),
+                       "GET %s HTTP/1.1\r\nHost: %s\r\n%s\r\n",
+                       spec,
+                       lg.host,
+                       connection);
+    }
+    if (len < 0 || (size_t)len >= sizeof(request->data)) {
+        return -1;
+    }
+    request->len = (size_t)len;
+
+    return 0;
+}
+
+static void lg_watch(lg_thread_t* t, lg_conn_t* c, uint32_t events)
+{
+    struct epoll_event ev;
+
+    if (c->events == events) {
+        return;
+    }
+
+    ev.events = events;
+    ev.data.ptr = c;
+    epoll_ctl(t->epfd, EPOLL_CTL_MOD, c->fd, &ev);
+    c->events = events;
+}
+
+static void lg_open(lg_thread_t* t, lg_conn_t* c, uint64_t now)
+{
+    int one = 1;
+    struct epoll_event ev;
+
+    c->fd = socket(lg.addr.ss_family,
+                   SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                   0);
+    if (c->fd == -1) {
+        t->stats.err_connect++;
+        c->retry = now + LG_RETRY_NS;
+        return;
+    }
+    setsockopt(c->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    c->connected = false;
+    c->opened = now;
+    c->events = EPOLLOUT;
+    ev.events = c->events;
+    ev.data.ptr = c;
+    if ((connect(c->fd, (struct sockaddr*)&lg.addr, lg.addr_len) &&
+         errno != EINPROGRESS) ||
+        epoll_ctl(t->epfd, EPOLL_CTL_ADD, c->fd, &ev)) {
+        t->stats.err_connect++;
+        close(c->fd);
+        c->fd = -1;
+        c->retry = now + LG_RETRY_NS;
+    }
+}
+
+static void lg_close(lg_thread_t* t, lg_conn_t* c, uint64_t* lost)
+{
+    (void)t;
+
+    if (lost) {
+        *lost += c->num;
+    }
+    close(c->fd);
+    c->fd = -1;
+    c->connected = false;
+    c->head = 0;
+    c->num = 0;
+    c->out = NULL;
+    c->body = false;
+    c->close = false;
+    c->in_len = 0;
+}
+
+static int lg_send(lg_thread_t* t, lg_conn_t* c, uint64_t now)
+{
+    ssize_t ret;
+    size_t slot;
+
+    while (1) {
+        if (!c->out) {
+            if (c->num == lg.depth || now >= lg.end) {
+                break;
+            }
+            if (lg.rate > 0) {
+                // Se envia con el retraso acumulado, pero la latencia se
+                // mide desde el instante programado
+                if (now < c->next || c->next >= lg.end) {
+                    break;
+                }
+                slot = (c->head + c->num) % LG_MAX_DEPTH;
+                c->ref[slot] = c->next;
+                c->next += lg.interval;
+            } else {
+                // Sin keep-alive el connect forma parte de la peticion
+                slot = (c->head + c->num) % LG_MAX_DEPTH;
+                c->ref[slot] = lg.keepalive ? now : c->opened;
+            }
+            c->sent[slot] = now;
+            c->num++;
+            c->out = &lg.requests[c->turn++ % lg.num_paths];
+            c->out_off = 0;
+        }
+
+        ret = send(c->fd,
+                   c->out->data + c->out_off,
+                   c->out->len - c->out_off,
+                   MSG_NOSIGNAL);
+        if (ret == -1) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                lg_watch(t, c, EPOLLIN | EPOLLOUT);
+                return 0;
+            }
+            return -1;
+        }
+        c->out_off += (size_t)ret;
+        if (c->out_off == c->out->len) {
+            c->out = NULL;
+        }
+    }
+    lg_watch(t, c, EPOLLIN);
+
+    return 0;
+}
+
+static int lg_recv(lg_thread_t* t, lg_conn_t* c, uint64_t now)
+{
+    ssize_t ret;
+    size_t off, i, take, num_headers;
+    int minor, status, pret;
+    const char* msg;
+    size_t msg_len;
+    struct phr_header headers[LG_MAX_HEADERS];
+
+    while (1) {
+        ret = recv(c->fd, c->in + c->in_len, sizeof(c->in) - c->in_len, 0);
+        if (ret == 0) {
+            return c->num ? -1 : 1;
+        }
+        if (ret == -1) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return 0;
+            }
+            return -1;
+        }
+        c->in_len += (size_t)ret;
+        t->stats.bytes += (uint64_t)ret;
+
+        off = 0;
+        while (1) {
+            if (c->body) {
+                take = c->in_len - off;
+                if (take > c->body_left) {
+                    take = (size_t)c->body_left;
+                }
+                c->body_left -= take;
+                off += take;
+                if (c->body_left) {
+                    break;
+                }
+                c->body = false;
+                lg_complete(t, c, now);
+                if (c->close) {
+                    return 1;
+                }
+                continue;
+            }
+            if (off == c->in_len) {
+                break;
+            }
+
+            num_headers = LG_MAX_HEADERS;
+            pret = phr_parse_response(c->in + off,
+                                      c->in_len - off,
+                                      &minor,
+                                      &status,
+                                      &msg,
+                                      &msg_len,
+                                      headers,
+                                      &num_headers,
+                                      0);
+            if (pret == -2) {
+                break;
+            }
+            if (pret == -1 || !c->num) {
+                t->stats.err_parse++;
+                return -1;
+            }
+            off += (size_t)pret;
+            c->body = true;
+            c->body_left = 0;
+            c->status = status;
+            c->close = !lg.keepalive;
+            for (i = 0; i < num_headers; i++) {
+                if (headers[i].name_len == strlen("Content-Length") &&
+                    !strncasecmp(headers[i].name,
+                                 "Content-Length",
+                                 headers[i].name_len)) {
+                    c->body_left = strtoull(headers[i].value, NULL, 10);
+                } else if (headers[i].name_len == strlen("Connection") &&
+                           !strncasecmp(headers[i].name,
+                                        "Connection",
+                                        headers[i].name_len) &&
+                           headers[i].value_len >= 5 &&
+                           !strncasecmp(headers[i].value, "close", 5)) {
+                    c->close = true;
+                }
+            }
+        }
+
+        memmove(c->in, c->in + off, c->in_len - off);
+        c->in_len -= off;
+        if (c->in_len == sizeof(c->in)) {
+            // Cabecera de respuesta demasiado larga
+            t->stats.err_parse++;
+            return -1;
+        }
+    }
+}
+
+static void lg_complete(lg_thread_t* t, lg_conn_t* c, uint64_t now)
+{
+    uint64_t ref = c->ref[c->head], us;
+
+    c->head = (c->head + 1) % LG_MAX_DEPTH;
+    c->num--;
+
+    // Solo cuentan las peticiones programadas o enviadas tras el
+    // calentamiento
+    if (ref < lg.measure) {
+        return;
+    }
+
+    us = (now - ref) / 1000;
+    t->stats.hist[lg_bucket(us)]++;
+    t->stats.count++;
+    t->stats.sum += us;
+    if (us > t->stats.max) {
+        t->stats.max = us;
+    }
+    if (c->status >= 100 && c->status < 600) {
+        t->stats.status[c->status / 100]++;
+    } else {
+        t->stats.status[0]++;
+    }
+}
+
+static void* lg_run(void* arg)
+{
+    lg_thread_t* t = (lg_thread_t*)arg;
+    lg_conn_t* c;
+    struct epoll_event events[LG_MAX_EVENTS];
+    uint64_t now, check = 0, drain;
+    size_t i;
+    int n, k, err, status, wait_ms;
+    socklen_t len;
+
+    // Los envios programados de las conexiones se escalonan dentro del
+    // periodo para no salir todos a la vez
+    now = lg_now();
+    for (i = 0; i < t->num_conns; i++) {
+        c = &t->conns[i];
+        c->fd = -1;
+        c->next = lg.start + lg.interval * (t->first + i) / lg.conns;
+        lg_open(t, c, now);
+    }
+    drain = lg.end + lg.timeout;
+
+    while (1) {
+        now = lg_now();
+        if (now >= drain) {
+            break;
+        }
+        if (now >= lg.end) {
+            // Se termina en cuanto no queda nada en vuelo
+            for (i = 0; i < t->num_conns && !t->conns[i].num; i++)
+                ;
+            if (i == t->num_conns) {
+                break;
+            }
+        }
+
+        // En bucle abierto hay que despertar a tiempo para cada envio
+        wait_ms = lg.rate > 0 ? 1 : 10;
+        n = epoll_wait(t->epfd, events, LG_MAX_EVENTS, wait_ms);
+        now = lg_now();
+        for (k = 0; k < n; k++) {
+            c = (lg_conn_t*)events[k].data.ptr;
+            if (c->fd == -1) {
+                continue;
+            }
+            status = 0;
+            if (!c->connected) {
+                err = 0;
+                len = sizeof(err);
+                getsockopt(c->fd, SOL_SOCKET, SO_ERROR, &err, &len);
+                if (err) {
+                    t->stats.err_connect++;
+                    lg_close(t, c, NULL);
+                    c->retry = now + LG_RETRY_NS;
+                    continue;
+                }
+                c->connected = true;
+                lg_watch(t, c, EPOLLIN);
+            }
+            if (events[k].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                status = lg_recv(t, c, now);
+            }
+            // Un cierre tras la respuesta pierde las que sigan en vuelo
+            if (status) {
+                lg_close(t, c, &t->stats.err_read);
+            } else if (lg_send(t, c, now)) {
+                lg_close(t, c, &t->stats.err_read);
+            }
+        }
+
+        for (i = 0; i < t->num_conns; i++) {
+            c = &t->conns[i];
+            if (c->fd == -1) {
+                if (now < lg.end && now >= c->retry) {
+                    lg_open(t, c, now);
+                }
+            } else if (c->connected && lg_send(t, c, now)) {
+                lg_close(t, c, &t->stats.err_read);
+            }
+        }
+
+        // Respuestas que no llegan a tiempo
+        if (now >= check) {
+            check = now + LG_CHECK_NS;
+            for (i = 0; i < t->num_conns; i++) {
+                c = &t->conns[i];
+                if (c->fd != -1 && c->num &&
+                    now - c->sent[c->head] > lg.timeout) {
+                    lg_close(t, c, &t->stats.err_timeout);
+                } else if (c->fd != -1 && !c->connected &&
+                           now - c->opened > lg.timeout) {
+                    t->stats.err_connect++;
+                    lg_close(t, c, NULL);
+                }
+            }
+        }
+    }
+
+    for (i = 0; i < t->num_conns; i++) {
+        c = &t->conns[i];
+        if (c->fd != -1) {
+            lg_close(t, c, &t->stats.err_timeout);
+        }
+        // Envios programados que no han salido por el atasco
+        if (lg.rate > 0) {
+            for (; c->next < lg.end; c->next += lg.interval) {
+                if (c->next >= lg.measure) {
+                    t->stats.backlog++;
+                }
+            }
+        }
+    }
+
+    return NULL;
+}
+
+static void lg_report(const lg_stats_t* stats, double elapsed)
+{
+    size_t i;
+
+    printf("{\"label\":\"%s\",\"config\":{\"host\":\"%s\",\"port\":\"%s\","
+           "\"connections\":%zu,\"threads\":%zu,\"duration_s\":%g,"
+           "\"warmup_s\":%g,\"rate\":%g,\"pipeline\":%zu,\"keepalive\":%s,"
+           "\"paths\":[",
+           lg.label,
+           lg.host,
+           lg.port,
+           lg.conns,
+           lg.threads,
+           lg.duration,
+           lg.warmup,
+           lg.rate,
+           lg.depth,
+           lg.keepalive ? "true" : "false");
+    for (i = 0; i < lg.num_paths; i++) {
+        printf("%s\"%s\"", i ? "," : "", lg.paths[i]);
+    }
+    printf("]},\"requests\":%llu,\"rps\":%.1f,\"bytes\":%llu,"
+           "\"mbps\":%.2f,",
+           (unsigned long long)stats->count,
+           stats->count / elapsed,
+           (unsigned long long)stats->bytes,
+           stats->bytes * 8 / elapsed / 1e6);
+    printf("\"status\":{\"1xx\":%llu,\"2xx\":%llu,\"3xx\":%llu,\"4xx\":%llu,"
+           "\"5xx\":%llu,\"other\":%llu},",
+           (unsigned long long)stats->status[1],
+           (unsigned long long)stats->status[2],
+           (unsigned long long)stats->status[3],
+           (unsigned long long)stats->status[4],
+           (unsigned long long)stats->status[5],
+           (unsigned long long)stats->status[0]);
+    printf("\"errors\":{\"connect\":%llu,\"read\":%llu,\"timeout\":%llu,"
+           "\"parse\":%llu},\"backlog\":%llu,",
+           (unsigned long long)stats->err_connect,
+           (unsigned long long)stats->err_read,
+           (unsigned long long)stats->err_timeout,
+           (unsigned long long)stats->err_parse,
+           (unsigned long long)stats->backlog);
+    printf("\"latency_us\":{\"mean\":%.1f,\"p50\":%llu,\"p90\":%llu,"
+           "\"p99\":%llu,\"p999\":%llu,\"max\":%llu}}\n",
+           stats->count ? (double)stats->sum / stats->count : 0.0,
+           (unsigned long long)lg_percentile(stats, 50),
+           (unsigned long long)lg_percentile(stats, 90),
+           (unsigned long long)lg_percentile(stats, 99),
+           (unsigned long long)lg_percentile(stats, 99.9),
+           (unsigned long long)stats->max);
+}
+
+static void lg_usage(const char* name)
+{
+    fprintf(stderr,
+            "USO: %s [-h host] [-p puerto] [-c conexiones] [-t hilos] "
+            "[-d segundos]\n"
+            "        [-w calentamiento] [-r peticiones/s] [-P profundidad] "
+            "[-k 0|1]\n"
+            "        [-T timeout_ms] [-l etiqueta] path ...\n"
+            "  Sin -r la carga es en bucle cerrado. Con el prefijo POST: el "
+            "path se pide\n"
+            "  con POST.\n",
+            name);
+}
@@ -0,0 +1,596 @@
+/*****************************************************************************
+ * ARCHIVO: micro_bench.c
+ * DESCRIPCION: Microbenchmarks de las piezas del camino de una peticion:
+ * phr_parse_request con cabeceras reales de navegadores y clientes, la ida y
+ * vuelta de un trabajo por tpool_add_work, http_get_content_type,
+ * http_get_date y el formateo de la cabecera de respuesta de http_get.
+ *
+ * Las funciones de http.c son estaticas, asi que el fichero se incluye
+ * entero. El hilo se fija a una CPU y cada prueba se repite varias veces
+ * quedandose con la mas rapida. Ademas del tiempo por operacion se leen
+ * con perf_event_open los ciclos, instrucciones, fallos de cache y fallos de
+ * prediccion de saltos del hilo (solo en espacio de usuario, que no exige
+ * privilegios con perf_event_paranoid <= 2). Si el kernel no da contadores
+ * se muestra "-".
+ *
+ * USO: ./micro_bench [-c cpu (-1: sin fijar)] [-t ms_por_prueba]
+ *                    [-n repeticiones] [-r peticion_capturada] [-j]
+ *      Con -r se anade una prueba de parseo del fichero, que contiene una
+ *      peticion en crudo capturada. Con -j cada prueba se escribe como una
+ *      linea JSON.
+ *
+ * FECHA CREACION: 19 Octubre de 2026
+ * AUTORES: Javier Mateos Najari, Adrian Sebastian Gil
+ *****************************************************************************/
+#include <linux/perf_event.h> // perf_event_attr
+#include <semaphore.h>        // sem_t
+#include <sys/ioctl.h>        // ioctl
+#include <sys/syscall.h>      // SYS_perf_event_open
+
+#include "http.c"
+#include "tpool.h"
+
+#define MICRO_MAX_TESTS 16     // Maximo de pruebas
+#define MICRO_MAX_REQUEST 4096 // Tamanio maximo de una peticion capturada
+#define MICRO_NUM_COUNTERS 4   // Contadores hardware leidos
+#define MICRO_CALIBRATE_NS 20000000 // Duracion minima de la calibracion
+#define MICRO_MAX_CPUS 1024    // CPUs que caben en la mascara de afinidad
+
+// Peticiones reales: Chrome, curl y el formulario POST de index.html
+static const char chrome_request[] =
+  "GET /media/img_small.jpeg HTTP/1.1\r\n"
+  "Host: localhost:3490\r\n"
+  "Connection: keep-alive\r\n"
+  "sec-ch-ua: \"Chromium\";v=\"128\", \"Not;A=Brand\";v=\"24\", "
+  "\"Google Chrome\";v=\"128\"\r\n"
+  "sec-ch-ua-mobile: ?0\r\n"
+  "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, "
+  "like Gecko) Chrome/128.0.0.0 Safari/537.36\r\n"
+  "sec-ch-ua-platform: \"Linux\"\r\n"
+  "Accept: image/avif,image/webp,image/apng,image/svg+xml,image/*,*/*;q=0.8\r\n"
+  "Sec-Fetch-Site: same-origin\r\n"
+  "Sec-Fetch-Mode: no-cors\r\n"
+  "Sec-Fetch-Dest: image\r\n"
+  "Referer: http://localhost:3490/index.html\r\n"
+  "Accept-Encoding: gzip, deflate, br, zstd\r\n"
+  "Accept-Language: es-ES,es;q=0.9,en;q=0.8\r\n"
+  "\r\n";
+static const char curl_request[] =
+  "GET /index.html HTTP/1.1\r\n"
+  "Host: localhost:3490\r\n"
+  "User-Agent: curl/8.5.0\r\n"
+  "Accept: */*\r\n"
+  "\r\n";
+static const char post_request[] =
+  "POST /scripts/test.py HTTP/1.1\r\n"
+  "Host: localhost:3490\r\n"
+  "Content-Type: application/x-www-form-urlencoded\r\n"
+  "Content-Length: 35\r\n"
+  "Origin: http://localhost:3490\r\n"
+  "Referer: http://localhost:3490/index.html\r\n"
+  "\r\n"
+  "variablePOST=hola+mundo+POST&x=1234";
+
+// Paths de la prueba de tipos de contenido
+static const char* content_paths[] = {
+    "www/index.html",          "www/media/img_small.jpeg", "www/media/img1.jpg",
+    "www/media/animacion.gif", "www/media/texto.txt",      "www/media/video.mpeg",
+    "www/scripts/test.py",     "www/docs/manual.pdf",
+};
+
+// Funcion de una prueba: ejecuta iters operaciones
+typedef void (*micro_func_t)(void* arg, size_t iters);
+
+// Prueba
+typedef struct micro_test {
+    const char* name;  // Nombre de la prueba
+    micro_func_t func; // Funcion de la prueba
+    void* arg;         // Argumento de la funcion
+} micro_test_t;
+
+// Peticion que se parsea
+typedef struct micro_parse {
+    const char* data; // Bytes de la peticion
+    size_t len;       // Longitud de la peticion
+} micro_parse_t;
+
+// Ida y vuelta por el pool de hilos
+typedef struct micro_pool {
+    tpool_t* tm; // Pool de un hilo
+    sem_t done;  // El trabajo ha terminado
+} micro_pool_t;
+
+// Resultado de una repeticion
+typedef struct micro_result {
+    double ns;                              // Tiempo por operacion
+    bool counted;                           // Hay contadores
+    double counters[MICRO_NUM_COUNTERS];    // Contadores por operacion
+} micro_result_t;
+
+// Contadores hardware del hilo
+static struct {
+    int fds[MICRO_NUM_COUNTERS]; // Descriptores (el primero es el lider)
+    bool enabled;                // Se han podido abrir todos
+} perf;
+
+static const uint64_t counter_configs[MICRO_NUM_COUNTERS] = {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES,
+    PERF_COUNT_HW_BRANCH_MISSES,
+};
+
+// Evita que el compilador elimine el trabajo de las pruebas
+static volatile size_t sink;
+
+/*******************************************************************************
+ * FUNCION: static uint64_t micro_now()
+ * DESCRIPCION: Obtiene el instante actual en el reloj monotono.
+ * ARGS_OUT: uint64_t - instante actual (ns).
+ ******************************************************************************/
+static uint64_t micro_now();
+
+/*******************************************************************************
+ * FUNCION: static int micro_pin(int* cpu)
+ * ARGS_IN: int* cpu - CPU a la que se fija el hilo (-2: la actual, que se
+ *                     devuelve aqui).
+ * DESCRIPCION: Fija el hilo a una CPU. Se usan las llamadas al sistema
+ *              directamente porque las envolturas de glibc necesitan
+ *              _GNU_SOURCE, que choca con el error_t de http.c.
+ * ARGS_OUT: int - 0 o -1 en caso de error.
+ ******************************************************************************/
+static int micro_pin(int* cpu);
+
+/*******************************************************************************
+ * FUNCION: static void micro_perf_open()
+ * DESCRIPCION: Abre un grupo de contadores hardware para el hilo actual.
+ *              Si alguno falla no se usa ninguno.
+ ******************************************************************************/
+static void micro_perf_open();
+
+/*******************************************************************************
+ * FUNCION: static bool micro_perf_read(uint64_t* values)
+ * ARGS_IN: uint64_t* values - valores de los contadores.
+ * DESCRIPCION: Lee el grupo de contadores escalando por el tiempo que el
+ *              kernel los ha tenido activos si ha tenido que multiplexarlos.
+ * ARGS_OUT: bool - true si se han leido.
+ ******************************************************************************/
+static bool micro_perf_read(uint64_t* values);
+
+/*******************************************************************************
+ * FUNCION: static micro_result_t micro_measure(const micro_test_t* test,
+ *                                              size_t iters)
+ * ARGS_IN: const micro_test_t* test - prueba.
+ *          size_t iters - operaciones.
+ * DESCRIPCION: Ejecuta una repeticion de la prueba con los contadores.
+ * ARGS_OUT: micro_result_t - tiempo y contadores por operacion.
+ ******************************************************************************/
+static micro_result_t micro_measure(const micro_test_t* test, size_t iters);
+
+/*******************************************************************************
+ * FUNCION: static void micro_parse(void* arg, size_t iters)
+ * ARGS_IN: void* arg - peticion (micro_parse_t).
+ *          size_t iters - operaciones.
+ * DESCRIPCION: Parsea la peticion con phr_parse_request como http.c.
+ ******************************************************************************/
+static void micro_parse(void* arg, size_t iters);
+
+/*******************************************************************************
+ * FUNCION: static void micro_pool_job(void* arg)
+ * ARGS_IN: void* arg - prueba del pool (micro_pool_t).
+ * DESCRIPCION: Trabajo vacio que avisa al hilo de la prueba.
+ ******************************************************************************/
+static void micro_pool_job(void* arg);
+
+/*******************************************************************************
+ * FUNCION: static void micro_pool(void* arg, size_t iters)
+ * ARGS_IN: void* arg - prueba del pool (micro_pool_t).
+ *          size_t iters - operaciones.
+ * DESCRIPCION: Encola un trabajo y espera a que se ejecute, una y otra vez.
+ ******************************************************************************/
+static void micro_pool(void* arg, size_t iters);
+
+/*******************************************************************************
+ * FUNCION: static void micro_content_type(void* arg, size_t iters)
+ * ARGS_IN: void* arg - sin uso.
+ *          size_t iters - operaciones.
+ * DESCRIPCION: Obtiene el tipo de contenido de paths de varias extensiones.
+ ******************************************************************************/
+static void micro_content_type(void* arg, size_t iters);
+
+/*******************************************************************************
+ * FUNCION: static void micro_date(void* arg, size_t iters)
+ * ARGS_IN: void* arg - sin uso.
+ *          size_t iters - operaciones.
+ * DESCRIPCION: Genera la fecha de la cabecera Date con http_get_date.
+ ******************************************************************************/
+static void micro_date(void* arg, size_t iters);
+
+/*******************************************************************************
+ * FUNCION: static void micro_header(void* arg, size_t iters)
+ * ARGS_IN: void* arg - sin uso.
+ *          size_t iters - operaciones.
+ * DESCRIPCION: Formatea la cabecera de una respuesta GET igual que
+ *              http_get: fecha, Last-Modified, tipo de contenido y sprintf.
+ ******************************************************************************/
+static void micro_header(void* arg, size_t iters);
+
+int main(int argc, char** argv)
+{
+    int opt, cpu = -2, fd;
+    double target_ms = 200;
+    int reps = 5, r;
+    bool json = false;
+    const char* capture = NULL;
+    char captured[MICRO_MAX_REQUEST];
+    ssize_t captured_len = 0;
+    size_t i, j, num_tests = 0, iters;
+    uint64_t start, elapsed;
+    micro_result_t best, result;
+    micro_test_t tests[MICRO_MAX_TESTS];
+    micro_parse_t parses[4];
+    micro_pool_t pool;
+    tpool_opts_t pool_opts = { 0 };
+    static const char* counter_names[MICRO_NUM_COUNTERS] = {
+        "cycles", "instructions", "cache_misses", "branch_misses"
+    };
+
+    while ((opt = getopt(argc, argv, "c:t:n:r:j")) != -1) {
+        switch (opt) {
+        case 'c':
+            cpu = atoi(optarg);
+            break;
+        case 't':
+            target_ms = atof(optarg);
+            break;
+        case 'n':
+            reps = atoi(optarg);
+            break;
+        case 'r':
+            capture = optarg;
+            break;
+        case 'j':
+            json = true;
+            break;
+        default:
+            fprintf(stderr,
+                    "USO: %s [-c cpu] [-t ms] [-n repeticiones] [-r "
+                    "peticion] [-j]\n",
+                    argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (reps < 1 || target_ms <= 0) {
+        return EXIT_FAILURE;
+    }
+
+    // Se fija el hilo a la CPU en la que esta si no se indica otra. Los
+    // hilos del pool se crean despues y heredan la misma mascara.
+    if (cpu != -1 && micro_pin(&cpu)) {
+        fprintf(stderr, "No se puede fijar la CPU %d\n", cpu);
+        return EXIT_FAILURE;
+    }
+    micro_perf_open();
+
+    parses[0].data = chrome_request;
+    parses[0].len = sizeof(chrome_request) - 1;
+    parses[1].data = curl_request;
+    parses[1].len = sizeof(curl_request) - 1;
+    parses[2].data = post_request;
+    parses[2].len = sizeof(post_request) - 1;
+    tests[num_tests++] = (micro_test_t){ "parse_chrome", micro_parse, &parses[0] };
+    tests[num_tests++] = (micro_test_t){ "parse_curl", micro_parse, &parses[1] };
+    tests[num_tests++] = (micro_test_t){ "parse_post", micro_parse, &parses[2] };
+    if (capture) {
+        fd = open(capture, O_RDONLY);
+        captured_len = fd == -1 ? -1 : read(fd, captured, sizeof(captured));
+        if (fd != -1) {
+            close(fd);
+        }
+        if (captured_len <= 0) {
+            fprintf(stderr, "No se puede leer %s\n", capture);
+            return EXIT_FAILURE;
+        }
+        parses[3].data = captured;
+        parses[3].len = (size_t)captured_len;
+        tests[num_tests++] =
+          (micro_test_t){ "parse_captured", micro_parse, &parses[3] };
+    }
+
+    pool_opts.num_threads = 1;
+    pool.tm = tpool_create_opts(&pool_opts);
+    if (!pool.tm) {
+        fprintf(stderr, "Error creando el pool de hilos\n");
+        return EXIT_FAILURE;
+    }
+    sem_init(&pool.done, 0, 0);
+    tests[num_tests++] = (micro_test_t){ "tpool_roundtrip", micro_pool, &pool };
+    tests[num_tests++] =
+      (micro_test_t){ "content_type", micro_content_type, NULL };
+    tests[num_tests++] = (micro_test_t){ "get_date", micro_date, NULL };
+    tests[num_tests++] = (micro_test_t){ "get_header", micro_header, NULL };
+
+    if (!json) {
+        printf("CPU %d, contadores %s (tpool_roundtrip solo cuenta el hilo "
+               "que encola)\n",
+               cpu,
+               perf.enabled ? "hardware" : "no disponibles");
+        printf("%-16s %10s %10s %10s %10s %6s %10s %10s\n",
+               "prueba",
+               "iters",
+               "ns/op",
+               "ciclos/op",
+               "instr/op",
+               "IPC",
+               "cache/op",
+               "saltos/op");
+    }
+
+    for (i = 0; i < num_tests; i++) {
+        // Calibracion: se dobla hasta tardar lo suficiente para medir y se
+        // ajusta a la duracion pedida
+        iters = 1;
+        do {
+            iters *= 2;
+            start = micro_now();
+            tests[i].func(tests[i].arg, iters);
+            elapsed = micro_now() - start;
+        } while (elapsed < MICRO_CALIBRATE_NS);
+        iters = (size_t)((double)iters * target_ms * 1e6 / elapsed) + 1;
+
+        best.ns = -1;
+        for (r = 0; r < reps; r++) {
+            result = micro_measure(&tests[i], iters);
+            if (best.ns < 0 || result.ns < best.ns) {
+                best = result;
+            }
+        }
+
+        if (json) {
+            printf("{\"name\":\"%s\",\"cpu\":%d,\"iters\":%zu,\"ns_per_op\":%.2f",
+                   tests[i].name,
+                   cpu,
+                   iters,
+                   best.ns);
+            for (j = 0; j < MICRO_NUM_COUNTERS; j++) {
+                if (best.counted) {
+                    printf(",\"%s\":%.2f", counter_names[j], best.counters[j]);
+                } else {
+                    printf(",\"%s\":null", counter_names[j]);
+                }
+            }
+            printf("}\n");
+        } else if (best.counted) {
+            printf("%-16s %10zu %10.1f %10.1f %10.1f %6.2f %10.3f %10.3f\n",
+                   tests[i].name,
+                   iters,
+                   best.ns,
+                   best.counters[0],
+                   best.counters[1],
+                   best.counters[0] ? best.counters[1] / best.counters[0] : 0,
+                   best.counters[2],
+                   best.counters[3]);
+        } else {
+            printf("%-16s %10zu %10.1f %10s %10s %6s %10s %10s\n",
+                   tests[i].name,
+                   iters,
+                   best.ns,
+                   "-",
+                   "-",
+                   "-",
+                   "-",
+                   "-");
+        }
+        fflush(stdout);
+    }
+
+    tpool_destroy(pool.tm);
+    sem_destroy(&pool.done);
+    for (j = 0; perf.enabled && j < MICRO_NUM_COUNTERS; j++) {
+        close(perf.fds[j]);
+    }
+
+    return EXIT_SUCCESS;
+}
+
+static uint64_t micro_now()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static int micro_pin(int* cpu)
+{
+    unsigned long mask[MICRO_MAX_CPUS / (8 * sizeof(unsigned long))];
+    unsigned current;
+
+    if (*cpu == -2) {
+        if (syscall(SYS_getcpu, &current, NULL, NULL)) {
+            return -1;
+        }
+        *cpu = (int)current;
+    }
+    if (*cpu < 0 || *cpu >= MICRO_MAX_CPUS) {
+        return -1;
+    }
+
+    memset(mask, 0, sizeof(mask));
+    mask[*cpu / (8 * sizeof(unsigned long))] |=
+      1UL << (*cpu % (8 * sizeof(unsigned long)));
+
+    return syscall(SYS_sched_setaffinity, 0, sizeof(mask), mask) ? -1 : 0;
+}
+
+static void micro_perf_open()
+{
+    struct perf_event_attr attr;
+    size_t i, j;
+
+    for (i = 0; i < MICRO_NUM_COUNTERS; i++) {
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = counter_configs[i];
+        attr.disabled = i == 0;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP |
+                           PERF_FORMAT_TOTAL_TIME_ENABLED |
+                           PERF_FORMAT_TOTAL_TIME_RUNNING;
+        perf.fds[i] = (int)syscall(SYS_perf_event_open,
+                                   &attr,
+                                   0,
+                                   -1,
+                                   i ? perf.fds[0] : -1,
+                                   0);
+        if (perf.fds[i] == -1) {
+            for (j = 0; j < i; j++) {
+                close(perf.fds[j]);
+            }
+            return;
+        }
+    }
+    perf.enabled = true;
+}
+
+static bool micro_perf_read(uint64_t* values)
+{
+    // nr, time_enabled, time_running y un valor por contador
+    uint64_t data[3 + MICRO_NUM_COUNTERS];
+    size_t i;
+
+    if (!perf.enabled ||
+        read(perf.fds[0], data, sizeof(data)) != (ssize_t)sizeof(data) ||
+        data[0] != MICRO_NUM_COUNTERS || !data[2]) {
+        return false;
+    }
+    for (i = 0; i < MICRO_NUM_COUNTERS; i++) {
+        values[i] = (uint64_t)((double)data[3 + i] * data[1] / data[2]);
+    }
+
+    return true;
+}
+
+static micro_result_t micro_measure(const micro_test_t* test, size_t iters)
+{
+    micro_result_t result;
+    uint64_t start, elapsed, values[MICRO_NUM_COUNTERS];
+    size_t i;
+
+    if (perf.enabled) {
+        ioctl(perf.fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(perf.fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+    start = micro_now();
+    test->func(test->arg, iters);
+    elapsed = micro_now() - start;
+    if (perf.enabled) {
+        ioctl(perf.fds[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    }
+
+    result.ns = (double)elapsed / iters;
+    result.counted = micro_perf_read(values);
+    for (i = 0; i < MICRO_NUM_COUNTERS; i++) {
+        result.counters[i] = result.counted ? (double)values[i] / iters : 0;
+    }
+
+    return result;
+}
+
+static void micro_parse(void* arg, size_t iters)
+{
+    micro_parse_t* parse = (micro_parse_t*)arg;
+    struct phr_header headers[MAX_HTTP_NUM_HEADERS];
+    const char *method, *path;
+    size_t method_len, path_len, num_headers, i;
+    int minor_version, pret = 0;
+
+    for (i = 0; i < iters; i++) {
+        num_headers = MAX_HTTP_NUM_HEADERS;
+        pret = phr_parse_request(parse->data,
+                                 parse->len,
+                                 &method,
+                                 &method_len,
+                                 &path,
+                                 &path_len,
+                                 &minor_version,
+                                 headers,
+                                 &num_headers,
+                                 0);
+    }
+    sink = (size_t)pret;
+}
+
+static void micro_pool_job(void* arg)
+{
+    micro_pool_t* pool = (micro_pool_t*)arg;
+
+    sem_post(&pool->done);
+}
+
+static void micro_pool(void* arg, size_t iters)
+{
+    micro_pool_t* pool = (micro_pool_t*)arg;
+    size_t i;
+
+    for (i = 0; i < iters; i++) {
+        tpool_add_work(pool->tm, micro_pool_job, pool);
+        sem_wait(&pool->done);
+    }
+}
+
+static void micro_content_type(void* arg, size_t iters)
+{
+    size_t i, total = 0;
+    const size_t num = sizeof(content_paths) / sizeof(content_paths[0]);
+
+    (void)arg;
+    for (i = 0; i < iters; i++) {
+        total += (size_t)http_get_content_type(content_paths[i % num]);
+    }
+    sink = total;
+}
+
+static void micro_date(void* arg, size_t iters)
+{
+    char date[MAX_HTTP_DATE_LEN];
+    size_t i, total = 0;
+
+    (void)arg;
+    for (i = 0; i < iters; i++) {
+        http_get_date(date);
+        total += (size_t)date[5];
+    }
+    sink = total;
+}
+
+static void micro_header(void* arg, size_t iters)
+{
+    char date[MAX_HTTP_DATE_LEN], last_modified[MAX_HTTP_DATE_LEN];
+    char response_header[MAX_HTTP_HEADER];
+    time_t mtime = 1617235200;
+    size_t i, total = 0;
+
+    (void)arg;
+    for (i = 0; i < iters; i++) {
+        strftime(last_modified,
+                 MAX_HTTP_DATE_LEN,
+                 "%a, %d %b %Y %H:%M:%S %Z",
+                 gmtime(&mtime));
+        http_get_date(date);
+        sprintf(response_header,
+                get_response,
+                1,
+                date,
+                "",
+                "perico",
+                last_modified,
+                3895,
+                http_get_content_type("www/index.html"));
+        total += strlen(response_header);
+    }
+    sink = total;
+}
@@ -0,0 +1,72 @@
+#!/bin/bash
+###############################################################################
+# ARCHIVO: pgo.sh
+# DESCRIPCION: Compilacion guiada por perfil (make pgo). Compila el servidor
+# instrumentado (BUILD=pgo PGO_PHASE=gen), lo entrena con el banco de pruebas
+# de make bench, lo recompila con el perfil obtenido (PGO_PHASE=use) junto a
+# la version release solo con LTO, y pasa el banco de pruebas a ./server,
+# ./server-release y ./server-pgo con la misma configuracion. Los resultados
+# se guardan en bench/results/pgo-<fecha> y al final se imprime la diferencia
+# de peticiones/s y p99 de cada prueba respecto a ./server.
+#
+# VARIABLES: PGO_TRAIN_DURATION (3 s por prueba de entrenamiento), OPT (-O2)
+# y las de bench.sh, que se aplican a las tres mediciones.
+#
+# FECHA CREACION: 19 Octubre de 2026
+# AUTORES: Javier Mateos Najari, Adrian Sebastian Gil
+###############################################################################
+set -eu
+
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+TRAIN=${PGO_TRAIN_DURATION:-3}
+OUT_DIR=${BENCH_OUT:-$ROOT/bench/results}/pgo-$(date -u +%Y%m%dT%H%M%SZ)
+MAKE=${MAKE:-make}
+
+cd "$ROOT"
+
+# Fase de entrenamiento: los .gcda se escriben junto a los objetos de
+# obj/pgo al terminar el servidor, por eso se recompila en el mismo sitio
+echo "> Compilando servidor instrumentado" >&2
+rm -rf obj/pgo lib/pgo server-pgo
+$MAKE --no-print-directory BUILD=pgo PGO_PHASE=gen exe >&2
+echo "> Entrenando con el banco de pruebas" >&2
+BENCH_SERVER="$ROOT/server-pgo" BENCH_DURATION=$TRAIN BENCH_WARMUP=0 \
+BENCH_OUT="$OUT_DIR/train" ./bench/bench.sh > /dev/null
+if ! ls obj/pgo/*.gcda > /dev/null 2>&1; then
+    echo "El entrenamiento no ha generado perfiles" >&2
+    exit 1
+fi
+
+echo "> Compilando con el perfil" >&2
+rm -f obj/pgo/*.o lib/pgo/*.a server-pgo
+$MAKE --no-print-directory BUILD=pgo PGO_PHASE=use exe >&2
+$MAKE --no-print-directory BUILD=release exe >&2
+
+# Mediciones con la misma configuracion
+for build in server server-release server-pgo; do
+    echo "> Midiendo $build" >&2
+    BENCH_SERVER="$ROOT/$build" BENCH_OUT="$OUT_DIR/$build" \
+    ./bench/bench.sh > /dev/null
+done
+
+# Prueba, peticiones/s y p99 de cada resultado
+scenarios() {
+    grep '"label"' "$1"/*.json |
+        sed -E 's/.*"label":"([^"]*)".*"rps":([0-9.]+).*"p99":([0-9]+).*/\1 \2 \3/'
+}
+
+{
+    printf '%-16s %-15s %10s %8s %10s %8s\n' \
+           prueba build req/s delta p99_us delta
+    for build in server-release server-pgo; do
+        join <(scenarios "$OUT_DIR/server" | sort) \
+             <(scenarios "$OUT_DIR/$build" | sort) |
+            awk -v build="$build" '{
+                rps = $2 > 0 ? sprintf("%+.1f%%", ($4 - $2) * 100 / $2) : "-"
+                p99 = $3 > 0 ? sprintf("%+.1f%%", ($5 - $3) * 100 / $3) : "-"
+                printf "%-16s %-15s %10s %8s %10s %8s\n", \
+                       $1, build, $4, rps, $5, p99
+            }'
+    done
+} | tee "$OUT_DIR/delta.txt"
+echo "Resultados en $OUT_DIR"
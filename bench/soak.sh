@@ -0,0 +1,215 @@
+#!/bin/bash
+###############################################################################
+# ARCHIVO: soak.sh
+# DESCRIPCION: Prueba de resistencia del servidor (make soak). Arranca ./server
+# como bench.sh y durante horas le envia por rondas trafico mixto: peticiones
+# validas (ficheros y scripts) con bench/loadgen junto a peticiones que
+# acaban en error (404, 415, scripts inexistentes) y, por un socket directo,
+# peticiones mal formadas, metodos no soportados, cabeceras enormes y
+# conexiones cortadas a mitad. Al final de cada ronda toma de /proc/<pid> la
+# memoria residente, los descriptores abiertos y los hilos, y de loadgen los
+# percentiles de latencia, y lo anade a un JSON lines en bench/results. Las
+# fugas se buscan en la memoria anonima (RssAnon): la residente total crece
+# al escribirse el log de accesos proyectado en memoria.
+#
+# Al terminar divide las muestras (sin las de calentamiento) en cuatro
+# ventanas y falla si el minimo de un recurso crece en todas ellas, que es
+# la forma de una fuga lenta, o si la p99 de la ultima ventana supera en
+# SOAK_DRIFT veces la de la primera. Si no hay al menos cuatro muestras tras
+# el calentamiento el resultado no es concluyente y tambien sale con error.
+#
+# VARIABLES: SOAK_PORT (3498), SOAK_DURATION (3600 s), SOAK_INTERVAL (30 s
+# por ronda), SOAK_RATE (20 peticiones/s, por debajo de lo que admiten los
+# scripts), SOAK_CONNS (16), SOAK_SKIP (3 rondas de calentamiento),
+# SOAK_ANON_SLACK (2048 KB de crecimiento tolerado), SOAK_DRIFT (2),
+# SOAK_IO_MODE (el de server.ini) y SOAK_OUT (bench/results).
+#
+# FECHA CREACION: 19 Octubre de 2026
+# AUTORES: Javier Mateos Najari, Adrian Sebastian Gil
+###############################################################################
+set -eu
+
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+PORT=${SOAK_PORT:-3498}
+DURATION=${SOAK_DURATION:-3600}
+INTERVAL=${SOAK_INTERVAL:-30}
+RATE=${SOAK_RATE:-20}
+CONNS=${SOAK_CONNS:-16}
+SKIP=${SOAK_SKIP:-3}
+ANON_SLACK=${SOAK_ANON_SLACK:-2048}
+DRIFT=${SOAK_DRIFT:-2}
+IO_MODE=${SOAK_IO_MODE:-}
+OUT_DIR=${SOAK_OUT:-$ROOT/bench/results}
+LOADGEN=$ROOT/bench/loadgen
+RUN=$(mktemp -d /tmp/server-soak.XXXXXX)
+PID=
+
+cleanup() {
+    if [ -n "$PID" ] && kill -0 "$PID" 2>/dev/null; then
+        kill -INT "$PID"
+        wait "$PID" || true
+    fi
+    rm -rf "$RUN"
+}
+trap cleanup EXIT
+
+# Corpus: ficheros validos, uno sin extension y otro de tipo desconocido
+mkdir -p "$RUN/www/soak" "$RUN/www/scripts"
+yes "perico soak corpus" | head -c 1024 > "$RUN/www/soak/1k.html"
+yes "perico soak corpus" | head -c 16384 > "$RUN/www/soak/16k.html"
+yes "perico soak corpus" | head -c 1024 > "$RUN/www/soak/LEEME"
+yes "perico soak corpus" | head -c 1024 > "$RUN/www/soak/datos.xyz"
+cp "$ROOT/www/scripts/test.py" "$RUN/www/scripts/"
+
+sed -e "s/^listen_port *=.*/listen_port = $PORT/" \
+    -e "s/^daemon *=.*/daemon = 0/" \
+    -e "s/^debug *=.*/debug = 0/" \
+    -e "s/^;file *=/file =/" \
+    -e "s/^admin_port *=/;admin_port =/" \
+    -e "s/^server_root *=.*/server_root = www/" \
+    "$ROOT/server.ini" > "$RUN/server.ini"
+if [ -n "$IO_MODE" ]; then
+    sed -i "s/^io_mode *=.*/io_mode = $IO_MODE/" "$RUN/server.ini"
+fi
+IO_MODE=$(sed -n "s/^io_mode *= *//p" "$RUN/server.ini")
+
+(cd "$RUN" && exec "$ROOT/server" > server.out 2>&1) &
+PID=$!
+for _ in $(seq 50); do
+    if (exec 3<> "/dev/tcp/127.0.0.1/$PORT") 2>/dev/null; then
+        break
+    fi
+    sleep 0.1
+done
+
+# Envia una peticion en bruto y cuenta si llega una linea de estado. Con
+# "corta" se cierra sin esperar respuesta.
+RAW_SENT=0
+RAW_ANSWERED=0
+# El servidor puede cerrar antes de leer una peticion en bruto entera
+trap "" PIPE
+raw() {
+    local line=
+    RAW_SENT=$((RAW_SENT + 1))
+    exec 3<> "/dev/tcp/127.0.0.1/$PORT" || return 0
+    printf '%b' "$1" >&3 2>/dev/null || true
+    if [ "${2:-}" != corta ] && read -r -t 5 line <&3 &&
+       [ "${line#HTTP/}" != "$line" ]; then
+        RAW_ANSWERED=$((RAW_ANSWERED + 1))
+    fi
+    exec 3<&-
+}
+
+BIG=$(head -c 16384 /dev/zero | tr '\0' 'a')
+invalid() {
+    local i
+    for i in $(seq 10); do
+        raw 'PERICO\r\n\r\n'
+        raw 'DELETE /soak/1k.html HTTP/1.1\r\nHost: soak\r\n\r\n'
+        raw "GET /soak/1k.html HTTP/1.1\r\nX-Relleno: $BIG\r\n\r\n"
+        raw 'GET /soak/1k.html HTTP/1.1\r\nHost:' corta
+        raw 'POST /scripts/test.py HTTP/1.1\r\nContent-Length: 100\r\n\r\nab' corta
+    done
+}
+
+# Recurso de /proc/<pid>/status en la unidad del fichero
+proc_status() {
+    sed -n "s/^$1:[[:space:]]*\([0-9]*\).*/\1/p" "/proc/$PID/status"
+}
+
+# Campo numerico de la salida JSON de loadgen
+field() {
+    sed -n "s/.*\"$1\":\([0-9.]*\).*/\1/p" <<< "$2"
+}
+
+mkdir -p "$OUT_DIR"
+OUT="$OUT_DIR/soak-$(date -u +%Y%m%dT%H%M%SZ).jsonl"
+COMMIT=$(git -C "$ROOT" rev-parse --short HEAD 2>/dev/null || echo unknown)
+printf '{"timestamp":"%s","commit":"%s","io_mode":"%s","duration_s":%s,"interval_s":%s,"rate":%s}\n' \
+       "$(date -u +%Y-%m-%dT%H:%M:%SZ)" "$COMMIT" "$IO_MODE" "$DURATION" \
+       "$INTERVAL" "$RATE" > "$OUT"
+
+printf '%6s %8s %10s %10s %6s %8s %10s %10s %8s\n' \
+       ronda segundo rss_kb anon_kb fds hilos p50_us p99_us errores
+START=$SECONDS
+ROUND=0
+while [ $((SECONDS - START)) -lt "$DURATION" ]; do
+    ROUND=$((ROUND + 1))
+    "$LOADGEN" -p "$PORT" -t 1 -c "$CONNS" -r "$RATE" -d "$INTERVAL" -w 0 \
+               -T 5000 -l "round-$ROUND" \
+               /soak/1k.html /soak/16k.html /soak/1k.html \
+               "/scripts/test.py?soak=1" "POST:/scripts/test.py" \
+               /soak/falta.html /soak/LEEME /soak/datos.xyz \
+               "/scripts/falta.py?soak=1" > "$RUN/round.json" &
+    LOAD=$!
+    invalid
+    wait "$LOAD" || true
+    RESULT=$(cat "$RUN/round.json")
+
+    if ! kill -0 "$PID" 2>/dev/null; then
+        echo "El servidor ha terminado en la ronda $ROUND" >&2
+        printf '{"round":%s,"verdict":"fail","reason":"server exited"}\n' \
+               "$ROUND" >> "$OUT"
+        exit 1
+    fi
+    # Los cierres de la ronda llegan al servidor antes de medir
+    sleep 1
+    RSS=$(proc_status VmRSS)
+    ANON=$(proc_status RssAnon)
+    THREADS=$(proc_status Threads)
+    FDS=$(ls "/proc/$PID/fd" | wc -l)
+    P50=$(field p50 "$RESULT")
+    P99=$(field p99 "$RESULT")
+    ERRORS=$(sed -n 's/.*"errors":{"connect":\([0-9]*\),"read":\([0-9]*\),"timeout":\([0-9]*\),"parse":\([0-9]*\)}.*/\1 \2 \3 \4/p' <<< "$RESULT" |
+             awk '{ print $1 + $2 + $3 + $4 }')
+
+    printf '{"round":%s,"elapsed_s":%s,"rss_kb":%s,"anon_kb":%s,"fds":%s,"threads":%s,"raw_sent":%s,"raw_answered":%s,"load":%s}\n' \
+           "$ROUND" $((SECONDS - START)) "$RSS" "$ANON" "$FDS" "$THREADS" \
+           "$RAW_SENT" "$RAW_ANSWERED" "$RESULT" >> "$OUT"
+    printf '%6s %8s %10s %10s %6s %8s %10s %10s %8s\n' "$ROUND" \
+           $((SECONDS - START)) "$RSS" "$ANON" "$FDS" "$THREADS" "$P50" "$P99" \
+           "$ERRORS"
+done
+
+# Tendencias: minimo de cada recurso y mediana de la p99 por ventana
+VERDICT=$(grep '"round"' "$OUT" | sed -E \
+    's/.*"anon_kb":([0-9]+),"fds":([0-9]+),"threads":([0-9]+).*"p99":([0-9]+).*/\1 \2 \3 \4/' |
+    awk -v skip="$SKIP" -v slack="$ANON_SLACK" -v drift="$DRIFT" '
+    NR > skip { n++; anon[n] = $1; fds[n] = $2; thr[n] = $3; p99[n] = $4 }
+    function grows(v, tol,    w, i, lo, hi, m, prev, first) {
+        for (w = 0; w < 4; w++) {
+            lo = int(w * n / 4) + 1; hi = int((w + 1) * n / 4)
+            m = v[lo]
+            for (i = lo + 1; i <= hi; i++) if (v[i] < m) m = v[i]
+            if (w == 0) first = m
+            else if (m <= prev) return 0
+            prev = m
+        }
+        return prev - first > tol
+    }
+    function median(v, lo, hi,    i, j, t, k, a) {
+        k = 0
+        for (i = lo; i <= hi; i++) a[++k] = v[i]
+        for (i = 2; i <= k; i++)
+            for (j = i; j > 1 && a[j - 1] > a[j]; j--) {
+                t = a[j]; a[j] = a[j - 1]; a[j - 1] = t
+            }
+        return a[int((k + 1) / 2)]
+    }
+    END {
+        if (n < 4) { print "inconclusive insufficient samples"; exit }
+        reason = ""
+        if (grows(anon, slack)) reason = reason " memory"
+        if (grows(fds, 0)) reason = reason " fds"
+        if (grows(thr, 0)) reason = reason " threads"
+        first = median(p99, 1, int(n / 4))
+        last = median(p99, int(3 * n / 4) + 1, n)
+        if (first > 0 && last > first * drift) reason = reason " latency"
+        print (reason == "" ? "pass" : "fail") reason
+    }')
+
+read -r RESULT REASON <<< "$VERDICT"
+printf '{"verdict":"%s","reason":"%s"}\n' "$RESULT" "${REASON:-}" >> "$OUT"
+echo "Resultado: $VERDICT"
+echo "Muestras en $OUT"
+[ "$RESULT" = pass ]
@@ -0,0 +1,467 @@
+/*****************************************************************************
+ * ARCHIVO: tpool_bench.c
+ * DESCRIPCION: Microbenchmark de contencion de la cola de trabajo del pool de
+ * hilos. Compara la cola enlazada protegida por un mutex (implementacion
+ * original de tpool.c) con la cola MPMC sin bloqueos (mpmc.c) usando de 1 a
+ * 64 productores y otros tantos consumidores. Despues mide, con el pool real
+ * en reposo, la latencia desde tpool_add_work hasta que un hilo empieza el
+ * trabajo y los cambios de contexto por trabajo. Por ultimo compara el modo
+ * de cola unica con el de robo de trabajo en una carga en la que cada
+ * trabajo crea otros (rendimiento y latencia de cola).
+ *
+ * USO: ./tpool_bench [operaciones_por_productor] [trabajos_de_despertar]
+ *                    [trabajos_raiz]
+ *
+ * FECHA CREACION: 19 Octubre de 2026
+ * AUTORES: Javier Mateos Najari, Adrian Sebastian Gil
+ *****************************************************************************/
+#include <pthread.h>
+#include <sched.h>        // sched_yield
+#include <semaphore.h>    // sem_t
+#include <sys/resource.h> // getrusage
+#include <stdatomic.h> // atomic_size_t
+#include <stdbool.h>   // bool
+#include <stdio.h>     // printf
+#include <stdlib.h>    // malloc
+#include <time.h>      // clock_gettime
+#include <unistd.h>    // usleep
+
+#include "mpmc.h"
+#include "tpool.h"
+
+#define BENCH_QUEUE_SIZE 1024  // Capacidad de ambas colas
+#define BENCH_DEFAULT_OPS 200000 // Operaciones por productor por defecto
+#define BENCH_MAX_THREADS 64   // Maximo de productores (y de consumidores)
+#define BENCH_WAKE_JOBS 2000   // Trabajos de la prueba de despertar
+#define BENCH_WAKE_IDLE_US 200 // Reposo entre trabajos para que duerman
+#define BENCH_TREE_ROOTS 2000  // Trabajos raiz de la prueba de modos
+#define BENCH_TREE_FANOUT 4    // Hijos que crea cada trabajo
+#define BENCH_TREE_DEPTH 3     // Niveles de hijos bajo cada raiz
+#define BENCH_TREE_SPIN 200    // Iteraciones de calculo de cada trabajo
+
+// Trabajo de prueba (mismo tamanio que el trabajo del pool)
+typedef struct bench_work {
+    void (*func)(void*); // Funcion trabajo
+    void* arg;           // Argumentos de la funcion
+} bench_work_t;
+
+// Nodo de la cola enlazada original
+typedef struct bench_node {
+    bench_work_t work;       // Trabajo
+    struct bench_node* next; // Siguiente nodo
+} bench_node_t;
+
+// Cola enlazada original con mutex
+typedef struct bench_locked {
+    bench_node_t* first;   // Primer elemento de la cola
+    bench_node_t* last;    // Ultimo elemento de la cola
+    size_t cnt;            // Tamanio actual de la cola
+    pthread_mutex_t mutex; // Sincroniza el acceso a la cola
+} bench_locked_t;
+
+// Operaciones de una cola
+typedef struct bench_queue {
+    const char* name;                         // Nombre de la implementacion
+    bool (*push)(void* q, bench_work_t* w);   // Inserta sin bloquear
+    bool (*pop)(void* q, bench_work_t* w);    // Extrae sin bloquear
+    void* q;                                  // Cola
+} bench_queue_t;
+
+// Estado de la prueba de despertar
+typedef struct bench_wake {
+    struct timespec added; // Instante en que se encola el trabajo
+    double* lat;           // Latencias de cada trabajo (ns)
+    size_t i;              // Trabajo en curso
+    sem_t done;            // Indica que el trabajo ha empezado
+} bench_wake_t;
+
+// Estado de la prueba de modos
+typedef struct bench_tree {
+    tpool_t* tm;              // Pool que se mide
+    struct bench_task* tasks; // Trabajos reservados de antemano
+    double* lat;              // Latencias de cada trabajo (ns)
+    atomic_size_t next;       // Siguiente trabajo libre
+    atomic_size_t done;       // Trabajos terminados
+    size_t total;             // Trabajos totales
+    sem_t finished;           // Indica que han terminado todos los trabajos
+} bench_tree_t;
+
+// Trabajo de la prueba de modos
+typedef struct bench_task {
+    bench_tree_t* tree;    // Prueba a la que pertenece
+    struct timespec added; // Instante en que se encola
+    size_t id;             // Indice del trabajo
+    int depth;             // Nivel del trabajo
+} bench_task_t;
+
+// Estado compartido de una ejecucion
+typedef struct bench_run {
+    bench_queue_t* queue;     // Cola que se mide
+    size_t ops;               // Operaciones por productor
+    atomic_size_t consumed;   // Trabajos extraidos
+    size_t total;             // Trabajos totales a extraer
+    pthread_barrier_t start;  // Arranque simultaneo
+} bench_run_t;
+
+static double elapsed_ns(struct timespec* start, struct timespec* end)
+{
+    return (end->tv_sec - start->tv_sec) * 1e9 +
+           (end->tv_nsec - start->tv_nsec);
+}
+
+static bool locked_push(void* q, bench_work_t* w)
+{
+    bench_locked_t* l = (bench_locked_t*)q;
+    bench_node_t* node = NULL;
+
+    // Como en tpool_add_work, el nodo se reserva fuera del mutex
+    node = (bench_node_t*)malloc(sizeof(bench_node_t));
+    if (!node) {
+        return false;
+    }
+    node->work = *w;
+    node->next = NULL;
+
+    pthread_mutex_lock(&l->mutex);
+    if (l->cnt >= BENCH_QUEUE_SIZE) {
+        pthread_mutex_unlock(&l->mutex);
+        free(node);
+        return false;
+    }
+    l->cnt++;
+    if (!l->first) {
+        l->first = node;
+        l->last = node;
+    } else {
+        l->last->next = node;
+        l->last = node;
+    }
+    pthread_mutex_unlock(&l->mutex);
+
+    return true;
+}
+
+static bool locked_pop(void* q, bench_work_t* w)
+{
+    bench_locked_t* l = (bench_locked_t*)q;
+    bench_node_t* node = NULL;
+
+    pthread_mutex_lock(&l->mutex);
+    node = l->first;
+    if (!node) {
+        pthread_mutex_unlock(&l->mutex);
+        return false;
+    }
+    l->first = node->next;
+    if (!l->first) {
+        l->last = NULL;
+    }
+    l->cnt--;
+    pthread_mutex_unlock(&l->mutex);
+
+    *w = node->work;
+    free(node);
+
+    return true;
+}
+
+static bool ring_push(void* q, bench_work_t* w)
+{
+    return mpmc_push((mpmc_t*)q, w);
+}
+
+static bool ring_pop(void* q, bench_work_t* w)
+{
+    return mpmc_pop((mpmc_t*)q, w);
+}
+
+static void* producer(void* arg)
+{
+    bench_run_t* run = (bench_run_t*)arg;
+    bench_work_t work = { NULL, NULL };
+    size_t i;
+
+    pthread_barrier_wait(&run->start);
+    for (i = 0; i < run->ops; i++) {
+        work.arg = (void*)i;
+        while (!run->queue->push(run->queue->q, &work)) {
+            sched_yield();
+        }
+    }
+
+    return NULL;
+}
+
+static void* consumer(void* arg)
+{
+    bench_run_t* run = (bench_run_t*)arg;
+    bench_work_t work;
+
+    pthread_barrier_wait(&run->start);
+    while (atomic_load_explicit(&run->consumed, memory_order_relaxed) <
+           run->total) {
+        if (run->queue->pop(run->queue->q, &work)) {
+            atomic_fetch_add_explicit(&run->consumed, 1, memory_order_relaxed);
+        } else {
+            sched_yield();
+        }
+    }
+
+    return NULL;
+}
+
+static double bench(bench_queue_t* queue, int threads, size_t ops)
+{
+    bench_run_t run;
+    pthread_t tids[2 * BENCH_MAX_THREADS];
+    struct timespec start, end;
+    int i;
+
+    run.queue = queue;
+    run.ops = ops;
+    run.total = ops * threads;
+    atomic_init(&run.consumed, 0);
+    pthread_barrier_init(&run.start, NULL, 2 * threads + 1);
+
+    for (i = 0; i < threads; i++) {
+        pthread_create(&tids[i], NULL, producer, &run);
+        pthread_create(&tids[threads + i], NULL, consumer, &run);
+    }
+
+    pthread_barrier_wait(&run.start);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < 2 * threads; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    pthread_barrier_destroy(&run.start);
+
+    // Nanosegundos por trabajo (push + pop)
+    return elapsed_ns(&start, &end) / (double)run.total;
+}
+
+static int cmp_double(const void* a, const void* b)
+{
+    double x = *(const double*)a, y = *(const double*)b;
+
+    return (x > y) - (x < y);
+}
+
+static void wake_job(void* arg)
+{
+    bench_wake_t* wake = (bench_wake_t*)arg;
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    wake->lat[wake->i] = elapsed_ns(&wake->added, &now);
+    sem_post(&wake->done);
+}
+
+static void bench_wake(int threads, size_t jobs)
+{
+    bench_wake_t wake;
+    struct rusage before, after;
+    tpool_opts_t opts = { 0 };
+    tpool_t* tm = NULL;
+    long csw;
+
+    opts.num_threads = threads;
+    opts.queue_size = BENCH_QUEUE_SIZE;
+    tm = tpool_create_opts(&opts);
+    wake.lat = (double*)malloc(jobs * sizeof(double));
+    if (!tm || !wake.lat) {
+        fprintf(stderr, "Error creando el pool de hilos\n");
+        tpool_destroy(tm);
+        free(wake.lat);
+        return;
+    }
+    sem_init(&wake.done, 0, 0);
+
+    // Dejamos que todos los hilos lleguen a dormir
+    usleep(10000);
+    getrusage(RUSAGE_SELF, &before);
+    for (wake.i = 0; wake.i < jobs; wake.i++) {
+        clock_gettime(CLOCK_MONOTONIC, &wake.added);
+        tpool_add_work(tm, wake_job, &wake);
+        sem_wait(&wake.done);
+        usleep(BENCH_WAKE_IDLE_US);
+    }
+    getrusage(RUSAGE_SELF, &after);
+
+    // Cambios de contexto de todo el proceso (incluye los del productor)
+    csw = (after.ru_nvcsw - before.ru_nvcsw) +
+          (after.ru_nivcsw - before.ru_nivcsw);
+
+    qsort(wake.lat, jobs, sizeof(double), cmp_double);
+    printf("%8d %14.1f %14.1f %14.2f\n",
+           threads,
+           wake.lat[jobs / 2] / 1e3,
+           wake.lat[jobs * 99 / 100] / 1e3,
+           (double)csw / jobs);
+
+    tpool_destroy(tm);
+    sem_destroy(&wake.done);
+    free(wake.lat);
+}
+
+static void tree_job(void* arg);
+
+static void tree_spawn(bench_tree_t* tree, int depth)
+{
+    bench_task_t* task = NULL;
+    size_t id;
+
+    id = atomic_fetch_add_explicit(&tree->next, 1, memory_order_relaxed);
+    task = &tree->tasks[id];
+    task->tree = tree;
+    task->id = id;
+    task->depth = depth;
+    clock_gettime(CLOCK_MONOTONIC, &task->added);
+    if (!tpool_try_add_work(tree->tm, tree_job, task)) {
+        // Cola llena, lo ejecuta el propio hilo
+        tree_job(task);
+    }
+}
+
+static void tree_job(void* arg)
+{
+    bench_task_t* task = (bench_task_t*)arg;
+    bench_tree_t* tree = task->tree;
+    struct timespec now;
+    volatile unsigned x = 0;
+    int i;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    tree->lat[task->id] = elapsed_ns(&task->added, &now);
+
+    for (i = 0; i < BENCH_TREE_SPIN; i++) {
+        x += i;
+    }
+    if (task->depth < BENCH_TREE_DEPTH) {
+        for (i = 0; i < BENCH_TREE_FANOUT; i++) {
+            tree_spawn(tree, task->depth + 1);
+        }
+    }
+
+    if (atomic_fetch_add(&tree->done, 1) + 1 == tree->total) {
+        sem_post(&tree->finished);
+    }
+}
+
+static void bench_tree(tpool_mode_t mode, int threads, size_t roots)
+{
+    bench_tree_t tree;
+    tpool_opts_t opts = { 0 };
+    tpool_stats_t stats;
+    struct timespec start, end;
+    size_t per_root = 1, level = 1, i;
+    int d;
+
+    for (d = 0; d < BENCH_TREE_DEPTH; d++) {
+        level *= BENCH_TREE_FANOUT;
+        per_root += level;
+    }
+
+    opts.num_threads = threads;
+    opts.queue_size = BENCH_QUEUE_SIZE;
+    opts.mode = mode;
+    tree.tm = tpool_create_opts(&opts);
+    tree.total = roots * per_root;
+    tree.tasks = (bench_task_t*)malloc(tree.total * sizeof(bench_task_t));
+    tree.lat = (double*)malloc(tree.total * sizeof(double));
+    if (!tree.tm || !tree.tasks || !tree.lat) {
+        fprintf(stderr, "Error creando el pool de hilos\n");
+        tpool_destroy(tree.tm);
+        free(tree.tasks);
+        free(tree.lat);
+        return;
+    }
+    atomic_init(&tree.next, 0);
+    atomic_init(&tree.done, 0);
+    sem_init(&tree.finished, 0, 0);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < roots; i++) {
+        tree_spawn(&tree, 0);
+    }
+    sem_wait(&tree.finished);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    tpool_get_stats(tree.tm, &stats);
+
+    qsort(tree.lat, tree.total, sizeof(double), cmp_double);
+    printf("%8s %8d %14.0f %10.1f %10.1f %10zu\n",
+           mode == TPOOL_MODE_STEAL ? "steal" : "fifo",
+           threads,
+           tree.total / (elapsed_ns(&start, &end) / 1e9),
+           tree.lat[tree.total / 2] / 1e3,
+           tree.lat[tree.total * 99 / 100] / 1e3,
+           stats.stolen);
+
+    tpool_destroy(tree.tm);
+    sem_destroy(&tree.finished);
+    free(tree.tasks);
+    free(tree.lat);
+}
+
+int main(int argc, char** argv)
+{
+    int threads;
+    size_t ops = BENCH_DEFAULT_OPS, jobs = BENCH_WAKE_JOBS;
+    size_t roots = BENCH_TREE_ROOTS;
+    double locked_ns, ring_ns;
+    bench_locked_t locked = { NULL, NULL, 0, PTHREAD_MUTEX_INITIALIZER };
+    bench_queue_t locked_queue = { "mutex", locked_push, locked_pop, &locked };
+    bench_queue_t ring_queue = { "mpmc", ring_push, ring_pop, NULL };
+
+    if (argc > 1) {
+        ops = strtoul(argv[1], NULL, 10);
+    }
+    if (argc > 2) {
+        jobs = strtoul(argv[2], NULL, 10);
+    }
+    if (!jobs) {
+        jobs = 1;
+    }
+    if (argc > 3) {
+        roots = strtoul(argv[3], NULL, 10);
+    }
+    if (!roots) {
+        roots = 1;
+    }
+
+    ring_queue.q = mpmc_create(BENCH_QUEUE_SIZE, sizeof(bench_work_t));
+    if (!ring_queue.q) {
+        fprintf(stderr, "Error creando la cola mpmc\n");
+        return EXIT_FAILURE;
+    }
+
+    printf("%8s %14s %14s %8s\n", "threads", "mutex ns/op", "mpmc ns/op",
+           "speedup");
+    for (threads = 1; threads <= BENCH_MAX_THREADS; threads *= 2) {
+        // Repartimos las operaciones para que cada fila dure parecido
+        locked_ns = bench(&locked_queue, threads, ops / threads);
+        ring_ns = bench(&ring_queue, threads, ops / threads);
+        printf("%8d %14.1f %14.1f %7.2fx\n",
+               threads,
+               locked_ns,
+               ring_ns,
+               locked_ns / ring_ns);
+    }
+
+    mpmc_destroy((mpmc_t*)ring_queue.q);
+
+    printf("\n%8s %14s %14s %14s\n", "threads", "wake p50 us", "wake p99 us",
+           "csw/job");
+    for (threads = 1; threads <= BENCH_MAX_THREADS; threads *= 4) {
+        bench_wake(threads, jobs);
+    }
+
+    printf("\n%8s %8s %14s %10s %10s %10s\n", "mode", "threads", "jobs/s",
+           "p50 us", "p99 us", "stolen");
+    for (threads = 1; threads <= BENCH_MAX_THREADS; threads *= 4) {
+        bench_tree(TPOOL_MODE_FIFO, threads, roots);
+        bench_tree(TPOOL_MODE_STEAL, threads, roots);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,98 @@
+/*****************************************************************************
+ * ARCHIVO: acclog.h
+ * DESCRIPCION: Interfaz de programacion del log de accesos. Cada peticion
+ * deja un registro binario de tamanio fijo en un fichero proyectado en
+ * memoria con mmap, que rota al llenarse. Cada hilo reserva bloques de
+ * registros del fichero y escribe en ellos sin bloqueos ni llamadas al
+ * sistema. tools/acclog_dump.c convierte los ficheros a JSON lines.
+ *
+ * FORMATO: una cabecera de ACCLOG_RECORD_SIZE bytes (acclog_header_t)
+ * seguida de registros (acclog_record_t) en el orden de la maquina. Los
+ * registros con time_us a 0 son huecos de bloques sin llenar.
+ *
+ * FECHA CREACION: 19 Octubre de 2026
+ * AUTORES: Javier Mateos Najari, Adrian Sebastian Gil
+ *****************************************************************************/
+#ifndef __ACCLOG_H__
+#define __ACCLOG_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define ACCLOG_MAGIC "ACCLOG01"  // Identifica un fichero del log de accesos
+#define ACCLOG_RECORD_SIZE 128   // Tamanio de la cabecera y de un registro
+#define ACCLOG_PATH_SIZE 82      // Bytes del path que se guardan
+
+// Metodos de la peticion
+#define ACCLOG_OTHER 0   // Metodo no soportado o peticion sin parsear
+#define ACCLOG_GET 1     // GET
+#define ACCLOG_POST 2    // POST
+#define ACCLOG_OPTIONS 3 // OPTIONS
+
+// Indicadores de la peticion
+#define ACCLOG_KEEPALIVE 0x01 // No es la primera peticion de la conexion
+#define ACCLOG_DEFERRED 0x02  // Se ha ejecutado en el pool de scripts
+
+// Cabecera de un fichero
+typedef struct acclog_header {
+    char magic[8];        // ACCLOG_MAGIC
+    uint32_t record_size; // ACCLOG_RECORD_SIZE
+    uint32_t pid;         // Proceso que escribe el fichero
+    uint64_t created_us;  // Creacion del fichero (us desde epoch)
+    char reserved[ACCLOG_RECORD_SIZE - 24];
+} acclog_header_t;
+
+// Registro de una peticion
+typedef struct acclog_record {
+    uint64_t time_us;    // Llegada de la peticion (us desde epoch, 0: hueco)
+    uint64_t bytes;      // Bytes de la respuesta
+    uint32_t addr;       // IPv4 del cliente (orden de red)
+    uint16_t port;       // Puerto del cliente (orden de red)
+    uint16_t status;     // Codigo de estado HTTP (0: sin respuesta)
+    uint32_t wait_us;    // Espera al primer byte (keep-alive)
+    uint32_t header_us;  // Recepcion de la cabecera y el cuerpo
+    uint32_t handler_us; // Fichero o script, incluida la cola de scripts
+    uint32_t send_us;    // Envio de la respuesta
+    uint8_t method;      // ACCLOG_GET, ACCLOG_POST...
+    uint8_t version;     // Version menor de HTTP/1.x
+    uint8_t flags;       // ACCLOG_KEEPALIVE | ACCLOG_DEFERRED
+    uint8_t reserved;    // Sin uso
+    uint16_t path_len;   // Longitud completa del path
+    char path[ACCLOG_PATH_SIZE]; // Path (truncado, sin terminar en '\0')
+} acclog_record_t;
+
+// Opciones del log de accesos
+typedef struct acclog_opts {
+    const char* path; // Fichero del log; los rotados son path.1 ... path.keep
+    size_t max_size;  // Tamanio de cada fichero (bytes, 0: 64 MB)
+    int keep;         // Ficheros rotados que se conservan (0: 4)
+} acclog_opts_t;
+
+/*******************************************************************************
+ * FUNCION: int acclog_init(const acclog_opts_t* opts)
+ * ARGS_IN: const acclog_opts_t* opts - opciones del log.
+ * DESCRIPCION: Crea el fichero del log y lo proyecta en memoria. Si ya existe
+ *              se rota. Hay un unico log de accesos por proceso.
+ * ARGS_OUT: int - 0 o -1 en caso de error.
+ ******************************************************************************/
+int acclog_init(const acclog_opts_t* opts);
+
+/*******************************************************************************
+ * FUNCION: void acclog_destroy()
+ * DESCRIPCION: Recorta el fichero actual a lo escrito y deshace las
+ *              proyecciones. Ningun otro hilo debe estar escribiendo.
+ ******************************************************************************/
+void acclog_destroy();
+
+/*******************************************************************************
+ * FUNCION: bool acclog_write(const acclog_record_t* record)
+ * ARGS_IN: const acclog_record_t* record - registro que se copia.
+ * DESCRIPCION: Copia el registro en el bloque del hilo. Solo toma un mutex
+ *              cada vez que el bloque se llena.
+ * ARGS_OUT: bool - true si se escribe o false si el log no esta iniciado o
+ *                  no se puede rotar.
+ ******************************************************************************/
+bool acclog_write(const acclog_record_t* record);
+
+#endif /* __ACCLOG_H__ */
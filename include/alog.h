@@ -0,0 +1,66 @@
+/*****************************************************************************
+ * ARCHIVO: alog.h
+ * DESCRIPCION: Interfaz de programacion del log asincrono. Cada hilo deja sus
+ * mensajes en su propio buffer circular sin bloqueos y un hilo escritor los
+ * recoge periodicamente y los escribe por lotes en un fichero (o en
+ * stdout/stderr) o en syslog. Si el buffer de un hilo esta lleno el mensaje
+ * se descarta y se cuenta: escribir en el log nunca bloquea.
+ *
+ * FECHA CREACION: 19 Octubre de 2026
+ * AUTORES: Javier Mateos Najari, Adrian Sebastian Gil
+ *****************************************************************************/
+#ifndef __ALOG_H__
+#define __ALOG_H__
+
+#include <stdbool.h>
+#include <stdio.h>
+
+// Opciones del log
+typedef struct alog_opts {
+    const char* path; // Fichero de log (NULL: stdout y stderr para LOG_ERR)
+    bool syslog;      // Escribir con syslog (ya abierto con openlog)
+    size_t ring_size; // Mensajes pendientes por hilo (0: 256)
+    int flush_ms;     // Periodo del hilo escritor en ms (0: 10)
+} alog_opts_t;
+
+// Estadisticas del log
+typedef struct alog_stats {
+    size_t written; // Mensajes escritos
+    size_t dropped; // Mensajes descartados por tener el buffer lleno
+    size_t rings;   // Buffers de hilos creados
+} alog_stats_t;
+
+/*******************************************************************************
+ * FUNCION: int alog_init(const alog_opts_t* opts)
+ * ARGS_IN: const alog_opts_t* opts - opciones del log.
+ * DESCRIPCION: Abre el destino del log y lanza el hilo escritor. Hay un
+ *              unico log por proceso.
+ * ARGS_OUT: int - 0 o -1 en caso de error.
+ ******************************************************************************/
+int alog_init(const alog_opts_t* opts);
+
+/*******************************************************************************
+ * FUNCION: void alog_destroy()
+ * DESCRIPCION: Escribe los mensajes pendientes, termina el hilo escritor y
+ *              libera los buffers. Ningun otro hilo debe estar escribiendo.
+ ******************************************************************************/
+void alog_destroy();
+
+/*******************************************************************************
+ * FUNCION: bool alog_write(int priority, const char* message)
+ * ARGS_IN: int priority - prioridad de syslog (LOG_INFO, LOG_ERR...).
+ *          const char* message - mensaje (se trunca si es muy largo).
+ * DESCRIPCION: Copia el mensaje en el buffer del hilo con la hora cacheada
+ *              por el escritor. No bloquea ni llama al sistema.
+ * ARGS_OUT: bool - true si se encola o false si se descarta.
+ ******************************************************************************/
+bool alog_write(int priority, const char* message);
+
+/*******************************************************************************
+ * FUNCION: void alog_get_stats(alog_stats_t* stats)
+ * ARGS_IN: alog_stats_t* stats - estadisticas que se rellenan.
+ * DESCRIPCION: Obtiene las estadisticas del log.
+ ******************************************************************************/
+void alog_get_stats(alog_stats_t* stats);
+
+#endif /* __ALOG_H__ */
@@ -0,0 +1,96 @@
+/*****************************************************************************
+ * ARCHIVO: capture.h
+ * DESCRIPCION: Interfaz de programacion de la captura de trafico. Guarda en
+ * un fichero binario compacto los bytes de cada peticion recibida (cabecera
+ * y cuerpo), el instante de llegada y la conexion a la que pertenece, para
+ * que tools/replay.c las reproduzca contra otra instancia del servidor con
+ * los mismos tamanios, proporciones de scripts y patrones de keep-alive.
+ *
+ * FORMATO: una cabecera (capture_header_t) seguida de registros de tamanio
+ * variable: un capture_record_t y sus len bytes de peticion, en el orden de
+ * la maquina. Los registros estan en el orden en que se escriben, que puede
+ * no coincidir con el de llegada entre conexiones distintas.
+ *
+ * FECHA CREACION: 19 Octubre de 2026
+ * AUTORES: Javier Mateos Najari, Adrian Sebastian Gil
+ *****************************************************************************/
+#ifndef __CAPTURE_H__
+#define __CAPTURE_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define CAPTURE_MAGIC "HTTPCAP1" // Identifica un fichero de captura
+
+// Indicadores de un registro
+#define CAPTURE_FIRST 0x01 // Primera peticion de la conexion
+
+// Cabecera del fichero
+typedef struct capture_header {
+    char magic[8];       // CAPTURE_MAGIC
+    uint32_t pid;        // Proceso que escribe el fichero
+    uint32_t reserved;   // Sin uso
+    uint64_t created_us; // Inicio de la captura (us desde epoch)
+} capture_header_t;
+
+// Registro de una peticion, seguido de sus len bytes
+typedef struct capture_record {
+    uint64_t time_ns; // Llegada del primer byte desde el inicio (ns)
+    uint64_t conn;    // Conexion de la peticion
+    uint32_t len;     // Bytes de la peticion
+    uint16_t flags;   // CAPTURE_FIRST
+    uint16_t reserved; // Sin uso
+} capture_record_t;
+
+// Opciones de la captura
+typedef struct capture_opts {
+    const char* path; // Fichero de la captura (se trunca)
+    size_t max_size;  // Tamanio maximo; al llegar se deja de capturar
+} capture_opts_t;
+
+/*******************************************************************************
+ * FUNCION: int capture_init(const capture_opts_t* opts)
+ * ARGS_IN: const capture_opts_t* opts - opciones de la captura.
+ * DESCRIPCION: Crea el fichero de la captura y escribe su cabecera. Hay una
+ *              unica captura por proceso.
+ * ARGS_OUT: int - 0 o -1 en caso de error.
+ ******************************************************************************/
+int capture_init(const capture_opts_t* opts);
+
+/*******************************************************************************
+ * FUNCION: void capture_destroy()
+ * DESCRIPCION: Deja de capturar y cierra el fichero. Ningun otro hilo debe
+ *              estar escribiendo.
+ ******************************************************************************/
+void capture_destroy();
+
+/*******************************************************************************
+ * FUNCION: bool capture_enabled()
+ * DESCRIPCION: Indica si se esta capturando.
+ * ARGS_OUT: bool - true si la captura esta activa.
+ ******************************************************************************/
+bool capture_enabled();
+
+/*******************************************************************************
+ * FUNCION: void capture_write(uint64_t time_ns,
+ *                             uint64_t conn,
+ *                             uint16_t flags,
+ *                             const char* data,
+ *                             size_t len)
+ * ARGS_IN: uint64_t time_ns - llegada del primer byte (ns del reloj
+ *                             monotono).
+ *          uint64_t conn - identificador de la conexion.
+ *          uint16_t flags - CAPTURE_FIRST si es la primera de la conexion.
+ *          const char* data - bytes de la peticion.
+ *          size_t len - longitud de la peticion.
+ * DESCRIPCION: Anade una peticion a la captura. Si no cabe en el tamanio
+ *              maximo la captura termina.
+ ******************************************************************************/
+void capture_write(uint64_t time_ns,
+                   uint64_t conn,
+                   uint16_t flags,
+                   const char* data,
+                   size_t len);
+
+#endif /* __CAPTURE_H__ */
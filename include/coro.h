@@ -0,0 +1,108 @@
+/*****************************************************************************
+ * ARCHIVO: coro.h
+ * DESCRIPCION: Interfaz de programacion de corrutinas con pila propia. Las
+ * pilas se reservan con mmap, llevan una pagina de guarda para que un
+ * desbordamiento termine en SIGSEGV en lugar de pisar otra pila, y se
+ * reutilizan a traves de un pool. Un pool solo lo usa un hilo.
+ *
+ * FECHA CREACION: 19 Octubre de 2026
+ * AUTORES: Javier Mateos Najari, Adrian Sebastian Gil
+ *****************************************************************************/
+#ifndef __CORO_H__
+#define __CORO_H__
+
+#include <stdbool.h>
+#include <stdio.h>
+
+typedef struct coro coro_t;           // Corrutina
+typedef struct coro_pool coro_pool_t; // Pool de pilas de un hilo
+
+typedef void (*coro_func_t)(void* arg); // Funcion que ejecuta una corrutina
+
+/*******************************************************************************
+ * FUNCION: coro_pool_t* coro_pool_create(size_t stack_size, size_t max_cached)
+ * ARGS_IN: size_t stack_size - tamanio de la pila de cada corrutina. Se
+ *                              redondea a paginas.
+ *          size_t max_cached - numero maximo de pilas libres que se guardan
+ *                              para reutilizarlas.
+ * DESCRIPCION: Crea un pool de pilas vacio.
+ * ARGS_OUT: coro_pool_t* - pool o NULL en caso de error.
+ ******************************************************************************/
+coro_pool_t* coro_pool_create(size_t stack_size, size_t max_cached);
+
+/*******************************************************************************
+ * FUNCION: void coro_pool_destroy(coro_pool_t* pool)
+ * ARGS_IN: coro_pool_t* pool - pool que se destruye.
+ * DESCRIPCION: Libera las pilas guardadas y el pool. Las corrutinas creadas
+ *              con el pool deben estar destruidas.
+ ******************************************************************************/
+void coro_pool_destroy(coro_pool_t* pool);
+
+/*******************************************************************************
+ * FUNCION: size_t coro_pool_mapped(coro_pool_t* pool)
+ * ARGS_IN: coro_pool_t* pool - pool de pilas.
+ * DESCRIPCION: Obtiene el numero de pilas reservadas (en uso y libres).
+ * ARGS_OUT: size_t - numero de pilas.
+ ******************************************************************************/
+size_t coro_pool_mapped(coro_pool_t* pool);
+
+/*******************************************************************************
+ * FUNCION: coro_t* coro_create(coro_pool_t* pool, coro_func_t func, void* arg)
+ * ARGS_IN: coro_pool_t* pool - pool del que se toma la pila.
+ *          coro_func_t func - funcion que ejecuta la corrutina.
+ *          void* arg - argumento de la funcion.
+ * DESCRIPCION: Crea una corrutina. No empieza a ejecutarse hasta el primer
+ *              coro_resume.
+ * ARGS_OUT: coro_t* - corrutina o NULL en caso de error.
+ ******************************************************************************/
+coro_t* coro_create(coro_pool_t* pool, coro_func_t func, void* arg);
+
+/*******************************************************************************
+ * FUNCION: void coro_destroy(coro_t* co)
+ * ARGS_IN: coro_t* co - corrutina que se destruye.
+ * DESCRIPCION: Devuelve la pila de la corrutina a su pool. La corrutina debe
+ *              haber terminado o no haber empezado.
+ ******************************************************************************/
+void coro_destroy(coro_t* co);
+
+/*******************************************************************************
+ * FUNCION: bool coro_resume(coro_t* co)
+ * ARGS_IN: coro_t* co - corrutina que se ejecuta.
+ * DESCRIPCION: Ejecuta la corrutina hasta que cede el control con coro_yield
+ *              o termina su funcion. No se puede llamar desde una corrutina.
+ * ARGS_OUT: bool - true si la corrutina ha terminado.
+ ******************************************************************************/
+bool coro_resume(coro_t* co);
+
+/*******************************************************************************
+ * FUNCION: void coro_yield()
+ * DESCRIPCION: Devuelve el control al coro_resume que ejecuta la corrutina
+ *              actual. Solo se puede llamar desde una corrutina.
+ ******************************************************************************/
+void coro_yield();
+
+/*******************************************************************************
+ * FUNCION: coro_t* coro_self()
+ * DESCRIPCION: Obtiene la corrutina que ejecuta el hilo.
+ * ARGS_OUT: coro_t* - corrutina actual o NULL fuera de una corrutina.
+ ******************************************************************************/
+coro_t* coro_self();
+
+/*******************************************************************************
+ * FUNCION: void coro_set_data(coro_t* co, void* data)
+ * ARGS_IN: coro_t* co - corrutina.
+ *          void* data - dato asociado.
+ * DESCRIPCION: Asocia un dato a la corrutina (por ejemplo, el estado del
+ *              planificador que la ejecuta).
+ ******************************************************************************/
+void coro_set_data(coro_t* co, void* data);
+
+/*******************************************************************************
+ * FUNCION: void* coro_get_data(coro_t* co)
+ * ARGS_IN: coro_t* co - corrutina.
+ * DESCRIPCION: Obtiene el dato asociado con coro_set_data.
+ * ARGS_OUT: void* - dato asociado.
+ ******************************************************************************/
+void* coro_get_data(coro_t* co);
+
+#endif /* __CORO_H__ */
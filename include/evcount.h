@@ -0,0 +1,87 @@
+/*****************************************************************************
+ * ARCHIVO: evcount.h
+ * DESCRIPCION: Interfaz de programacion de un eventcount basado en futex.
+ * Permite dormir hilos a la espera de una condicion comprobada sin bloqueos
+ * (por ejemplo, que una cola MPMC tenga elementos) y despertar solo a uno de
+ * ellos por cada aviso.
+ *
+ * USO: el hilo que espera llama a evcount_prepare_wait(), vuelve a comprobar
+ * la condicion y, si sigue sin cumplirse, llama a evcount_wait() con la clave
+ * obtenida (o a evcount_cancel_wait() si ya se cumple). El hilo que avisa
+ * hace cierta la condicion y despues llama a evcount_notify_one().
+ *
+ * FECHA CREACION: 19 Octubre de 2026
+ * AUTORES: Javier Mateos Najari, Adrian Sebastian Gil
+ *****************************************************************************/
+#ifndef __EVCOUNT_H__
+#define __EVCOUNT_H__
+
+#include <stdatomic.h>
+#include <stdbool.h>
+
+// Eventcount
+typedef struct evcount {
+    atomic_uint epoch;   // Se incrementa en cada aviso con hilos esperando
+    atomic_uint waiters; // Hilos que se han preparado para esperar
+} evcount_t;
+
+/*******************************************************************************
+ * FUNCION: void evcount_init(evcount_t* ec)
+ * ARGS_IN: evcount_t* ec - eventcount que se inicializa.
+ * DESCRIPCION: Inicializa un eventcount sin hilos esperando.
+ ******************************************************************************/
+void evcount_init(evcount_t* ec);
+
+/*******************************************************************************
+ * FUNCION: unsigned evcount_prepare_wait(evcount_t* ec)
+ * ARGS_IN: evcount_t* ec - eventcount.
+ * DESCRIPCION: Anota al hilo como esperando. Tras esta llamada el hilo debe
+ *              volver a comprobar la condicion antes de dormir.
+ * ARGS_OUT: unsigned - clave para evcount_wait().
+ ******************************************************************************/
+unsigned evcount_prepare_wait(evcount_t* ec);
+
+/*******************************************************************************
+ * FUNCION: void evcount_cancel_wait(evcount_t* ec)
+ * ARGS_IN: evcount_t* ec - eventcount.
+ * DESCRIPCION: Cancela una espera preparada porque la condicion ya se cumple.
+ ******************************************************************************/
+void evcount_cancel_wait(evcount_t* ec);
+
+/*******************************************************************************
+ * FUNCION: void evcount_wait(evcount_t* ec, unsigned key)
+ * ARGS_IN: evcount_t* ec - eventcount.
+ *          unsigned key - clave devuelta por evcount_prepare_wait().
+ * DESCRIPCION: Duerme al hilo hasta que llegue un aviso posterior a la
+ *              preparacion. Puede retornar sin aviso, por lo que el llamante
+ *              debe volver a comprobar la condicion.
+ ******************************************************************************/
+void evcount_wait(evcount_t* ec, unsigned key);
+
+/*******************************************************************************
+ * FUNCION: bool evcount_wait_for(evcount_t* ec, unsigned key, int timeout)
+ * ARGS_IN: evcount_t* ec - eventcount.
+ *          unsigned key - clave devuelta por evcount_prepare_wait().
+ *          int timeout - tiempo maximo de espera en milisegundos.
+ * DESCRIPCION: Igual que evcount_wait() pero deja de esperar al vencer el
+ *              tiempo indicado.
+ * ARGS_OUT: bool - false si ha vencido el tiempo sin recibir ningun aviso.
+ ******************************************************************************/
+bool evcount_wait_for(evcount_t* ec, unsigned key, int timeout);
+
+/*******************************************************************************
+ * FUNCION: void evcount_notify_one(evcount_t* ec)
+ * ARGS_IN: evcount_t* ec - eventcount.
+ * DESCRIPCION: Despierta como mucho a un hilo. Si no hay hilos esperando no
+ *              realiza ninguna escritura ni llamada al sistema.
+ ******************************************************************************/
+void evcount_notify_one(evcount_t* ec);
+
+/*******************************************************************************
+ * FUNCION: void evcount_notify_all(evcount_t* ec)
+ * ARGS_IN: evcount_t* ec - eventcount.
+ * DESCRIPCION: Despierta a todos los hilos que esperan.
+ ******************************************************************************/
+void evcount_notify_all(evcount_t* ec);
+
+#endif /* __EVCOUNT_H__ */
@@ -0,0 +1,120 @@
+/*****************************************************************************
+ * ARCHIVO: evloop.h
+ * DESCRIPCION: Interfaz de programacion de un grupo de bucles de eventos, uno
+ * por hilo, que ejecutan cada trabajo en una corrutina (ver coro.h). Cuando
+ * una corrutina tendria que bloquearse en un socket cede el control a su
+ * bucle, que la reanuda cuando epoll indica que el socket esta listo. Asi el
+ * codigo se escribe de forma secuencial y cada hilo atiende miles de
+ * conexiones.
+ *
+ * FECHA CREACION: 19 Octubre de 2026
+ * AUTORES: Javier Mateos Najari, Adrian Sebastian Gil
+ *****************************************************************************/
+#ifndef __EVLOOP_H__
+#define __EVLOOP_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "topology.h"
+
+typedef struct evloop evloop_t; // Grupo de bucles de eventos
+
+typedef void (*evloop_func_t)(void* arg); // Trabajo de una corrutina
+
+// Opciones de creacion del grupo de bucles
+typedef struct evloop_opts {
+    int num_loops;              // Numero de bucles (0: una por CPU)
+    size_t stack_size;          // Tamanio de pila de cada corrutina (bytes)
+    size_t queue_size;          // Trabajos pendientes por bucle (0: 1024)
+    const topology_t* topology; // Si no es NULL, cada bucle se fija a un core
+    size_t cpu_offset;          // Posicion del primer bucle en el reparto
+} evloop_opts_t;
+
+// Estadisticas del grupo de bucles
+typedef struct evloop_stats {
+    size_t num_loops;  // Numero de bucles
+    size_t active;     // Corrutinas vivas
+    size_t max_active; // Maximo de corrutinas vivas a la vez
+    size_t completed;  // Corrutinas terminadas
+    size_t rejected;   // Trabajos rechazados por tener las colas llenas
+    size_t timeouts;   // Esperas en sockets que han expirado
+    size_t stacks;     // Pilas reservadas (en uso y libres)
+} evloop_stats_t;
+
+/*******************************************************************************
+ * FUNCION: evloop_t* evloop_create(const evloop_opts_t* opts)
+ * ARGS_IN: const evloop_opts_t* opts - opciones del grupo de bucles.
+ * DESCRIPCION: Crea los bucles de eventos y lanza un hilo para cada uno. Con
+ *              topology, el bucle i se fija a la CPU topology_spread(
+ *              topology, cpu_offset + i).
+ * ARGS_OUT: evloop_t* - grupo de bucles o NULL en caso de error.
+ ******************************************************************************/
+evloop_t* evloop_create(const evloop_opts_t* opts);
+
+/*******************************************************************************
+ * FUNCION: void evloop_destroy(evloop_t* el)
+ * ARGS_IN: evloop_t* el - grupo de bucles que se destruye.
+ * DESCRIPCION: Despierta a todas las corrutinas que esperan en un socket como
+ *              si hubiese expirado la espera, espera a que terminen y libera
+ *              los bucles. Los trabajos que no han empezado se descartan.
+ ******************************************************************************/
+void evloop_destroy(evloop_t* el);
+
+/*******************************************************************************
+ * FUNCION: bool evloop_submit(evloop_t* el, evloop_func_t func, void* arg)
+ * ARGS_IN: evloop_t* el - grupo de bucles.
+ *          evloop_func_t func - funcion que ejecuta la corrutina.
+ *          void* arg - argumento de la funcion.
+ * DESCRIPCION: Entrega un trabajo a uno de los bucles (por turnos), que lo
+ *              ejecuta en una corrutina nueva. No bloquea.
+ * ARGS_OUT: bool - true si se entrega o false si todas las colas estan
+ *                  llenas.
+ ******************************************************************************/
+bool evloop_submit(evloop_t* el, evloop_func_t func, void* arg);
+
+/*******************************************************************************
+ * FUNCION: int evloop_wait(int fd, uint32_t events, uint64_t deadline)
+ * ARGS_IN: int fd - descriptor por el que se espera.
+ *          uint32_t events - EPOLLIN y/o EPOLLOUT.
+ *          uint64_t deadline - instante en que expira la espera, en el reloj
+ *                              de twheel_clock() (ms, 0: sin limite).
+ * DESCRIPCION: Cede el control al bucle hasta que el descriptor este listo.
+ *              Se llama tras recibir EAGAIN de un socket no bloqueante. El
+ *              descriptor queda registrado en el bucle hasta que termina la
+ *              corrutina o se llama a evloop_forget.
+ * ARGS_OUT: int - 0 si esta listo o -1 si ha expirado la espera, se esta
+ *                 destruyendo el grupo o no se llama desde una corrutina de
+ *                 un bucle (errno ETIMEDOUT, ECANCELED o EWOULDBLOCK).
+ ******************************************************************************/
+int evloop_wait(int fd, uint32_t events, uint64_t deadline);
+
+/*******************************************************************************
+ * FUNCION: void evloop_forget(int fd)
+ * ARGS_IN: int fd - descriptor que se va a cerrar.
+ * DESCRIPCION: Retira el descriptor del bucle de la corrutina que llama. Debe
+ *              llamarse antes de cerrarlo: si otro proceso conserva una copia
+ *              (un script entre fork y exec), epoll lo mantiene registrado y
+ *              seguiria apuntando a la pila de la corrutina. Fuera de una
+ *              corrutina o con otro descriptor no hace nada.
+ ******************************************************************************/
+void evloop_forget(int fd);
+
+/*******************************************************************************
+ * FUNCION: bool evloop_inside()
+ * DESCRIPCION: Indica si el hilo que llama es el de un bucle, en cuyo caso no
+ *              debe bloquearse y tiene que esperar con evloop_wait.
+ * ARGS_OUT: bool - true si es el hilo de un bucle.
+ ******************************************************************************/
+bool evloop_inside();
+
+/*******************************************************************************
+ * FUNCION: void evloop_get_stats(evloop_t* el, evloop_stats_t* stats)
+ * ARGS_IN: evloop_t* el - grupo de bucles.
+ *          evloop_stats_t* stats - estadisticas que se rellenan.
+ * DESCRIPCION: Obtiene las estadisticas del grupo de bucles.
+ ******************************************************************************/
+void evloop_get_stats(evloop_t* el, evloop_stats_t* stats);
+
+#endif /* __EVLOOP_H__ */
@@ -8,18 +8,158 @@
 #ifndef __HTTP_H__
 #define __HTTP_H__
 
+#include <netinet/in.h>
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 
+#define HTTP_DEFERRED 1 // La conexion tiene una peticion de script pendiente
+
+typedef struct http_script http_script_t; // Peticion de script diferida
+
+// Tiempo maximo de ejecucion de los scripts de una ruta
+typedef struct http_route {
+    char* prefix; // Prefijo del path de la peticion
+    int timeout;  // Tiempo maximo de ejecucion en segundos (0: sin limite)
+} http_route_t;
+
+// Configuracion del modulo http
+typedef struct http_config {
+    int script_timeout;     // Tiempo maximo de ejecucion por defecto (s)
+    int script_cpu_limit;   // Limite de tiempo de CPU de un script (s)
+    int script_mem_limit;   // Limite de memoria de un script (MB)
+    size_t num_routes;      // Numero de rutas con tiempo maximo propio
+    http_route_t* routes;   // Rutas con tiempo maximo propio
+    char* server_root;      // Ruta a los recursos del servidor
+    char* server_signature; // Nombre del servidor en las respuestas
+    int header_timeout;     // Limite para recibir la cabecera (s)
+    int body_timeout;       // Limite para recibir el cuerpo (s)
+    int write_timeout;      // Tiempo maximo para enviar una respuesta (s)
+    int keepalive_timeout;  // Espera a la siguiente peticion (s)
+} http_config_t;
+
+// Datos de una conexion aceptada
+typedef struct http_conn {
+    struct sockaddr_in peer; // Direccion del cliente
+    uint64_t id;             // Identificador de la conexion (captura)
+    uint64_t queued;         // Instante en que se encolo (ns del reloj
+                             // monotono, 0: no se traza)
+} http_conn_t;
+
 /******************************************************************************
- * FUNCION: int http(int socket, char* server_root, char* server_signature)
- * ARGS_IN: int socket - identificador del hilo donde se escribe.
- *          char* server_root - ruta a los recursos del servidor.
- *          char* server_signature - nombre del servidor.
- * DESCRIPCION: establece la conexión entre el socket y el servidor para que se
- *              comuniquen mediante el protocolo http.
+ * FUNCION: int http_init(const http_config_t* conf)
+ * ARGS_IN: const http_config_t* conf - configuracion del modulo (se copia).
+ *                                      Los limites a 0 indican sin limite.
+ * DESCRIPCION: inicializa el estado compartido por todas las conexiones
+ *              (agrupacion de peticiones identicas en curso y limites de
+ *              ejecucion de los scripts) y genera la respuesta de
+ *              sobrecarga.
  * ARGS_OUT: int - devuelve 0 en caso de funcionar correctamente -1 en caso
  *                 contrario.
  *****************************************************************************/
-int http(int socket, char* server_root, char* server_signature);
+int http_init(const http_config_t* conf);
+
+/******************************************************************************
+ * FUNCION: int http_reload(const http_config_t* conf)
+ * ARGS_IN: const http_config_t* conf - nueva configuracion (se copia).
+ * DESCRIPCION: publica una nueva configuracion sin parar el servidor. Las
+ *              peticiones que empiecen despues la usan, tambien las de
+ *              conexiones keep-alive ya abiertas; las que estan en curso, y
+ *              sus peticiones de script diferidas, terminan con la anterior,
+ *              que se libera cuando acaba la ultima. Las rutas
+ *              nuevas no tienen serie de latencia propia: cuentan en la de
+ *              scripts hasta reiniciar.
+ * ARGS_OUT: int - 0 o -1 si no se ha podido copiar (sigue la anterior).
+ *****************************************************************************/
+int http_reload(const http_config_t* conf);
+
+/******************************************************************************
+ * FUNCION: void http_destroy()
+ * DESCRIPCION: libera el estado compartido por todas las conexiones.
+ *****************************************************************************/
+void http_destroy();
+
+/******************************************************************************
+ * FUNCION: void http_conn_open(int socket)
+ * ARGS_IN: int socket - socket de la conexion aceptada.
+ * DESCRIPCION: registra una conexion abierta para que http_drain la pueda
+ *              cerrar. Se llama antes de entregarla a otro hilo.
+ *****************************************************************************/
+void http_conn_open(int socket);
+
+/******************************************************************************
+ * FUNCION: void http_conn_close(int socket)
+ * ARGS_IN: int socket - socket de la conexion.
+ * DESCRIPCION: retira la conexion del registro. Se llama antes de cerrar el
+ *              socket, para que http_drain no toque un descriptor reutilizado.
+ *****************************************************************************/
+void http_conn_close(int socket);
+
+/******************************************************************************
+ * FUNCION: void http_drain(bool force)
+ * ARGS_IN: bool force - cerrar tambien las conexiones que estan atendiendo
+ *                       una peticion.
+ * DESCRIPCION: empieza a drenar las conexiones: las respuestas llevan
+ *              Connection: close y las conexiones keep-alive se cierran en
+ *              lugar de esperar otra peticion, tambien las que ya esperan.
+ *              Con force se cierran todos los sockets registrados para lectura
+ *              y escritura, asi que las peticiones en curso terminan con
+ *              error en cuanto usan el socket.
+ *****************************************************************************/
+void http_drain(bool force);
+
+/******************************************************************************
+ * FUNCION: int http(int socket,
+ *                   const http_conn_t* conn,
+ *                   bool keepalive,
+ *                   http_script_t** script)
+ * ARGS_IN: int socket - identificador del hilo donde se escribe.
+ *          const http_conn_t* conn - (opcional) datos de la conexion para el
+ *                                    log de accesos, la traza y la captura.
+ *          bool keepalive - la conexion ya ha atendido alguna peticion, asi
+ *                           que la siguiente se espera keepalive_timeout.
+ *          http_script_t** script - (opcional) si no es NULL, las peticiones
+ *                                   que ejecutan scripts no se procesan y se
+ *                                   devuelven aqui para otro pool de hilos.
+ * DESCRIPCION: establece la conexión entre el socket y el servidor para que se
+ *              comuniquen mediante el protocolo http. Cada peticion se
+ *              espera con los limites publicados y se atiende con la
+ *              configuracion publicada cuando llega (ver http_reload).
+ * ARGS_OUT: int - devuelve 0 en caso de funcionar correctamente, -1 en caso
+ *                 contrario o HTTP_DEFERRED si se ha devuelto una peticion de
+ *                 script pendiente. En ese caso la conexion sigue abierta.
+ *****************************************************************************/
+int http(int socket,
+         const http_conn_t* conn,
+         bool keepalive,
+         http_script_t** script);
+
+/******************************************************************************
+ * FUNCION: int http_script_run(http_script_t* script)
+ * ARGS_IN: http_script_t* script - peticion de script diferida.
+ * DESCRIPCION: ejecuta el script, envia la respuesta y libera la peticion.
+ * ARGS_OUT: int - 0 si la conexion puede seguir recibiendo peticiones o 1 si
+ *                 se debe cerrar.
+ *****************************************************************************/
+int http_script_run(http_script_t* script);
+
+/******************************************************************************
+ * FUNCION: void http_script_reject(http_script_t* script)
+ * ARGS_IN: http_script_t* script - peticion de script diferida.
+ * DESCRIPCION: responde 503 a la peticion porque no hay capacidad para
+ *              ejecutar mas scripts y libera la peticion.
+ *****************************************************************************/
+void http_script_reject(http_script_t* script);
+
+/******************************************************************************
+ * FUNCION: void http_overload(int socket)
+ * ARGS_IN: int socket - socket de la conexion que no se va a atender.
+ * DESCRIPCION: responde 503 con Retry-After a una conexion sin leer su
+ *              peticion. La respuesta se genera al publicar la configuracion
+ *              y se envia sin bloquear, asi que se puede llamar desde el
+ *              bucle de accept.
+ *              No cierra el socket.
+ *****************************************************************************/
+void http_overload(int socket);
 
-#endif /* __HTTP_H__ */
\ No newline at end of file
+#endif /* __HTTP_H__ */
@@ -0,0 +1,207 @@
+/*****************************************************************************
+ * ARCHIVO: metrics.h
+ * DESCRIPCION: Interfaz de programacion de las metricas del servidor. Los
+ * contadores e histogramas de latencia se registran al arrancar y cada hilo
+ * los actualiza en su propia copia sin bloqueos ni instrucciones atomicas de
+ * lectura-modificacion-escritura. Al consultarlos se suman las copias de
+ * todos los hilos. Las metricas se sirven en el formato de texto de
+ * Prometheus en un puerto de administracion aparte.
+ *
+ * Los histogramas son de tipo HDR: 8 subintervalos por cada potencia de 2,
+ * asi que el error relativo es como mucho de un 12.5% en todo el rango.
+ *
+ * FECHA CREACION: 19 Octubre de 2026
+ * AUTORES: Javier Mateos Najari, Adrian Sebastian Gil
+ *****************************************************************************/
+#ifndef __METRICS_H__
+#define __METRICS_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define METRICS_MAX_COUNTERS 128   // Maximo de contadores registrados
+#define METRICS_MAX_HISTOGRAMS 128 // Maximo de histogramas registrados
+
+typedef struct metrics_out metrics_out_t; // Texto de una consulta
+
+// Tipo de una metrica
+typedef enum {
+    METRICS_COUNTER, // Solo crece
+    METRICS_GAUGE    // Sube y baja
+} metrics_type_t;
+
+/*******************************************************************************
+ * FUNCION: typedef void (*metrics_collect_t)(metrics_out_t* out, void* arg)
+ * ARGS_IN: metrics_out_t* out - texto de la consulta (ver metrics_emit).
+ *          void* arg - argumento del registro.
+ * DESCRIPCION: Funcion que anade valores obtenidos en el momento de la
+ *              consulta, como las estadisticas de los pools de hilos.
+ ******************************************************************************/
+typedef void (*metrics_collect_t)(metrics_out_t* out, void* arg);
+
+/*******************************************************************************
+ * FUNCION: typedef int (*metrics_handle_t)(const char* query,
+ *                                          char** body,
+ *                                          size_t* len,
+ *                                          void* arg)
+ * ARGS_IN: const char* query - parametros de la consulta sin '?' ("" si no
+ *                              hay).
+ *          char** body - texto de la respuesta (se libera con free).
+ *          size_t* len - longitud del texto.
+ *          void* arg - argumento del registro.
+ * DESCRIPCION: Funcion que atiende un path propio del puerto de
+ *              administracion. Se ejecuta en el hilo del puerto, asi que
+ *              mientras dura no se atienden otras consultas.
+ * ARGS_OUT: int - codigo de estado HTTP de la respuesta.
+ ******************************************************************************/
+typedef int (*metrics_handle_t)(const char* query,
+                                char** body,
+                                size_t* len,
+                                void* arg);
+
+/*******************************************************************************
+ * FUNCION: int metrics_counter(const char* name,
+ *                              const char* help,
+ *                              const char* labels)
+ * ARGS_IN: const char* name - nombre de la metrica.
+ *          const char* help - descripcion de la metrica.
+ *          const char* labels - (opcional) etiquetas (p. ej. "code=\"200\"").
+ * DESCRIPCION: Registra un contador. Las series con el mismo nombre deben
+ *              registrarse seguidas. Se registra antes de lanzar los hilos.
+ * ARGS_OUT: int - identificador del contador o -1 en caso de error.
+ ******************************************************************************/
+int metrics_counter(const char* name, const char* help, const char* labels);
+
+/*******************************************************************************
+ * FUNCION: int metrics_histogram(const char* name,
+ *                                const char* help,
+ *                                const char* labels)
+ * ARGS_IN: const char* name - nombre de la metrica (en segundos).
+ *          const char* help - descripcion de la metrica.
+ *          const char* labels - (opcional) etiquetas.
+ * DESCRIPCION: Registra un histograma de latencias, como metrics_counter.
+ *              Ademas de los intervalos se publican los percentiles 50, 90,
+ *              99 y 99.9 en name_quantile.
+ * ARGS_OUT: int - identificador del histograma o -1 en caso de error.
+ ******************************************************************************/
+int metrics_histogram(const char* name, const char* help, const char* labels);
+
+/*******************************************************************************
+ * FUNCION: int metrics_collector(metrics_collect_t func, void* arg)
+ * ARGS_IN: metrics_collect_t func - funcion que anade valores.
+ *          void* arg - argumento de la funcion.
+ * DESCRIPCION: Registra una funcion que se llama en cada consulta, despues
+ *              de escribir los contadores y los histogramas.
+ * ARGS_OUT: int - 0 o -1 en caso de error.
+ ******************************************************************************/
+int metrics_collector(metrics_collect_t func, void* arg);
+
+/*******************************************************************************
+ * FUNCION: int metrics_handler(const char* path,
+ *                              metrics_handle_t func,
+ *                              void* arg)
+ * ARGS_IN: const char* path - path que atiende la funcion.
+ *          metrics_handle_t func - funcion que genera la respuesta.
+ *          void* arg - argumento de la funcion.
+ * DESCRIPCION: Registra un path del puerto de administracion aparte del de
+ *              las metricas. Se registran antes de metrics_serve.
+ * ARGS_OUT: int - 0 o -1 en caso de error.
+ ******************************************************************************/
+int metrics_handler(const char* path, metrics_handle_t func, void* arg);
+
+/*******************************************************************************
+ * FUNCION: void metrics_add(int id, uint64_t value)
+ * ARGS_IN: int id - identificador del contador (-1: no se hace nada).
+ *          uint64_t value - cantidad que se suma.
+ * DESCRIPCION: Suma en la copia del contador del hilo.
+ ******************************************************************************/
+void metrics_add(int id, uint64_t value);
+
+/*******************************************************************************
+ * FUNCION: void metrics_observe(int id, uint64_t us)
+ * ARGS_IN: int id - identificador del histograma (-1: no se hace nada).
+ *          uint64_t us - latencia observada (us).
+ * DESCRIPCION: Anade una observacion a la copia del histograma del hilo.
+ ******************************************************************************/
+void metrics_observe(int id, uint64_t us);
+
+/*******************************************************************************
+ * FUNCION: uint64_t metrics_sum(int id)
+ * ARGS_IN: int id - identificador del contador.
+ * DESCRIPCION: Suma las copias del contador de todos los hilos.
+ * ARGS_OUT: uint64_t - valor del contador.
+ ******************************************************************************/
+uint64_t metrics_sum(int id);
+
+/*******************************************************************************
+ * FUNCION: void metrics_emit(metrics_out_t* out,
+ *                            metrics_type_t type,
+ *                            const char* name,
+ *                            const char* help,
+ *                            const char* labels,
+ *                            double value)
+ * ARGS_IN: metrics_out_t* out - texto de la consulta.
+ *          metrics_type_t type - tipo de la metrica.
+ *          const char* name - nombre de la metrica.
+ *          const char* help - descripcion de la metrica.
+ *          const char* labels - (opcional) etiquetas.
+ *          double value - valor.
+ * DESCRIPCION: Anade una serie desde una funcion de metrics_collector. Las
+ *              series con el mismo nombre deben emitirse seguidas.
+ ******************************************************************************/
+void metrics_emit(metrics_out_t* out,
+                  metrics_type_t type,
+                  const char* name,
+                  const char* help,
+                  const char* labels,
+                  double value);
+
+/*******************************************************************************
+ * FUNCION: void metrics_escape(char* dst, size_t size, const char* value)
+ * ARGS_IN: char* dst - buffer de salida.
+ *          size_t size - tamanio de dst.
+ *          const char* value - valor de una etiqueta.
+ * DESCRIPCION: Escapa las comillas, las barras y los saltos de linea de un
+ *              valor de etiqueta. Se trunca si no cabe en dst.
+ ******************************************************************************/
+void metrics_escape(char* dst, size_t size, const char* value);
+
+/*******************************************************************************
+ * FUNCION: char* metrics_render(size_t* len)
+ * ARGS_IN: size_t* len - longitud del texto.
+ * DESCRIPCION: Genera el texto de todas las metricas en el formato de texto
+ *              de Prometheus (version 0.0.4).
+ * ARGS_OUT: char* - texto (se libera con free) o NULL si no hay memoria.
+ ******************************************************************************/
+char* metrics_render(size_t* len);
+
+/*******************************************************************************
+ * FUNCION: int metrics_serve(char* host, char* port, const char* path)
+ * ARGS_IN: char* host - direccion en la que escucha (NULL: todas).
+ *          char* port - puerto de administracion.
+ *          const char* path - path en el que se sirven las metricas.
+ * DESCRIPCION: Lanza un hilo que atiende de una en una las consultas GET al
+ *              puerto de administracion. No hay autenticacion: quien llega
+ *              al puerto puede leer las metricas y lanzar los manejadores.
+ * ARGS_OUT: int - 0 o -1 en caso de error.
+ ******************************************************************************/
+int metrics_serve(char* host, char* port, const char* path);
+
+/*******************************************************************************
+ * FUNCION: void metrics_stop()
+ * DESCRIPCION: Cierra el puerto de administracion y espera a que termine su
+ *              hilo. Hay que llamarla antes de liberar lo que consultan las
+ *              funciones de metrics_collector.
+ ******************************************************************************/
+void metrics_stop();
+
+/*******************************************************************************
+ * FUNCION: void metrics_destroy()
+ * DESCRIPCION: Cierra el puerto de administracion si sigue abierto y libera
+ *              las copias de los hilos. Ningun otro hilo debe estar
+ *              actualizando.
+ ******************************************************************************/
+void metrics_destroy();
+
+#endif /* __METRICS_H__ */
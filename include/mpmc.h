@@ -0,0 +1,70 @@
+/*****************************************************************************
+ * ARCHIVO: mpmc.h
+ * DESCRIPCION: Interfaz de programacion de una cola acotada sin bloqueos con
+ * multiples productores y multiples consumidores (MPMC). Los elementos se
+ * copian por valor en un buffer circular reservado al crear la cola.
+ *
+ * FECHA CREACION: 19 Octubre de 2026
+ * AUTORES: Javier Mateos Najari, Adrian Sebastian Gil
+ *****************************************************************************/
+#ifndef __MPMC_H__
+#define __MPMC_H__
+
+#include <stdbool.h>
+#include <stdio.h>
+
+typedef struct mpmc mpmc_t; // Cola MPMC acotada
+
+/*******************************************************************************
+ * FUNCION: mpmc_t* mpmc_create(size_t capacity, size_t elem_size)
+ * ARGS_IN: size_t capacity - numero minimo de elementos de la cola. Se
+ *                            redondea a la siguiente potencia de dos.
+ *          size_t elem_size - tamanio en bytes de cada elemento.
+ * DESCRIPCION: Crea e inicializa una cola vacia.
+ * ARGS_OUT: mpmc_t* - cola inicializada o NULL en caso de error.
+ ******************************************************************************/
+mpmc_t* mpmc_create(size_t capacity, size_t elem_size);
+
+/*******************************************************************************
+ * FUNCION: void mpmc_destroy(mpmc_t* q)
+ * ARGS_IN: mpmc_t* q - cola que se destruye.
+ * DESCRIPCION: Libera la cola. Los elementos que queden se descartan.
+ ******************************************************************************/
+void mpmc_destroy(mpmc_t* q);
+
+/*******************************************************************************
+ * FUNCION: bool mpmc_push(mpmc_t* q, const void* elem)
+ * ARGS_IN: mpmc_t* q - cola en la que se inserta.
+ *          const void* elem - elemento que se copia en la cola.
+ * DESCRIPCION: Inserta un elemento sin bloquear.
+ * ARGS_OUT: bool - true si se inserta o false si la cola esta llena.
+ ******************************************************************************/
+bool mpmc_push(mpmc_t* q, const void* elem);
+
+/*******************************************************************************
+ * FUNCION: bool mpmc_pop(mpmc_t* q, void* elem)
+ * ARGS_IN: mpmc_t* q - cola de la que se extrae.
+ *          void* elem - donde se copia el elemento extraido.
+ * DESCRIPCION: Extrae el elemento mas antiguo sin bloquear.
+ * ARGS_OUT: bool - true si se extrae o false si la cola esta vacia.
+ ******************************************************************************/
+bool mpmc_pop(mpmc_t* q, void* elem);
+
+/*******************************************************************************
+ * FUNCION: size_t mpmc_size(mpmc_t* q)
+ * ARGS_IN: mpmc_t* q - cola de la que se obtiene el tamanio.
+ * DESCRIPCION: Obtiene el numero aproximado de elementos en la cola. Con
+ *              operaciones concurrentes el valor puede estar desfasado.
+ * ARGS_OUT: size_t - numero de elementos.
+ ******************************************************************************/
+size_t mpmc_size(mpmc_t* q);
+
+/*******************************************************************************
+ * FUNCION: size_t mpmc_capacity(mpmc_t* q)
+ * ARGS_IN: mpmc_t* q - cola de la que se obtiene la capacidad.
+ * DESCRIPCION: Obtiene el numero maximo de elementos de la cola.
+ * ARGS_OUT: size_t - capacidad de la cola.
+ ******************************************************************************/
+size_t mpmc_capacity(mpmc_t* q);
+
+#endif /* __MPMC_H__ */
@@ -0,0 +1,134 @@
+/*****************************************************************************
+ * ARCHIVO: probes.h
+ * DESCRIPCION: Puntos de traza estaticos (USDT) del ciclo de vida de una
+ * peticion, con proveedor "server". Cada punto es una instruccion nop y una
+ * nota ELF en .note.stapsdt que describe donde estan sus argumentos, como
+ * los de <sys/sdt.h>: sin un trazador enganchado no cuestan nada mas. Con
+ * bpftrace, perf o SystemTap se activan sobre el ejecutable en marcha:
+ *
+ *   bpftrace -e 'usdt:./server:server:request_parsed { @[str(arg2)] = count(); }'
+ *   bpftrace -l 'usdt:./server:*'
+ *
+ * Puntos y argumentos:
+ *   accept(fd, conn)                    conexion aceptada en main
+ *   tpool_enqueue(pool, arg)            trabajo encolado en un pool
+ *   tpool_dequeue(pool, arg, added_ns)  trabajo que empieza a ejecutarse
+ *   request_parsed(fd, method, path, header_bytes, body_bytes)
+ *   response_start(fd, path, bytes)     antes de enviar una respuesta 200
+ *   response_end(fd, status, bytes)     respuesta enviada (status -1: error)
+ *   script_spawn(pid, path)             interprete lanzado
+ *   script_exit(pid, wstatus, bytes)    interprete terminado y su salida
+ *
+ * Las cadenas son punteros (str() en bpftrace). Si el sistema tiene
+ * <sys/sdt.h> se usa; si no, en x86-64 se generan las mismas notas aqui. En
+ * otras arquitecturas, o compilando con -DNO_PROBES, los puntos desaparecen.
+ *
+ * FECHA CREACION: 19 Octubre de 2026
+ * AUTORES: Javier Mateos Najari, Adrian Sebastian Gil
+ *****************************************************************************/
+#ifndef __PROBES_H__
+#define __PROBES_H__
+
+#if defined(NO_PROBES)
+
+#define PROBE0(name)
+#define PROBE1(name, a)
+#define PROBE2(name, a, b)
+#define PROBE3(name, a, b, c)
+#define PROBE4(name, a, b, c, d)
+#define PROBE5(name, a, b, c, d, e)
+
+#elif defined(__has_include) && __has_include(<sys/sdt.h>)
+
+#include <sys/sdt.h>
+
+#define PROBE0(name) DTRACE_PROBE(server, name)
+#define PROBE1(name, a) DTRACE_PROBE1(server, name, a)
+#define PROBE2(name, a, b) DTRACE_PROBE2(server, name, a, b)
+#define PROBE3(name, a, b, c) DTRACE_PROBE3(server, name, a, b, c)
+#define PROBE4(name, a, b, c, d) DTRACE_PROBE4(server, name, a, b, c, d)
+#define PROBE5(name, a, b, c, d, e) DTRACE_PROBE5(server, name, a, b, c, d, e)
+
+#elif defined(__x86_64__)
+
+/* Tamanio de un argumento, negativo si es un entero con signo. Con %n el
+ * ensamblador escribe el opuesto de la constante, por eso el signo va al
+ * reves. Los tipos que no son enteros (punteros) cuentan como sin signo. */
+#define PROBE_INT(x)                                                           \
+    __typeof__(__builtin_choose_expr(                                          \
+      ((__builtin_classify_type(x) + 3) & -4) == 4, (x), 0U))
+#define PROBE_SIZE(x)                                                          \
+    (((PROBE_INT(x)) - 1 > (PROBE_INT(x))0 ? -1 : 1) * (int)sizeof(x))
+
+#define PROBE_ARG(n, x) [s##n] "n"(PROBE_SIZE(x)), [a##n] "nor"(x)
+
+/* Nota en el formato de <sys/sdt.h> (tipo 3): direccion del nop, direccion
+ * de .stapsdt.base para corregir el desplazamiento al cargar, semaforo (no
+ * hay), proveedor, nombre y argumentos "tamanio@operando". */
+#define PROBE_ASM(name, args)                                                  \
+    "990: nop\n"                                                               \
+    ".pushsection .note.stapsdt,\"?\",\"note\"\n"                              \
+    ".balign 4\n"                                                              \
+    ".4byte 992f-991f, 994f-993f, 3\n"                                         \
+    "991: .asciz \"stapsdt\"\n"                                                \
+    "992: .balign 4\n"                                                         \
+    "993: .8byte 990b\n"                                                       \
+    ".8byte _.stapsdt.base\n"                                                  \
+    ".8byte 0\n"                                                               \
+    ".asciz \"server\"\n"                                                      \
+    ".asciz \"" #name "\"\n"                                                   \
+    ".asciz \"" args "\"\n"                                                    \
+    "994: .balign 4\n"                                                         \
+    ".popsection\n"                                                            \
+    ".ifndef _.stapsdt.base\n"                                                 \
+    ".pushsection .stapsdt.base,\"aG\",\"progbits\",.stapsdt.base,comdat\n"    \
+    ".weak _.stapsdt.base\n"                                                   \
+    ".hidden _.stapsdt.base\n"                                                 \
+    "_.stapsdt.base: .space 1\n"                                               \
+    ".size _.stapsdt.base, 1\n"                                                \
+    ".popsection\n"                                                            \
+    ".endif\n"
+
+#define PROBE0(name) __asm__ __volatile__(PROBE_ASM(name, ""))
+#define PROBE1(name, a)                                                        \
+    __asm__ __volatile__(PROBE_ASM(name, "%n[s1]@%[a1]")::PROBE_ARG(1, a))
+#define PROBE2(name, a, b)                                                     \
+    __asm__ __volatile__(                                                      \
+      PROBE_ASM(name, "%n[s1]@%[a1] %n[s2]@%[a2]")::PROBE_ARG(1, a),         \
+      PROBE_ARG(2, b))
+#define PROBE3(name, a, b, c)                                                  \
+    __asm__ __volatile__(                                                      \
+      PROBE_ASM(name, "%n[s1]@%[a1] %n[s2]@%[a2] %n[s3]@%[a3]")::PROBE_ARG(  \
+        1, a),                                                                 \
+      PROBE_ARG(2, b),                                                         \
+      PROBE_ARG(3, c))
+#define PROBE4(name, a, b, c, d)                                               \
+    __asm__ __volatile__(                                                      \
+      PROBE_ASM(name,                                                          \
+                "%n[s1]@%[a1] %n[s2]@%[a2] %n[s3]@%[a3] "                      \
+                "%n[s4]@%[a4]")::PROBE_ARG(1, a),                              \
+      PROBE_ARG(2, b),                                                         \
+      PROBE_ARG(3, c),                                                         \
+      PROBE_ARG(4, d))
+#define PROBE5(name, a, b, c, d, e)                                            \
+    __asm__ __volatile__(                                                      \
+      PROBE_ASM(name,                                                          \
+                "%n[s1]@%[a1] %n[s2]@%[a2] %n[s3]@%[a3] "                      \
+                "%n[s4]@%[a4] %n[s5]@%[a5]")::PROBE_ARG(1, a),                 \
+      PROBE_ARG(2, b),                                                         \
+      PROBE_ARG(3, c),                                                         \
+      PROBE_ARG(4, d),                                                         \
+      PROBE_ARG(5, e))
+
+#else
+
+#define PROBE0(name)
+#define PROBE1(name, a)
+#define PROBE2(name, a, b)
+#define PROBE3(name, a, b, c)
+#define PROBE4(name, a, b, c, d)
+#define PROBE5(name, a, b, c, d, e)
+
+#endif
+
+#endif /* __PROBES_H__ */
@@ -0,0 +1,71 @@
+/*****************************************************************************
+ * ARCHIVO: profiler.h
+ * DESCRIPCION: Interfaz de programacion del perfilador de CPU por muestreo.
+ * Muestrea durante unos segundos todos los hilos del proceso con
+ * perf_event_open (reloj de CPU, solo espacio de usuario), recorre las pilas
+ * por frame pointers y devuelve las pilas agregadas en el formato "folded"
+ * (un "hilo;funcion;...;hoja cuenta" por linea) que leen flamegraph.pl y
+ * speedscope. Los simbolos se resuelven con las tablas ELF del ejecutable y
+ * de las librerias cargadas.
+ *
+ * Las pilas solo son completas en el codigo compilado con frame pointers; el
+ * Makefile compila el servidor con -fno-omit-frame-pointer en todos los
+ * modos. Las funciones de librerias sin frame pointers pueden cortar la pila.
+ *
+ * FECHA CREACION: 19 Octubre de 2026
+ * AUTORES: Javier Mateos Najari, Adrian Sebastian Gil
+ *****************************************************************************/
+#ifndef __PROFILER_H__
+#define __PROFILER_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define PROFILER_MAX_SECONDS 60    // Duracion maxima de un muestreo
+#define PROFILER_MAX_FREQUENCY 1000 // Muestras por segundo maximas por hilo
+
+// Resultado de un muestreo
+typedef struct profiler_stats {
+    size_t threads;   // Hilos muestreados
+    uint64_t samples; // Muestras leidas
+    uint64_t lost;    // Muestras perdidas con el buffer lleno
+} profiler_stats_t;
+
+/*******************************************************************************
+ * FUNCION: int profiler_run(unsigned seconds,
+ *                           unsigned frequency,
+ *                           char** out,
+ *                           size_t* len,
+ *                           profiler_stats_t* stats)
+ * ARGS_IN: unsigned seconds - duracion del muestreo (1-PROFILER_MAX_SECONDS).
+ *          unsigned frequency - muestras por segundo de cada hilo
+ *                               (1-PROFILER_MAX_FREQUENCY).
+ *          char** out - pilas en formato folded (se libera con free).
+ *          size_t* len - longitud de out.
+ *          profiler_stats_t* stats - (opcional) resumen del muestreo.
+ * DESCRIPCION: Muestrea los hilos que existen al empezar, salvo el que llama,
+ *              y bloquea al que llama durante el muestreo. Solo puede haber
+ *              un muestreo a la vez.
+ * ARGS_OUT: int - 0 o -1 en caso de error (errno de perf_event_open si el
+ *                 sistema no lo permite, EBUSY si ya hay otro muestreo,
+ *                 ECANCELED si esta deshabilitado o se corta con
+ *                 profiler_enable).
+ ******************************************************************************/
+int profiler_run(unsigned seconds,
+                 unsigned frequency,
+                 char** out,
+                 size_t* len,
+                 profiler_stats_t* stats);
+
+/*******************************************************************************
+ * FUNCION: void profiler_enable(bool enable)
+ * ARGS_IN: bool enable - false para cortar el muestreo en curso y rechazar
+ *                        los siguientes, true para volver a permitirlos.
+ * DESCRIPCION: Un muestreo cortado termina en menos de un periodo de lectura
+ *              de los buffers sin resolver las pilas, asi que quien espera al
+ *              hilo que lo ejecuta no se queda bloqueado hasta que acabe.
+ ******************************************************************************/
+void profiler_enable(bool enable);
+
+#endif /* __PROFILER_H__ */
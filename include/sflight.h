@@ -0,0 +1,63 @@
+/*****************************************************************************
+ * ARCHIVO: sflight.h
+ * DESCRIPCION: Interfaz de programacion para la agrupacion de peticiones
+ * concurrentes identicas (single-flight). Mientras una ejecucion para una
+ * clave esta en curso, el resto de llamadas con la misma clave esperan a su
+ * resultado en lugar de repetir el trabajo.
+ *
+ * FECHA CREACION: 19 Octubre de 2026
+ * AUTORES: Javier Mateos Najari, Adrian Sebastian Gil
+ *****************************************************************************/
+#ifndef __SFLIGHT_H__
+#define __SFLIGHT_H__
+
+#include <stdbool.h>
+#include <stdio.h>
+
+typedef struct sflight sflight_t; // Grupo de ejecuciones en curso
+
+/* Funcion que produce el resultado de una clave. Debe reservar con malloc
+ * el buffer devuelto en data y devolver su longitud en len. El valor de
+ * retorno es un codigo de estado que se propaga a todos los que esperan. */
+typedef int (*sflight_func_t)(void* arg, char** data, size_t* len);
+
+/*******************************************************************************
+ * FUNCION: sflight_t* sflight_create()
+ * DESCRIPCION: Crea e inicializa un grupo de ejecuciones single-flight.
+ * ARGS_OUT: sflight_t* - grupo inicializado o NULL en caso de error.
+ ******************************************************************************/
+sflight_t* sflight_create();
+
+/*******************************************************************************
+ * FUNCION: void sflight_destroy(sflight_t* sf)
+ * ARGS_IN: sflight_t* sf - grupo que se destruye.
+ * DESCRIPCION: Libera el grupo. No debe haber ejecuciones en curso.
+ ******************************************************************************/
+void sflight_destroy(sflight_t* sf);
+
+/*******************************************************************************
+ * FUNCION: int sflight_do(sflight_t* sf, const char* key, sflight_func_t func,
+ *                         void* arg, char** data, size_t* len, bool* shared)
+ * ARGS_IN: sflight_t* sf - grupo de ejecuciones.
+ *          const char* key - clave que identifica el resultado.
+ *          sflight_func_t func - funcion que produce el resultado.
+ *          void* arg - argumento de la funcion.
+ *          char** data - buffer con el resultado (lo libera el llamante).
+ *          size_t* len - longitud del resultado.
+ *          bool* shared - (opcional) true si el resultado se ha obtenido de
+ *                         la ejecucion de otro hilo.
+ * DESCRIPCION: Ejecuta func para la clave si no hay ninguna ejecucion en
+ *              curso para ella. En caso contrario espera a que termine y
+ *              devuelve una copia de su resultado. Si no hay memoria para la
+ *              copia, data queda a NULL aunque func no haya fallado.
+ * ARGS_OUT: int - codigo de estado devuelto por func.
+ ******************************************************************************/
+int sflight_do(sflight_t* sf,
+               const char* key,
+               sflight_func_t func,
+               void* arg,
+               char** data,
+               size_t* len,
+               bool* shared);
+
+#endif /* __SFLIGHT_H__ */
@@ -8,41 +8,95 @@
 #ifndef __SOCKET_H__
 #define __SOCKET_H__
 
+#include <netinet/in.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <sys/types.h>
 
 /*******************************************************************************
- * FUNCION: int socket_init(char* port, int backlog)
- * ARGS_IN: char* port - Puerto del socket.
+ * FUNCION: int socket_init(char* host, char* port, int backlog)
+ * ARGS_IN: char* host - Direccion en la que escucha (NULL: todas).
+ *          char* port - Puerto del socket.
  *          int backlog - Numero de usuario maximo de la cola del socket.
  * DESCRIPCION: Crea e inicializa un socket del conexion para el servidor.
  * ARGS_OUT: int - Descriptor de fichero del socket.
  ******************************************************************************/
-int socket_init(char* port, int backlog);
+int socket_init(char* host, char* port, int backlog);
 
 /*******************************************************************************
- * FUNCION: int socket_accept(int sock_fd)
+ * FUNCION: int socket_accept(int sock_fd, struct sockaddr_in* peer)
  * ARGS_IN: int sock_fd - Descriptor de fichero del socket en el que escucha el
  *                        servidor.
+ *          struct sockaddr_in* peer - Direccion del cliente (se pone a 0 si
+ *                                     no es IPv4).
  * DESCRIPCION: Acepta conexiones entrantes al servidor.
  * ARGS_OUT: int - Descriptor de fichero del socket para la conexion recibida.
  ******************************************************************************/
-int socket_accept(int sock_fd);
+int socket_accept(int sock_fd, struct sockaddr_in* peer);
 
 /*******************************************************************************
  * FUNCION: int socket_send(int sock_fd, char* response_header, char*
- *                          response_body, int response_body_len)
+ *                          response_body, int response_body_len,
+ *                          int timeout_ms)
  * ARGS_IN: int sock_fd - Descriptor de fichero del socket de la conexion con
  *                        el cliente.
  *          char* response_header - Cabecera del mensaje enviado.
  *          char* response_body - Cuerpo del mensaje enviado.
  *          int response_body_len - Longitud del cuerpo del mensaje.
- * DESCRIPCION: Acepta conexiones entrantes al servidor.
+ *          int timeout_ms - Tiempo maximo para enviar la respuesta entera
+ *                           (ms, 0: sin limite).
+ * DESCRIPCION: Envia la cabecera y el cuerpo de una respuesta. Si se llena el
+ *              buffer de envio espera a que el cliente lea; en una corrutina
+ *              lo hace en su bucle de eventos (ver evloop.h). El limite es
+ *              unico para toda la respuesta, asi que un cliente que lee muy
+ *              despacio no retiene la conexion indefinidamente.
  * ARGS_OUT: int - 0 si se ha enviado todo correctamente o -1 si se produce
- *                 algun error.
+ *                 algun error o expira la espera.
  ******************************************************************************/
 int socket_send(int sock_fd,
                 char* response_header,
                 char* response_body,
-                int response_body_len);
+                int response_body_len,
+                int timeout_ms);
+/*******************************************************************************
+ * FUNCION: ssize_t socket_recv(int sock_fd, char* buf, size_t len,
+ *                              uint64_t deadline)
+ * ARGS_IN: int sock_fd - Descriptor de fichero del socket de la conexion con
+ *                        el cliente.
+ *          char* buf - Buffer donde se reciben los datos.
+ *          size_t len - Tamanio del buffer.
+ *          uint64_t deadline - Instante limite (ver socket_deadline, 0: sin
+ *                              limite).
+ * DESCRIPCION: Recibe datos del cliente. Si no hay datos espera hasta que
+ *              lleguen o se alcance el instante limite.
+ * ARGS_OUT: ssize_t - bytes recibidos, 0 si el cliente ha cerrado o -1 en
+ *                     caso de error o de expirar la espera (errno
+ *                     ETIMEDOUT).
+ ******************************************************************************/
+ssize_t socket_recv(int sock_fd, char* buf, size_t len, uint64_t deadline);
+/*******************************************************************************
+ * FUNCION: int socket_write(int sock_fd, const char* buf, size_t len,
+ *                           uint64_t deadline)
+ * ARGS_IN: int sock_fd - Descriptor de fichero del socket de la conexion con
+ *                        el cliente.
+ *          const char* buf - Datos que se envian.
+ *          size_t len - Longitud de los datos.
+ *          uint64_t deadline - Instante limite (ver socket_deadline, 0: sin
+ *                              limite).
+ * DESCRIPCION: Envia todos los datos, esperando como socket_send, hasta el
+ *              instante limite. Varios envios de una misma respuesta
+ *              comparten el mismo instante limite.
+ * ARGS_OUT: int - 0 si se ha enviado todo o -1 si se produce algun error o
+ *                 expira la espera.
+ ******************************************************************************/
+int socket_write(int sock_fd, const char* buf, size_t len, uint64_t deadline);
+/*******************************************************************************
+ * FUNCION: uint64_t socket_deadline(int timeout_ms)
+ * ARGS_IN: int timeout_ms - Tiempo desde ahora (ms, 0 o menos: sin limite).
+ * DESCRIPCION: Calcula el instante limite de una espera en el reloj de los
+ *              bucles de eventos (ver twheel_clock).
+ * ARGS_OUT: uint64_t - Instante limite o 0 si no hay limite.
+ ******************************************************************************/
+uint64_t socket_deadline(int timeout_ms);
 
 #endif /* __SOCKET_H__ */
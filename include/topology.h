@@ -0,0 +1,61 @@
+/*****************************************************************************
+ * ARCHIVO: topology.h
+ * DESCRIPCION: Interfaz de programacion para descubrir la topologia de CPUs
+ * de la maquina (CPUs, cores fisicos, sockets y nodos NUMA) a partir de
+ * sysfs.
+ *
+ * FECHA CREACION: 19 Octubre de 2026
+ * AUTORES: Javier Mateos Najari, Adrian Sebastian Gil
+ *****************************************************************************/
+#ifndef __TOPOLOGY_H__
+#define __TOPOLOGY_H__
+
+#include <stdio.h>
+
+// CPU logica
+typedef struct topology_cpu {
+    int id;      // Numero de la CPU para el sistema operativo
+    int core;    // Indice del core fisico (unico en toda la maquina)
+    int sibling; // Posicion de la CPU entre las de su core (SMT)
+    int package; // Socket fisico
+    int node;    // Nodo NUMA
+    int rank;    // Posicion del core entre los del mismo nodo
+} topology_cpu_t;
+
+// Topologia de la maquina
+typedef struct topology {
+    size_t num_cpus;      // Numero de CPUs en linea
+    size_t num_cores;     // Numero de cores fisicos
+    size_t num_packages;  // Numero de sockets
+    size_t num_nodes;     // Numero de nodos NUMA
+    topology_cpu_t* cpus; // CPUs ordenadas por numero
+    size_t* spread;       // Orden de reparto de hilos (indices de cpus)
+} topology_t;
+
+/*******************************************************************************
+ * FUNCION: topology_t* topology_discover()
+ * DESCRIPCION: Lee la topologia de /sys/devices/system. Si no hay informacion
+ *              de nodos NUMA todas las CPUs se asignan al nodo 0.
+ * ARGS_OUT: topology_t* - topologia o NULL en caso de error.
+ ******************************************************************************/
+topology_t* topology_discover();
+
+/*******************************************************************************
+ * FUNCION: void topology_destroy(topology_t* topo)
+ * ARGS_IN: topology_t* topo - topologia que se libera.
+ * DESCRIPCION: Libera la topologia.
+ ******************************************************************************/
+void topology_destroy(topology_t* topo);
+
+/*******************************************************************************
+ * FUNCION: const topology_cpu_t* topology_spread(const topology_t* topo,
+ *                                               size_t idx)
+ * ARGS_IN: const topology_t* topo - topologia.
+ *          size_t idx - indice del hilo que se coloca.
+ * DESCRIPCION: Reparte hilos entre CPUs llenando primero un hilo por core
+ *              fisico, alternando nodos, y despues los hermanos SMT.
+ * ARGS_OUT: const topology_cpu_t* - CPU del hilo idx.
+ ******************************************************************************/
+const topology_cpu_t* topology_spread(const topology_t* topo, size_t idx);
+
+#endif /* __TOPOLOGY_H__ */
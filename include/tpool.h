@@ -11,10 +11,62 @@
 #include <stdio.h>
 #include <stdbool.h>
 
+#include "topology.h"
+
 typedef struct tpool tpool_t; // Pool de hilos
 
 typedef void (*thread_func_t)(void* arg); // Funcion tipo que ejecutan los hilos
 
+// Modo de reparto del trabajo entre los hilos. Con robo de trabajo solo van a
+// la cola de un hilo los trabajos que se encolan desde un hilo del propio
+// pool; los que llegan de fuera van a la cola comun. Solo compensa cuando los
+// trabajos encolan a su vez otros en el mismo pool.
+typedef enum tpool_mode {
+    TPOOL_MODE_FIFO = 0, // Una unica cola compartida por todos los hilos
+    TPOOL_MODE_STEAL     // Una cola por hilo con robo de trabajo
+} tpool_mode_t;
+
+// Fijacion de los hilos a CPUs
+typedef enum tpool_affinity {
+    TPOOL_AFFINITY_NONE = 0, // Los hilos se mueven libremente
+    TPOOL_AFFINITY_CORE,     // Cada hilo fijado a una CPU de un core distinto
+    TPOOL_AFFINITY_NODE      // Cada hilo fijado a las CPUs de un nodo NUMA
+} tpool_affinity_t;
+
+// Opciones de creacion del pool de hilos
+typedef struct tpool_opts {
+    int num_threads;            // Numero minimo de hilos del pool
+    int max_threads;            // Numero maximo de hilos (0: num_threads)
+    int target_ms;              // Espera en cola que hace crecer (0: 5 ms)
+    int idle_ms;                // Reposo tras el que sobra un hilo (0: 10 s)
+    size_t queue_size;          // Tamanio max de cada cola (0: num * num)
+    tpool_mode_t mode;          // Modo de reparto del trabajo
+    tpool_affinity_t affinity;  // Fijacion de los hilos a CPUs
+    const topology_t* topology; // Topologia (debe vivir mas que el pool)
+    size_t cpu_offset;          // Posicion del primer hilo en el reparto
+    int codel_target_ms;        // Espera en cola aceptable (0: sin CoDel)
+    int codel_interval_ms;      // Intervalo de CoDel (0: 100 ms)
+    thread_func_t shed;         // Funcion para los trabajos descartados
+    int limit_threads;          // Maximo de tpool_resize (0: max_threads)
+} tpool_opts_t;
+
+// Estadisticas del pool de hilos
+typedef struct tpool_stats {
+    size_t num_threads; // Numero de hilos vivos del pool
+    size_t min_threads; // Numero minimo de hilos del pool
+    size_t max_threads; // Numero maximo de hilos del pool
+    size_t queue_size;  // Tamanio max de la cola de trabajo
+    size_t queued;      // Trabajos esperando en la cola
+    size_t max_queued;  // Maximo de trabajos que han esperado en la cola
+    size_t active;      // Hilos ejecutando un trabajo
+    size_t completed;   // Trabajos terminados
+    size_t rejected;    // Trabajos rechazados por tener la cola llena
+    size_t dropped;     // Trabajos descartados por CoDel
+    size_t stolen;      // Trabajos robados de la cola de otro hilo
+    size_t grown;       // Hilos creados por encima del minimo
+    size_t retired;     // Hilos retirados por falta de trabajo
+} tpool_stats_t;
+
 /*******************************************************************************
  * FUNCION: tpool_t* tpool_create(int num)
  * ARGS_IN: int num - numero de hilos del pool.
@@ -23,11 +75,37 @@ typedef void (*thread_func_t)(void* arg); // Funcion tipo que ejecutan los hilos
  ******************************************************************************/
 tpool_t* tpool_create(int num);
 
+/*******************************************************************************
+ * FUNCION: tpool_t* tpool_create_opts(const tpool_opts_t* opts)
+ * ARGS_IN: const tpool_opts_t* opts - opciones del pool.
+ * DESCRIPCION: Crea e inicializa un pool de hilos con las opciones indicadas.
+ *              En el modo TPOOL_MODE_STEAL cada hilo tiene su propia cola:
+ *              los trabajos que aniade un hilo del pool van a su cola y los
+ *              que se aniaden desde fuera a una cola global. Un hilo sin
+ *              trabajo lo toma de su cola, de la global o lo roba de la cola
+ *              de otro hilo elegido al azar.
+ *              Si max_threads es mayor que num_threads, se crea un hilo mas
+ *              cada vez que un trabajo espera en cola mas de target_ms,
+ *              hasta max_threads, y los hilos por encima de num_threads
+ *              terminan tras idle_ms sin trabajo.
+ *              Con affinity distinto de TPOOL_AFFINITY_NONE, el hilo del
+ *              hueco i se fija segun topology_spread(topology, cpu_offset
+ *              + i), a esa CPU o a todo su nodo.
+ *              Con codel_target_ms y shed, al sacar cada trabajo se aplica
+ *              CoDel: si la espera en cola supera el objetivo durante todo
+ *              un intervalo, se descartan trabajos llamando a shed(arg) en
+ *              lugar de a la funcion del trabajo, cada vez mas a menudo
+ *              mientras no baje la espera.
+ * ARGS_OUT: tpool_t* - pool de hilos inicializado.
+ ******************************************************************************/
+tpool_t* tpool_create_opts(const tpool_opts_t* opts);
+
 /*******************************************************************************
  * FUNCION: void tpool_destroy(tpool_t* tm)
- * ARGS_IN: int num - pool de hilos que se destruye.
+ * ARGS_IN: tpool_t* tm - pool de hilos que se destruye.
  * DESCRIPCION: Destruye y libera el pool de hilos esperando a que todos los
- *              hilos del pool finalicen.
+ *              hilos del pool finalicen. Los trabajos que siguen en la cola
+ *              se descartan sin ejecutarse y sus argumentos no se liberan.
  ******************************************************************************/
 void tpool_destroy(tpool_t* tm);
 
@@ -43,4 +121,50 @@ void tpool_destroy(tpool_t* tm);
  ******************************************************************************/
 bool tpool_add_work(tpool_t* tm, thread_func_t func, void* arg);
 
+/*******************************************************************************
+ * FUNCION: bool tpool_try_add_work(tpool_t* tm, thread_func_t func, void* arg)
+ * ARGS_IN: tpool_t* tm - pool de hilos al que se aniade el trabajo.
+ *          thread_funct_t func - funcion de trabajo que ejecuta el hilo.
+ *          void* arg - argumentos de la funcion de trabajo.
+ * DESCRIPCION: Aniade un trabajo a la cola de trabajos del pool de hilos sin
+ *              bloquear. Si no hay espacio en la cola el trabajo se rechaza.
+ * ARGS_OUT: bool - true si se aniade o false en caso contrario.
+ ******************************************************************************/
+bool tpool_try_add_work(tpool_t* tm, thread_func_t func, void* arg);
+
+/*******************************************************************************
+ * FUNCION: bool tpool_resize(tpool_t* tm, int num_threads, int max_threads)
+ * ARGS_IN: tpool_t* tm - pool de hilos.
+ *          int num_threads - nuevo numero minimo de hilos.
+ *          int max_threads - nuevo numero maximo de hilos (0: num_threads).
+ * DESCRIPCION: Cambia el numero de hilos del pool sin pararlo. Si sube el
+ *              minimo se lanzan los hilos que falten; si baja, los que
+ *              sobran terminan al quedarse sin trabajo como los hilos
+ *              elasticos, sin interrumpir el trabajo en curso. El maximo no
+ *              puede pasar de limit_threads, porque los huecos de los hilos
+ *              se reservan al crear el pool.
+ * ARGS_OUT: bool - false si el maximo supera limit_threads.
+ ******************************************************************************/
+bool tpool_resize(tpool_t* tm, int num_threads, int max_threads);
+
+/*******************************************************************************
+ * FUNCION: void tpool_get_stats(tpool_t* tm, tpool_stats_t* stats)
+ * ARGS_IN: tpool_t* tm - pool de hilos del que se obtienen las estadisticas.
+ *          tpool_stats_t* stats - estructura donde se guardan.
+ * DESCRIPCION: Obtiene una foto de la ocupacion de la cola y de los hilos.
+ ******************************************************************************/
+void tpool_get_stats(tpool_t* tm, tpool_stats_t* stats);
+
+/*******************************************************************************
+ * FUNCION: bool tpool_get_placement(tpool_t* tm, size_t idx, int* cpu,
+ *                                   int* node)
+ * ARGS_IN: tpool_t* tm - pool de hilos.
+ *          size_t idx - hueco del hilo (de 0 al maximo de hilos).
+ *          int* cpu - donde se guarda la CPU del hilo (-1: sin fijar).
+ *          int* node - donde se guarda el nodo del hilo (-1: sin fijar).
+ * DESCRIPCION: Obtiene donde se coloca el hilo de un hueco.
+ * ARGS_OUT: bool - false si el hueco no existe.
+ ******************************************************************************/
+bool tpool_get_placement(tpool_t* tm, size_t idx, int* cpu, int* node);
+
 #endif /* __TPOOL_H__ */
@@ -0,0 +1,131 @@
+/*****************************************************************************
+ * ARCHIVO: trace.h
+ * DESCRIPCION: Interfaz de programacion de la traza de peticiones. Una de
+ * cada N peticiones guarda instantes del reloj monotono en cada fase (cola,
+ * recepcion, parseo, fichero o script, envio) y al terminar se escriben como
+ * spans en formato Chrome Trace Event (JSON), que se abren en
+ * chrome://tracing o en Perfetto. Cada peticion muestreada es una pista
+ * (tid) propia, de modo que las corrutinas de un mismo hilo no se mezclan.
+ *
+ * Con el muestreo desactivado cada peticion solo comprueba un entero.
+ *
+ * FECHA CREACION: 19 Octubre de 2026
+ * AUTORES: Javier Mateos Najari, Adrian Sebastian Gil
+ *****************************************************************************/
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define TRACE_BUF_SIZE 2048 // Tamanio de los spans de una peticion
+
+// Opciones de la traza
+typedef struct trace_opts {
+    const char* path; // Fichero JSON de la traza (se trunca)
+    unsigned sample;  // Se traza una de cada sample peticiones (0: ninguna)
+} trace_opts_t;
+
+// Spans de una peticion pendientes de escribir
+typedef struct trace_buf {
+    uint64_t id;                // Pista de la peticion (ver trace_begin)
+    size_t len;                 // Bytes usados de data
+    char data[TRACE_BUF_SIZE];  // Eventos JSON separados por comas
+} trace_buf_t;
+
+/*******************************************************************************
+ * FUNCION: int trace_init(const trace_opts_t* opts)
+ * ARGS_IN: const trace_opts_t* opts - opciones de la traza.
+ * DESCRIPCION: Crea el fichero de la traza y activa el muestreo. Hay una
+ *              unica traza por proceso.
+ * ARGS_OUT: int - 0 o -1 en caso de error.
+ ******************************************************************************/
+int trace_init(const trace_opts_t* opts);
+
+/*******************************************************************************
+ * FUNCION: void trace_destroy()
+ * DESCRIPCION: Desactiva el muestreo, cierra el array JSON y el fichero.
+ *              Ningun otro hilo debe estar escribiendo.
+ ******************************************************************************/
+void trace_destroy();
+
+/*******************************************************************************
+ * FUNCION: bool trace_enabled()
+ * DESCRIPCION: Indica si hay muestreo, para no tomar instantes que solo
+ *              sirven a la traza.
+ * ARGS_OUT: bool - true si la traza esta iniciada.
+ ******************************************************************************/
+bool trace_enabled();
+
+/*******************************************************************************
+ * FUNCION: uint64_t trace_begin()
+ * DESCRIPCION: Decide si se traza la peticion que empieza. Cada hilo sortea
+ *              sus peticiones con probabilidad 1/sample sin compartir nada.
+ * ARGS_OUT: uint64_t - identificador de la peticion si se traza o 0 si no.
+ ******************************************************************************/
+uint64_t trace_begin();
+
+/*******************************************************************************
+ * FUNCION: uint64_t trace_now()
+ * DESCRIPCION: Obtiene el instante actual en el reloj monotono.
+ * ARGS_OUT: uint64_t - instante actual (ns).
+ ******************************************************************************/
+uint64_t trace_now();
+
+/*******************************************************************************
+ * FUNCION: long trace_thread()
+ * DESCRIPCION: Obtiene el identificador del hilo en el sistema, para
+ *              relacionar las pistas con los hilos que las atienden.
+ * ARGS_OUT: long - identificador del hilo (gettid).
+ ******************************************************************************/
+long trace_thread();
+
+/*******************************************************************************
+ * FUNCION: void trace_buf_init(trace_buf_t* buf, uint64_t id)
+ * ARGS_IN: trace_buf_t* buf - spans de la peticion.
+ *          uint64_t id - identificador de trace_begin.
+ * DESCRIPCION: Prepara el buffer para los spans de una peticion.
+ ******************************************************************************/
+void trace_buf_init(trace_buf_t* buf, uint64_t id);
+
+/*******************************************************************************
+ * FUNCION: void trace_span(trace_buf_t* buf,
+ *                          const char* name,
+ *                          uint64_t start,
+ *                          uint64_t end,
+ *                          const char* args)
+ * ARGS_IN: trace_buf_t* buf - spans de la peticion.
+ *          const char* name - nombre de la fase.
+ *          uint64_t start - inicio de la fase (ns de trace_now, 0: sin dato).
+ *          uint64_t end - fin de la fase (ns de trace_now, 0: sin dato).
+ *          const char* args - (opcional) miembros JSON de "args", ya
+ *                             escapados (p. ej. "\"status\":200").
+ * DESCRIPCION: Anade un evento completo ("ph":"X"). Las fases sin alguno de
+ *              los instantes o que no caben en el buffer se omiten.
+ ******************************************************************************/
+void trace_span(trace_buf_t* buf,
+                const char* name,
+                uint64_t start,
+                uint64_t end,
+                const char* args);
+
+/*******************************************************************************
+ * FUNCION: void trace_flush(trace_buf_t* buf)
+ * ARGS_IN: trace_buf_t* buf - spans de la peticion.
+ * DESCRIPCION: Escribe los spans de la peticion en la traza de una vez.
+ ******************************************************************************/
+void trace_flush(trace_buf_t* buf);
+
+/*******************************************************************************
+ * FUNCION: void trace_escape(char* dst, size_t size, const char* value)
+ * ARGS_IN: char* dst - buffer de salida.
+ *          size_t size - tamanio de dst.
+ *          const char* value - cadena que se copia.
+ * DESCRIPCION: Escapa una cadena para un string JSON. Los bytes de control y
+ *              los que no son ASCII se escriben como \u00XX. Se trunca si no
+ *              cabe en dst.
+ ******************************************************************************/
+void trace_escape(char* dst, size_t size, const char* value);
+
+#endif /* __TRACE_H__ */
@@ -0,0 +1,103 @@
+/*****************************************************************************
+ * ARCHIVO: twheel.h
+ * DESCRIPCION: Interfaz de programacion de una rueda de temporizadores
+ * jerarquica. Armar y cancelar un temporizador es O(1) y avanzar el reloj
+ * solo toca las ranuras que vencen. Los temporizadores van dentro de la
+ * estructura del usuario, asi que la rueda no reserva memoria. Una rueda
+ * solo la usa un hilo.
+ *
+ * REFERENCIA: Varghese y Lauck, "Hashed and Hierarchical Timing Wheels"
+ *
+ * FECHA CREACION: 19 Octubre de 2026
+ * AUTORES: Javier Mateos Najari, Adrian Sebastian Gil
+ *****************************************************************************/
+#ifndef __TWHEEL_H__
+#define __TWHEEL_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define TWHEEL_BITS 6                        // Bits del indice de una ranura
+#define TWHEEL_SLOTS (1 << TWHEEL_BITS)      // Ranuras de cada nivel
+#define TWHEEL_LEVELS 4                      // Niveles de la rueda
+
+// Temporizador. Se incluye en la estructura del usuario.
+typedef struct twheel_timer {
+    uint64_t expires;            // Instante en que vence (ms)
+    struct twheel_timer* next;   // Siguiente de la ranura
+    struct twheel_timer** pprev; // Enlace que apunta a este (NULL: sin armar)
+} twheel_timer_t;
+
+// Rueda de temporizadores. El nivel l tiene ranuras de 64^l ms.
+typedef struct twheel {
+    uint64_t now;   // Ultimo instante procesado (ms)
+    size_t count;   // Temporizadores armados
+    twheel_timer_t* slots[TWHEEL_LEVELS][TWHEEL_SLOTS]; // Ranuras
+} twheel_t;
+
+// Funcion a la que se llama con cada temporizador que vence
+typedef void (*twheel_func_t)(twheel_timer_t* timer, void* arg);
+
+/*******************************************************************************
+ * FUNCION: uint64_t twheel_clock()
+ * DESCRIPCION: Obtiene el instante actual en el reloj de las ruedas
+ *              (CLOCK_MONOTONIC).
+ * ARGS_OUT: uint64_t - instante actual (ms).
+ ******************************************************************************/
+uint64_t twheel_clock();
+
+/*******************************************************************************
+ * FUNCION: void twheel_init(twheel_t* tw, uint64_t now)
+ * ARGS_IN: twheel_t* tw - rueda que se inicializa.
+ *          uint64_t now - instante actual (ms).
+ * DESCRIPCION: Inicializa una rueda vacia.
+ ******************************************************************************/
+void twheel_init(twheel_t* tw, uint64_t now);
+
+/*******************************************************************************
+ * FUNCION: void twheel_arm(twheel_t* tw, twheel_timer_t* timer,
+ *                          uint64_t expires)
+ * ARGS_IN: twheel_t* tw - rueda.
+ *          twheel_timer_t* timer - temporizador (si ya estaba armado se
+ *                                  rearma).
+ *          uint64_t expires - instante en que vence (ms). Si ya ha pasado
+ *                             vence en el siguiente avance.
+ * DESCRIPCION: Arma un temporizador. Los plazos de mas de 64^4 ms (unas
+ *              cuatro horas y media) se acortan a ese maximo.
+ ******************************************************************************/
+void twheel_arm(twheel_t* tw, twheel_timer_t* timer, uint64_t expires);
+
+/*******************************************************************************
+ * FUNCION: void twheel_cancel(twheel_t* tw, twheel_timer_t* timer)
+ * ARGS_IN: twheel_t* tw - rueda.
+ *          twheel_timer_t* timer - temporizador (puede no estar armado).
+ * DESCRIPCION: Desarma un temporizador.
+ ******************************************************************************/
+void twheel_cancel(twheel_t* tw, twheel_timer_t* timer);
+
+/*******************************************************************************
+ * FUNCION: void twheel_advance(twheel_t* tw, uint64_t now,
+ *                              twheel_func_t func, void* arg)
+ * ARGS_IN: twheel_t* tw - rueda.
+ *          uint64_t now - instante actual (ms).
+ *          twheel_func_t func - funcion a la que se llama con cada
+ *                               temporizador vencido, ya desarmado. Puede
+ *                               armar y cancelar temporizadores.
+ *          void* arg - argumento de la funcion.
+ * DESCRIPCION: Avanza la rueda hasta now y vence los temporizadores.
+ ******************************************************************************/
+void twheel_advance(twheel_t* tw, uint64_t now, twheel_func_t func, void* arg);
+
+/*******************************************************************************
+ * FUNCION: int twheel_timeout(twheel_t* tw, uint64_t now)
+ * ARGS_IN: twheel_t* tw - rueda.
+ *          uint64_t now - instante actual (ms).
+ * DESCRIPCION: Calcula cuanto se puede esperar antes de avanzar la rueda. Si
+ *              el primer temporizador esta en un nivel alto devuelve cuando
+ *              hay que bajarlo de nivel, que es antes de que venza.
+ * ARGS_OUT: int - milisegundos (0: ya hay que avanzar, -1: rueda vacia).
+ ******************************************************************************/
+int twheel_timeout(twheel_t* tw, uint64_t now);
+
+#endif /* __TWHEEL_H__ */
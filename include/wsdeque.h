@@ -0,0 +1,75 @@
+/*****************************************************************************
+ * ARCHIVO: wsdeque.h
+ * DESCRIPCION: Interfaz de programacion de una cola doble acotada para robo
+ * de trabajo (Chase-Lev). Un unico hilo propietario inserta y extrae por un
+ * extremo (LIFO) y el resto de hilos roban por el otro (FIFO). Los elementos
+ * se copian por valor en un buffer circular reservado al crear la cola.
+ *
+ * FECHA CREACION: 19 Octubre de 2026
+ * AUTORES: Javier Mateos Najari, Adrian Sebastian Gil
+ *****************************************************************************/
+#ifndef __WSDEQUE_H__
+#define __WSDEQUE_H__
+
+#include <stdbool.h>
+#include <stdio.h>
+
+typedef struct wsdeque wsdeque_t; // Cola de robo de trabajo
+
+/*******************************************************************************
+ * FUNCION: wsdeque_t* wsdeque_create(size_t capacity, size_t elem_size)
+ * ARGS_IN: size_t capacity - numero minimo de elementos de la cola. Se
+ *                            redondea a la siguiente potencia de dos.
+ *          size_t elem_size - tamanio en bytes de cada elemento.
+ * DESCRIPCION: Crea e inicializa una cola vacia.
+ * ARGS_OUT: wsdeque_t* - cola inicializada o NULL en caso de error.
+ ******************************************************************************/
+wsdeque_t* wsdeque_create(size_t capacity, size_t elem_size);
+
+/*******************************************************************************
+ * FUNCION: void wsdeque_destroy(wsdeque_t* q)
+ * ARGS_IN: wsdeque_t* q - cola que se destruye.
+ * DESCRIPCION: Libera la cola. Los elementos que queden se descartan.
+ ******************************************************************************/
+void wsdeque_destroy(wsdeque_t* q);
+
+/*******************************************************************************
+ * FUNCION: bool wsdeque_push(wsdeque_t* q, const void* elem)
+ * ARGS_IN: wsdeque_t* q - cola en la que se inserta.
+ *          const void* elem - elemento que se copia en la cola.
+ * DESCRIPCION: Inserta un elemento sin bloquear. Solo puede llamarla el hilo
+ *              propietario de la cola.
+ * ARGS_OUT: bool - true si se inserta o false si la cola esta llena.
+ ******************************************************************************/
+bool wsdeque_push(wsdeque_t* q, const void* elem);
+
+/*******************************************************************************
+ * FUNCION: bool wsdeque_pop(wsdeque_t* q, void* elem)
+ * ARGS_IN: wsdeque_t* q - cola de la que se extrae.
+ *          void* elem - donde se copia el elemento extraido.
+ * DESCRIPCION: Extrae el ultimo elemento insertado sin bloquear. Solo puede
+ *              llamarla el hilo propietario de la cola.
+ * ARGS_OUT: bool - true si se extrae o false si la cola esta vacia.
+ ******************************************************************************/
+bool wsdeque_pop(wsdeque_t* q, void* elem);
+
+/*******************************************************************************
+ * FUNCION: bool wsdeque_steal(wsdeque_t* q, void* elem)
+ * ARGS_IN: wsdeque_t* q - cola de la que se roba.
+ *          void* elem - donde se copia el elemento robado.
+ * DESCRIPCION: Extrae el elemento mas antiguo sin bloquear. Puede llamarla
+ *              cualquier hilo.
+ * ARGS_OUT: bool - true si se extrae o false si la cola esta vacia.
+ ******************************************************************************/
+bool wsdeque_steal(wsdeque_t* q, void* elem);
+
+/*******************************************************************************
+ * FUNCION: size_t wsdeque_size(wsdeque_t* q)
+ * ARGS_IN: wsdeque_t* q - cola de la que se obtiene el tamanio.
+ * DESCRIPCION: Obtiene el numero aproximado de elementos en la cola. Con
+ *              operaciones concurrentes el valor puede estar desfasado.
+ * ARGS_OUT: size_t - numero de elementos.
+ ******************************************************************************/
+size_t wsdeque_size(wsdeque_t* q);
+
+#endif /* __WSDEQUE_H__ */
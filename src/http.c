@@ -6,28 +6,49 @@
  * FECHA CREACION: 4 Marzo de 2021
  * AUTORES: Javier Mateos Najari, Adrian Sebastian Gil
  ******************************************************************************/
+#include <errno.h>        // errno
 #include <fcntl.h>        // open
+#include <poll.h>         // poll
+#include <pthread.h>      // pthread_mutex_lock
+#include <signal.h>       // kill
+#include <stdatomic.h>    // atomic_size_t
+#include <stdbool.h>      // bool
 #include <stdlib.h>       // NULL
 #include <string.h>       // strcmp
+#include <strings.h>      // strncasecmp
+#include <sys/eventfd.h>  // eventfd
 #include <sys/sendfile.h> // sendfile
 #include <sys/socket.h>   // recv
 #include <sys/stat.h>     // stat
+#include <sys/resource.h> // setrlimit
 #include <sys/stat.h>     // open
+#include <sys/syscall.h>  // SYS_pipe2, SYS_pidfd_open
 #include <sys/wait.h>     // wait
 #include <time.h>         // strftime
+#include <unistd.h>       // fork
 
+#include "acclog.h"
+#include "capture.h"
+#include "evloop.h"
 #include "http.h"
+#include "metrics.h"
 #include "picohttpparser.h"
+#include "probes.h"
+#include "sflight.h"
 #include "socket.h"
+#include "trace.h"
 
 #define MAX_HTTP_REQUESTS_SIZE 4096 // Tamanyo maximo de la peticion
 #define MAX_HTTP_NUM_HEADERS 100    // Numero maximo de cabeceras
 #define MAX_HTTP_DATE_LEN 128       // Maxima longitud de la fecha
 #define MAX_HTTP_HEADER 1024       // Tamanyo maximo de cabecera en la respuesta
-#define MAX_HTTP_ERRORS 5          // Numero de errores del servidor
+#define MAX_HTTP_ERRORS 8          // Numero de errores del servidor
 #define MAX_HTTP_PATH 100          // Tamanyo maximo del path
-#define MAX_HTTP_COMMAND 200       // Tamanyo maximo del comando CGI
 #define MAX_HTTP_CGI_RESPONSE 3072 // Tamanyo maximo de la respuesta CGI
+#define MAX_HTTP_FLIGHT_KEY 512    // Tamanyo maximo de la clave single-flight
+#define HTTP_CGI_EXEC_FAILED 127   // Codigo de salida si el exec falla
+#define MAX_HTTP_OVERLOAD 256      // Tamanyo maximo de la respuesta 503 fija
+#define MAX_HTTP_CONNS (1 << 20)   // Descriptores de conexion con estado
 
 // Definicion de los errores del protocolo http
 typedef enum error {
@@ -36,6 +57,9 @@ typedef enum error {
     NOT_IMPLEMENTED,        // NOT_IMPLEMENTED
     UNSUPPORTED_MEDIA_TYPE, // UNSUPPORTED_MEDIA_TYPE
     INTERNAL_SERVER_ERROR,  // INTERNAL_SERVER_ERROR
+    SERVICE_UNAVAILABLE,    // SERVICE_UNAVAILABLE
+    GATEWAY_TIMEOUT,        // GATEWAY_TIMEOUT
+    REQUEST_TIMEOUT,        // REQUEST_TIMEOUT
     OK,                     // OK
 } error_t;
 
@@ -52,23 +76,146 @@ typedef struct request_header {
 typedef struct request {
     request_header_t header; // Cabecera de la request
     char* body;              // Cuerpo de la request
+    uint32_t addr;           // IPv4 del cliente (orden de red)
+    uint16_t port;           // Puerto del cliente (orden de red)
+    uint8_t flags;           // ACCLOG_KEEPALIVE | ACCLOG_DEFERRED
+    uint64_t conn;           // Identificador de la conexion
+    int status;              // Codigo de estado de la respuesta
+    size_t bytes;            // Bytes de la respuesta
+    uint64_t time_us;        // Llegada de la peticion (us desde epoch)
+    uint64_t t_wait;         // Inicio de la espera de la peticion (ns)
+    uint64_t t_first;        // Llegada del primer byte (ns)
+    uint64_t t_header;       // Cabecera y cuerpo recibidos (ns)
+    uint64_t t_send;         // Inicio del envio de la respuesta (ns)
+    int route;               // Serie de latencia (ver http_metrics_t)
+    uint64_t trace_id;       // Pista de la traza (0: no se traza)
+    uint64_t t_queued;       // Conexion encolada (ns, solo en la traza)
+    uint64_t t_start;        // Conexion recogida por un hilo (ns)
+    uint64_t t_parsed;       // Cabecera parseada (ns)
+    uint64_t parse_ns;       // Tiempo dentro del parser (ns)
+    uint64_t t_run;          // Script recogido por el pool de scripts (ns)
+    uint64_t t_open;         // Inicio de la lectura del fichero o script (ns)
+    uint64_t t_opened;       // Fichero o salida del script listos (ns)
+    const char* handler;     // Fase del recurso: "open" o "script"
+    const http_config_t* conf; // Configuracion con la que se atiende
 } request_t;
 
-// Cadena con la respuesta a una peticion GET
+// Ejecucion de un script
+typedef struct cgi {
+    char* interpreter; // Interprete que ejecuta el script
+    char* path;        // Ruta al script
+    char* args;        // Argumento del script (puede ser NULL)
+    int timeout;       // Tiempo maximo de ejecucion en segundos (0: sin limite)
+    int cpu_limit;     // Limite de tiempo de CPU en segundos (0: sin limite)
+    int mem_limit;     // Limite de memoria en MB (0: sin limite)
+} cgi_t;
+
+// Peticion de script diferida al pool de scripts
+struct http_script {
+    request_t request; // Peticion pendiente de procesar
+    int socket;        // Socket de la conexion
+};
+
+// Ejecuciones en curso de peticiones GET identicas (scripts y ficheros)
+static sflight_t* flights = NULL;
+
+// Configuracion publicada del modulo. Es inmutable: http_reload publica una
+// nueva y la anterior se libera cuando termina la ultima llamada que la usa,
+// asi que una peticion en curso no ve cambiar sus limites.
+typedef struct http_snapshot {
+    http_config_t conf; // Copia de la configuracion (primer campo)
+    int* series;        // Serie de latencia de cada ruta (ver http_route)
+    char overload[MAX_HTTP_OVERLOAD]; // Respuesta 503 generada al publicarla
+                                      // para rechazar conexiones sin
+                                      // formatear nada. No lleva Date para
+                                      // que no caduque.
+    size_t overload_len;              // Longitud de overload
+    atomic_size_t refs; // Llamadas que la usan, mas una mientras se publica
+} http_snapshot_t;
+
+// Configuracion publicada. El mutex solo protege tomar una referencia a la
+// vez que se cambia, no el uso de la configuracion.
+static http_snapshot_t* current = NULL;
+static pthread_mutex_t current_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Estado de cada conexion abierta para el drenado, indexado por su socket
+typedef enum http_conn_state {
+    HTTP_CONN_NONE,    // No es una conexion abierta
+    HTTP_CONN_BUSY,    // Atendiendo una peticion o esperando en una cola
+    HTTP_CONN_IDLE,    // Esperando la siguiente peticion keep-alive
+    HTTP_CONN_CLOSING, // Cerrada para lectura por el drenado mientras esperaba
+} http_conn_state_t;
+
+// Conexiones abiertas (ver http_conn_open) y si se esta drenando. Al drenar
+// se cierran las que esperan sin peticion y las respuestas llevan
+// Connection: close. Una conexion marca su espera antes de mirar draining y
+// http_drain hace lo contrario, asi que siempre la ve uno de los dos.
+static atomic_uchar* conns = NULL;
+static size_t max_conns = 0;
+static atomic_bool draining = false;
+// Se activa al drenar a la fuerza para cortar los scripts en ejecucion
+static int drain_fd = -1;
+
+// Cadena con la respuesta a una peticion GET. Tras Date va la cabecera
+// Connection (vacia o http_close_header)
 char* get_response =
-  "HTTP/1.%d 200 OK\r\nDate: %s\r\nServer: %s\r\nLast-Modified: "
+  "HTTP/1.%d 200 OK\r\nDate: %s\r\n%sServer: %s\r\nLast-Modified: "
   "%s\r\nContent-Length: %d\r\nContent-Type: %s\r\n\r\n";
 
 // Cadena con la respuesta a una peticion POST
 char* post_response =
-  "HTTP/1.%d 200 OK\r\nDate: %s\r\nServer: %s\r\nLast-Modified: "
+  "HTTP/1.%d 200 OK\r\nDate: %s\r\n%sServer: %s\r\nLast-Modified: "
   "%s\r\nContent-Length: %d\r\nContent-Type: %s\r\n\r\n";
 
+// Cabecera de las respuestas tras las que se cierra la conexion
+char* http_close_header = "Connection: close\r\n";
+
 // Cadena con la respuesta a una peticion OPTIONS
 char* options_response =
   "HTTP/1.%d 200 OK\r\nDate: %s\r\nConnection: close\r\nServer: "
   "%s\r\nContent-Length: 0\r\nAllow: GET, POST, OPTIONS\r\n\r\n";
 
+// Cadena con la respuesta a una conexion rechazada por sobrecarga
+char* overload_format =
+  "HTTP/1.1 503 Service Unavailable\r\nConnection: close\r\nServer: "
+  "%s\r\nRetry-After: 1\r\nContent-Length: 0\r\n\r\n";
+
+// Codigo de estado HTTP de cada error, en el orden de error_t
+static const uint16_t error_status[MAX_HTTP_ERRORS] = {
+    400, 404, 501, 415, 500, 503, 504, 408,
+};
+
+// Nombre de cada valor de error_t, para las metricas
+static const char* error_name[MAX_HTTP_ERRORS + 1] = {
+    "BAD_REQUEST",         "NOT_FOUND",       "NOT_IMPLEMENTED",
+    "UNSUPPORTED_MEDIA_TYPE", "INTERNAL_SERVER_ERROR", "SERVICE_UNAVAILABLE",
+    "GATEWAY_TIMEOUT",     "REQUEST_TIMEOUT", "OK",
+};
+
+// Metodos con serie de latencia propia (el resto van a "other")
+static const char* metric_methods[] = { "GET", "POST", "OPTIONS", "other" };
+
+#define HTTP_NUM_METHODS (sizeof(metric_methods) / sizeof(metric_methods[0]))
+#define HTTP_ROUTE_NONE 0   // Peticion sin parsear
+#define HTTP_ROUTE_STATIC 1 // Fichero
+#define HTTP_ROUTE_SCRIPT 2 // Script sin ruta configurada
+#define HTTP_ROUTE_FIRST 3  // Script de la ruta configurada 0
+
+// Identificadores de las metricas del modulo. La latencia de una peticion
+// va a la serie durations[metodo * num_routes + route]. Las series por ruta
+// son las de la configuracion de http_init: las rutas que aparecen al
+// recargar cuentan en la serie "script".
+typedef struct http_metrics {
+    int responses[MAX_HTTP_ERRORS + 1]; // Respuestas por error_t
+    int bytes;                          // Bytes de las respuestas
+    int overload;                       // Conexiones rechazadas con 503
+    int* durations;                     // Latencia por metodo y ruta
+    size_t num_routes;                  // Rutas por metodo
+    char** prefixes;                    // Prefijo de cada serie de ruta
+} http_metrics_t;
+
+static http_metrics_t metric_ids = { .bytes = -1, .overload = -1 };
+
 // Cadenas generadas para enviar la respuesta si se produce un error
 char* error_response[MAX_HTTP_ERRORS] = {
     "HTTP/1.1 400 Bad Request\r\nDate: %s\r\nConnection: close\r\nServer: "
@@ -83,20 +230,36 @@ char* error_response[MAX_HTTP_ERRORS] = {
     "HTTP/1.1 500 Internal Server Error\r\nDate: %s\r\nConnection: "
     "close\r\nServer: %s\r\nContent-Length: "
     "0\r\nContent-Type:text/html\r\n\r\n",
+    "HTTP/1.1 503 Service Unavailable\r\nDate: %s\r\nConnection: "
+    "close\r\nServer: %s\r\nRetry-After: 1\r\nContent-Length: "
+    "0\r\nContent-Type:text/html\r\n\r\n",
+    "HTTP/1.1 504 Gateway Timeout\r\nDate: %s\r\nConnection: "
+    "close\r\nServer: %s\r\nContent-Length: "
+    "0\r\nContent-Type:text/html\r\n\r\n",
+    "HTTP/1.1 408 Request Timeout\r\nDate: %s\r\nConnection: "
+    "close\r\nServer: %s\r\nContent-Length: "
+    "0\r\nContent-Type:text/html\r\n\r\n",
 };
 
 // Funciones privadas
 
 /******************************************************************************
- * FUNCION: static int http_parse_request(int socket, request_t* request)
+ * FUNCION: static int http_parse_request(int socket,
+ *                                        request_t* request,
+ *                                        bool keepalive)
  * ARGS_IN: int socket - socket donde se van a recibir las peticiones.
  *          request_t* request - estructura donde se va a almacenar la request
  *                               recibida.
+ *          bool keepalive - la conexion ya ha atendido alguna peticion.
  * DESCRIPCION: almacena lapeticion leida en la estructura recibida como
- *              argumento.
- * ARGS_OUT: int - codigo de la estructura error.
+ *              argumento. La cabecera tiene que llegar en header_timeout y
+ *              el cuerpo (segun Content-Length) en body_timeout. En una
+ *              conexion keep-alive se esperan keepalive_timeout segundos al
+ *              primer byte y el limite de la cabecera cuenta desde ahi.
+ * ARGS_OUT: int - codigo de la estructura error o -1 si el cliente cierra la
+ *                 conexion o no envia nada.
  *****************************************************************************/
-static int http_parse_request(int socket, request_t* request);
+static int http_parse_request(int socket, request_t* request, bool keepalive);
 
 /*****************************************************************************
  * FUNCION: static void http_free_request(request_t* request)
@@ -106,11 +269,56 @@ static int http_parse_request(int socket, request_t* request);
 static void http_free_request(request_t* request);
 
 /******************************************************************************
- * FUNCION: http_get(request_t request,
+ * FUNCION: static bool http_is_script(request_t* request)
+ * ARGS_IN: request_t* request - peticion a clasificar.
+ * DESCRIPCION: indica si la peticion ejecuta un script (GET con argumentos o
+ *              POST) en lugar de servir un fichero estatico.
+ * ARGS_OUT: bool - true si la peticion ejecuta un script.
+ *****************************************************************************/
+static bool http_is_script(request_t* request);
+
+/******************************************************************************
+ * FUNCION: static int http_dispatch(request_t* request,
+ *                                  int socket,
+ *                                  char* server_root,
+ *                                  char* server_signature)
+ * ARGS_IN: request_t* request - peticion a procesar.
+ *          int socket - socket donde esta establecida la conexion.
+ *          char* server_root - ruta donde estan los recursos del servidor.
+ *          char* server_signature - nombre del servidor.
+ * DESCRIPCION: procesa una peticion segun su metodo y envia la respuesta o
+ *              el error correspondiente.
+ * ARGS_OUT: int - 0 si la conexion sigue abierta, 1 si se debe cerrar.
+ *****************************************************************************/
+static int http_dispatch(request_t* request,
+                         int socket,
+                         char* server_root,
+                         char* server_signature);
+
+/******************************************************************************
+ * FUNCION: static bool http_conn_idle(int socket)
+ * ARGS_IN: int socket - socket de la conexion.
+ * DESCRIPCION: marca que la conexion espera la siguiente peticion, para que
+ *              http_drain pueda cerrarla.
+ * ARGS_OUT: bool - false si se esta drenando y la conexion se debe cerrar.
+ *****************************************************************************/
+static bool http_conn_idle(int socket);
+
+/******************************************************************************
+ * FUNCION: static void http_conn_busy(int socket)
+ * ARGS_IN: int socket - socket de la conexion.
+ * DESCRIPCION: marca que la conexion ha dejado de esperar. Si http_drain ya
+ *              la ha cerrado para lectura se queda asi: se atiende lo que
+ *              haya llegado.
+ *****************************************************************************/
+static void http_conn_busy(int socket);
+
+/******************************************************************************
+ * FUNCION: http_get(request_t* request,
  *                  int socket,
  *                  char* server_root,
  *                  char* server_signature)
- * ARGS_IN: request_t request - peticion a procesar.
+ * ARGS_IN: request_t* request - peticion a procesar. Se anota el envio.
  *          int socket - socket donde esta establecida la conexion.
  *          char* server_root - ruta donde estan los recursos del servidor.
  *          char* server_signature - nombre del servidor.
@@ -118,17 +326,17 @@ static void http_free_request(request_t* request);
  *              recibidas por el servidor.
  * ARGS_OUT: int - codigo de la estuctura error.
  *****************************************************************************/
-static int http_get(request_t request,
+static int http_get(request_t* request,
                     int socket,
                     char* server_root,
                     char* server_signature);
 
 /******************************************************************************
- * FUNCION: http_post(request_t request,
+ * FUNCION: http_post(request_t* request,
  *                   int socket,
  *                   char* server_root,
  *                   char* server_signature)
- * ARGS_IN: request_t request - peticion a procesar.
+ * ARGS_IN: request_t* request - peticion a procesar. Se anota el envio.
  *          int socket - socket donde esta establecida la conexion.
  *          char* server_root - ruta donde estan los recursos del servidor.
  *          char* server_signature - nombre del servidor.
@@ -136,34 +344,132 @@ static int http_get(request_t request,
  *              recibidas por el servidor.
  * ARGS_OUT: int - codigo de la estuctura error.
  *****************************************************************************/
-static int http_post(request_t request,
+static int http_post(request_t* request,
                      int socket,
                      char* server_root,
                      char* server_signature);
 
 /******************************************************************************
- * FUNCION: static int http_options(request_t request,
+ * FUNCION: static int http_options(request_t* request,
  *                                 int socket,
  *                                 char* server_signature)
- * ARGS_IN: request_t request - peticion a procesar.
+ * ARGS_IN: request_t* request - peticion a procesar. Se anota el envio.
  *          int socket - socket donde esta establecida la conexion.
  *          char* server_signature - nombre del servidor.
  * DESCRIPCION: procesa y genera la respuesta a las peticiones de metodo
  *              OPTIONS recibidas por el servidor.
  * ARGS_OUT: int - codigo de la estuctura error.
  *****************************************************************************/
-static int http_options(request_t request, int socket, char* server_signature);
+static int http_options(request_t* request,
+                        int socket,
+                        char* server_signature);
 
 /******************************************************************************
- * FUNCION: static void http_error(int socket,
+ * FUNCION: static void http_error(request_t* request,
+ *                                int socket,
  *                                char* server_signature,
  *                                error_t error)
- * ARGS_IN: int socket - socket donde esta establecida la conexion.
+ * ARGS_IN: request_t* request - peticion a la que se responde.
+ *          int socket - socket donde esta establecida la conexion.
  *          char* server_signature - nombre del servidor.
  *          error_t error - tipo de error obtenido.
  * DESCRIPCION: envia el error obtenido como respuesta a la peticion recibida.
  *****************************************************************************/
-static void http_error(int socket, char* server_signature, error_t error);
+static void http_error(request_t* request,
+                       int socket,
+                       char* server_signature,
+                       error_t error);
+
+/******************************************************************************
+ * FUNCION: static void http_access(request_t* request)
+ * ARGS_IN: request_t* request - peticion atendida.
+ * DESCRIPCION: escribe el registro de la peticion en el log de accesos y
+ *              actualiza las metricas de respuestas y latencia.
+ *****************************************************************************/
+static void http_access(request_t* request);
+
+/******************************************************************************
+ * FUNCION: static void http_trace(request_t* request, uint64_t now)
+ * ARGS_IN: request_t* request - peticion trazada.
+ *          uint64_t now - fin de la peticion (ns).
+ * DESCRIPCION: escribe en la traza un span por cada fase de la peticion.
+ *****************************************************************************/
+static void http_trace(request_t* request, uint64_t now);
+
+/******************************************************************************
+ * FUNCION: static int http_metrics_init(const http_config_t* conf)
+ * ARGS_IN: const http_config_t* conf - configuracion con las rutas.
+ * DESCRIPCION: registra las metricas del modulo: respuestas por error_t,
+ *              bytes enviados y latencia por metodo y ruta.
+ * ARGS_OUT: int - 0 o -1 si no hay memoria.
+ *****************************************************************************/
+static int http_metrics_init(const http_config_t* conf);
+
+/******************************************************************************
+ * FUNCION: static http_snapshot_t* http_snapshot_create(
+ *                                    const http_config_t* conf)
+ * ARGS_IN: const http_config_t* conf - configuracion que se copia.
+ * DESCRIPCION: crea una configuracion publicable con una referencia: copia
+ *              las rutas, les asigna su serie de latencia y genera la
+ *              respuesta de sobrecarga.
+ * ARGS_OUT: http_snapshot_t* - configuracion creada o NULL si no hay memoria
+ *                              o la firma no cabe en la respuesta 503.
+ *****************************************************************************/
+static http_snapshot_t* http_snapshot_create(const http_config_t* conf);
+
+/******************************************************************************
+ * FUNCION: static const http_config_t* http_config_acquire()
+ * DESCRIPCION: toma una referencia a la configuracion publicada.
+ * ARGS_OUT: const http_config_t* - configuracion, valida hasta que se
+ *                                  suelte con http_config_release.
+ *****************************************************************************/
+static const http_config_t* http_config_acquire();
+
+/******************************************************************************
+ * FUNCION: static void http_config_release(const http_config_t* conf)
+ * ARGS_IN: const http_config_t* conf - configuracion de http_config_acquire.
+ * DESCRIPCION: suelta la referencia y libera la configuracion si era la
+ *              ultima.
+ *****************************************************************************/
+static void http_config_release(const http_config_t* conf);
+
+/******************************************************************************
+ * FUNCION: static const http_config_t* http_config_refresh(
+ *            const http_config_t* conf)
+ * ARGS_IN: const http_config_t* conf - configuracion de http_config_acquire.
+ * DESCRIPCION: cambia la referencia por una a la configuracion publicada si
+ *              se ha recargado desde que se tomo.
+ * ARGS_OUT: const http_config_t* - configuracion publicada, que se suelta
+ *                                  con http_config_release.
+ *****************************************************************************/
+static const http_config_t* http_config_refresh(const http_config_t* conf);
+
+/******************************************************************************
+ * FUNCION: static int http_route_match(const http_config_t* conf,
+ *                                      const char* path)
+ * ARGS_IN: const http_config_t* conf - configuracion con las rutas.
+ *          const char* path - path de la peticion sin argumentos.
+ * DESCRIPCION: busca la ruta configurada con el prefijo mas largo del path.
+ * ARGS_OUT: int - indice de la ruta o -1 si no hay ninguna.
+ *****************************************************************************/
+static int http_route_match(const http_config_t* conf, const char* path);
+
+/******************************************************************************
+ * FUNCION: static int http_route(request_t* request)
+ * ARGS_IN: request_t* request - peticion parseada.
+ * DESCRIPCION: clasifica la peticion para su serie de latencia. Se llama
+ *              antes de procesarla porque http_get corta el path.
+ * ARGS_OUT: int - HTTP_ROUTE_STATIC, HTTP_ROUTE_SCRIPT o la serie de la ruta
+ *                 (HTTP_ROUTE_FIRST + indice de la ruta en http_init).
+ *****************************************************************************/
+static int http_route(request_t* request);
+
+/******************************************************************************
+ * FUNCION: static uint64_t http_now()
+ * DESCRIPCION: obtiene el instante actual en el reloj monotono.
+ * ARGS_OUT: uint64_t - instante actual (ns).
+ *****************************************************************************/
+static uint64_t http_now();
 
 // Funciones Auxiliares
 
@@ -183,97 +489,587 @@ static char* http_get_content_type(const char* file_extension);
  *****************************************************************************/
 static void http_get_date(char* date);
 
-int http(int socket, char* server_root, char* server_signature)
+/******************************************************************************
+ * FUNCION: static int http_load_file(void* arg, char** data, size_t* len)
+ * ARGS_IN: void* arg - ruta del fichero que se lee.
+ *          char** data - buffer reservado con el contenido del fichero.
+ *          size_t* len - longitud del contenido leido.
+ * DESCRIPCION: lee el contenido completo de un fichero estatico.
+ * ARGS_OUT: int - codigo de la estructura error.
+ *****************************************************************************/
+static int http_load_file(void* arg, char** data, size_t* len);
+
+/******************************************************************************
+ * FUNCION: static int http_load_script(void* arg, char** data, size_t* len)
+ * ARGS_IN: void* arg - comando que ejecuta el script.
+ *          char** data - buffer reservado con la salida del script.
+ *          size_t* len - longitud de la salida leida.
+ * DESCRIPCION: ejecuta un script y lee su salida estandar.
+ * ARGS_OUT: int - codigo de la estructura error.
+ *****************************************************************************/
+static int http_load_script(void* arg, char** data, size_t* len);
+
+/******************************************************************************
+ * FUNCION: static int http_cgi_init(cgi_t* cgi,
+ *                                   const http_config_t* conf,
+ *                                   char* path,
+ *                                   char* route,
+ *                                   char* args)
+ * ARGS_IN: cgi_t* cgi - ejecucion que se inicializa.
+ *          const http_config_t* conf - configuracion de la peticion.
+ *          char* path - ruta al script en el sistema de ficheros.
+ *          char* route - path de la peticion (selecciona el tiempo maximo).
+ *          char* args - argumento del script (puede ser NULL).
+ * DESCRIPCION: obtiene el interprete, el tiempo maximo de ejecucion y los
+ *              limites de recursos de un script.
+ * ARGS_OUT: int - OK o BAD_REQUEST si la extension no es un script.
+ *****************************************************************************/
+static int http_cgi_init(cgi_t* cgi,
+                         const http_config_t* conf,
+                         char* path,
+                         char* route,
+                         char* args);
+
+/******************************************************************************
+ * FUNCION: static void http_cgi_exec(cgi_t* cgi, int out)
+ * ARGS_IN: cgi_t* cgi - ejecucion del script.
+ *          int out - extremo de escritura del pipe de salida.
+ * DESCRIPCION: prepara el proceso hijo (grupo de procesos propio, limites de
+ *              CPU y memoria, stdout/stderr al pipe) y ejecuta el script.
+ *              No retorna.
+ *****************************************************************************/
+static void http_cgi_exec(cgi_t* cgi, int out);
+
+/******************************************************************************
+ * FUNCION: static bool http_cgi_wait(pid_t pid,
+ *                                   struct timespec* deadline,
+ *                                   int* wstatus)
+ * ARGS_IN: pid_t pid - proceso del script.
+ *          struct timespec* deadline - instante limite (NULL: sin limite).
+ *          int* wstatus - estado de terminacion del script.
+ * DESCRIPCION: espera a que el script termine sin pasar del instante limite
+ *              ni de un drenado a la fuerza (ver http_drain). Espera en un
+ *              pidfd; si el sistema no lo tiene, espera sin limite como
+ *              cuando no hay plazo.
+ * ARGS_OUT: bool - true si el script ha terminado, false si ha expirado o
+ *                  hay que cortarlo.
+ *****************************************************************************/
+static bool http_cgi_wait(pid_t pid, struct timespec* deadline, int* wstatus);
+
+/******************************************************************************
+ * FUNCION: static int http_ms_left(struct timespec* deadline)
+ * ARGS_IN: struct timespec* deadline - instante limite (NULL: sin limite).
+ * DESCRIPCION: calcula los milisegundos que quedan hasta el instante limite.
+ * ARGS_OUT: int - milisegundos restantes (0 si ya ha pasado, -1 sin limite).
+ *****************************************************************************/
+static int http_ms_left(struct timespec* deadline);
+
+int http_init(const http_config_t* conf)
+{
+    http_config_t empty = { 0 };
+    struct rlimit rl;
+
+    if (!conf) {
+        conf = &empty;
+    }
+
+    flights = sflight_create();
+    if (!flights) {
+        return -1;
+    }
+
+    // Las series por ruta se registran antes para asignarselas a las rutas
+    if (http_metrics_init(conf)) {
+        return -1;
+    }
+
+    // Las conexiones se indexan por socket, hasta el limite de descriptores
+    max_conns = MAX_HTTP_CONNS;
+    if (!getrlimit(RLIMIT_NOFILE, &rl) && rl.rlim_cur < max_conns) {
+        max_conns = rl.rlim_cur;
+    }
+    conns = (atomic_uchar*)calloc(max_conns, sizeof(atomic_uchar));
+    drain_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (!conns || drain_fd == -1) {
+        return -1;
+    }
+
+    current = http_snapshot_create(conf);
+
+    return current ? 0 : -1;
+}
+
+int http_reload(const http_config_t* conf)
+{
+    http_snapshot_t* snap = NULL;
+    http_snapshot_t* old = NULL;
+
+    if (!conf || !current) {
+        return -1;
+    }
+    snap = http_snapshot_create(conf);
+    if (!snap) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&current_mutex);
+    old = current;
+    current = snap;
+    pthread_mutex_unlock(&current_mutex);
+
+    // Las peticiones en curso la siguen usando hasta terminar
+    http_config_release(&old->conf);
+
+    return 0;
+}
+
+void http_destroy()
+{
+    size_t i;
+
+    sflight_destroy(flights);
+    flights = NULL;
+
+    if (current) {
+        http_config_release(&current->conf);
+        current = NULL;
+    }
+
+    free(metric_ids.durations);
+    metric_ids.durations = NULL;
+    for (i = 0; metric_ids.prefixes && metric_ids.prefixes[i]; i++) {
+        free(metric_ids.prefixes[i]);
+    }
+    free(metric_ids.prefixes);
+    metric_ids.prefixes = NULL;
+
+    free(conns);
+    conns = NULL;
+    max_conns = 0;
+    if (drain_fd != -1) {
+        close(drain_fd);
+        drain_fd = -1;
+    }
+}
+
+void http_conn_open(int socket)
+{
+    if (socket >= 0 && (size_t)socket < max_conns) {
+        atomic_store_explicit(
+          &conns[socket], HTTP_CONN_BUSY, memory_order_relaxed);
+    }
+}
+
+void http_conn_close(int socket)
+{
+    if (socket >= 0 && (size_t)socket < max_conns) {
+        atomic_store_explicit(
+          &conns[socket], HTTP_CONN_NONE, memory_order_relaxed);
+    }
+}
+
+void http_drain(bool force)
+{
+    unsigned char idle;
+    uint64_t value = 1;
+    size_t i;
+
+    atomic_store(&draining, true);
+    // El eventfd queda legible: los scripts en curso y los que empiecen
+    // terminan como si venciese su plazo
+    if (force && write(drain_fd, &value, sizeof(value)) == -1) {
+        // Ya estaba activado
+    }
+    for (i = 0; i < max_conns; i++) {
+        if (force) {
+            // Despierta a quien espere en el socket, leyendo o escribiendo
+            if (atomic_load_explicit(&conns[i], memory_order_relaxed) !=
+                HTTP_CONN_NONE) {
+                shutdown((int)i, SHUT_RDWR);
+            }
+            continue;
+        }
+        // Solo las que esperan sin haber recibido nada de otra peticion
+        idle = HTTP_CONN_IDLE;
+        if (atomic_compare_exchange_strong(
+              &conns[i], &idle, HTTP_CONN_CLOSING)) {
+            shutdown((int)i, SHUT_RD);
+        }
+    }
+}
+
+static http_snapshot_t* http_snapshot_create(const http_config_t* conf)
+{
+    http_snapshot_t* snap = NULL;
+    size_t i, j;
+    int len;
+
+    snap = (http_snapshot_t*)calloc(1, sizeof(http_snapshot_t));
+    if (!snap) {
+        return NULL;
+    }
+    snap->conf = *conf;
+    snap->conf.routes = NULL;
+    snap->conf.num_routes = 0;
+    snap->conf.server_root = NULL;
+    snap->conf.server_signature = NULL;
+    atomic_init(&snap->refs, 1);
+
+    len = snprintf(snap->overload,
+                   sizeof(snap->overload),
+                   overload_format,
+                   conf->server_signature ? conf->server_signature : "");
+    if (len < 0 || (size_t)len >= sizeof(snap->overload)) {
+        free(snap);
+        return NULL;
+    }
+    snap->overload_len = (size_t)len;
+
+    snap->conf.server_root = strdup(conf->server_root ? conf->server_root : "");
+    snap->conf.server_signature =
+      strdup(conf->server_signature ? conf->server_signature : "");
+    if (!snap->conf.server_root || !snap->conf.server_signature) {
+        http_config_release(&snap->conf);
+        return NULL;
+    }
+
+    if (conf->num_routes) {
+        snap->conf.routes =
+          (http_route_t*)calloc(conf->num_routes, sizeof(http_route_t));
+        snap->series = (int*)calloc(conf->num_routes, sizeof(int));
+        if (!snap->conf.routes || !snap->series) {
+            http_config_release(&snap->conf);
+            return NULL;
+        }
+    }
+    for (i = 0; i < conf->num_routes; i++) {
+        snap->conf.routes[i].prefix = strdup(conf->routes[i].prefix);
+        if (!snap->conf.routes[i].prefix) {
+            http_config_release(&snap->conf);
+            return NULL;
+        }
+        snap->conf.routes[i].timeout = conf->routes[i].timeout;
+        snap->conf.num_routes++;
+
+        snap->series[i] = HTTP_ROUTE_SCRIPT;
+        for (j = HTTP_ROUTE_FIRST; j < metric_ids.num_routes; j++) {
+            if (!strcmp(metric_ids.prefixes[j - HTTP_ROUTE_FIRST],
+                        conf->routes[i].prefix)) {
+                snap->series[i] = (int)j;
+                break;
+            }
+        }
+    }
+
+    return snap;
+}
+
+static const http_config_t* http_config_acquire()
+{
+    http_snapshot_t* snap = NULL;
+
+    pthread_mutex_lock(&current_mutex);
+    snap = current;
+    atomic_fetch_add_explicit(&snap->refs, 1, memory_order_relaxed);
+    pthread_mutex_unlock(&current_mutex);
+
+    return &snap->conf;
+}
+
+static const http_config_t* http_config_refresh(const http_config_t* conf)
+{
+    http_snapshot_t* snap = NULL;
+
+    pthread_mutex_lock(&current_mutex);
+    snap = current;
+    if (&snap->conf == conf) {
+        pthread_mutex_unlock(&current_mutex);
+        return conf;
+    }
+    atomic_fetch_add_explicit(&snap->refs, 1, memory_order_relaxed);
+    pthread_mutex_unlock(&current_mutex);
+    http_config_release(conf);
+
+    return &snap->conf;
+}
+
+static void http_config_release(const http_config_t* conf)
+{
+    // conf es el primer campo de la configuracion publicada
+    http_snapshot_t* snap = (http_snapshot_t*)conf;
+    size_t i;
+
+    if (atomic_fetch_sub_explicit(&snap->refs, 1, memory_order_acq_rel) != 1) {
+        return;
+    }
+
+    for (i = 0; i < snap->conf.num_routes; i++) {
+        free(snap->conf.routes[i].prefix);
+    }
+    free(snap->conf.routes);
+    free(snap->conf.server_root);
+    free(snap->conf.server_signature);
+    free(snap->series);
+    free(snap);
+}
+
+int http(int socket,
+         const http_conn_t* conn,
+         bool keepalive,
+         http_script_t** script)
 {
     int status;
     request_t request;
+    uint64_t queued = conn ? conn->queued : 0;
+    uint64_t start = queued ? http_now() : 0;
 
     while (1) {
         memset(&request, 0, sizeof(request));
-        status = http_parse_request(socket, &request);
+        // La espera y la recepcion usan los limites publicados al empezar a
+        // esperar la peticion
+        request.conf = http_config_acquire();
+        if (conn) {
+            request.addr = conn->peer.sin_addr.s_addr;
+            request.port = conn->peer.sin_port;
+            request.conn = conn->id;
+        }
+        request.flags = keepalive ? ACCLOG_KEEPALIVE : 0;
+        // Solo la primera peticion ha esperado en la cola de conexiones
+        request.t_queued = queued;
+        request.t_start = start;
+        queued = 0;
+        status = http_parse_request(socket, &request, keepalive);
         if (status == -1) {
             // Conexion cerrada por el cliente
+            http_free_request(&request);
+            http_config_release(request.conf);
             break;
-        } else if (status == BAD_REQUEST) {
-            // Bad request
-            http_error(socket, server_signature, BAD_REQUEST);
+        } else if (status == BAD_REQUEST || status == REQUEST_TIMEOUT) {
+            // Bad request o peticion que no llega a tiempo
+            http_error(
+              &request, socket, request.conf->server_signature, status);
+            http_access(&request);
+            http_free_request(&request);
+            http_config_release(request.conf);
             break;
         }
-
-        if (!strcmp("GET", request.header.method)) {
-            status = http_get(request, socket, server_root, server_signature);
-            if (status == BAD_REQUEST) {
-                http_error(socket, server_signature, BAD_REQUEST);
-                break;
-            } else if (status == NOT_FOUND) {
-                http_error(socket, server_signature, NOT_FOUND);
-                break;
-            } else if (status == INTERNAL_SERVER_ERROR) {
-                http_error(socket, server_signature, INTERNAL_SERVER_ERROR);
-                break;
-            }
-        } else if (!strcmp("POST", request.header.method)) {
-            status = http_post(request, socket, server_root, server_signature);
-            if (status == BAD_REQUEST) {
-                http_error(socket, server_signature, BAD_REQUEST);
-                break;
-            } else if (status == NOT_FOUND) {
-                http_error(socket, server_signature, NOT_FOUND);
-                break;
-            } else if (status == INTERNAL_SERVER_ERROR) {
-                http_error(socket, server_signature, INTERNAL_SERVER_ERROR);
-                break;
-            } else if (status == UNSUPPORTED_MEDIA_TYPE) {
-                http_error(socket, server_signature, UNSUPPORTED_MEDIA_TYPE);
-                break;
-            }
-        } else if (!strcmp("OPTIONS", request.header.method)) {
-            status = http_options(request, socket, server_signature);
-            if (status == INTERNAL_SERVER_ERROR) {
-                http_error(socket, server_signature, INTERNAL_SERVER_ERROR);
-                break;
+        keepalive = true;
+        // Y se atiende con la configuracion publicada al llegar, asi que una
+        // conexion keep-alive pasa a la nueva en cuanto se recarga
+        request.conf = http_config_refresh(request.conf);
+        request.route = http_route(&request);
+
+        // Las peticiones de scripts se difieren al pool de scripts para no
+        // ocupar el hilo de la conexion mientras se ejecuta el interprete
+        if (script && http_is_script(&request)) {
+            *script = (http_script_t*)malloc(sizeof(http_script_t));
+            if (*script) {
+                request.flags |= ACCLOG_DEFERRED;
+                (*script)->request = request;
+                (*script)->socket = socket;
+                // La referencia a la configuracion pasa a la peticion
+                return HTTP_DEFERRED;
             }
-        } else {
-            http_error(socket, server_signature, NOT_IMPLEMENTED);
-            break;
         }
 
-        if (status == INTERNAL_SERVER_ERROR) {
-            return -1;
+        status = http_dispatch(&request,
+                               socket,
+                               request.conf->server_root,
+                               request.conf->server_signature);
+        http_access(&request);
+        http_free_request(&request);
+        http_config_release(request.conf);
+        if (status) {
+            break;
         }
+    }
 
-        http_free_request(&request);
+    return 0;
+}
+
+int http_script_run(http_script_t* script)
+{
+    int status;
+
+    if (!script) {
+        return 1;
+    }
+
+    if (script->request.trace_id) {
+        script->request.t_run = http_now();
     }
+    status = http_dispatch(&script->request,
+                           script->socket,
+                           script->request.conf->server_root,
+                           script->request.conf->server_signature);
+    http_access(&script->request);
+    http_free_request(&script->request);
+    http_config_release(script->request.conf);
+    free(script);
+
+    return status;
+}
+
+void http_script_reject(http_script_t* script)
+{
+    if (!script) {
+        return;
+    }
+
+    http_error(&script->request,
+               script->socket,
+               script->request.conf->server_signature,
+               SERVICE_UNAVAILABLE);
+    http_access(&script->request);
+    http_free_request(&script->request);
+    http_config_release(script->request.conf);
+    free(script);
+}
 
-    http_free_request(&request);
+void http_overload(int socket)
+{
+    char buf[MAX_HTTP_REQUESTS_SIZE];
+    const http_config_t* conf = http_config_acquire();
+    const http_snapshot_t* snap = (const http_snapshot_t*)conf;
+
+    metrics_add(metric_ids.overload, 1);
+    send(socket,
+         snap->overload,
+         snap->overload_len,
+         MSG_DONTWAIT | MSG_NOSIGNAL);
+    http_config_release(conf);
+    // Descartamos lo que ya haya llegado de la peticion para que el close no
+    // envie un RST que haga perder la respuesta al cliente
+    shutdown(socket, SHUT_WR);
+    while (recv(socket, buf, sizeof(buf), MSG_DONTWAIT) > 0)
+        ;
+}
+
+static bool http_is_script(request_t* request)
+{
+    if (!strcmp("POST", request->header.method)) {
+        return true;
+    }
+
+    return !strcmp("GET", request->header.method) &&
+           strchr(request->header.path, '?');
+}
+
+static int http_dispatch(request_t* request,
+                         int socket,
+                         char* server_root,
+                         char* server_signature)
+{
+    int status;
+
+    if (!strcmp("GET", request->header.method)) {
+        status = http_get(request, socket, server_root, server_signature);
+    } else if (!strcmp("POST", request->header.method)) {
+        status = http_post(request, socket, server_root, server_signature);
+    } else if (!strcmp("OPTIONS", request->header.method)) {
+        status = http_options(request, socket, server_signature);
+    } else {
+        status = NOT_IMPLEMENTED;
+    }
+
+    if (status != OK) {
+        // Si la respuesta ya ha empezado a enviarse el cliente no la ha
+        // leido entera y un error detras solo la corromperia
+        if (!request->t_send) {
+            http_error(request, socket, server_signature, status);
+        }
+        return 1;
+    }
 
     return 0;
 }
 
-static int http_parse_request(int socket, request_t* request)
+static bool http_conn_idle(int socket)
+{
+    unsigned char busy = HTTP_CONN_BUSY;
+
+    if (socket >= 0 && (size_t)socket < max_conns) {
+        atomic_compare_exchange_strong(&conns[socket], &busy, HTTP_CONN_IDLE);
+    }
+
+    return !atomic_load(&draining);
+}
+
+static void http_conn_busy(int socket)
+{
+    unsigned char idle = HTTP_CONN_IDLE;
+
+    if (socket >= 0 && (size_t)socket < max_conns) {
+        atomic_compare_exchange_strong(&conns[socket], &idle, HTTP_CONN_BUSY);
+    }
+}
+
+static int http_parse_request(int socket, request_t* request, bool keepalive)
 {
     size_t i;
     char buf[MAX_HTTP_REQUESTS_SIZE];
     size_t offset = 0, prev_offset = 0, num_headers, method_len, path_len;
+    size_t body_end = 0;
     ssize_t recv_ret;
     struct phr_header headers[MAX_HTTP_NUM_HEADERS];
     int pret, pret_total = 0, minor_version;
     const char* method = NULL;
     const char* path = NULL;
+    uint64_t deadline, parse_start = 0;
+    struct timespec now;
 
     memset(buf, 0, sizeof(buf));
 
+    // Una conexion que espera otra peticion se cierra si se esta drenando
+    if (keepalive && !http_conn_idle(socket)) {
+        return -1;
+    }
+
+    request->t_wait = http_now();
+    deadline = socket_deadline(
+      (keepalive ? request->conf->keepalive_timeout
+                 : request->conf->header_timeout) *
+      1000);
+
     while (1) {
-        recv_ret = recv(socket, buf + offset, sizeof(buf) - offset, 0);
+        // El ultimo byte queda a '\0' para tratar el cuerpo como cadena
+        recv_ret =
+          socket_recv(socket, buf + offset, sizeof(buf) - 1 - offset, deadline);
+        if (keepalive && !offset) {
+            http_conn_busy(socket);
+        }
         if (recv_ret <= 0) {
-            // Cierre de conexion del cliente, error or timeout
+            // Cierre de conexion del cliente, error or timeout. Si la
+            // cabecera ha llegado a medias se avisa al cliente.
+            if (recv_ret == -1 && errno == ETIMEDOUT && offset) {
+                return REQUEST_TIMEOUT;
+            }
             return -1;
         }
 
         prev_offset = offset;
         offset += recv_ret;
 
+        if (!prev_offset) {
+            clock_gettime(CLOCK_REALTIME, &now);
+            request->time_us =
+              (uint64_t)now.tv_sec * 1000000 + (uint64_t)now.tv_nsec / 1000;
+            request->t_first = http_now();
+            // Se decide con el primer byte para que las esperas que acaban
+            // en el cierre de la conexion no cuenten en el muestreo
+            request->trace_id = trace_begin();
+        }
+
+        // Con el primer byte de una peticion keep-alive empieza a contar el
+        // limite de la cabecera
+        if (keepalive && !prev_offset) {
+            deadline = socket_deadline(request->conf->header_timeout * 1000);
+        }
+
         num_headers = sizeof(headers) / sizeof(headers[0]);
+        if (request->trace_id) {
+            parse_start = http_now();
+        }
         pret = phr_parse_request(buf,
                                  offset,
                                  &method,
@@ -284,20 +1080,56 @@ static int http_parse_request(int socket, request_t* request)
                                  headers,
                                  &num_headers,
                                  prev_offset);
-        // Guardamos la longitud total de la cabecera
-        pret_total += pret;
+        if (request->trace_id) {
+            request->t_parsed = http_now();
+            request->parse_ns += request->t_parsed - parse_start;
+        }
         if (pret > 0) {
-            // Cabecera correctamente parseada
+            // Cabecera correctamente parseada, guardamos su longitud
+            pret_total = pret;
             break;
         } else if (pret == -1) {
             // Error parseando la request
             return BAD_REQUEST;
-        } else if (offset == sizeof(buf)) {
+        } else if (offset == sizeof(buf) - 1) {
             // Request demasiado larga
             return BAD_REQUEST;
         }
     }
 
+    // Leemos el resto del cuerpo que anuncia Content-Length, hasta donde cabe
+    // en el buffer
+    for (i = 0; i < num_headers; i++) {
+        if (headers[i].name_len == strlen("Content-Length") &&
+            !strncasecmp(headers[i].name, "Content-Length", headers[i].name_len)) {
+            body_end = strtoul(headers[i].value, NULL, 10);
+            body_end = body_end < sizeof(buf) - 1 - pret_total
+                         ? pret_total + body_end
+                         : sizeof(buf) - 1;
+        }
+    }
+    if (body_end) {
+        deadline = socket_deadline(request->conf->body_timeout * 1000);
+        while (offset < body_end) {
+            recv_ret =
+              socket_recv(socket, buf + offset, body_end - offset, deadline);
+            if (recv_ret <= 0) {
+                return recv_ret == -1 && errno == ETIMEDOUT ? REQUEST_TIMEOUT
+                                                            : -1;
+            }
+            offset += recv_ret;
+        }
+        buf[body_end] = '\0';
+    }
+    request->t_header = http_now();
+    if (capture_enabled()) {
+        capture_write(request->t_first,
+                      request->conn,
+                      request->flags & ACCLOG_KEEPALIVE ? 0 : CAPTURE_FIRST,
+                      buf,
+                      offset);
+    }
+
     // Almacenamos los datos de la request
     request->header.num_headers = num_headers;
     request->header.version = minor_version;
@@ -333,6 +1165,12 @@ static int http_parse_request(int socket, request_t* request)
           (char*)malloc((strlen(buf + pret_total) + 1) * sizeof(char));
         sprintf(request->body, "%s", buf + pret_total);
     }
+    PROBE5(request_parsed,
+           socket,
+           request->header.method,
+           request->header.path,
+           pret_total,
+           offset - pret_total);
 
     return OK;
 }
@@ -363,67 +1201,84 @@ static void http_free_request(request_t* request)
     }
 }
 
-static int http_get(request_t request,
+static int http_get(request_t* request,
                     int socket,
                     char* server_root,
                     char* server_signature)
 {
-    int response_body_len;
+    int status;
+    size_t response_body_len;
     struct stat attr;
     char last_modified[MAX_HTTP_DATE_LEN];
     char date[MAX_HTTP_DATE_LEN];
     char response_header[MAX_HTTP_HEADER];
     char path[MAX_HTTP_PATH];
-    char command[MAX_HTTP_COMMAND];
-    char* response_body;
+    char key[MAX_HTTP_FLIGHT_KEY];
+    cgi_t cgi;
+    sflight_t* group;
+    char* response_body = NULL;
     char* content_type = NULL;
     char* args = NULL;
-    FILE* file = NULL;
 
     // Parseamos los argumentos si existen
-    if (strstr(request.header.path, "?")) {
-        args = strrchr(request.header.path, '?');
+    if (strstr(request->header.path, "?")) {
+        args = strrchr(request->header.path, '?');
         *args = '\0';
         args++;
     }
 
     // Obtenemos el path del recurso
     strcpy(path, server_root);
-    strcat(path, request.header.path);
+    strcat(path, request->header.path);
 
+    // Las peticiones GET identicas y concurrentes comparten una unica
+    // ejecucion del script o lectura del fichero. Un bucle de eventos no
+    // puede bloquearse esperando a otro hilo: lee el fichero por su cuenta.
+    group = evloop_inside() ? NULL : flights;
     if (args) {
-        if (strstr(path, ".py")) {
-            sprintf(command, "python3 %s %s 2>&1", path, args);
-        } else if (strstr(path, ".php")) {
-            sprintf(command, "php %s %s 2>&1", path, args);
-        } else {
+        if (http_cgi_init(
+              &cgi, request->conf, path, request->header.path, args) != OK) {
             return BAD_REQUEST;
         }
-
-        file = popen(command, "r");
-        if (!file) {
-            return NOT_FOUND;
+        request->handler = "script";
+        if (request->trace_id) {
+            request->t_open = http_now();
         }
-        // Nota: Puesto que este "file" no es un stream normal, no podemos
-        // determinar el tamanio que tendrá, ya que en realidad se trata de
-        // de un pipe.
-        response_body_len = MAX_HTTP_CGI_RESPONSE;
+        snprintf(key, sizeof(key), "cgi %s %s %s", cgi.interpreter, path, args);
+        status = sflight_do(group,
+                            key,
+                            http_load_script,
+                            &cgi,
+                            &response_body,
+                            &response_body_len,
+                            NULL);
     } else {
-        file = fopen(path, "rb");
-        if (!file) {
-            return NOT_FOUND;
+        request->handler = "open";
+        if (request->trace_id) {
+            request->t_open = http_now();
         }
-        fseek(file, 0L, SEEK_END);
-        response_body_len = ftell(file);
-        fseek(file, 0L, SEEK_SET);
+        snprintf(key, sizeof(key), "file %s", path);
+        status = sflight_do(group,
+                            key,
+                            http_load_file,
+                            path,
+                            &response_body,
+                            &response_body_len,
+                            NULL);
+    }
+    if (status != OK) {
+        return status;
+    }
+    // Sin memoria para copiar el resultado de otro hilo
+    if (!response_body) {
+        return INTERNAL_SERVER_ERROR;
     }
-
-    response_body = (char*)malloc((response_body_len + 1) * sizeof(char));
-    memset(response_body, 0, response_body_len);
-    fread(response_body, 1, response_body_len, file);
 
     // Ultima vez modificado
     stat(path, &attr);
+    if (request->trace_id) {
+        request->t_opened = http_now();
+    }
     strftime(last_modified,
              MAX_HTTP_DATE_LEN,
              "%a, %d %b %Y %H:%M:%S %Z",
@@ -432,6 +1287,7 @@ static int http_get(request_t request,
     // Tipo de fichero
     content_type = http_get_content_type(path);
     if (!content_type) {
+        free(response_body);
         return UNSUPPORTED_MEDIA_TYPE;
     }
 
@@ -441,114 +1297,115 @@ static int http_get(request_t request,
     memset(response_header, 0, MAX_HTTP_HEADER);
     sprintf(response_header,
             get_response,
-            request.header.version,
+            request->header.version,
             date,
+            atomic_load_explicit(&draining, memory_order_relaxed)
+              ? http_close_header
+              : "",
             server_signature,
             last_modified,
-            response_body_len,
+            (int)response_body_len,
             content_type);
 
-    if (socket_send(
-          socket, response_header, response_body, response_body_len) == -1) {
+    request->t_send = http_now();
+    request->status = 200;
+    request->bytes = strlen(response_header) + response_body_len;
+    PROBE3(response_start, socket, request->header.path, request->bytes);
+    if (socket_send(socket,
+                    response_header,
+                    response_body,
+                    (int)response_body_len,
+                    request->conf->write_timeout * 1000) == -1) {
+        PROBE3(response_end, socket, -1, request->bytes);
+        free(response_body);
         return INTERNAL_SERVER_ERROR;
     }
-
-    if (args) {
-        pclose(file);
-    } else {
-        fclose(file);
-    }
+    PROBE3(response_end, socket, request->status, request->bytes);
 
     free(response_body);
 
-    return 0;
+    return OK;
 }
 
-static int http_options(request_t request, int socket, char* server_signature)
+static int http_options(request_t* request,
+                        int socket,
+                        char* server_signature)
 {
     char date[MAX_HTTP_DATE_LEN], response_header[MAX_HTTP_HEADER];
-    ssize_t bytes, offset = 0;
 
     http_get_date(date);
 
     sprintf(response_header,
             options_response,
-            request.header.version,
+            request->header.version,
             date,
             server_signature);
 
-    do {
-        bytes = send(socket,
-                     response_header + offset,
-                     strlen(response_header) - offset,
-                     0);
-        if (bytes == -1) {
-            return -4;
-        }
-        offset += bytes;
-    } while (offset < (ssize_t)strlen(response_header));
+    request->t_send = http_now();
+    request->status = 200;
+    request->bytes = strlen(response_header);
+    if (socket_write(socket,
+                     response_header,
+                     strlen(response_header),
+                     socket_deadline(request->conf->write_timeout * 1000))) {
+        return INTERNAL_SERVER_ERROR;
+    }
 
-    return 0;
+    return OK;
 }
 
-static int http_post(request_t request,
+static int http_post(request_t* request,
                      int socket,
                      char* server_root,
                      char* server_signature)
 {
-    int response_body_len;
+    int status;
+    size_t response_body_len;
     struct stat attr;
     char last_modified[MAX_HTTP_DATE_LEN];
     char date[MAX_HTTP_DATE_LEN];
     char response_header[MAX_HTTP_HEADER];
     char path[MAX_HTTP_PATH];
-    char command[MAX_HTTP_COMMAND];
-    char* response_body;
+    char* response_body = NULL;
     char* content_type = NULL;
     char* args = NULL;
-    FILE* file = NULL;
+    cgi_t cgi;
 
     // Eliminamos los argumentos del path si existen
-    if (strstr(request.header.path, "?")) {
-        args = strrchr(request.header.path, '?');
+    if (strstr(request->header.path, "?")) {
+        args = strrchr(request->header.path, '?');
         *args = '\0';
         args++;
     }
 
     // Obtenemos el path del recurso
     strcpy(path, server_root);
-    strcat(path, request.header.path);
-
-    if (request.body) {
-        if (strstr(path, ".py")) {
-            sprintf(command, "python3 %s %s 2>&1", path, request.body);
-        } else if (strstr(path, ".php")) {
-            sprintf(command, "php %s %s 2>&1", path, request.body);
-        } else {
-            return BAD_REQUEST;
-        }
-    } else {
-        if (strstr(path, ".py")) {
-            sprintf(command, "python3 %s 2>&1", path);
-        } else if (strstr(path, ".php")) {
-            sprintf(command, "php %s 2>&1", path);
-        } else {
-            return BAD_REQUEST;
-        }
+    strcat(path, request->header.path);
+
+    // El cuerpo de la peticion se pasa como argumento del script
+    if (http_cgi_init(&cgi,
+                      request->conf,
+                      path,
+                      request->header.path,
+                      request->body) != OK) {
+        return BAD_REQUEST;
     }
 
-    file = popen(command, "r");
-    if (!file) {
-        return NOT_FOUND;
+    // Las peticiones POST no son cacheables, cada una ejecuta su script
+    request->handler = "script";
+    if (request->trace_id) {
+        request->t_open = http_now();
+    }
+    status = http_load_script(&cgi, &response_body, &response_body_len);
+    if (status != OK) {
+        return status;
     }
-
-    response_body_len = MAX_HTTP_CGI_RESPONSE;
-    response_body = (char*)malloc((response_body_len + 1) * sizeof(char));
-    memset(response_body, 0, response_body_len);
-    fread(response_body, 1, response_body_len, file);
 
     // Ultima vez modificado
     stat(path, &attr);
+    if (request->trace_id) {
+        request->t_opened = http_now();
+    }
     strftime(last_modified,
              MAX_HTTP_DATE_LEN,
              "%a, %d %b %Y %H:%M:%S %Z",
@@ -557,6 +1414,7 @@ static int http_post(request_t request,
     // Tipo de fichero
     content_type = http_get_content_type(path);
     if (!content_type) {
+        free(response_body);
         return UNSUPPORTED_MEDIA_TYPE;
     }
 
@@ -566,37 +1424,45 @@ static int http_post(request_t request,
     memset(response_header, 0, MAX_HTTP_HEADER);
     sprintf(response_header,
             get_response,
-            request.header.version,
+            request->header.version,
             date,
+            atomic_load_explicit(&draining, memory_order_relaxed)
+              ? http_close_header
+              : "",
             server_signature,
             last_modified,
-            response_body_len,
+            (int)response_body_len,
             content_type);
 
-    if (socket_send(
-          socket, response_header, response_body, response_body_len) == -1) {
+    request->t_send = http_now();
+    request->status = 200;
+    request->bytes = strlen(response_header) + response_body_len;
+    PROBE3(response_start, socket, request->header.path, request->bytes);
+    if (socket_send(socket,
+                    response_header,
+                    response_body,
+                    (int)response_body_len,
+                    request->conf->write_timeout * 1000) == -1) {
+        PROBE3(response_end, socket, -1, request->bytes);
+        free(response_body);
         return INTERNAL_SERVER_ERROR;
     }
-
-    if (args) {
-        pclose(file);
-    } else {
-        fclose(file);
-    }
+    PROBE3(response_end, socket, request->status, request->bytes);
 
     free(response_body);
 
-    return 0;
+    return OK;
 }
 
 static char* http_get_content_type(const char* path)
 {
     const char* file_extension = NULL;
 
-    file_extension = strrchr(path, '.') + 1;
+    file_extension = strrchr(path, '.');
     if (!file_extension) {
         return NULL;
     }
+    file_extension++;
 
     if (!strcmp("txt", file_extension))
         return "text/plain";
@@ -627,10 +1493,501 @@ static void http_get_date(char* date)
     strftime(date, MAX_HTTP_DATE_LEN, "%a, %d %b %Y %H:%M:%S %Z", tm);
 }
 
-static void http_error(int socket, char* server_signature, error_t error)
+static void http_error(request_t* request,
+                       int socket,
+                       char* server_signature,
+                       error_t error)
 {
     char date[MAX_HTTP_DATE_LEN], response_header[MAX_HTTP_HEADER];
     http_get_date(date);
     sprintf(response_header, error_response[error], date, server_signature);
-    send(socket, response_header, strlen(response_header), 0);
+    request->t_send = http_now();
+    request->status = error_status[error];
+    request->bytes = strlen(response_header);
+    socket_write(socket,
+                 response_header,
+                 strlen(response_header),
+                 socket_deadline(request->conf->write_timeout * 1000));
+}
+
+static void http_access(request_t* request)
+{
+    acclog_record_t record;
+    const char* method = request->header.method;
+    const char* path = request->header.path;
+    uint64_t now = http_now();
+    size_t len, i, series;
+
+    record.bytes = request->bytes;
+    record.addr = request->addr;
+    record.port = request->port;
+    record.status = request->status;
+
+    // Una peticion cortada a medias solo tiene algunos instantes
+    record.wait_us = request->t_first && request->t_wait
+                       ? (request->t_first - request->t_wait) / 1000
+                       : 0;
+    record.header_us = request->t_header && request->t_first
+                         ? (request->t_header - request->t_first) / 1000
+                         : 0;
+    record.handler_us = request->t_send && request->t_header
+                          ? (request->t_send - request->t_header) / 1000
+                          : 0;
+    record.send_us = request->t_send ? (now - request->t_send) / 1000 : 0;
+
+    if (!method) {
+        record.method = ACCLOG_OTHER;
+    } else if (!strcmp("GET", method)) {
+        record.method = ACCLOG_GET;
+    } else if (!strcmp("POST", method)) {
+        record.method = ACCLOG_POST;
+    } else if (!strcmp("OPTIONS", method)) {
+        record.method = ACCLOG_OPTIONS;
+    } else {
+        record.method = ACCLOG_OTHER;
+    }
+    record.version = request->header.version;
+    record.flags = request->flags;
+    record.reserved = 0;
+
+    len = path ? strlen(path) : 0;
+    record.path_len = len > UINT16_MAX ? UINT16_MAX : len;
+    len = len < ACCLOG_PATH_SIZE ? len : ACCLOG_PATH_SIZE;
+    if (len) {
+        memcpy(record.path, path, len);
+    }
+    memset(record.path + len, 0, ACCLOG_PATH_SIZE - len);
+
+    record.time_us = request->time_us;
+    acclog_write(&record);
+
+    // Respuestas por error_t y latencia desde el primer byte
+    for (i = 0; i < MAX_HTTP_ERRORS && error_status[i] != record.status; i++)
+        ;
+    if (i < MAX_HTTP_ERRORS || record.status == 200) {
+        metrics_add(metric_ids.responses[i], 1);
+    }
+    metrics_add(metric_ids.bytes, record.bytes);
+    if (request->t_first && metric_ids.durations) {
+        series = record.method == ACCLOG_OTHER ? HTTP_NUM_METHODS - 1
+                                               : (size_t)record.method - 1;
+        series = series * metric_ids.num_routes + request->route;
+        metrics_observe(metric_ids.durations[series],
+                        (now - request->t_first) / 1000);
+    }
+
+    if (request->trace_id) {
+        http_trace(request, now);
+    }
+}
+
+static void http_trace(request_t* request, uint64_t now)
+{
+    trace_buf_t buf;
+    char path[2 * MAX_HTTP_PATH], args[4 * MAX_HTTP_PATH];
+    const char* method = request->header.method;
+
+    trace_escape(
+      path, sizeof(path), request->header.path ? request->header.path : "");
+    snprintf(args,
+             sizeof(args),
+             "\"method\":\"%s\",\"path\":\"%s\",\"status\":%d,"
+             "\"bytes\":%zu,\"keepalive\":%s,\"thread\":%ld",
+             method && strlen(method) < 16 ? method : "-",
+             path,
+             request->status,
+             request->bytes,
+             request->flags & ACCLOG_KEEPALIVE ? "true" : "false",
+             trace_thread());
+
+    // Las fases que no han llegado a ocurrir tienen algun instante a 0 y
+    // trace_span las omite
+    trace_buf_init(&buf, request->trace_id);
+    trace_span(&buf, "queue", request->t_queued, request->t_start, NULL);
+    trace_span(&buf, "wait", request->t_wait, request->t_first, NULL);
+    trace_span(&buf, "request", request->t_first, now, args);
+    trace_span(&buf, "recv", request->t_first, request->t_parsed, NULL);
+    trace_span(&buf,
+               "parse",
+               request->t_parsed ? request->t_parsed - request->parse_ns : 0,
+               request->t_parsed,
+               NULL);
+    trace_span(&buf, "body", request->t_parsed, request->t_header, NULL);
+    trace_span(&buf, "script_queue", request->t_header, request->t_run, NULL);
+    trace_span(&buf,
+               request->handler ? request->handler : "handler",
+               request->t_open,
+               request->t_opened,
+               NULL);
+    trace_span(&buf, "send", request->t_send, now, NULL);
+    trace_flush(&buf);
+}
+
+static int http_metrics_init(const http_config_t* conf)
+{
+    char labels[256], route[128];
+    size_t i, j;
+
+    for (i = 0; i <= MAX_HTTP_ERRORS; i++) {
+        snprintf(labels,
+                 sizeof(labels),
+                 "code=\"%u\",status=\"%s\"",
+                 i < MAX_HTTP_ERRORS ? error_status[i] : 200,
+                 error_name[i]);
+        metric_ids.responses[i] = metrics_counter(
+          "http_responses_total", "Respuestas enviadas por error_t", labels);
+    }
+    metric_ids.bytes = metrics_counter(
+      "http_response_bytes_total", "Bytes de las respuestas enviadas", NULL);
+    metric_ids.overload =
+      metrics_counter("http_overload_total",
+                      "Conexiones rechazadas con 503 sin leer la peticion",
+                      NULL);
+
+    metric_ids.durations =
+      (int*)malloc(HTTP_NUM_METHODS * (HTTP_ROUTE_FIRST + conf->num_routes) *
+                   sizeof(int));
+    metric_ids.prefixes = (char**)calloc(conf->num_routes + 1, sizeof(char*));
+    if (!metric_ids.durations || !metric_ids.prefixes) {
+        return -1;
+    }
+    for (i = 0; i < conf->num_routes; i++) {
+        metric_ids.prefixes[i] = strdup(conf->routes[i].prefix);
+        if (!metric_ids.prefixes[i]) {
+            return -1;
+        }
+    }
+    metric_ids.num_routes = HTTP_ROUTE_FIRST + conf->num_routes;
+    for (i = 0; i < HTTP_NUM_METHODS; i++) {
+        for (j = 0; j < metric_ids.num_routes; j++) {
+            if (j == HTTP_ROUTE_NONE) {
+                snprintf(route, sizeof(route), "none");
+            } else if (j == HTTP_ROUTE_STATIC) {
+                snprintf(route, sizeof(route), "static");
+            } else if (j == HTTP_ROUTE_SCRIPT) {
+                snprintf(route, sizeof(route), "script");
+            } else {
+                metrics_escape(route,
+                               sizeof(route),
+                               conf->routes[j - HTTP_ROUTE_FIRST].prefix);
+            }
+            snprintf(labels,
+                     sizeof(labels),
+                     "method=\"%s\",route=\"%s\"",
+                     metric_methods[i],
+                     route);
+            metric_ids.durations[i * metric_ids.num_routes + j] =
+              metrics_histogram("http_request_duration_seconds",
+                                "Tiempo desde el primer byte de la peticion "
+                                "hasta enviar la respuesta",
+                                labels);
+        }
+    }
+
+    return 0;
+}
+
+static int http_route_match(const http_config_t* conf, const char* path)
+{
+    size_t i, len, match = 0;
+    int route = -1;
+
+    for (i = 0; i < conf->num_routes; i++) {
+        len = strlen(conf->routes[i].prefix);
+        if (len > match && !strncmp(path, conf->routes[i].prefix, len)) {
+            match = len;
+            route = (int)i;
+        }
+    }
+
+    return route;
+}
+
+static int http_route(request_t* request)
+{
+    int route;
+
+    if (!request->header.path) {
+        return HTTP_ROUTE_NONE;
+    }
+    if (!http_is_script(request)) {
+        return HTTP_ROUTE_STATIC;
+    }
+
+    route = http_route_match(request->conf, request->header.path);
+
+    // conf es el primer campo de la configuracion publicada
+    return route == -1
+             ? HTTP_ROUTE_SCRIPT
+             : ((const http_snapshot_t*)request->conf)->series[route];
+}
+
+static uint64_t http_now()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+static int http_load_file(void* arg, char** data, size_t* len)
+{
+    long size;
+    FILE* file = NULL;
+
+    file = fopen((char*)arg, "rbe");
+    if (!file) {
+        return NOT_FOUND;
+    }
+    fseek(file, 0L, SEEK_END);
+    size = ftell(file);
+    fseek(file, 0L, SEEK_SET);
+    if (size < 0) {
+        fclose(file);
+        return NOT_FOUND;
+    }
+
+    *data = (char*)malloc((size + 1) * sizeof(char));
+    if (!*data) {
+        fclose(file);
+        return INTERNAL_SERVER_ERROR;
+    }
+    *len = fread(*data, 1, size, file);
+    (*data)[*len] = '\0';
+    fclose(file);
+
+    return OK;
+}
+
+static int http_load_script(void* arg, char** data, size_t* len)
+{
+    cgi_t* cgi = (cgi_t*)arg;
+    int fds[2], ms, wstatus = 0;
+    pid_t pid;
+    ssize_t bytes;
+    bool expired = false;
+    struct timespec deadline;
+    struct timespec* limit = NULL;
+    struct pollfd pfd[2];
+
+    // Instante limite de ejecucion del script
+    if (cgi->timeout > 0) {
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_sec += cgi->timeout;
+        limit = &deadline;
+    }
+
+    *data = (char*)malloc((MAX_HTTP_CGI_RESPONSE + 1) * sizeof(char));
+    if (!*data) {
+        return INTERNAL_SERVER_ERROR;
+    }
+
+    // Todos los descriptores del servidor se crean con O_CLOEXEC: ningun
+    // script hereda el pipe de otro ni los ficheros de otras peticiones.
+    // pipe2 no se declara sin _GNU_SOURCE, que choca con error_t.
+    if (syscall(SYS_pipe2, fds, O_CLOEXEC) == -1) {
+        free(*data);
+        *data = NULL;
+        return INTERNAL_SERVER_ERROR;
+    }
+
+    pid = fork();
+    if (pid == -1) {
+        close(fds[0]);
+        close(fds[1]);
+        free(*data);
+        *data = NULL;
+        return INTERNAL_SERVER_ERROR;
+    } else if (pid == 0) {
+        http_cgi_exec(cgi, fds[1]);
+    }
+    // Tambien desde el padre para no depender de que el hijo lo haga antes
+    // de que tengamos que matar el grupo
+    setpgid(pid, pid);
+    close(fds[1]);
+    PROBE2(script_spawn, pid, cgi->path);
+
+    // Nota: Puesto que la salida del script es un pipe no podemos determinar
+    // el tamanio que tendrá. Leemos hasta el final, hasta llenar el buffer o
+    // hasta que venza el plazo.
+    *len = 0;
+    pfd[0].fd = fds[0];
+    pfd[0].events = POLLIN;
+    pfd[1].fd = drain_fd;
+    pfd[1].events = POLLIN;
+    while (*len < MAX_HTTP_CGI_RESPONSE) {
+        ms = http_ms_left(limit);
+        if (ms == 0) {
+            expired = true;
+            break;
+        }
+        if (poll(pfd, 2, ms) == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        if (pfd[1].revents) {
+            // Drenado a la fuerza (ver http_drain)
+            expired = true;
+            break;
+        }
+        if (!pfd[0].revents) {
+            continue;
+        }
+        bytes = read(fds[0], *data + *len, MAX_HTTP_CGI_RESPONSE - *len);
+        if (bytes == -1 && errno == EINTR) {
+            continue;
+        } else if (bytes <= 0) {
+            break;
+        }
+        *len += bytes;
+    }
+    // Si el script sigue escribiendo recibira SIGPIPE
+    close(fds[0]);
+
+    if (expired || !http_cgi_wait(pid, limit, &wstatus)) {
+        // Matamos el grupo completo para no dejar procesos hijos del script
+        kill(-pid, SIGKILL);
+        waitpid(pid, &wstatus, 0);
+        PROBE3(script_exit, pid, wstatus, *len);
+        free(*data);
+        *data = NULL;
+        *len = 0;
+        return GATEWAY_TIMEOUT;
+    }
+    PROBE3(script_exit, pid, wstatus, *len);
+
+    if (WIFEXITED(wstatus) &&
+        WEXITSTATUS(wstatus) == HTTP_CGI_EXEC_FAILED && *len == 0) {
+        // No se ha podido ejecutar el interprete
+        free(*data);
+        *data = NULL;
+        return INTERNAL_SERVER_ERROR;
+    }
+
+    (*data)[*len] = '\0';
+
+    return OK;
+}
+
+static int http_cgi_init(cgi_t* cgi,
+                         const http_config_t* conf,
+                         char* path,
+                         char* route,
+                         char* args)
+{
+    int i;
+
+    if (strstr(path, ".py")) {
+        cgi->interpreter = "python3";
+    } else if (strstr(path, ".php")) {
+        cgi->interpreter = "php";
+    } else {
+        return BAD_REQUEST;
+    }
+    cgi->path = path;
+    cgi->args = args;
+
+    // Se aplica el tiempo de la ruta con el prefijo mas largo
+    i = http_route_match(conf, route);
+    cgi->timeout = i == -1 ? conf->script_timeout : conf->routes[i].timeout;
+    cgi->cpu_limit = conf->script_cpu_limit;
+    cgi->mem_limit = conf->script_mem_limit;
+
+    return OK;
+}
+
+static void http_cgi_exec(cgi_t* cgi, int out)
+{
+    int in;
+    char* argv[4];
+    sigset_t set;
+    struct rlimit rl;
+
+    // Grupo de procesos propio para poder matar al script y a sus hijos
+    setpgid(0, 0);
+
+    // Los hilos del servidor bloquean algunas seniales, el script no. El
+    // servidor ignora SIGPIPE y eso se hereda en el exec.
+    sigemptyset(&set);
+    sigprocmask(SIG_SETMASK, &set, NULL);
+    signal(SIGPIPE, SIG_DFL);
+
+    if (cgi->cpu_limit > 0) {
+        rl.rlim_cur = cgi->cpu_limit;
+        rl.rlim_max = cgi->cpu_limit + 1;
+        setrlimit(RLIMIT_CPU, &rl);
+    }
+    if (cgi->mem_limit > 0) {
+        rl.rlim_cur = (rlim_t)cgi->mem_limit * 1024 * 1024;
+        rl.rlim_max = rl.rlim_cur;
+        setrlimit(RLIMIT_AS, &rl);
+    }
+
+    in = open("/dev/null", O_RDONLY);
+    if (in != -1) {
+        dup2(in, STDIN_FILENO);
+    }
+    dup2(out, STDOUT_FILENO);
+    dup2(out, STDERR_FILENO);
+
+    argv[0] = cgi->interpreter;
+    argv[1] = cgi->path;
+    argv[2] = cgi->args;
+    argv[3] = NULL;
+    execvp(cgi->interpreter, argv);
+
+    _exit(HTTP_CGI_EXEC_FAILED);
+}
+
+static bool http_cgi_wait(pid_t pid, struct timespec* deadline, int* wstatus)
+{
+    int ms;
+    struct pollfd pfd[2];
+
+    // El script puede cerrar su salida y seguir ejecutandose. El pidfd se
+    // vuelve legible cuando termina.
+    pfd[0].fd = (int)syscall(SYS_pidfd_open, pid, 0);
+    pfd[0].events = POLLIN;
+    pfd[0].revents = 0;
+    pfd[1].fd = drain_fd;
+    pfd[1].events = POLLIN;
+    pfd[1].revents = 0;
+    while (pfd[0].fd != -1) {
+        ms = http_ms_left(deadline);
+        if (ms == 0 || pfd[1].revents) {
+            // Vence el plazo o se drena a la fuerza
+            close(pfd[0].fd);
+            return false;
+        }
+        if (poll(pfd, 2, ms) == -1 && errno != EINTR) {
+            break;
+        }
+        if (pfd[0].revents) {
+            break;
+        }
+    }
+    if (pfd[0].fd != -1) {
+        close(pfd[0].fd);
+    }
+
+    return waitpid(pid, wstatus, 0) == pid;
+}
+
+static int http_ms_left(struct timespec* deadline)
+{
+    long ms;
+    struct timespec now;
+
+    if (!deadline) {
+        return -1;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    ms = (deadline->tv_sec - now.tv_sec) * 1000 +
+         (deadline->tv_nsec - now.tv_nsec) / 1000000;
+
+    return ms > 0 ? (int)ms : 0;
 }
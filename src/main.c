@@ -5,29 +5,75 @@
  * FECHA CREACION: 4 Marzo de 2021
  * AUTORES: Javier Mateos Najari, Adrian Sebastian Gil
  *****************************************************************************/
+#define _GNU_SOURCE       // pipe2, close_range
+#include <errno.h>        // errno
 #include <fcntl.h>        // open
+#include <limits.h>       // PATH_MAX
+#include <poll.h>         // poll
 #include <signal.h>       // pthread_sigmask
 #include <stdbool.h>      // bool
+#include <stddef.h>       // offsetof
 #include <sys/resource.h> // getrlimit
 #include <sys/socket.h>   // send
 #include <sys/stat.h>     // umask
 #include <sys/syslog.h>   // syslog
+#include <sys/wait.h>     // waitpid
 #include <syslog.h>       // openlog
+#include <time.h>         // nanosleep
 #include <unistd.h>       // close
 
+#include "acclog.h"
+#include "alog.h"
+#include "capture.h"
+#include "evloop.h"
 #include "http.h"
 #include "iniparser.h"
+#include "metrics.h"
+#include "probes.h"
+#include "profiler.h"
 #include "socket.h"
+#include "topology.h"
+#include "trace.h"
 #include "tpool.h"
 
-#define TIME_OUT_SOCKET 15      // Tiempo de espera en un socket de un cliente
 #define MAX_SERVER_SIGNATURE 50 // Tamanyo maximo de nombre de servidor
 #define MAX_SERVER_ROOT 50      // Tamanyio maximo del directorio root http
+#define MAX_LOG_MESSAGE 1024    // Tamanyo maximo de un mensaje de log largo
+#define HEADER_TIMEOUT 10       // Limite por defecto para recibir la cabecera
+#define BODY_TIMEOUT 30         // Limite por defecto para recibir el cuerpo
+#define WRITE_TIMEOUT 30        // Limite por defecto para enviar una respuesta
+#define KEEPALIVE_TIMEOUT 15    // Espera por defecto a la siguiente peticion
+#define ACCESS_SIZE 64          // Tamanio por defecto del log de accesos (MB)
+#define METRICS_PATH "/metrics" // Path por defecto de las metricas
+#define ADMIN_BIND "127.0.0.1"  // Direccion por defecto del puerto de admin
+#define CAPTURE_SIZE 256        // Tamanio maximo por defecto de la captura (MB)
+#define PROFILE_SECONDS 10      // Duracion por defecto de un perfil
+#define PROFILE_HZ 99           // Muestras por segundo por defecto de un perfil
+#define THREAD_LIMIT 2          // Margen de hilos para recargar (veces el max)
+#define DRAIN_TIMEOUT 30        // Espera por defecto a las conexiones abiertas
+#define DRAIN_POLL_MS 100       // Intervalo de comprobacion del drenado
+#define DRAIN_FORCE_MS 1000     // Espera a las conexiones cerradas a la fuerza
+#define LISTEN_FD_ENV "SERVER_LISTEN_FD" // Socket heredado al actualizar
+#define READY_FD_ENV "SERVER_READY_FD"   // Aviso de proceso nuevo listo
 
 int sock_fd;      // Socket en el que recibe las peticiones
 tpool_t* tm;      // Pool de hilos
+tpool_t* ts;      // Pool de hilos para la ejecucion de scripts
+evloop_t* el;     // Bucles de eventos (conexiones en corrutinas)
+topology_t* topo; // Topologia de CPUs de la maquina
 bool daemon_proc; // Indica si debe ser un proceso daemon
 bool debug;       // Indica que el servidor esta en modo debug
+bool async_log;   // Los mensajes pasan por el log asincrono
+int conn_opened = -1; // Metrica de conexiones aceptadas
+int conn_closed = -1; // Metrica de conexiones cerradas
+volatile sig_atomic_t reload;  // SIGHUP pendiente de atender en el accept
+volatile sig_atomic_t upgrade; // SIGUSR2 pendiente de atender en el accept
+volatile sig_atomic_t stop;    // SIGINT o SIGTERM: drenar y terminar
+volatile sig_atomic_t force;   // Segunda senial de terminacion: no esperar
+int sig_pipe[2] = { -1, -1 };  // Despierta al bucle de accept (self-pipe)
+pid_t upgrade_pid = -1;  // Proceso nuevo que todavia no esta listo
+int upgrade_fd = -1;     // Por donde avisa el proceso nuevo de que esta listo
+char exe_path[PATH_MAX]; // Ejecutable que se lanza al actualizar
 struct config_s {
     struct read_ini* ri;
     struct ini* conf;
@@ -36,22 +82,270 @@ struct config_s {
 // Argumentos que se pasa a los hilos
 struct thread_arg {
     int new_fd; // Socket en el que se comunica con el cliente
-    char server_signature[MAX_SERVER_SIGNATURE]; // Nombre del servidor
-    char server_root[MAX_SERVER_ROOT]; // Carpeta raiz en la que se encuentran
-                                       // los ficheros del servidor http
+    http_conn_t conn; // Direccion, identificador e instante de encolado
+    http_script_t* script; // Peticion de script pendiente de la conexion
+    bool resumed; // La conexion vuelve del pool de scripts
 };
 
+// Parametros que solo se aplican al arrancar. Si cambian al recargar la
+// configuracion se avisa de que hace falta reiniciar.
+static const char* restart_keys[][2] = {
+    { "inicializacion", "max_clients" },  { "inicializacion", "listen_port" },
+    { "inicializacion", "daemon" },       { "inicializacion", "debug" },
+    { "inicializacion", "queue_target" }, { "inicializacion", "thread_idle" },
+    { "inicializacion", "queue_size" },   { "inicializacion", "codel_target" },
+    { "inicializacion", "codel_interval" }, { "inicializacion", "affinity" },
+    { "inicializacion", "io_mode" },      { "inicializacion", "coro_loops" },
+    { "inicializacion", "coro_stack" },   { "inicializacion", "script_queue" },
+    { "inicializacion", "thread_limit" },
+    { "inicializacion", "script_thread_limit" },
+    { "log", "file" },                    { "log", "ring_size" },
+    { "log", "flush_ms" },                { "log", "access_file" },
+    { "log", "access_size" },             { "log", "access_keep" },
+    { "log", "trace_file" },              { "log", "trace_sample" },
+    { "log", "capture_file" },            { "log", "capture_size" },
+    { "metricas", "admin_port" },         { "metricas", "path" },
+    { "metricas", "profile_path" },       { "metricas", "admin_bind" },
+};
+
+// Estadistica de un pool o de los bucles que se publica como metrica
+typedef struct stat_metric {
+    const char* name;    // Nombre de la metrica
+    const char* help;    // Descripcion de la metrica
+    metrics_type_t type; // Contador o valor instantaneo
+    size_t offset;       // Campo de tpool_stats_t o evloop_stats_t
+} stat_metric_t;
+
+// Metricas de los pools de hilos (etiqueta pool="main" o "scripts")
+static const stat_metric_t pool_metrics[] = {
+    { "tpool_threads", "Hilos vivos del pool", METRICS_GAUGE,
+      offsetof(tpool_stats_t, num_threads) },
+    { "tpool_active_threads", "Hilos ejecutando un trabajo", METRICS_GAUGE,
+      offsetof(tpool_stats_t, active) },
+    { "tpool_queued", "Trabajos esperando en la cola", METRICS_GAUGE,
+      offsetof(tpool_stats_t, queued) },
+    { "tpool_queue_size", "Capacidad de la cola", METRICS_GAUGE,
+      offsetof(tpool_stats_t, queue_size) },
+    { "tpool_max_queued", "Maximo de trabajos que han esperado en la cola",
+      METRICS_GAUGE, offsetof(tpool_stats_t, max_queued) },
+    { "tpool_completed_total", "Trabajos terminados", METRICS_COUNTER,
+      offsetof(tpool_stats_t, completed) },
+    { "tpool_rejected_total", "Trabajos rechazados con la cola llena",
+      METRICS_COUNTER, offsetof(tpool_stats_t, rejected) },
+    { "tpool_dropped_total", "Trabajos descartados por CoDel",
+      METRICS_COUNTER, offsetof(tpool_stats_t, dropped) },
+    { "tpool_stolen_total", "Trabajos robados de la cola de otro hilo",
+      METRICS_COUNTER, offsetof(tpool_stats_t, stolen) },
+};
+
+// Metricas de los bucles de eventos
+static const stat_metric_t loop_metrics[] = {
+    { "evloop_coroutines", "Corrutinas vivas", METRICS_GAUGE,
+      offsetof(evloop_stats_t, active) },
+    { "evloop_max_coroutines", "Maximo de corrutinas vivas a la vez",
+      METRICS_GAUGE, offsetof(evloop_stats_t, max_active) },
+    { "evloop_stacks", "Pilas reservadas", METRICS_GAUGE,
+      offsetof(evloop_stats_t, stacks) },
+    { "evloop_completed_total", "Corrutinas terminadas", METRICS_COUNTER,
+      offsetof(evloop_stats_t, completed) },
+    { "evloop_rejected_total", "Conexiones rechazadas con las colas llenas",
+      METRICS_COUNTER, offsetof(evloop_stats_t, rejected) },
+    { "evloop_timeouts_total", "Esperas en sockets expiradas",
+      METRICS_COUNTER, offsetof(evloop_stats_t, timeouts) },
+};
+
+/*******************************************************************************
+ * FUNCION: static void signal_handler(int sig)
+ * ARGS_IN: int sig - senial recibida.
+ * DESCRIPCION: Rutina de servicio de SIGINT, SIGTERM, SIGHUP y SIGUSR2. Solo
+ *              marca lo que se pide y escribe en sig_pipe para despertar al
+ *              bucle de accept, que es quien lo hace.
+ ******************************************************************************/
+static void signal_handler(int sig);
+/*******************************************************************************
+ * FUNCION: static bool accept_wait()
+ * DESCRIPCION: Espera a la vez una conexion, una senial (sig_pipe) y, con
+ *              una actualizacion en curso, el aviso del proceso nuevo.
+ * ARGS_OUT: bool - true si hay una conexion que aceptar o false si hay que
+ *                  volver a comprobar lo que piden las seniales.
+ ******************************************************************************/
+static bool accept_wait();
+/*******************************************************************************
+ * FUNCION: static void server_drain()
+ * DESCRIPCION: Deja de aceptar conexiones y espera como mucho drain_timeout
+ *              segundos a que se atiendan las que estan en cola y en curso.
+ *              Las conexiones keep-alive se cierran tras su respuesta (ver
+ *              http_drain). Al vencer el plazo, o con una segunda senial de
+ *              terminacion, cierra a la fuerza las que queden.
+ ******************************************************************************/
+static void server_drain();
+/*******************************************************************************
+ * FUNCION: static void server_shutdown()
+ * DESCRIPCION: Libera los pools, los modulos y la configuracion, escribe lo
+ *              pendiente de los logs y termina el proceso.
+ ******************************************************************************/
+static void server_shutdown();
+/*******************************************************************************
+ * FUNCION: static void config_reload()
+ * DESCRIPCION: Vuelve a leer server.ini y aplica lo que se puede cambiar en
+ *              marcha: la configuracion del modulo http (server_root,
+ *              server_signature y limites de las conexiones y de los
+ *              scripts, ver http_reload) y el numero de hilos de los pools
+ *              (ver tpool_resize). Las peticiones en curso terminan con la
+ *              configuracion anterior y las siguientes, tambien las de
+ *              conexiones keep-alive abiertas, usan la nueva. Si el fichero
+ *              no se puede leer o no es valido se mantiene la anterior.
+ ******************************************************************************/
+static void config_reload();
+/*******************************************************************************
+ * FUNCION: static bool config_apply(struct config_s* old)
+ * ARGS_IN: struct config_s* old - configuracion anterior.
+ * DESCRIPCION: Aplica la configuracion recien leida en config y avisa de
+ *              los parametros que han cambiado pero necesitan reiniciar.
+ * ARGS_OUT: bool - false si no es valida y no se ha aplicado nada.
+ ******************************************************************************/
+static bool config_apply(struct config_s* old);
 /*******************************************************************************
- * FUNCION: static void signal_handler()
- * DESCRIPCION: Rutina de servicio cuando se recibe la señal SIGINT o SIGTERM.
+ * FUNCION: static int upgrade_inherit(int* ready_fd)
+ * ARGS_IN: int* ready_fd - descriptor por el que avisar al proceso anterior
+ *                          de que este esta listo (-1 si no hay).
+ * DESCRIPCION: Recoge el socket de escucha que deja el proceso anterior en
+ *              una actualizacion y borra las variables de entorno que lo
+ *              indican para que no las hereden los scripts.
+ * ARGS_OUT: int - socket de escucha heredado o -1 si no lo hay.
  ******************************************************************************/
-static void signal_handler();
+static int upgrade_inherit(int* ready_fd);
+/*******************************************************************************
+ * FUNCION: static void upgrade_start()
+ * DESCRIPCION: Lanza el ejecutable del servidor (el que haya ahora en su
+ *              ruta) pasandole el socket de escucha abierto y un pipe por el
+ *              que avisa cuando esta listo. Mientras tanto este proceso sigue
+ *              aceptando conexiones. Cierra el puerto de administracion para
+ *              que lo abra el proceso nuevo.
+ ******************************************************************************/
+static void upgrade_start();
+/*******************************************************************************
+ * FUNCION: static void upgrade_exec(char** argv, char** envp, int ready_fd)
+ * ARGS_IN: char** argv - argumentos del ejecutable.
+ *          char** envp - entorno con los descriptores heredados.
+ *          int ready_fd - extremo de escritura del aviso de listo.
+ * DESCRIPCION: En el hijo de upgrade_start, cierra todos los descriptores
+ *              salvo los estandar, el socket de escucha y ready_fd, y lanza
+ *              el ejecutable. Solo usa funciones seguras tras fork.
+ ******************************************************************************/
+static void upgrade_exec(char** argv, char** envp, int ready_fd);
+/*******************************************************************************
+ * FUNCION: static void upgrade_check()
+ * DESCRIPCION: Lee el aviso del proceso nuevo. Si esta listo, este proceso
+ *              termina como con SIGTERM: las conexiones que esperan en el
+ *              socket son ya del nuevo. Si ha terminado sin estar listo se
+ *              sigue como antes.
+ ******************************************************************************/
+static void upgrade_check();
+/*******************************************************************************
+ * FUNCION: static void metrics_restart()
+ * DESCRIPCION: Vuelve a abrir el puerto de administracion y a permitir los
+ *              perfiles si la actualizacion no sale adelante.
+ ******************************************************************************/
+static void metrics_restart();
 /*******************************************************************************
  * FUNCION: static void thread_routine(void* args)
  * ARGS_IN: void* args - Argumento de la funcion ejecutada por el hilo.
  * DESCRIPCION: Rutina de servicio que ejecuta un hilo.
  ******************************************************************************/
 static void thread_routine(void* args);
+/*******************************************************************************
+ * FUNCION: static void script_routine(void* args)
+ * ARGS_IN: void* args - Argumento de la funcion ejecutada por el hilo.
+ * DESCRIPCION: Rutina de servicio que ejecuta un hilo del pool de scripts.
+ *              Procesa la peticion de script diferida y devuelve la conexion
+ *              al pool principal.
+ ******************************************************************************/
+static void script_routine(void* args);
+/*******************************************************************************
+ * FUNCION: static void shed_routine(void* args)
+ * ARGS_IN: void* args - Argumento de la conexion descartada.
+ * DESCRIPCION: Rutina que ejecuta el pool principal en lugar de thread_routine
+ *              cuando CoDel descarta la conexion. Responde 503 a las
+ *              conexiones nuevas y la cierra.
+ ******************************************************************************/
+static void shed_routine(void* args);
+/*******************************************************************************
+ * FUNCION: static void close_connection(struct thread_arg* arg)
+ * ARGS_IN: struct thread_arg* arg - Argumento de la conexion que se cierra.
+ * DESCRIPCION: Cierra la conexion con el cliente y libera su argumento.
+ ******************************************************************************/
+static void close_connection(struct thread_arg* arg);
+/*******************************************************************************
+ * FUNCION: static bool submit_connection(struct thread_arg* arg)
+ * ARGS_IN: struct thread_arg* arg - Argumento de la conexion.
+ * DESCRIPCION: Entrega la conexion al pool principal o, en modo corrutinas, a
+ *              los bucles de eventos. No bloquea.
+ * ARGS_OUT: bool - true si se ha entregado.
+ ******************************************************************************/
+static bool submit_connection(struct thread_arg* arg);
+/*******************************************************************************
+ * FUNCION: static int config_get_int(char* section, char* key, int def)
+ * ARGS_IN: char* section - Seccion del fichero de configuracion.
+ *          char* key - Clave dentro de la seccion.
+ *          int def - Valor por defecto si la clave no existe.
+ * DESCRIPCION: Obtiene un parametro numerico de la configuracion.
+ * ARGS_OUT: int - Valor del parametro.
+ ******************************************************************************/
+static int config_get_int(char* section, char* key, int def);
+/*******************************************************************************
+ * FUNCION: static void config_get_pools(tpool_opts_t* pool_opts,
+ *                                       tpool_opts_t* script_opts)
+ * ARGS_IN: tpool_opts_t* pool_opts - opciones del pool principal.
+ *          tpool_opts_t* script_opts - opciones del pool de scripts.
+ * DESCRIPCION: Obtiene las opciones de los pools de hilos de la seccion
+ *              inicializacion. La topologia y el reparto de CPUs se
+ *              completan al crearlos.
+ ******************************************************************************/
+static void config_get_pools(tpool_opts_t* pool_opts,
+                             tpool_opts_t* script_opts);
+/*******************************************************************************
+ * FUNCION: static void config_get_http(http_config_t* http_conf)
+ * ARGS_IN: http_config_t* http_conf - configuracion del modulo http.
+ * DESCRIPCION: Obtiene la configuracion del modulo http: directorio raiz,
+ *              nombre del servidor, limites de los scripts y de las
+ *              conexiones y rutas (se libera routes).
+ ******************************************************************************/
+static void config_get_http(http_config_t* http_conf);
+/*******************************************************************************
+ * FUNCION: static tpool_affinity_t config_get_affinity(char* section,
+ *                                                      char* key)
+ * ARGS_IN: char* section - seccion del fichero de configuracion.
+ *          char* key - clave del parametro.
+ * DESCRIPCION: Obtiene la fijacion de los hilos a CPUs ("none", "core" o
+ *              "node"). Si no existe los hilos no se fijan.
+ * ARGS_OUT: tpool_affinity_t - fijacion de los hilos.
+ ******************************************************************************/
+static tpool_affinity_t config_get_affinity(char* section, char* key);
+/*******************************************************************************
+ * FUNCION: static bool config_get_io_mode(char* section, char* key)
+ * ARGS_IN: char* section - seccion del fichero de configuracion.
+ *          char* key - clave del parametro.
+ * DESCRIPCION: Obtiene como se atienden las conexiones ("threads": un hilo
+ *              del pool por conexion, o "coro": corrutinas sobre bucles de
+ *              eventos). Si no existe se usa el pool de hilos.
+ * ARGS_OUT: bool - true en modo corrutinas.
+ ******************************************************************************/
+static bool config_get_io_mode(char* section, char* key);
+/*******************************************************************************
+ * FUNCION: static void log_placement(char* name, tpool_t* pool)
+ * ARGS_IN: char* name - nombre del pool en el log.
+ *          tpool_t* pool - pool de hilos.
+ * DESCRIPCION: Loggea la CPU y el nodo de cada hilo del pool.
+ ******************************************************************************/
+static void log_placement(char* name, tpool_t* pool);
+/*******************************************************************************
+ * FUNCION: static void config_get_routes(http_config_t* http_conf)
+ * ARGS_IN: http_config_t* http_conf - Configuracion del modulo http.
+ * DESCRIPCION: Obtiene los tiempos maximos de ejecucion por ruta de la seccion
+ *              script_timeouts. Las rutas apuntan a la configuracion leida.
+ ******************************************************************************/
+static void config_get_routes(http_config_t* http_conf);
 /*******************************************************************************
  * FUNCION: static void daemon_process()
  * DESCRIPCION: Convierte el proceso en un proceso demonio.
@@ -63,58 +357,127 @@ static void daemon_process();
  *          char* message - Mensaje que se loggea.
  * DESCRIPCION: Logea el mensaje el logger del sistema en caso de que se trate
  *              de un proceso demonio o imprime por stdout en caso contrario.
+ *              Una vez iniciado el log asincrono solo encola el mensaje (ver
+ *              alog.h), que se descarta si el buffer del hilo esta lleno.
  *
  * Los posibles valores de priority son: LOG_INFO, LOG_DEBUG, LOG_ERROR.
  ******************************************************************************/
 static void logger(int priority, char* message);
+/*******************************************************************************
+ * FUNCION: static void collect_metrics(metrics_out_t* out, void* arg)
+ * ARGS_IN: metrics_out_t* out - texto de la consulta de metricas.
+ *          void* arg - no se usa.
+ * DESCRIPCION: Publica las conexiones abiertas y las estadisticas de los
+ *              pools, de los bucles de eventos y del log.
+ ******************************************************************************/
+static void collect_metrics(metrics_out_t* out, void* arg);
+/*******************************************************************************
+ * FUNCION: static int profile_handler(const char* query,
+ *                                     char** body,
+ *                                     size_t* len,
+ *                                     void* arg)
+ * ARGS_IN: const char* query - parametros seconds y hz.
+ *          char** body - pilas en formato folded o mensaje de error.
+ *          size_t* len - longitud de body.
+ *          void* arg - no se usa.
+ * DESCRIPCION: Atiende el path del perfilador del puerto de administracion:
+ *              muestrea los hilos del servidor durante seconds segundos
+ *              (PROFILE_SECONDS) a hz muestras por segundo (PROFILE_HZ).
+ * ARGS_OUT: int - codigo de estado HTTP.
+ ******************************************************************************/
+static int profile_handler(const char* query,
+                           char** body,
+                           size_t* len,
+                           void* arg);
 /*******************************************************************************
  * FUNCION: static struct thread_arg* create_thread_args(int new_fd,
-                                             char* server_root,
-                                             char* server_signature);
+                                             struct sockaddr_in* peer,
+                                             uint64_t id);
  * ARGS_IN: int new_fd - Descriptor de fichero de la conexion.
- *          char* server_root - Directorio raiz del servidor web.
- *          char* server_signature - Nombre del servidor.
+ *          struct sockaddr_in* peer - Direccion del cliente.
+ *          uint64_t id - Identificador de la conexion.
  * DESCRIPCION: Crea e inicializa el argumento para la función de trabajo del
  *              hilo.
  * ARGS_OUT: thread_arg* - Argumento creado e inicializado para la funcion de
  *                         trabajo.
  ******************************************************************************/
 static struct thread_arg* create_thread_args(int new_fd,
-                                             char* server_root,
-                                             char* server_signature);
+                                             struct sockaddr_in* peer,
+                                             uint64_t id);
 
 int main(void)
 {
-    int num_threads, backlog;
+    int backlog;
+    tpool_opts_t pool_opts = { 0 };
+    tpool_opts_t script_opts = { 0 };
+    http_config_t http_conf = { 0 };
     char* port = NULL;
-    char* server_root = NULL;
-    char* server_signature = NULL;
     int new_fd;
+    int listen_fd, ready_fd;
+    bool coro_mode;
+    evloop_opts_t loop_opts = { 0 };
+    evloop_stats_t loop_stats;
+    alog_opts_t log_opts = { 0 };
+    acclog_opts_t access_opts = { 0 };
+    trace_opts_t trace_opts = { 0 };
+    capture_opts_t capture_opts = { 0 };
+    char* admin_port = NULL;
+    char* admin_bind = NULL;
+    char* metrics_path = NULL;
+    char* profile_path = NULL;
+    struct sockaddr_in peer;
+    uint64_t conn_id = 0;
+    struct rlimit rl;
     struct sigaction sa;
-    struct timeval timeout;
     struct thread_arg* args = NULL;
+    char message[MAX_LOG_MESSAGE];
 
     config.conf = read_ini(&config.ri, "server.ini");
     if (!config.conf) {
         fprintf(stderr, "Error leyendo el fichero de configuracion...\n");
         exit(EXIT_FAILURE);
     }
+    listen_fd = upgrade_inherit(&ready_fd);
+    // Se resuelve ahora: al actualizar se lanza lo que haya en la misma ruta
+    if (readlink("/proc/self/exe", exe_path, sizeof(exe_path) - 1) == -1) {
+        exe_path[0] = '\0';
+    }
 
     // Obtenmos lo parametros de configuracion e inicializacion del servidor
     backlog = atoi(ini_get_value(config.conf, "inicializacion", "max_clients"));
     port = ini_get_value(config.conf, "inicializacion", "listen_port");
-    num_threads =
-      atoi(ini_get_value(config.conf, "inicializacion", "num_threads"));
     daemon_proc = atoi(ini_get_value(config.conf, "inicializacion", "daemon"));
     debug = atoi(ini_get_value(config.conf, "inicializacion", "debug"));
-    server_root = ini_get_value(config.conf, "configuracion", "server_root");
-    server_signature =
-      ini_get_value(config.conf, "configuracion", "server_signature");
+    config_get_pools(&pool_opts, &script_opts);
+    coro_mode = config_get_io_mode("inicializacion", "io_mode");
+    loop_opts.num_loops = config_get_int("inicializacion", "coro_loops", 0);
+    loop_opts.stack_size =
+      (size_t)config_get_int("inicializacion", "coro_stack", 0) * 1024;
+    config_get_http(&http_conf);
+    log_opts.path = ini_get_value(config.conf, "log", "file");
+    log_opts.ring_size = config_get_int("log", "ring_size", 0);
+    log_opts.flush_ms = config_get_int("log", "flush_ms", 0);
+    access_opts.path = ini_get_value(config.conf, "log", "access_file");
+    access_opts.max_size =
+      (size_t)config_get_int("log", "access_size", ACCESS_SIZE) * 1024 * 1024;
+    access_opts.keep = config_get_int("log", "access_keep", 0);
+    trace_opts.path = ini_get_value(config.conf, "log", "trace_file");
+    trace_opts.sample = (unsigned)config_get_int("log", "trace_sample", 0);
+    capture_opts.path = ini_get_value(config.conf, "log", "capture_file");
+    capture_opts.max_size =
+      (size_t)config_get_int("log", "capture_size", CAPTURE_SIZE) * 1024 * 1024;
+    admin_port = ini_get_value(config.conf, "metricas", "admin_port");
+    admin_bind = ini_get_value(config.conf, "metricas", "admin_bind");
+    metrics_path = ini_get_value(config.conf, "metricas", "path");
+    profile_path = ini_get_value(config.conf, "metricas", "profile_path");
 
     if (daemon_proc) {
-        // Convertimos el proceso en demonio
-        fprintf(stdout, "Ejecutando servidor como proceso daemon...\n");
-        daemon_process();
+        // Convertimos el proceso en demonio. El lanzado por una actualizacion
+        // ya lo es: es hijo del demonio anterior.
+        if (listen_fd == -1) {
+            fprintf(stdout, "Ejecutando servidor como proceso daemon...\n");
+            daemon_process();
+        }
         // Inicializamos el fichero de logs
         if (debug) {
             setlogmask(LOG_UPTO(LOG_DEBUG));
@@ -124,93 +487,877 @@ int main(void)
         openlog("SERVER", LOG_CONS | LOG_PID | LOG_NDELAY, LOG_DAEMON);
     }
 
+    // A partir de aqui los hilos dejan los mensajes en su buffer y los
+    // escribe el hilo del log. Tiene que lanzarse despues de daemon_process
+    // porque fork no copia los hilos.
+    log_opts.syslog = daemon_proc;
+    if (alog_init(&log_opts)) {
+        logger(LOG_ERR, "Error iniciando el log asincrono...\n");
+    } else {
+        async_log = true;
+    }
+    if (access_opts.path && acclog_init(&access_opts)) {
+        logger(LOG_ERR, "Error iniciando el log de accesos...\n");
+    }
+    if (trace_opts.path && trace_opts.sample && trace_init(&trace_opts)) {
+        logger(LOG_ERR, "Error iniciando la traza de peticiones...\n");
+    }
+    if (capture_opts.path && capture_init(&capture_opts)) {
+        logger(LOG_ERR, "Error iniciando la captura de trafico...\n");
+    }
+
     logger(LOG_DEBUG, "Iniciando el socket...\n");
-    sock_fd = socket_init(port, backlog);
+    if (listen_fd != -1) {
+        // Las conexiones que esperan en su cola no se pierden
+        sock_fd = listen_fd;
+        logger(LOG_INFO, "Socket de escucha heredado del proceso anterior\n");
+    } else {
+        sock_fd = socket_init(NULL, port, backlog);
+    }
     if (sock_fd == -1) {
         logger(LOG_ERR, "Error inicializando el socket...\n");
         exit(EXIT_FAILURE);
     }
 
-    logger(LOG_DEBUG, "Iniciando el pool de hilos...\n");
-    tm = tpool_create(num_threads);
-    if (!tm) {
-        logger(LOG_ERR, "Error inicializando el pool de hilos...\n");
+    // Cada conexion en corrutina ocupa un descriptor y ningun hilo, asi que
+    // el limite de descriptores pasa a ser el de conexiones. Se sube antes
+    // de http_init, que registra las conexiones por descriptor.
+    if (coro_mode && !getrlimit(RLIMIT_NOFILE, &rl) &&
+        rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+
+    logger(LOG_DEBUG, "Iniciando el modulo http...\n");
+    if (http_init(&http_conf) == -1) {
+        logger(LOG_ERR, "Error inicializando el modulo http...\n");
         exit(EXIT_FAILURE);
     }
+    free(http_conf.routes);
+    conn_opened = metrics_counter(
+      "server_connections_total", "Conexiones aceptadas", NULL);
+    conn_closed = metrics_counter(
+      "server_connections_closed_total", "Conexiones cerradas", NULL);
+    metrics_collector(collect_metrics, NULL);
 
-    // Establecemos el tratamiento de las seniales de terminacion del programa
-    sa.sa_handler = signal_handler;
-    sigemptyset(&sa.sa_mask);
-    sa.sa_flags = SA_RESTART;
-    if (sigaction(SIGINT, &sa, NULL)) {
+    topo = topology_discover();
+    if (topo) {
+        snprintf(message,
+                 sizeof(message),
+                 "Topologia: %zu CPUs, %zu cores, %zu sockets, %zu nodos "
+                 "NUMA\n",
+                 topo->num_cpus,
+                 topo->num_cores,
+                 topo->num_packages,
+                 topo->num_nodes);
+        logger(LOG_DEBUG, message);
+    } else if (pool_opts.affinity != TPOOL_AFFINITY_NONE) {
+        logger(LOG_ERR, "Topologia desconocida, los hilos no se fijan...\n");
+    }
+    // Los hilos de scripts se colocan a continuacion de todos los huecos de
+    // los principales
+    pool_opts.topology = topo;
+    script_opts.affinity = pool_opts.affinity;
+    script_opts.topology = topo;
+    script_opts.cpu_offset = pool_opts.num_threads;
+    if (pool_opts.max_threads > (int)script_opts.cpu_offset) {
+        script_opts.cpu_offset = pool_opts.max_threads;
+    }
+    if (pool_opts.limit_threads > (int)script_opts.cpu_offset) {
+        script_opts.cpu_offset = pool_opts.limit_threads;
+    }
+
+    if (coro_mode) {
+        logger(LOG_DEBUG, "Iniciando los bucles de eventos...\n");
+        if (pool_opts.affinity != TPOOL_AFFINITY_NONE) {
+            loop_opts.topology = topo;
+        }
+        el = evloop_create(&loop_opts);
+        if (!el) {
+            logger(LOG_ERR, "Error inicializando los bucles de eventos...\n");
+            exit(EXIT_FAILURE);
+        }
+        evloop_get_stats(el, &loop_stats);
+        script_opts.cpu_offset = loop_stats.num_loops;
+        snprintf(message,
+                 sizeof(message),
+                 "Conexiones en corrutinas sobre %zu bucles de eventos\n",
+                 loop_stats.num_loops);
+        logger(LOG_DEBUG, message);
+    } else {
+        logger(LOG_DEBUG, "Iniciando el pool de hilos...\n");
+        tm = tpool_create_opts(&pool_opts);
+        if (!tm) {
+            logger(LOG_ERR, "Error inicializando el pool de hilos...\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    logger(LOG_DEBUG, "Iniciando el pool de hilos de scripts...\n");
+    ts = tpool_create_opts(&script_opts);
+    if (!ts) {
+        logger(LOG_ERR, "Error inicializando el pool de scripts...\n");
         exit(EXIT_FAILURE);
     }
-    if (sigaction(SIGTERM, &sa, NULL)) {
+    if (tm) {
+        log_placement("pool principal", tm);
+    }
+    log_placement("pool de scripts", ts);
+
+    if (admin_port) {
+        if (!admin_bind) {
+            admin_bind = ADMIN_BIND;
+        }
+        if (!metrics_path) {
+            metrics_path = METRICS_PATH;
+        }
+        if (profile_path &&
+            metrics_handler(profile_path, profile_handler, NULL)) {
+            logger(LOG_ERR, "Error registrando el perfilador...\n");
+        }
+        if (metrics_serve(admin_bind, admin_port, metrics_path)) {
+            logger(LOG_ERR, "Error abriendo el puerto de metricas...\n");
+        } else {
+            snprintf(message,
+                     sizeof(message),
+                     "Metricas en %s:%s, path %s\n",
+                     admin_bind,
+                     admin_port,
+                     metrics_path);
+            logger(LOG_INFO, message);
+        }
+    }
+
+    // Establecemos el tratamiento de las seniales. Las atiende el bucle de
+    // accept, sin SA_RESTART para que salga de accept, y el pipe evita
+    // perder una que llegue justo antes de que se bloquee.
+    if (pipe2(sig_pipe, O_CLOEXEC | O_NONBLOCK)) {
+        logger(LOG_ERR, "Error creando el pipe de seniales...\n");
         exit(EXIT_FAILURE);
     }
+    sa.sa_handler = signal_handler;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = 0;
+    if (sigaction(SIGINT, &sa, NULL) || sigaction(SIGTERM, &sa, NULL) ||
+        sigaction(SIGHUP, &sa, NULL) || sigaction(SIGUSR2, &sa, NULL)) {
+        exit(EXIT_FAILURE);
+    }
+    // Un cliente que cierra antes de leer toda la respuesta (por ejemplo tras
+    // un 503) no debe terminar el servidor: send devuelve EPIPE
+    signal(SIGPIPE, SIG_IGN);
 
     logger(LOG_INFO, "Servidor listo para recibir conexiones...\n");
+    // El proceso anterior deja de aceptar en cuanto lo sabe
+    if (ready_fd != -1) {
+        if (write(ready_fd, "1", 1) != 1) {
+            logger(LOG_ERR, "Error avisando al proceso anterior...\n");
+        }
+        close(ready_fd);
+    }
 
-    do {
-        new_fd = socket_accept(sock_fd);
+    while (!stop) {
+        if (reload) {
+            reload = 0;
+            config_reload();
+        }
+        if (upgrade) {
+            upgrade = 0;
+            if (upgrade_pid == -1) {
+                upgrade_start();
+            }
+        }
+        if (!accept_wait()) {
+            continue;
+        }
+        new_fd = socket_accept(sock_fd, &peer);
         if (new_fd == -1) {
             continue;
         }
         // Bloqueamos las seniales mientras se introduce el trabajo en la cola
         pthread_sigmask(SIG_BLOCK, &sa.sa_mask, NULL);
-        // Asignamos un time-out al socket
-        timeout.tv_sec = TIME_OUT_SOCKET;
-        timeout.tv_usec = 0;
-        setsockopt(
-          new_fd, SOL_SOCKET, SO_RCVTIMEO, (char*)&timeout, sizeof(timeout));
-        // Insertamos el trabajo en la cola de trabajos del pool de hilos
-        args = create_thread_args(new_fd, server_root, server_signature);
-        if (!tpool_add_work(tm, thread_routine, args)) {
-            logger(LOG_ERR, "Conexion entrante no procesada...\n");
+        // Insertamos el trabajo en la cola de trabajos del pool de hilos. Si
+        // esta llena no esperamos: se responde 503 para no dejar de aceptar
+        // y que el backlog del kernel no se desborde.
+        // Se cuenta antes de encolarla para que nunca haya mas cerradas
+        // que aceptadas
+        metrics_add(conn_opened, 1);
+        http_conn_open(new_fd);
+        PROBE2(accept, new_fd, conn_id + 1);
+        args = create_thread_args(new_fd, &peer, ++conn_id);
+        if (!args || !submit_connection(args)) {
+            logger(LOG_DEBUG, "Servidor saturado, conexion rechazada...\n");
+            http_overload(new_fd);
+            http_conn_close(new_fd);
             close(new_fd);
+            free(args);
+            metrics_add(conn_closed, 1);
         }
         // Desbloqueamos las seniales
         pthread_sigmask(SIG_UNBLOCK, &sa.sa_mask, NULL);
-    } while (1);
+    }
+
+    server_drain();
+    server_shutdown();
 
     exit(EXIT_SUCCESS);
 }
 
-static void signal_handler()
+static void signal_handler(int sig)
+{
+    int saved = errno;
+
+    if (sig == SIGHUP) {
+        reload = 1;
+    } else if (sig == SIGUSR2) {
+        upgrade = 1;
+    } else {
+        if (stop) {
+            force = 1;
+        }
+        stop = 1;
+    }
+    if (write(sig_pipe[1], "", 1) == -1) {
+        // El pipe esta lleno: ya hay un aviso pendiente
+    }
+    errno = saved;
+}
+
+static bool accept_wait()
+{
+    struct pollfd fds[3];
+    nfds_t num = 2;
+    char buf[64];
+
+    fds[0].fd = sock_fd;
+    fds[0].events = POLLIN;
+    fds[1].fd = sig_pipe[0];
+    fds[1].events = POLLIN;
+    if (upgrade_fd != -1) {
+        fds[2].fd = upgrade_fd;
+        fds[2].events = POLLIN;
+        num = 3;
+    }
+    if (poll(fds, num, -1) == -1) {
+        return false;
+    }
+
+    if (fds[1].revents) {
+        while (read(sig_pipe[0], buf, sizeof(buf)) > 0) {
+        }
+        return false;
+    }
+    if (num == 3 && fds[2].revents) {
+        upgrade_check();
+        return false;
+    }
+
+    // Si durante una actualizacion el proceso nuevo se lleva la conexion,
+    // accept espera a la siguiente o a una senial
+    return fds[0].revents != 0;
+}
+
+static void server_drain()
 {
-    logger(LOG_DEBUG,
-           "Senial recibida, esperando a que finalicen los hilos...\n");
+    int timeout = config_get_int("conexiones", "drain_timeout", DRAIN_TIMEOUT);
+    struct timespec wait = { 0, DRAIN_POLL_MS * 1000000L };
+    uint64_t open_conns;
+    char message[128];
+    int i;
 
+    // Las conexiones que esperan en el socket se pierden salvo que lo
+    // comparta un proceso nuevo (SIGUSR2), que las atiende
     close(sock_fd);
+    sock_fd = -1;
+    http_drain(false);
+    snprintf(message,
+             sizeof(message),
+             "Dejando de aceptar, esperando como mucho %d s a las conexiones "
+             "abiertas...\n",
+             timeout);
+    logger(LOG_INFO, message);
+
+    open_conns = metrics_sum(conn_opened) - metrics_sum(conn_closed);
+    for (i = 0; open_conns && !force && i < timeout * 1000 / DRAIN_POLL_MS;
+         i++) {
+        nanosleep(&wait, NULL);
+        open_conns = metrics_sum(conn_opened) - metrics_sum(conn_closed);
+    }
+    if (!open_conns) {
+        return;
+    }
+
+    snprintf(message,
+             sizeof(message),
+             "Cerrando a la fuerza %lu conexiones...\n",
+             (unsigned long)open_conns);
+    logger(LOG_ERR, message);
+    // Los trabajos que esperan en las colas se atienden enseguida: su
+    // socket ya no admite nada
+    http_drain(true);
+    for (i = 0; open_conns && i < DRAIN_FORCE_MS / DRAIN_POLL_MS; i++) {
+        nanosleep(&wait, NULL);
+        open_conns = metrics_sum(conn_opened) - metrics_sum(conn_closed);
+    }
+}
+
+static void server_shutdown()
+{
+    tpool_stats_t stats;
+    evloop_stats_t loop_stats;
+    alog_stats_t log_stats;
+    char message[256];
+
+    logger(LOG_DEBUG, "Esperando a que finalicen los hilos...\n");
+
+    // Las funciones de consulta leen los pools que se liberan a continuacion.
+    // Un perfil en curso ocuparia el puerto hasta PROFILER_MAX_SECONDS.
+    profiler_enable(false);
+    metrics_stop();
+    if (el) {
+        evloop_get_stats(el, &loop_stats);
+        snprintf(message,
+                 sizeof(message),
+                 "Bucles de eventos: %zu bucles, %zu conexiones atendidas, "
+                 "maximo %zu a la vez, %zu pilas, %zu esperas expiradas, %zu "
+                 "rechazadas\n",
+                 loop_stats.num_loops,
+                 loop_stats.completed,
+                 loop_stats.max_active,
+                 loop_stats.stacks,
+                 loop_stats.timeouts,
+                 loop_stats.rejected);
+        logger(LOG_DEBUG, message);
+    }
+    if (tm) {
+        tpool_get_stats(tm, &stats);
+        snprintf(message,
+                 sizeof(message),
+                 "Pool principal: %zu hilos (%zu-%zu), %zu creados, %zu "
+                 "retirados, cola maxima %zu/%zu, %zu rechazadas con cola "
+                 "llena, %zu descartadas por CoDel\n",
+                 stats.num_threads,
+                 stats.min_threads,
+                 stats.max_threads,
+                 stats.grown,
+                 stats.retired,
+                 stats.max_queued,
+                 stats.queue_size,
+                 stats.rejected,
+                 stats.dropped);
+        logger(LOG_DEBUG, message);
+    }
+    tpool_get_stats(ts, &stats);
+    snprintf(message,
+             sizeof(message),
+             "Pool de scripts: %zu completados, %zu rechazados, cola maxima "
+             "%zu/%zu\n",
+             stats.completed,
+             stats.rejected,
+             stats.max_queued,
+             stats.queue_size);
+    logger(LOG_DEBUG, message);
+    // Los scripts en curso terminan; los que siguen en la cola se descartan y
+    // sus sockets se cierran al salir del proceso
+    tpool_destroy(ts);
+    evloop_destroy(el);
     tpool_destroy(tm);
+    topology_destroy(topo);
+    http_destroy();
     destroy_ini(config.conf);
     cleanup_readini(config.ri);
+    if (async_log) {
+        alog_get_stats(&log_stats);
+        snprintf(message,
+                 sizeof(message),
+                 "Log: %zu mensajes escritos, %zu descartados, %zu buffers\n",
+                 log_stats.written,
+                 log_stats.dropped,
+                 log_stats.rings);
+        logger(LOG_DEBUG, message);
+    }
     logger(LOG_INFO,
            "Hilos del servidor finalizados, cerrando servidor...\n");
+    metrics_destroy();
+    // Escribimos lo que quede pendiente
+    acclog_destroy();
+    trace_destroy();
+    capture_destroy();
+    alog_destroy();
 
     exit(EXIT_SUCCESS);
 }
 
+static void config_reload()
+{
+    struct config_s old = config;
+
+    logger(LOG_INFO, "Recargando la configuracion...\n");
+    config.ri = NULL;
+    config.conf = read_ini(&config.ri, "server.ini");
+    if (config.conf && config_apply(&old)) {
+        // Los modulos copian lo que usan, asi que la anterior ya no se usa
+        destroy_ini(old.conf);
+        cleanup_readini(old.ri);
+        logger(LOG_INFO, "Configuracion recargada...\n");
+    } else {
+        if (config.conf) {
+            destroy_ini(config.conf);
+        }
+        cleanup_readini(config.ri);
+        config = old;
+        logger(LOG_ERR,
+               "Error recargando la configuracion, se mantiene la "
+               "anterior...\n");
+    }
+}
+
+static bool config_apply(struct config_s* old)
+{
+    tpool_opts_t pool_opts = { 0 };
+    tpool_opts_t script_opts = { 0 };
+    http_config_t http_conf = { 0 };
+    char* root = NULL;
+    char* signature = NULL;
+    char* before = NULL;
+    char* after = NULL;
+    char message[MAX_LOG_MESSAGE];
+    size_t i;
+
+    // Caben en los paths que arma el modulo http
+    root = ini_get_value(config.conf, "configuracion", "server_root");
+    signature = ini_get_value(config.conf, "configuracion", "server_signature");
+    if (!root || strlen(root) >= MAX_SERVER_ROOT || !signature ||
+        strlen(signature) >= MAX_SERVER_SIGNATURE) {
+        logger(LOG_ERR, "Falta server_root o server_signature o es demasiado "
+                        "largo...\n");
+        return false;
+    }
+
+    config_get_http(&http_conf);
+    if (http_reload(&http_conf)) {
+        free(http_conf.routes);
+        return false;
+    }
+    free(http_conf.routes);
+
+    // Los pools crecen o menguan sin parar; el resto de sus opciones son de
+    // arranque
+    config_get_pools(&pool_opts, &script_opts);
+    if (tm && !tpool_resize(tm, pool_opts.num_threads, pool_opts.max_threads)) {
+        logger(LOG_ERR,
+               "El pool principal no puede pasar de thread_limit hilos, no "
+               "se cambia...\n");
+    }
+    if (!tpool_resize(ts, script_opts.num_threads, 0)) {
+        logger(LOG_ERR,
+               "El pool de scripts no puede pasar de script_thread_limit "
+               "hilos, no se cambia...\n");
+    }
+
+    for (i = 0; i < sizeof(restart_keys) / sizeof(restart_keys[0]); i++) {
+        before = ini_get_value(
+          old->conf, (char*)restart_keys[i][0], (char*)restart_keys[i][1]);
+        after = ini_get_value(
+          config.conf, (char*)restart_keys[i][0], (char*)restart_keys[i][1]);
+        if (before == after ||
+            (before && after && !strcmp(before, after))) {
+            continue;
+        }
+        snprintf(message,
+                 sizeof(message),
+                 "[%s] %s ha cambiado, no se aplica hasta reiniciar...\n",
+                 restart_keys[i][0],
+                 restart_keys[i][1]);
+        logger(LOG_ERR, message);
+    }
+
+    return true;
+}
+
+static int upgrade_inherit(int* ready_fd)
+{
+    char* value = getenv(LISTEN_FD_ENV);
+    int fd = value ? atoi(value) : -1;
+    int listening = 0;
+    socklen_t len = sizeof(listening);
+
+    value = getenv(READY_FD_ENV);
+    *ready_fd = value ? atoi(value) : -1;
+    unsetenv(LISTEN_FD_ENV);
+    unsetenv(READY_FD_ENV);
+
+    // Los scripts no deben heredarlos
+    if (*ready_fd != -1 && fcntl(*ready_fd, F_SETFD, FD_CLOEXEC) == -1) {
+        *ready_fd = -1;
+    }
+    if (fd == -1 ||
+        getsockopt(fd, SOL_SOCKET, SO_ACCEPTCONN, &listening, &len) ||
+        !listening || fcntl(fd, F_SETFD, FD_CLOEXEC) == -1) {
+        return -1;
+    }
+
+    return fd;
+}
+
+static void upgrade_start()
+{
+    char listen_env[32], ready_env[32];
+    char* argv[2];
+    char** envp = NULL;
+    char message[MAX_LOG_MESSAGE];
+    size_t i, n;
+    int fds[2];
+    pid_t pid;
+
+    if (!exe_path[0]) {
+        logger(LOG_ERR, "Ejecutable desconocido, no se puede actualizar...\n");
+        return;
+    }
+    if (pipe2(fds, O_CLOEXEC)) {
+        logger(LOG_ERR, "Error creando el aviso de la actualizacion...\n");
+        return;
+    }
+
+    // Todo lo que necesita el hijo se prepara antes de fork: despues solo
+    // puede usar funciones seguras ante seniales
+    for (n = 0; environ[n]; n++) {
+    }
+    envp = (char**)malloc((n + 3) * sizeof(char*));
+    if (!envp) {
+        close(fds[0]);
+        close(fds[1]);
+        return;
+    }
+    for (i = 0; i < n; i++) {
+        envp[i] = environ[i];
+    }
+    snprintf(listen_env, sizeof(listen_env), LISTEN_FD_ENV "=%d", sock_fd);
+    snprintf(ready_env, sizeof(ready_env), READY_FD_ENV "=%d", fds[1]);
+    envp[n] = listen_env;
+    envp[n + 1] = ready_env;
+    envp[n + 2] = NULL;
+    argv[0] = exe_path;
+    argv[1] = NULL;
+
+    // El puerto de administracion lo abre el proceso nuevo. Se corta el
+    // perfil en curso para no dejar de aceptar mientras termina.
+    profiler_enable(false);
+    metrics_stop();
+    pid = fork();
+    if (pid == 0) {
+        upgrade_exec(argv, envp, fds[1]);
+    }
+    free(envp);
+    close(fds[1]);
+    if (pid == -1) {
+        close(fds[0]);
+        logger(LOG_ERR, "Error lanzando el proceso nuevo...\n");
+        metrics_restart();
+        return;
+    }
+
+    upgrade_pid = pid;
+    upgrade_fd = fds[0];
+    snprintf(message,
+             sizeof(message),
+             "Actualizando: lanzado %.512s (pid %d), esperando a que este "
+             "listo...\n",
+             exe_path,
+             (int)pid);
+    logger(LOG_INFO, message);
+}
+
+static void upgrade_exec(char** argv, char** envp, int ready_fd)
+{
+    int low = sock_fd < ready_fd ? sock_fd : ready_fd;
+    int high = sock_fd < ready_fd ? ready_fd : sock_fd;
+
+    // Ni conexiones ni pipes de scripts abiertos en otros hilos pasan al
+    // proceso nuevo
+    fcntl(sock_fd, F_SETFD, 0);
+    fcntl(ready_fd, F_SETFD, 0);
+    if (low > 3) {
+        close_range(3, low - 1, 0);
+    }
+    if (high > low + 1) {
+        close_range(low + 1, high - 1, 0);
+    }
+    close_range(high + 1, ~0U, 0);
+
+    execve(argv[0], argv, envp);
+    _exit(EXIT_FAILURE);
+}
+
+static void upgrade_check()
+{
+    char ready;
+
+    if (read(upgrade_fd, &ready, 1) == 1) {
+        close(upgrade_fd);
+        upgrade_fd = -1;
+        logger(LOG_INFO, "Proceso nuevo listo, dejando de aceptar...\n");
+        stop = 1;
+        return;
+    }
+
+    // Ha terminado sin llegar a estar listo (el aviso se cierra al salir)
+    close(upgrade_fd);
+    upgrade_fd = -1;
+    waitpid(upgrade_pid, NULL, 0);
+    upgrade_pid = -1;
+    logger(LOG_ERR,
+           "El proceso nuevo ha terminado sin estar listo, se sigue con "
+           "este...\n");
+    metrics_restart();
+}
+
+static void metrics_restart()
+{
+    char* admin_port = ini_get_value(config.conf, "metricas", "admin_port");
+    char* admin_bind = ini_get_value(config.conf, "metricas", "admin_bind");
+    char* metrics_path = ini_get_value(config.conf, "metricas", "path");
+
+    profiler_enable(true);
+    if (admin_port &&
+        metrics_serve(admin_bind ? admin_bind : ADMIN_BIND,
+                      admin_port,
+                      metrics_path ? metrics_path : METRICS_PATH)) {
+        logger(LOG_ERR, "Error abriendo el puerto de metricas...\n");
+    }
+}
+
 static void thread_routine(void* args)
 {
     int status;
-    struct thread_arg arg = *((struct thread_arg*)args);
+    struct thread_arg* arg = (struct thread_arg*)args;
+    tpool_stats_t stats;
+    char message[128];
 
-    free(args);
-
-    logger(LOG_INFO, "Conexion entrante recibida...\n");
+    if (!arg->resumed) {
+        logger(LOG_INFO, "Conexion entrante recibida...\n");
+    }
+    arg->script = NULL;
 
-    status = http(arg.new_fd, arg.server_root, arg.server_signature);
-    if (status == -1) {
+    status = http(arg->new_fd, &arg->conn, arg->resumed, &arg->script);
+    if (status == HTTP_DEFERRED) {
+        // La peticion ejecuta un script, la procesa el pool de scripts
+        if (tpool_try_add_work(ts, script_routine, arg)) {
+            return;
+        }
+        tpool_get_stats(ts, &stats);
+        snprintf(message,
+                 sizeof(message),
+                 "Cola de scripts llena (%zu/%zu), peticion rechazada...\n",
+                 stats.queued,
+                 stats.queue_size);
+        logger(LOG_ERR, message);
+        http_script_reject(arg->script);
+    } else if (status == -1) {
         logger(LOG_ERR,
                "Error interno del servidor enviando los datos a través del "
                "socket...\n");
     }
-    close(arg.new_fd);
+
+    close_connection(arg);
+}
+
+static void script_routine(void* args)
+{
+    struct thread_arg* arg = (struct thread_arg*)args;
+
+    // Si la conexion sigue abierta vuelve al pool principal para atender el
+    // resto de peticiones. Si no hay sitio en su cola se cierra.
+    arg->resumed = true;
+    if (!http_script_run(arg->script) && submit_connection(arg)) {
+        return;
+    }
+
+    close_connection(arg);
+}
+
+static void shed_routine(void* args)
+{
+    struct thread_arg* arg = (struct thread_arg*)args;
+
+    // Una conexion que vuelve del pool de scripts ya ha recibido su respuesta:
+    // un 503 se leeria como respuesta a una peticion que no existe, se cierra
+    if (!arg->resumed) {
+        http_overload(arg->new_fd);
+    }
+    close_connection(arg);
+}
+
+static bool submit_connection(struct thread_arg* arg)
+{
+    arg->conn.queued = trace_enabled() ? trace_now() : 0;
+    if (!el) {
+        return tpool_try_add_work(tm, thread_routine, arg);
+    }
+
+    // La rutina es la misma: en una corrutina recv y send ceden el hilo al
+    // bucle en lugar de bloquearlo
+    return evloop_submit(el, thread_routine, arg);
+}
+
+static void close_connection(struct thread_arg* arg)
+{
+    http_conn_close(arg->new_fd);
+    // En una corrutina el socket se retira del bucle antes de cerrarlo
+    evloop_forget(arg->new_fd);
+    close(arg->new_fd);
+    free(arg);
+    metrics_add(conn_closed, 1);
 
     logger(LOG_INFO, "Conexion cerrada...\n");
 }
 
+static int config_get_int(char* section, char* key, int def)
+{
+    char* value = ini_get_value(config.conf, section, key);
+
+    if (!value) {
+        return def;
+    }
+
+    return atoi(value);
+}
+
+static void config_get_pools(tpool_opts_t* pool_opts,
+                             tpool_opts_t* script_opts)
+{
+    int num_threads = config_get_int("inicializacion", "num_threads", 0);
+
+    pool_opts->num_threads = num_threads;
+    pool_opts->max_threads =
+      config_get_int("inicializacion", "max_threads", num_threads);
+    pool_opts->limit_threads =
+      config_get_int("inicializacion", "thread_limit", 0);
+    if (pool_opts->limit_threads <= 0) {
+        pool_opts->limit_threads = THREAD_LIMIT * pool_opts->max_threads;
+    }
+    pool_opts->target_ms = config_get_int("inicializacion", "queue_target", 0);
+    pool_opts->idle_ms = config_get_int("inicializacion", "thread_idle", 0);
+    pool_opts->queue_size = config_get_int("inicializacion", "queue_size", 0);
+    pool_opts->affinity = config_get_affinity("inicializacion", "affinity");
+    pool_opts->codel_target_ms =
+      config_get_int("inicializacion", "codel_target", 0);
+    pool_opts->codel_interval_ms =
+      config_get_int("inicializacion", "codel_interval", 0);
+    pool_opts->shed = shed_routine;
+    script_opts->num_threads =
+      config_get_int("inicializacion", "script_threads", num_threads / 2);
+    script_opts->limit_threads =
+      config_get_int("inicializacion", "script_thread_limit", 0);
+    if (script_opts->limit_threads <= 0) {
+        script_opts->limit_threads = THREAD_LIMIT * script_opts->num_threads;
+    }
+    script_opts->queue_size =
+      config_get_int("inicializacion", "script_queue", num_threads);
+}
+
+static void config_get_http(http_config_t* http_conf)
+{
+    http_conf->server_root =
+      ini_get_value(config.conf, "configuracion", "server_root");
+    http_conf->server_signature =
+      ini_get_value(config.conf, "configuracion", "server_signature");
+    http_conf->script_timeout = config_get_int("scripts", "timeout", 0);
+    http_conf->script_cpu_limit = config_get_int("scripts", "cpu_limit", 0);
+    http_conf->script_mem_limit = config_get_int("scripts", "mem_limit", 0);
+    http_conf->header_timeout =
+      config_get_int("conexiones", "header_timeout", HEADER_TIMEOUT);
+    http_conf->body_timeout =
+      config_get_int("conexiones", "body_timeout", BODY_TIMEOUT);
+    http_conf->write_timeout =
+      config_get_int("conexiones", "write_timeout", WRITE_TIMEOUT);
+    http_conf->keepalive_timeout =
+      config_get_int("conexiones", "keepalive_timeout", KEEPALIVE_TIMEOUT);
+    config_get_routes(http_conf);
+}
+
+static tpool_affinity_t config_get_affinity(char* section, char* key)
+{
+    char* value = ini_get_value(config.conf, section, key);
+
+    if (value && !strcmp(value, "core")) {
+        return TPOOL_AFFINITY_CORE;
+    }
+    if (value && !strcmp(value, "node")) {
+        return TPOOL_AFFINITY_NODE;
+    }
+
+    return TPOOL_AFFINITY_NONE;
+}
+
+static bool config_get_io_mode(char* section, char* key)
+{
+    char* value = ini_get_value(config.conf, section, key);
+
+    return value && !strcmp(value, "coro");
+}
+
+static void log_placement(char* name, tpool_t* pool)
+{
+    char message[MAX_LOG_MESSAGE];
+    size_t i, len;
+    int cpu, node;
+
+    len = snprintf(message, sizeof(message), "Colocacion del %s:", name);
+    for (i = 0; tpool_get_placement(pool, i, &cpu, &node) &&
+                len < sizeof(message);
+         i++) {
+        if (node == -1) {
+            len += snprintf(message + len, sizeof(message) - len, " libre");
+            break;
+        } else if (cpu == -1) {
+            len += snprintf(
+              message + len, sizeof(message) - len, " h%zu=n%d", i, node);
+        } else {
+            len += snprintf(message + len,
+                            sizeof(message) - len,
+                            " h%zu=cpu%d/n%d",
+                            i,
+                            cpu,
+                            node);
+        }
+    }
+    if (len < sizeof(message) - 1) {
+        message[len++] = '\n';
+        message[len] = '\0';
+    } else {
+        message[sizeof(message) - 2] = '\n';
+    }
+    logger(LOG_DEBUG, message);
+}
+
+static void config_get_routes(http_config_t* http_conf)
+{
+    int i, j;
+    struct section* section = NULL;
+
+    for (i = 0; i < config.conf->num_sections; i++) {
+        if (config.conf->sections[i]->name &&
+            !strcmp(config.conf->sections[i]->name, "script_timeouts")) {
+            section = config.conf->sections[i];
+            break;
+        }
+    }
+    if (!section || !section->num_configs) {
+        return;
+    }
+
+    http_conf->routes =
+      (http_route_t*)calloc(section->num_configs, sizeof(http_route_t));
+    if (!http_conf->routes) {
+        return;
+    }
+    for (j = 0; j < section->num_configs; j++) {
+        http_conf->routes[j].prefix = section->configs[j]->key;
+        http_conf->routes[j].timeout = atoi(section->configs[j]->value);
+    }
+    http_conf->num_routes = section->num_configs;
+}
+
 static void daemon_process()
 {
     int fd0, fd1, fd2;
@@ -281,6 +1428,13 @@ static void daemon_process()
 
 static void logger(int priority, char* message)
 {
+    if (async_log) {
+        if (priority != LOG_DEBUG || debug) {
+            alog_write(priority, message);
+        }
+        return;
+    }
+
     if (daemon_proc) {
         syslog(priority, "%s", message);
     } else {
@@ -299,9 +1453,145 @@ static void logger(int priority, char* message)
     }
 }
 
+static void collect_metrics(metrics_out_t* out, void* arg)
+{
+    tpool_stats_t pools[2];
+    evloop_stats_t loops;
+    alog_stats_t log_stats;
+    const char* labels[2] = { "pool=\"main\"", "pool=\"scripts\"" };
+    uint64_t closed;
+    size_t i, j, first;
+
+    (void)arg;
+
+    // Primero las cerradas: las aceptadas no pueden quedar por debajo
+    closed = metrics_sum(conn_closed);
+    metrics_emit(out,
+                 METRICS_GAUGE,
+                 "server_connections_active",
+                 "Conexiones abiertas",
+                 NULL,
+                 (double)(metrics_sum(conn_opened) - closed));
+
+    // Con corrutinas no hay pool principal
+    first = tm ? 0 : 1;
+    if (tm) {
+        tpool_get_stats(tm, &pools[0]);
+    }
+    tpool_get_stats(ts, &pools[1]);
+    for (i = 0; i < sizeof(pool_metrics) / sizeof(pool_metrics[0]); i++) {
+        for (j = first; j < 2; j++) {
+            metrics_emit(
+              out,
+              pool_metrics[i].type,
+              pool_metrics[i].name,
+              pool_metrics[i].help,
+              labels[j],
+              (double)*(size_t*)((char*)&pools[j] + pool_metrics[i].offset));
+        }
+    }
+
+    if (el) {
+        evloop_get_stats(el, &loops);
+        for (i = 0; i < sizeof(loop_metrics) / sizeof(loop_metrics[0]); i++) {
+            metrics_emit(
+              out,
+              loop_metrics[i].type,
+              loop_metrics[i].name,
+              loop_metrics[i].help,
+              NULL,
+              (double)*(size_t*)((char*)&loops + loop_metrics[i].offset));
+        }
+    }
+
+    if (async_log) {
+        alog_get_stats(&log_stats);
+        metrics_emit(out,
+                     METRICS_COUNTER,
+                     "log_written_total",
+                     "Mensajes de log escritos",
+                     NULL,
+                     (double)log_stats.written);
+        metrics_emit(out,
+                     METRICS_COUNTER,
+                     "log_dropped_total",
+                     "Mensajes de log descartados con el buffer lleno",
+                     NULL,
+                     (double)log_stats.dropped);
+    }
+}
+
+static int profile_handler(const char* query,
+                           char** body,
+                           size_t* len,
+                           void* arg)
+{
+    unsigned seconds = PROFILE_SECONDS, hz = PROFILE_HZ;
+    profiler_stats_t stats;
+    char message[256];
+    const char* param;
+
+    (void)arg;
+
+    for (param = query; *param; param += strcspn(param, "&")) {
+        if (*param == '&') {
+            param++;
+        }
+        if (!strncmp(param, "seconds=", 8)) {
+            seconds = (unsigned)strtoul(param + 8, NULL, 10);
+        } else if (!strncmp(param, "hz=", 3)) {
+            hz = (unsigned)strtoul(param + 3, NULL, 10);
+        }
+    }
+    if (!seconds || seconds > PROFILER_MAX_SECONDS || !hz ||
+        hz > PROFILER_MAX_FREQUENCY) {
+        snprintf(message,
+                 sizeof(message),
+                 "seconds debe estar entre 1 y %d y hz entre 1 y %d\n",
+                 PROFILER_MAX_SECONDS,
+                 PROFILER_MAX_FREQUENCY);
+        *body = strdup(message);
+        *len = *body ? strlen(*body) : 0;
+        return 400;
+    }
+
+    if (profiler_run(seconds, hz, body, len, &stats)) {
+        if (errno == EBUSY) {
+            snprintf(message, sizeof(message), "Ya hay un perfil en curso\n");
+        } else if (errno == ECANCELED) {
+            snprintf(message,
+                     sizeof(message),
+                     "Perfil cortado, el servidor se esta cerrando\n");
+        } else {
+            // Con perf_event_paranoid > 2 no se permite ni el propio proceso
+            snprintf(message,
+                     sizeof(message),
+                     "No se puede muestrear: %s "
+                     "(ver /proc/sys/kernel/perf_event_paranoid)\n",
+                     strerror(errno));
+        }
+        *body = strdup(message);
+        *len = *body ? strlen(*body) : 0;
+        return 503;
+    }
+
+    snprintf(message,
+             sizeof(message),
+             "Perfil de %u s a %u Hz: %zu hilos, %llu muestras, %llu "
+             "perdidas\n",
+             seconds,
+             hz,
+             stats.threads,
+             (unsigned long long)stats.samples,
+             (unsigned long long)stats.lost);
+    logger(LOG_INFO, message);
+
+    return 200;
+}
+
 static struct thread_arg* create_thread_args(int new_fd,
-                                             char* server_root,
-                                             char* server_signature)
+                                             struct sockaddr_in* peer,
+                                             uint64_t id)
 {
     struct thread_arg* args = NULL;
 
@@ -311,8 +1601,11 @@ static struct thread_arg* create_thread_args(int new_fd,
     }
 
     args->new_fd = new_fd;
-    strcpy(args->server_root, server_root);
-    strcpy(args->server_signature, server_signature);
+    args->conn.peer = *peer;
+    args->conn.id = id;
+    args->conn.queued = 0;
+    args->script = NULL;
+    args->resumed = false;
 
     return args;
 }
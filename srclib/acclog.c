@@ -0,0 +1,344 @@
+/*****************************************************************************
+ * ARCHIVO: acclog.c
+ * DESCRIPCION: Implementacion del log de accesos binario con mmap.
+ *
+ * NOTA: El fichero se reserva con ftruncate a su tamanio maximo y se
+ * proyecta entero con MAP_SHARED, asi que un registro esta en la cache de
+ * paginas del kernel en cuanto se copia: no hay que vaciar nada y otro
+ * proceso puede leer el fichero mientras se escribe. Los hilos reservan
+ * bloques de ACCLOG_CHUNK registros bajo un mutex y despues escriben sin
+ * sincronizacion.
+ *
+ * Cada bloque reservado cuenta como una referencia a su fichero. Al rotar,
+ * el fichero lleno se retira pero no se deshace su proyeccion hasta que
+ * todos los hilos han dejado sus bloques, cosa que hacen en su siguiente
+ * escritura o al terminar.
+ *
+ * FECHA CREACION: 19 Octubre de 2026
+ * AUTORES: Javier Mateos Najari, Adrian Sebastian Gil
+ *****************************************************************************/
+#include <fcntl.h>     // open
+#include <pthread.h>   // pthread_mutex_lock
+#include <stdatomic.h> // atomic_bool
+#include <stdlib.h>    // calloc
+#include <string.h>    // memcpy
+#include <sys/mman.h>  // mmap
+#include <time.h>      // clock_gettime
+#include <unistd.h>    // ftruncate
+
+#include "acclog.h"
+
+#define ACCLOG_MAX_SIZE (64 * 1024 * 1024) // Tamanio por defecto
+#define ACCLOG_KEEP 4                      // Rotados por defecto
+#define ACCLOG_CHUNK 64                    // Registros de un bloque
+#define ACCLOG_CHUNK_SIZE (ACCLOG_CHUNK * ACCLOG_RECORD_SIZE)
+#define ACCLOG_MAX_PATH 4096               // Longitud maxima de una ruta
+
+_Static_assert(sizeof(acclog_record_t) == ACCLOG_RECORD_SIZE,
+               "acclog_record_t debe ocupar ACCLOG_RECORD_SIZE bytes");
+_Static_assert(sizeof(acclog_header_t) == ACCLOG_RECORD_SIZE,
+               "acclog_header_t debe ocupar ACCLOG_RECORD_SIZE bytes");
+
+// Fichero proyectado
+typedef struct acclog_file {
+    int fd;                   // Descriptor del fichero
+    char* map;                // Proyeccion del fichero entero
+    size_t size;              // Tamanio del fichero y de la proyeccion
+    size_t used;              // Bytes reservados
+    size_t refs;              // Bloques reservados por hilos
+    atomic_bool retired;      // Se ha rotado
+    struct acclog_file* next; // Siguiente fichero en uso
+} acclog_file_t;
+
+// Bloque de registros de un hilo
+typedef struct acclog_chunk {
+    acclog_file_t* file;  // Fichero del bloque (NULL: ninguno)
+    acclog_record_t* pos; // Siguiente registro libre
+    acclog_record_t* end; // Fin del bloque
+} acclog_chunk_t;
+
+// Estado del log de accesos
+typedef struct acclog {
+    pthread_mutex_t mutex;   // Protege la reserva de bloques y la rotacion
+    pthread_key_t key;       // Suelta el bloque al terminar un hilo
+    atomic_bool running;     // Se aceptan registros
+    char path[ACCLOG_MAX_PATH]; // Fichero actual
+    size_t max_size;         // Tamanio de cada fichero
+    int keep;                // Ficheros rotados que se conservan
+    acclog_file_t* current;  // Fichero en el que se reservan bloques
+    acclog_file_t* files;    // Ficheros con bloques reservados
+} acclog_t;
+
+static acclog_t state = { .mutex = PTHREAD_MUTEX_INITIALIZER };
+
+// Bloque del hilo
+static _Thread_local acclog_chunk_t acclog_self = { NULL, NULL, NULL };
+
+/*******************************************************************************
+ * FUNCION: static acclog_file_t* acclog_open()
+ * DESCRIPCION: Rota los ficheros existentes y crea, reserva y proyecta uno
+ *              nuevo con su cabecera.
+ * ARGS_OUT: acclog_file_t* - fichero o NULL en caso de error.
+ ******************************************************************************/
+static acclog_file_t* acclog_open();
+
+/*******************************************************************************
+ * FUNCION: static void acclog_close(acclog_file_t* file, size_t size)
+ * ARGS_IN: acclog_file_t* file - fichero sin bloques reservados.
+ *          size_t size - tamanio final del fichero.
+ * DESCRIPCION: Deshace la proyeccion, recorta y cierra el fichero y lo saca
+ *              de la lista.
+ ******************************************************************************/
+static void acclog_close(acclog_file_t* file, size_t size);
+
+/*******************************************************************************
+ * FUNCION: static void acclog_put(acclog_chunk_t* chunk)
+ * ARGS_IN: acclog_chunk_t* chunk - bloque de un hilo.
+ * DESCRIPCION: Suelta el bloque. Si era la ultima referencia a un fichero
+ *              rotado, lo cierra. Se llama con el mutex tomado.
+ ******************************************************************************/
+static void acclog_put(acclog_chunk_t* chunk);
+
+/*******************************************************************************
+ * FUNCION: static bool acclog_get(acclog_chunk_t* chunk)
+ * ARGS_IN: acclog_chunk_t* chunk - bloque de un hilo.
+ * DESCRIPCION: Suelta el bloque y reserva otro, rotando si el fichero esta
+ *              lleno.
+ * ARGS_OUT: bool - true si hay bloque.
+ ******************************************************************************/
+static bool acclog_get(acclog_chunk_t* chunk);
+
+/*******************************************************************************
+ * FUNCION: static void acclog_release(void* arg)
+ * ARGS_IN: void* arg - bloque (acclog_chunk_t*) del hilo que termina.
+ * DESCRIPCION: Suelta el bloque de un hilo que termina.
+ ******************************************************************************/
+static void acclog_release(void* arg);
+
+static acclog_file_t* acclog_open()
+{
+    acclog_file_t* file = NULL;
+    acclog_header_t* header = NULL;
+    char from[ACCLOG_MAX_PATH + 16], to[ACCLOG_MAX_PATH + 16];
+    struct timespec ts;
+    int i;
+
+    // path.(keep-1) -> path.keep, ..., path -> path.1
+    for (i = state.keep; i > 0; i--) {
+        if (i > 1) {
+            snprintf(from, sizeof(from), "%s.%d", state.path, i - 1);
+        } else {
+            snprintf(from, sizeof(from), "%s", state.path);
+        }
+        snprintf(to, sizeof(to), "%s.%d", state.path, i);
+        rename(from, to);
+    }
+
+    file = (acclog_file_t*)calloc(1, sizeof(acclog_file_t));
+    if (!file) {
+        return NULL;
+    }
+    file->size = state.max_size;
+    file->used = ACCLOG_RECORD_SIZE;
+    atomic_init(&file->retired, false);
+
+    file->fd = open(state.path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (file->fd == -1) {
+        free(file);
+        return NULL;
+    }
+    if (ftruncate(file->fd, (off_t)file->size)) {
+        close(file->fd);
+        free(file);
+        return NULL;
+    }
+    file->map = (char*)mmap(
+      NULL, file->size, PROT_READ | PROT_WRITE, MAP_SHARED, file->fd, 0);
+    if (file->map == MAP_FAILED) {
+        close(file->fd);
+        free(file);
+        return NULL;
+    }
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    header = (acclog_header_t*)file->map;
+    memcpy(header->magic, ACCLOG_MAGIC, sizeof(header->magic));
+    header->record_size = ACCLOG_RECORD_SIZE;
+    header->pid = (uint32_t)getpid();
+    header->created_us =
+      (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+
+    file->next = state.files;
+    state.files = file;
+
+    return file;
+}
+
+static void acclog_close(acclog_file_t* file, size_t size)
+{
+    acclog_file_t** link = NULL;
+
+    for (link = &state.files; *link; link = &(*link)->next) {
+        if (*link == file) {
+            *link = file->next;
+            break;
+        }
+    }
+
+    munmap(file->map, file->size);
+    if (size < file->size && ftruncate(file->fd, (off_t)size)) {
+        // Queda con huecos a cero al final, que el lector ignora
+    }
+    close(file->fd);
+    free(file);
+}
+
+static void acclog_put(acclog_chunk_t* chunk)
+{
+    acclog_file_t* file = chunk->file;
+
+    if (!file) {
+        return;
+    }
+
+    chunk->file = NULL;
+    chunk->pos = NULL;
+    chunk->end = NULL;
+    file->refs--;
+    if (!file->refs &&
+        atomic_load_explicit(&file->retired, memory_order_relaxed)) {
+        acclog_close(file, file->used);
+    }
+}
+
+static bool acclog_get(acclog_chunk_t* chunk)
+{
+    acclog_file_t* file = NULL;
+    bool first = !chunk->file;
+
+    pthread_mutex_lock(&state.mutex);
+    acclog_put(chunk);
+
+    file = state.current;
+    if (file && file->used + ACCLOG_CHUNK_SIZE > file->size) {
+        // Fichero lleno: los hilos que tienen bloques en el lo sueltan en su
+        // siguiente escritura
+        atomic_store_explicit(&file->retired, true, memory_order_relaxed);
+        state.current = acclog_open();
+        if (!file->refs) {
+            acclog_close(file, file->used);
+        }
+        file = state.current;
+    }
+    if (!file) {
+        pthread_mutex_unlock(&state.mutex);
+        return false;
+    }
+
+    chunk->file = file;
+    chunk->pos = (acclog_record_t*)(file->map + file->used);
+    chunk->end = chunk->pos + ACCLOG_CHUNK;
+    file->used += ACCLOG_CHUNK_SIZE;
+    file->refs++;
+    pthread_mutex_unlock(&state.mutex);
+
+    if (first) {
+        pthread_setspecific(state.key, chunk);
+    }
+
+    return true;
+}
+
+static void acclog_release(void* arg)
+{
+    pthread_mutex_lock(&state.mutex);
+    acclog_put((acclog_chunk_t*)arg);
+    pthread_mutex_unlock(&state.mutex);
+}
+
+int acclog_init(const acclog_opts_t* opts)
+{
+    size_t size;
+
+    if (!opts || !opts->path || strlen(opts->path) >= sizeof(state.path)) {
+        return -1;
+    }
+
+    snprintf(state.path, sizeof(state.path), "%s", opts->path);
+    state.keep = opts->keep > 0 ? opts->keep : ACCLOG_KEEP;
+    // Cabecera y un numero entero de bloques
+    size = opts->max_size ? opts->max_size : ACCLOG_MAX_SIZE;
+    if (size < ACCLOG_RECORD_SIZE + ACCLOG_CHUNK_SIZE) {
+        size = ACCLOG_RECORD_SIZE + ACCLOG_CHUNK_SIZE;
+    }
+    state.max_size = ACCLOG_RECORD_SIZE +
+                     (size - ACCLOG_RECORD_SIZE) / ACCLOG_CHUNK_SIZE *
+                       ACCLOG_CHUNK_SIZE;
+    state.files = NULL;
+
+    if (pthread_key_create(&state.key, acclog_release)) {
+        return -1;
+    }
+    pthread_mutex_lock(&state.mutex);
+    state.current = acclog_open();
+    pthread_mutex_unlock(&state.mutex);
+    if (!state.current) {
+        pthread_key_delete(state.key);
+        return -1;
+    }
+    atomic_store_explicit(&state.running, true, memory_order_release);
+
+    return 0;
+}
+
+void acclog_destroy()
+{
+    acclog_file_t* file = NULL;
+
+    if (!atomic_load_explicit(&state.running, memory_order_acquire)) {
+        return;
+    }
+    atomic_store_explicit(&state.running, false, memory_order_relaxed);
+    pthread_key_delete(state.key);
+
+    // Los bloques sin llenar del fichero actual quedan como huecos
+    pthread_mutex_lock(&state.mutex);
+    while ((file = state.files)) {
+        acclog_close(file, file->used);
+    }
+    state.current = NULL;
+    pthread_mutex_unlock(&state.mutex);
+
+    acclog_self.file = NULL;
+    acclog_self.pos = NULL;
+    acclog_self.end = NULL;
+}
+
+bool acclog_write(const acclog_record_t* record)
+{
+    acclog_chunk_t* chunk = &acclog_self;
+    acclog_record_t* dst = NULL;
+
+    if (!record ||
+        !atomic_load_explicit(&state.running, memory_order_acquire)) {
+        return false;
+    }
+
+    if (chunk->pos == chunk->end ||
+        atomic_load_explicit(&chunk->file->retired, memory_order_relaxed)) {
+        if (!acclog_get(chunk)) {
+            return false;
+        }
+    }
+
+    // time_us se escribe el ultimo: un lector que mira el fichero mientras
+    // se escribe no ve un registro a medias como valido
+    dst = chunk->pos++;
+    memcpy((char*)dst + sizeof(dst->time_us),
+           (const char*)record + sizeof(record->time_us),
+           sizeof(acclog_record_t) - sizeof(record->time_us));
+    atomic_signal_fence(memory_order_release);
+    dst->time_us = record->time_us;
+
+    return true;
+}
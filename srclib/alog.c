@@ -0,0 +1,502 @@
+/*****************************************************************************
+ * ARCHIVO: alog.c
+ * DESCRIPCION: Implementacion del log asincrono.
+ *
+ * NOTA: Cada buffer circular tiene un unico productor (el hilo que lo posee)
+ * y un unico consumidor (el escritor), asi que basta con dos indices
+ * atomicos en lineas de cache distintas. Los buffers se enlazan en una lista
+ * a la que solo se anade al principio con CAS y nunca se quita nada: cuando
+ * un hilo termina su buffer queda libre para el siguiente hilo que escriba,
+ * lo que mantiene acotada la memoria con pools elasticos.
+ *
+ * La hora de cada mensaje es la que el escritor guarda en cada vuelta, con
+ * la precision del periodo del escritor, para no leer el reloj al escribir.
+ *
+ * FECHA CREACION: 19 Octubre de 2026
+ * AUTORES: Javier Mateos Najari, Adrian Sebastian Gil
+ *****************************************************************************/
+#include <errno.h>     // errno
+#include <fcntl.h>     // open
+#include <pthread.h>   // pthread_create
+#include <signal.h>    // pthread_sigmask
+#include <stdatomic.h> // atomic_size_t
+#include <stdint.h>    // uint64_t
+#include <stdlib.h>    // aligned_alloc
+#include <string.h>    // memcpy
+#include <syslog.h>    // syslog
+#include <time.h>      // clock_gettime
+#include <unistd.h>    // write
+
+#include "alog.h"
+
+#define ALOG_RING_SIZE 256   // Mensajes pendientes por hilo por defecto
+#define ALOG_FLUSH_MS 10     // Periodo del escritor por defecto
+#define ALOG_MSG_SIZE 512    // Tamanio de un mensaje en el buffer
+#define ALOG_BATCH 65536     // Buffer de escritura del escritor
+#define ALOG_CACHE_LINE 64   // Tamanio de una linea de cache
+#define ALOG_STAMP_SIZE 32   // Tamanio de la fecha formateada
+
+// Mensaje en el buffer de un hilo
+typedef struct alog_msg {
+    uint64_t time;  // Hora en ms desde epoch (cacheada)
+    int priority;   // Prioridad de syslog
+    uint32_t len;   // Longitud del texto (sin terminar en '\0')
+    char text[ALOG_MSG_SIZE - 16]; // Texto del mensaje
+} alog_msg_t;
+
+// Buffer circular de un hilo
+typedef struct alog_ring {
+    // Indice de escritura (hilo propietario)
+    _Alignas(ALOG_CACHE_LINE) atomic_size_t tail;
+    // Indice de lectura (escritor)
+    _Alignas(ALOG_CACHE_LINE) atomic_size_t head;
+    // Mensajes descartados y propietario
+    _Alignas(ALOG_CACHE_LINE) atomic_size_t dropped;
+    atomic_bool owned;      // Lo usa un hilo vivo
+    size_t mask;            // Capacidad - 1
+    alog_msg_t* msgs;       // Mensajes
+    struct alog_ring* next; // Siguiente buffer de la lista
+} alog_ring_t;
+
+// Salida por lotes a un descriptor
+typedef struct alog_out {
+    int fd;                // Descriptor (-1: no se usa)
+    size_t len;            // Bytes pendientes
+    char buf[ALOG_BATCH];  // Bytes pendientes de escribir
+} alog_out_t;
+
+// Estado del log
+typedef struct alog {
+    bool syslog;                   // Escribir con syslog
+    bool close_fd;                 // out.fd es un fichero propio
+    size_t ring_size;              // Capacidad de cada buffer
+    int flush_ms;                  // Periodo del escritor
+    pthread_t thread;              // Hilo escritor
+    pthread_key_t key;             // Libera el buffer al terminar un hilo
+    atomic_bool running;           // Se aceptan mensajes
+    atomic_bool stop;              // El escritor debe terminar
+    _Atomic(alog_ring_t*) rings;   // Lista de buffers
+    _Atomic(uint64_t) clock;       // Hora cacheada (ms desde epoch)
+    atomic_size_t num_rings;       // Buffers creados
+    atomic_size_t written;         // Mensajes escritos
+    size_t reported;               // Descartes ya avisados (escritor)
+    time_t stamp_sec;              // Segundo de stamp
+    char stamp[ALOG_STAMP_SIZE];   // Fecha formateada (escritor)
+    alog_out_t out;                // Salida de los mensajes
+    alog_out_t err;                // Salida de LOG_ERR (sin fichero)
+} alog_t;
+
+static alog_t state;
+
+// Buffer del hilo
+static _Thread_local alog_ring_t* alog_self = NULL;
+
+/*******************************************************************************
+ * FUNCION: static void alog_release(void* arg)
+ * ARGS_IN: void* arg - buffer (alog_ring_t*) del hilo que termina.
+ * DESCRIPCION: Deja el buffer libre para otro hilo. Los mensajes pendientes
+ *              se siguen escribiendo.
+ ******************************************************************************/
+static void alog_release(void* arg);
+
+/*******************************************************************************
+ * FUNCION: static alog_ring_t* alog_ring()
+ * DESCRIPCION: Obtiene el buffer del hilo. La primera vez reutiliza uno libre
+ *              o crea uno nuevo.
+ * ARGS_OUT: alog_ring_t* - buffer o NULL si no hay memoria.
+ ******************************************************************************/
+static alog_ring_t* alog_ring();
+
+/*******************************************************************************
+ * FUNCION: static void alog_flush(alog_out_t* out)
+ * ARGS_IN: alog_out_t* out - salida.
+ * DESCRIPCION: Escribe los bytes pendientes de una salida.
+ ******************************************************************************/
+static void alog_flush(alog_out_t* out);
+
+/*******************************************************************************
+ * FUNCION: static void alog_emit(int priority, uint64_t time,
+ *                                const char* text, size_t len)
+ * ARGS_IN: int priority - prioridad del mensaje.
+ *          uint64_t time - hora del mensaje (ms desde epoch).
+ *          const char* text - texto del mensaje.
+ *          size_t len - longitud del texto.
+ * DESCRIPCION: Pasa un mensaje a syslog o lo anade al lote de su salida.
+ ******************************************************************************/
+static void alog_emit(int priority,
+                      uint64_t time,
+                      const char* text,
+                      size_t len);
+
+/*******************************************************************************
+ * FUNCION: static void alog_drain()
+ * DESCRIPCION: Escribe los mensajes pendientes de todos los buffers y avisa
+ *              de los descartes nuevos.
+ ******************************************************************************/
+static void alog_drain();
+
+/*******************************************************************************
+ * FUNCION: static void* alog_main(void* arg)
+ * ARGS_IN: void* arg - no se usa.
+ * DESCRIPCION: Hilo escritor.
+ * ARGS_OUT: void* - NULL.
+ ******************************************************************************/
+static void* alog_main(void* arg);
+
+static void alog_release(void* arg)
+{
+    alog_ring_t* ring = (alog_ring_t*)arg;
+
+    atomic_store_explicit(&ring->owned, false, memory_order_release);
+}
+
+static alog_ring_t* alog_ring()
+{
+    alog_ring_t* ring = NULL;
+    bool expected;
+
+    if (alog_self) {
+        return alog_self;
+    }
+
+    // Buscamos el buffer de un hilo que ya ha terminado
+    for (ring = atomic_load_explicit(&state.rings, memory_order_acquire); ring;
+         ring = ring->next) {
+        expected = false;
+        if (atomic_compare_exchange_strong_explicit(&ring->owned,
+                                                    &expected,
+                                                    true,
+                                                    memory_order_acquire,
+                                                    memory_order_relaxed)) {
+            break;
+        }
+    }
+
+    if (!ring) {
+        ring = (alog_ring_t*)aligned_alloc(ALOG_CACHE_LINE, sizeof(alog_ring_t));
+        if (!ring) {
+            return NULL;
+        }
+        memset(ring, 0, sizeof(alog_ring_t));
+        ring->msgs = (alog_msg_t*)malloc(state.ring_size * sizeof(alog_msg_t));
+        if (!ring->msgs) {
+            free(ring);
+            return NULL;
+        }
+        ring->mask = state.ring_size - 1;
+        atomic_init(&ring->tail, 0);
+        atomic_init(&ring->head, 0);
+        atomic_init(&ring->dropped, 0);
+        atomic_init(&ring->owned, true);
+        ring->next = atomic_load_explicit(&state.rings, memory_order_relaxed);
+        while (!atomic_compare_exchange_weak_explicit(&state.rings,
+                                                      &ring->next,
+                                                      ring,
+                                                      memory_order_release,
+                                                      memory_order_relaxed))
+            ;
+        atomic_fetch_add_explicit(&state.num_rings, 1, memory_order_relaxed);
+    }
+
+    pthread_setspecific(state.key, ring);
+    alog_self = ring;
+
+    return ring;
+}
+
+static void alog_flush(alog_out_t* out)
+{
+    size_t offset = 0;
+    ssize_t bytes;
+
+    while (offset < out->len) {
+        bytes = write(out->fd, out->buf + offset, out->len - offset);
+        if (bytes > 0) {
+            offset += bytes;
+        } else if (bytes == -1 && errno == EINTR) {
+            continue;
+        } else {
+            // Sin destino no hay a quien avisar: el lote se pierde
+            break;
+        }
+    }
+    out->len = 0;
+}
+
+static void alog_emit(int priority, uint64_t time, const char* text, size_t len)
+{
+    alog_out_t* out = &state.out;
+    const char* label = NULL;
+    struct tm tm;
+    time_t sec;
+    int n;
+
+    atomic_fetch_add_explicit(&state.written, 1, memory_order_relaxed);
+
+    if (state.syslog) {
+        syslog(priority, "%.*s", (int)len, text);
+        return;
+    }
+
+    switch (priority) {
+        case LOG_INFO:
+            label = "LOG_INFO";
+            break;
+        case LOG_ERR:
+            label = "LOG_ERR";
+            if (state.err.fd != -1) {
+                out = &state.err;
+            }
+            break;
+        case LOG_DEBUG:
+            label = "LOG_DEBUG";
+            break;
+        default:
+            label = "LOG";
+    }
+
+    // La fecha solo se formatea cuando cambia el segundo
+    sec = (time_t)(time / 1000);
+    if (sec != state.stamp_sec) {
+        state.stamp_sec = sec;
+        localtime_r(&sec, &tm);
+        strftime(state.stamp, sizeof(state.stamp), "%Y-%m-%d %H:%M:%S", &tm);
+    }
+
+    if (out->len + ALOG_MSG_SIZE + 64 > sizeof(out->buf)) {
+        alog_flush(out);
+    }
+    n = snprintf(out->buf + out->len,
+                 sizeof(out->buf) - out->len,
+                 "%s.%03u [Server] [%s]: ",
+                 state.stamp,
+                 (unsigned)(time % 1000),
+                 label);
+    out->len += n;
+    memcpy(out->buf + out->len, text, len);
+    out->len += len;
+}
+
+static void alog_drain()
+{
+    alog_ring_t* ring = NULL;
+    alog_msg_t* msg = NULL;
+    size_t head, tail, dropped = 0;
+    char text[128];
+    int n;
+
+    for (ring = atomic_load_explicit(&state.rings, memory_order_acquire); ring;
+         ring = ring->next) {
+        head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+        tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+        for (; head != tail; head++) {
+            msg = &ring->msgs[head & ring->mask];
+            alog_emit(msg->priority, msg->time, msg->text, msg->len);
+        }
+        atomic_store_explicit(&ring->head, head, memory_order_release);
+        dropped += atomic_load_explicit(&ring->dropped, memory_order_relaxed);
+    }
+
+    if (dropped > state.reported) {
+        n = snprintf(text,
+                     sizeof(text),
+                     "Log lleno, %zu mensajes descartados (%zu en total)\n",
+                     dropped - state.reported,
+                     dropped);
+        state.reported = dropped;
+        alog_emit(LOG_ERR,
+                  atomic_load_explicit(&state.clock, memory_order_relaxed),
+                  text,
+                  (size_t)n);
+    }
+
+    if (state.out.len) {
+        alog_flush(&state.out);
+    }
+    if (state.err.len) {
+        alog_flush(&state.err);
+    }
+}
+
+static void* alog_main(void* arg)
+{
+    struct timespec ts, wait;
+    sigset_t set;
+    bool stop;
+
+    (void)arg;
+
+    // Las seniales las atiende el hilo principal
+    sigemptyset(&set);
+    sigaddset(&set, SIGINT);
+    sigaddset(&set, SIGTERM);
+    sigaddset(&set, SIGHUP);
+    sigaddset(&set, SIGUSR2);
+    pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+    wait.tv_sec = state.flush_ms / 1000;
+    wait.tv_nsec = (long)(state.flush_ms % 1000) * 1000000;
+
+    while (1) {
+        // Lo que se escribe antes de pedir la parada se ve en esta vuelta
+        stop = atomic_load_explicit(&state.stop, memory_order_acquire);
+
+        clock_gettime(CLOCK_REALTIME, &ts);
+        atomic_store_explicit(&state.clock,
+                              (uint64_t)ts.tv_sec * 1000 +
+                                (uint64_t)ts.tv_nsec / 1000000,
+                              memory_order_relaxed);
+
+        alog_drain();
+        if (stop) {
+            break;
+        }
+        nanosleep(&wait, NULL);
+    }
+
+    return NULL;
+}
+
+int alog_init(const alog_opts_t* opts)
+{
+    struct timespec ts;
+    size_t size = 2;
+
+    memset(&state, 0, sizeof(state));
+    state.out.fd = STDOUT_FILENO;
+    state.err.fd = STDERR_FILENO;
+    state.stamp_sec = (time_t)-1;
+    state.ring_size = ALOG_RING_SIZE;
+    state.flush_ms = ALOG_FLUSH_MS;
+
+    if (opts) {
+        state.syslog = opts->syslog;
+        if (opts->ring_size) {
+            state.ring_size = opts->ring_size;
+        }
+        if (opts->flush_ms > 0) {
+            state.flush_ms = opts->flush_ms;
+        }
+        if (opts->path && !state.syslog) {
+            state.out.fd = open(opts->path,
+                                O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC,
+                                0644);
+            if (state.out.fd == -1) {
+                return -1;
+            }
+            state.close_fd = true;
+            state.err.fd = -1;
+        }
+    }
+    while (size < state.ring_size) {
+        size <<= 1;
+    }
+    state.ring_size = size;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    atomic_init(&state.clock,
+                (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000);
+    atomic_init(&state.rings, NULL);
+    atomic_init(&state.num_rings, 0);
+    atomic_init(&state.written, 0);
+    atomic_init(&state.stop, false);
+    atomic_init(&state.running, false);
+
+    if (pthread_key_create(&state.key, alog_release)) {
+        if (state.close_fd) {
+            close(state.out.fd);
+        }
+        return -1;
+    }
+    if (pthread_create(&state.thread, NULL, alog_main, NULL)) {
+        pthread_key_delete(state.key);
+        if (state.close_fd) {
+            close(state.out.fd);
+        }
+        return -1;
+    }
+    atomic_store_explicit(&state.running, true, memory_order_release);
+
+    return 0;
+}
+
+void alog_destroy()
+{
+    alog_ring_t* ring = NULL;
+
+    if (!atomic_load_explicit(&state.running, memory_order_acquire)) {
+        return;
+    }
+
+    atomic_store_explicit(&state.running, false, memory_order_relaxed);
+    atomic_store_explicit(&state.stop, true, memory_order_release);
+    pthread_join(state.thread, NULL);
+    pthread_key_delete(state.key);
+
+    while ((ring = atomic_load_explicit(&state.rings, memory_order_relaxed))) {
+        atomic_store_explicit(&state.rings, ring->next, memory_order_relaxed);
+        free(ring->msgs);
+        free(ring);
+    }
+    if (state.close_fd) {
+        close(state.out.fd);
+    }
+    alog_self = NULL;
+}
+
+bool alog_write(int priority, const char* message)
+{
+    alog_ring_t* ring = NULL;
+    alog_msg_t* msg = NULL;
+    size_t head, tail, len;
+
+    if (!message ||
+        !atomic_load_explicit(&state.running, memory_order_acquire)) {
+        return false;
+    }
+
+    ring = alog_ring();
+    if (!ring) {
+        return false;
+    }
+
+    tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    if (tail - head > ring->mask) {
+        atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+        return false;
+    }
+
+    msg = &ring->msgs[tail & ring->mask];
+    len = strlen(message);
+    if (len > sizeof(msg->text)) {
+        // Truncado, pero terminando la linea
+        len = sizeof(msg->text);
+        memcpy(msg->text, message, len - 1);
+        msg->text[len - 1] = '\n';
+    } else {
+        memcpy(msg->text, message, len);
+    }
+    msg->len = (uint32_t)len;
+    msg->priority = priority;
+    msg->time = atomic_load_explicit(&state.clock, memory_order_relaxed);
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+
+    return true;
+}
+
+void alog_get_stats(alog_stats_t* stats)
+{
+    alog_ring_t* ring = NULL;
+
+    if (!stats) {
+        return;
+    }
+
+    memset(stats, 0, sizeof(alog_stats_t));
+    stats->written = atomic_load(&state.written);
+    stats->rings = atomic_load(&state.num_rings);
+    for (ring = atomic_load(&state.rings); ring; ring = ring->next) {
+        stats->dropped += atomic_load(&ring->dropped);
+    }
+}
@@ -0,0 +1,124 @@
+/*****************************************************************************
+ * ARCHIVO: capture.c
+ * DESCRIPCION: Implementacion de la captura de trafico.
+ *
+ * NOTA: Los registros se escriben bajo un mutex en un FILE con buffer, asi
+ * que la mayoria de las peticiones solo copian sus bytes en memoria. La
+ * captura es una herramienta de diagnostico que se activa durante un
+ * tiempo; con ella apagada cada peticion solo consulta un booleano.
+ *
+ * FECHA CREACION: 19 Octubre de 2026
+ * AUTORES: Javier Mateos Najari, Adrian Sebastian Gil
+ *****************************************************************************/
+#include <pthread.h>   // pthread_mutex_lock
+#include <stdatomic.h> // atomic_bool
+#include <stdio.h>     // fopen
+#include <string.h>    // memcpy
+#include <time.h>      // clock_gettime
+#include <unistd.h>    // getpid
+
+#include "capture.h"
+
+#define CAPTURE_MAX_SIZE (256 * 1024 * 1024) // Tamanio maximo por defecto
+#define CAPTURE_FILE_BUF (256 * 1024)        // Buffer del fichero
+
+_Static_assert(sizeof(capture_header_t) == 24,
+               "capture_header_t debe ocupar 24 bytes");
+_Static_assert(sizeof(capture_record_t) == 24,
+               "capture_record_t debe ocupar 24 bytes");
+
+// Estado de la captura
+typedef struct capture {
+    pthread_mutex_t mutex; // Protege el fichero y size
+    atomic_bool running;   // Se aceptan registros
+    FILE* file;            // Fichero de la captura
+    size_t size;           // Bytes escritos
+    size_t max_size;       // Tamanio maximo
+    uint64_t origin;       // Inicio de la captura (ns del reloj monotono)
+} capture_t;
+
+static capture_t state = { .mutex = PTHREAD_MUTEX_INITIALIZER };
+
+int capture_init(const capture_opts_t* opts)
+{
+    capture_header_t header;
+    struct timespec ts;
+
+    if (!opts || !opts->path) {
+        return -1;
+    }
+
+    state.file = fopen(opts->path, "we");
+    if (!state.file) {
+        return -1;
+    }
+    setvbuf(state.file, NULL, _IOFBF, CAPTURE_FILE_BUF);
+    state.max_size = opts->max_size ? opts->max_size : CAPTURE_MAX_SIZE;
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CAPTURE_MAGIC, sizeof(header.magic));
+    header.pid = (uint32_t)getpid();
+    clock_gettime(CLOCK_REALTIME, &ts);
+    header.created_us =
+      (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+    if (fwrite(&header, sizeof(header), 1, state.file) != 1) {
+        fclose(state.file);
+        state.file = NULL;
+        return -1;
+    }
+    state.size = sizeof(header);
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    state.origin = (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+    atomic_store_explicit(&state.running, true, memory_order_release);
+
+    return 0;
+}
+
+void capture_destroy()
+{
+    atomic_store_explicit(&state.running, false, memory_order_relaxed);
+
+    pthread_mutex_lock(&state.mutex);
+    if (state.file) {
+        fclose(state.file);
+        state.file = NULL;
+    }
+    pthread_mutex_unlock(&state.mutex);
+}
+
+bool capture_enabled()
+{
+    return atomic_load_explicit(&state.running, memory_order_relaxed);
+}
+
+void capture_write(uint64_t time_ns,
+                   uint64_t conn,
+                   uint16_t flags,
+                   const char* data,
+                   size_t len)
+{
+    capture_record_t record;
+
+    if (!capture_enabled()) {
+        return;
+    }
+
+    record.time_ns = time_ns > state.origin ? time_ns - state.origin : 0;
+    record.conn = conn;
+    record.len = (uint32_t)len;
+    record.flags = flags;
+    record.reserved = 0;
+
+    pthread_mutex_lock(&state.mutex);
+    if (state.file && state.size + sizeof(record) + len <= state.max_size) {
+        fwrite(&record, sizeof(record), 1, state.file);
+        fwrite(data, 1, len, state.file);
+        state.size += sizeof(record) + len;
+    } else if (state.file) {
+        // Fichero lleno: lo capturado hasta aqui queda completo
+        atomic_store_explicit(&state.running, false, memory_order_relaxed);
+        fflush(state.file);
+    }
+    pthread_mutex_unlock(&state.mutex);
+}
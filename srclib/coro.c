@@ -0,0 +1,297 @@
+/*****************************************************************************
+ * ARCHIVO: coro.c
+ * DESCRIPCION: Implementacion de las corrutinas con pila propia.
+ *
+ * NOTA: En x86-64 el cambio de contexto se hace a mano: se guardan en la pila
+ * los registros que el ABI obliga a conservar, se intercambia el puntero de
+ * pila y se retorna, sin pasar por el kernel. swapcontext guarda y restaura
+ * ademas la mascara de seniales con una llamada al sistema en cada cambio,
+ * por lo que solo se usa en el resto de arquitecturas.
+ *
+ * Cada pila es una unica reserva con mmap: la pagina mas baja es la de
+ * guarda (PROT_NONE) y en lo mas alto va la propia estructura de la
+ * corrutina, asi que crear una corrutina no llama a malloc. Solo se tocan
+ * las paginas que la pila llega a usar.
+ *
+ * FECHA CREACION: 19 Octubre de 2026
+ * AUTORES: Javier Mateos Najari, Adrian Sebastian Gil
+ *****************************************************************************/
+#include <stdint.h>   // uintptr_t
+#include <stdlib.h>   // malloc
+#include <sys/mman.h> // mmap
+#include <unistd.h>   // sysconf
+
+#include "coro.h"
+
+#if defined(__x86_64__)
+#define CORO_ASM_SWITCH 1
+#else
+#include <ucontext.h> // swapcontext
+#endif
+
+#define CORO_ALIGN 64 // Alineacion de la estructura de la corrutina
+
+// Corrutina. Se guarda en lo mas alto de su propia pila.
+struct coro {
+#ifdef CORO_ASM_SWITCH
+    void* sp;        // Puntero de pila guardado de la corrutina
+    void* caller_sp; // Puntero de pila guardado de quien la reanuda
+#else
+    ucontext_t ctx;        // Contexto de la corrutina
+    ucontext_t caller_ctx; // Contexto de quien la reanuda
+#endif
+    coro_func_t func;  // Funcion de la corrutina
+    void* arg;         // Argumento de la funcion
+    void* data;        // Dato asociado
+    bool done;         // La funcion ha terminado
+    coro_pool_t* pool; // Pool al que vuelve la pila
+    void* map;         // Inicio de la reserva (pagina de guarda)
+    coro_t* next;      // Siguiente pila libre del pool
+};
+
+// Pool de pilas
+struct coro_pool {
+    size_t map_size;   // Tamanio de cada reserva (pila y guarda)
+    size_t page_size;  // Tamanio de pagina
+    size_t max_cached; // Maximo de pilas libres guardadas
+    size_t cached;     // Pilas libres guardadas
+    size_t mapped;     // Pilas reservadas
+    coro_t* free;      // Pilas libres
+};
+
+// Corrutina que ejecuta el hilo
+static _Thread_local coro_t* coro_current = NULL;
+
+#ifdef CORO_ASM_SWITCH
+/*******************************************************************************
+ * FUNCION: void coro_switch(void** from, void* to)
+ * ARGS_IN: void** from - donde se guarda el puntero de pila actual.
+ *          void* to - puntero de pila que se restaura.
+ * DESCRIPCION: Guarda rbp, rbx y r12-r15 en la pila actual, cambia de pila y
+ *              restaura los de la otra. Retorna a donde la otra pila se
+ *              quedo (o a coro_entry la primera vez).
+ ******************************************************************************/
+void coro_switch(void** from, void* to) __attribute__((visibility("hidden")));
+
+__asm__(".text\n"
+        ".p2align 4\n"
+        ".globl coro_switch\n"
+        ".hidden coro_switch\n"
+        ".type coro_switch, @function\n"
+        "coro_switch:\n"
+        "    pushq %rbp\n"
+        "    pushq %rbx\n"
+        "    pushq %r12\n"
+        "    pushq %r13\n"
+        "    pushq %r14\n"
+        "    pushq %r15\n"
+        "    movq %rsp, (%rdi)\n"
+        "    movq %rsi, %rsp\n"
+        "    popq %r15\n"
+        "    popq %r14\n"
+        "    popq %r13\n"
+        "    popq %r12\n"
+        "    popq %rbx\n"
+        "    popq %rbp\n"
+        "    ret\n"
+        ".size coro_switch, .-coro_switch\n");
+#endif
+
+/*******************************************************************************
+ * FUNCION: static void coro_entry()
+ * DESCRIPCION: Primera funcion que ejecuta una corrutina. Llama a su funcion
+ *              y vuelve a quien la reanudo. Nunca retorna.
+ ******************************************************************************/
+static void coro_entry();
+
+static void coro_entry()
+{
+    coro_t* co = coro_current;
+
+    co->func(co->arg);
+    co->done = true;
+#ifdef CORO_ASM_SWITCH
+    coro_switch(&co->sp, co->caller_sp);
+#else
+    swapcontext(&co->ctx, &co->caller_ctx);
+#endif
+}
+
+coro_pool_t* coro_pool_create(size_t stack_size, size_t max_cached)
+{
+    coro_pool_t* pool = NULL;
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+
+    pool = (coro_pool_t*)calloc(1, sizeof(coro_pool_t));
+    if (!pool) {
+        return NULL;
+    }
+
+    // Pila, estructura de la corrutina y pagina de guarda
+    stack_size += sizeof(coro_t) + CORO_ALIGN;
+    pool->page_size = page;
+    pool->map_size = page + ((stack_size + page - 1) & ~(page - 1));
+    pool->max_cached = max_cached;
+
+    return pool;
+}
+
+void coro_pool_destroy(coro_pool_t* pool)
+{
+    coro_t* co = NULL;
+
+    if (!pool) {
+        return;
+    }
+
+    while ((co = pool->free)) {
+        pool->free = co->next;
+        munmap(co->map, pool->map_size);
+    }
+    free(pool);
+}
+
+size_t coro_pool_mapped(coro_pool_t* pool)
+{
+    return pool ? pool->mapped : 0;
+}
+
+coro_t* coro_create(coro_pool_t* pool, coro_func_t func, void* arg)
+{
+    coro_t* co = NULL;
+    void* map = NULL;
+    uintptr_t top;
+#ifdef CORO_ASM_SWITCH
+    void** sp = NULL;
+    int i;
+#endif
+
+    if (!pool || !func) {
+        return NULL;
+    }
+
+    if (pool->free) {
+        co = pool->free;
+        pool->free = co->next;
+        pool->cached--;
+        map = co->map;
+    } else {
+        map = mmap(NULL,
+                   pool->map_size,
+                   PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK,
+                   -1,
+                   0);
+        if (map == MAP_FAILED) {
+            return NULL;
+        }
+        if (mprotect(map, pool->page_size, PROT_NONE)) {
+            munmap(map, pool->map_size);
+            return NULL;
+        }
+        pool->mapped++;
+        top = ((uintptr_t)map + pool->map_size - sizeof(coro_t)) &
+              ~(uintptr_t)(CORO_ALIGN - 1);
+        co = (coro_t*)top;
+    }
+
+    co->func = func;
+    co->arg = arg;
+    co->data = NULL;
+    co->done = false;
+    co->pool = pool;
+    co->map = map;
+    co->next = NULL;
+
+    // La pila empieza justo debajo de la estructura de la corrutina
+    top = (uintptr_t)co & ~(uintptr_t)15;
+#ifdef CORO_ASM_SWITCH
+    // Marco que deshace coro_switch: seis registros a cero y la direccion de
+    // retorno a coro_entry, que arranca con la pila alineada como tras un call
+    sp = (void**)top;
+    *--sp = NULL;
+    *--sp = (void*)(uintptr_t)coro_entry;
+    for (i = 0; i < 6; i++) {
+        *--sp = NULL;
+    }
+    co->sp = sp;
+#else
+    getcontext(&co->ctx);
+    co->ctx.uc_stack.ss_sp = (char*)map + pool->page_size;
+    co->ctx.uc_stack.ss_size =
+      (size_t)(top - ((uintptr_t)map + pool->page_size));
+    co->ctx.uc_link = NULL;
+    makecontext(&co->ctx, coro_entry, 0);
+#endif
+
+    return co;
+}
+
+void coro_destroy(coro_t* co)
+{
+    coro_pool_t* pool = NULL;
+
+    if (!co) {
+        return;
+    }
+
+    pool = co->pool;
+    if (pool->cached < pool->max_cached) {
+        co->next = pool->free;
+        pool->free = co;
+        pool->cached++;
+    } else {
+        munmap(co->map, pool->map_size);
+        pool->mapped--;
+    }
+}
+
+bool coro_resume(coro_t* co)
+{
+    if (!co || co->done || coro_current) {
+        return true;
+    }
+
+    coro_current = co;
+#ifdef CORO_ASM_SWITCH
+    coro_switch(&co->caller_sp, co->sp);
+#else
+    swapcontext(&co->caller_ctx, &co->ctx);
+#endif
+    coro_current = NULL;
+
+    return co->done;
+}
+
+void coro_yield()
+{
+    coro_t* co = coro_current;
+
+    if (!co) {
+        return;
+    }
+
+#ifdef CORO_ASM_SWITCH
+    coro_switch(&co->sp, co->caller_sp);
+#else
+    swapcontext(&co->ctx, &co->caller_ctx);
+#endif
+    // Al volver, coro_resume ya ha restaurado coro_current
+}
+
+coro_t* coro_self()
+{
+    return coro_current;
+}
+
+void coro_set_data(coro_t* co, void* data)
+{
+    if (co) {
+        co->data = data;
+    }
+}
+
+void* coro_get_data(coro_t* co)
+{
+    return co ? co->data : NULL;
+}
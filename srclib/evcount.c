@@ -0,0 +1,112 @@
+/*****************************************************************************
+ * ARCHIVO: evcount.c
+ * DESCRIPCION: Implementacion del eventcount basado en futex.
+ *
+ * REFERENCIA: https://github.com/facebook/folly/blob/main/folly/experimental/EventCount.h
+ *
+ * NOTA: El hilo que espera se anota en waiters y lee la epoca antes de volver
+ * a comprobar la condicion. El hilo que avisa hace cierta la condicion antes
+ * de leer waiters. Las barreras seq_cst de ambos lados garantizan que o bien
+ * el que espera ve la condicion cierta, o bien el que avisa le ve anotado,
+ * incrementa la epoca y futex_wait retorna inmediatamente o es despertado.
+ *
+ * FECHA CREACION: 19 Octubre de 2026
+ * AUTORES: Javier Mateos Najari, Adrian Sebastian Gil
+ *****************************************************************************/
+#include <limits.h>      // INT_MAX
+#include <linux/futex.h> // FUTEX_WAIT_PRIVATE
+#include <sys/syscall.h> // SYS_futex
+#include <time.h>        // clock_gettime
+#include <unistd.h>      // syscall
+
+#include "evcount.h"
+
+/*******************************************************************************
+ * FUNCION: static void evcount_wake(evcount_t* ec, int num)
+ * ARGS_IN: evcount_t* ec - eventcount.
+ *          int num - numero maximo de hilos que se despiertan.
+ * DESCRIPCION: Avanza la epoca y despierta hilos si hay alguno esperando.
+ ******************************************************************************/
+static void evcount_wake(evcount_t* ec, int num);
+
+static void evcount_wake(evcount_t* ec, int num)
+{
+    atomic_thread_fence(memory_order_seq_cst);
+    if (!atomic_load_explicit(&ec->waiters, memory_order_relaxed)) {
+        return;
+    }
+
+    atomic_fetch_add_explicit(&ec->epoch, 1, memory_order_acq_rel);
+    syscall(SYS_futex, &ec->epoch, FUTEX_WAKE_PRIVATE, num, NULL, NULL, 0);
+}
+
+void evcount_init(evcount_t* ec)
+{
+    atomic_init(&ec->epoch, 0);
+    atomic_init(&ec->waiters, 0);
+}
+
+unsigned evcount_prepare_wait(evcount_t* ec)
+{
+    atomic_fetch_add_explicit(&ec->waiters, 1, memory_order_seq_cst);
+    atomic_thread_fence(memory_order_seq_cst);
+
+    return atomic_load_explicit(&ec->epoch, memory_order_acquire);
+}
+
+void evcount_cancel_wait(evcount_t* ec)
+{
+    atomic_fetch_sub_explicit(&ec->waiters, 1, memory_order_seq_cst);
+}
+
+void evcount_wait(evcount_t* ec, unsigned key)
+{
+    // futex_wait solo duerme si la epoca sigue valiendo key
+    while (atomic_load_explicit(&ec->epoch, memory_order_acquire) == key) {
+        syscall(SYS_futex, &ec->epoch, FUTEX_WAIT_PRIVATE, key, NULL, NULL, 0);
+    }
+    atomic_fetch_sub_explicit(&ec->waiters, 1, memory_order_seq_cst);
+}
+
+bool evcount_wait_for(evcount_t* ec, unsigned key, int timeout)
+{
+    struct timespec now, deadline, left;
+    bool notified = true;
+
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += timeout / 1000;
+    deadline.tv_nsec += (long)(timeout % 1000) * 1000000;
+    if (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+
+    while (atomic_load_explicit(&ec->epoch, memory_order_acquire) == key) {
+        // futex_wait recibe un tiempo relativo, lo recalculamos en cada vuelta
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        left.tv_sec = deadline.tv_sec - now.tv_sec;
+        left.tv_nsec = deadline.tv_nsec - now.tv_nsec;
+        if (left.tv_nsec < 0) {
+            left.tv_sec--;
+            left.tv_nsec += 1000000000;
+        }
+        if (left.tv_sec < 0) {
+            notified = false;
+            break;
+        }
+        syscall(SYS_futex, &ec->epoch, FUTEX_WAIT_PRIVATE, key, &left, NULL, 0);
+    }
+    atomic_fetch_sub_explicit(&ec->waiters, 1, memory_order_seq_cst);
+
+    return notified;
+}
+
+void evcount_notify_one(evcount_t* ec)
+{
+    evcount_wake(ec, 1);
+}
+
+void evcount_notify_all(evcount_t* ec)
+{
+    evcount_wake(ec, INT_MAX);
+}
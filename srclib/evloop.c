@@ -0,0 +1,592 @@
+/*****************************************************************************
+ * ARCHIVO: evloop.c
+ * DESCRIPCION: Implementacion del grupo de bucles de eventos con corrutinas.
+ *
+ * NOTA: Cada bucle tiene su propio epoll, su pool de pilas y una cola MPMC
+ * (ver mpmc.c) por la que recibe trabajos de otros hilos, avisado con un
+ * eventfd. Una corrutina solo se ejecuta en el hilo de su bucle, asi que el
+ * estado de las esperas no necesita sincronizacion y vive en la pila de la
+ * propia corrutina.
+ *
+ * Los descriptores se registran una sola vez, en modo edge-triggered y con
+ * lectura y escritura, en la primera espera de la corrutina. Un aviso que
+ * llega mientras la corrutina no espera se ignora: solo se espera tras un
+ * EAGAIN, y a partir de ahi cualquier dato nuevo genera otro aviso.
+ *
+ * Cada espera lleva su propio limite (cabeceras, cuerpo, escritura o
+ * keep-alive), asi que los limites se llevan en una rueda de temporizadores
+ * por bucle (ver twheel.c): armar y cancelar es O(1) y epoll_wait duerme
+ * hasta el siguiente temporizador. La lista de corrutinas esperando solo se
+ * usa para cancelarlas todas al destruir el grupo.
+ *
+ * FECHA CREACION: 19 Octubre de 2026
+ * AUTORES: Javier Mateos Najari, Adrian Sebastian Gil
+ *****************************************************************************/
+#define _GNU_SOURCE           // pthread_attr_setaffinity_np
+#include <errno.h>            // errno
+#include <linux/mempolicy.h>  // MPOL_LOCAL
+#include <pthread.h>          // pthread_create
+#include <signal.h>           // pthread_sigmask
+#include <stdatomic.h>        // atomic_size_t
+#include <stdlib.h>           // calloc
+#include <string.h>           // memset
+#include <sys/epoll.h>        // epoll_wait
+#include <sys/eventfd.h>      // eventfd
+#include <stddef.h>           // offsetof
+#include <sys/syscall.h>      // SYS_set_mempolicy
+#include <unistd.h>           // close
+
+#include "coro.h"
+#include "evloop.h"
+#include "mpmc.h"
+#include "twheel.h"
+
+#define EVLOOP_QUEUE_SIZE 1024         // Trabajos pendientes por defecto
+#define EVLOOP_STACK_SIZE (64 * 1024)  // Pila por defecto de una corrutina
+#define EVLOOP_MAX_EVENTS 256          // Avisos de epoll por iteracion
+#define EVLOOP_MAX_CACHED 1024         // Pilas libres que guarda cada bucle
+
+typedef struct evloop_loop evloop_loop_t;
+
+// Trabajo pendiente de un bucle
+typedef struct evloop_job {
+    evloop_func_t func; // Funcion de la corrutina
+    void* arg;          // Argumento de la funcion
+} evloop_job_t;
+
+// Estado de una corrutina en su bucle (en la pila de la corrutina)
+typedef struct evloop_task {
+    coro_t* co;               // Corrutina
+    evloop_loop_t* loop;      // Bucle que la ejecuta
+    int fd;                   // Descriptor registrado en epoll (-1: ninguno)
+    uint32_t waiting;         // Eventos que espera (0: no espera)
+    int result;               // 0 o errno de la ultima espera
+    twheel_timer_t timer;     // Limite de la espera
+    struct evloop_task* prev; // Anterior en la lista de esperas
+    struct evloop_task* next; // Siguiente en la lista de esperas
+} evloop_task_t;
+
+// Bucle de eventos
+struct evloop_loop {
+    evloop_t* el;          // Grupo al que pertenece
+    pthread_t thread;      // Hilo del bucle
+    int cpu;               // CPU a la que se fija (-1: ninguna)
+    int epfd;              // epoll del bucle
+    int evfd;              // eventfd para avisar de trabajos nuevos
+    mpmc_t* queue;         // Trabajos pendientes
+    coro_pool_t* pool;     // Pilas de las corrutinas
+    size_t active;         // Corrutinas vivas del bucle
+    evloop_task_t* head;   // Corrutinas esperando
+    twheel_t wheel;        // Limites de las esperas
+    atomic_size_t stacks;  // Pilas reservadas por el bucle
+};
+
+// Grupo de bucles de eventos
+struct evloop {
+    evloop_loop_t* loops;       // Bucles
+    size_t num_loops;           // Numero de bucles
+    size_t stack_size;          // Pila de cada corrutina
+    atomic_size_t next;         // Siguiente bucle en el reparto
+    atomic_bool stop;           // Indica que el grupo se esta destruyendo
+    atomic_size_t active_cnt;   // Corrutinas vivas
+    atomic_size_t max_active;   // Maximo de corrutinas vivas
+    atomic_size_t done_cnt;     // Corrutinas terminadas
+    atomic_size_t rejected_cnt; // Trabajos rechazados
+    atomic_size_t timeout_cnt;  // Esperas expiradas
+};
+
+// Bucle que ejecuta el hilo
+static _Thread_local evloop_loop_t* evloop_self = NULL;
+
+/*******************************************************************************
+ * FUNCION: static void evloop_unlink(evloop_loop_t* loop, evloop_task_t* task)
+ * ARGS_IN: evloop_loop_t* loop - bucle.
+ *          evloop_task_t* task - corrutina que deja de esperar.
+ * DESCRIPCION: Saca la corrutina de la lista de esperas.
+ ******************************************************************************/
+static void evloop_unlink(evloop_loop_t* loop, evloop_task_t* task);
+
+/*******************************************************************************
+ * FUNCION: static void evloop_task_main(void* arg)
+ * ARGS_IN: void* arg - trabajo (evloop_job_t*) que ejecuta la corrutina.
+ * DESCRIPCION: Cuerpo de todas las corrutinas: prepara su estado en la pila,
+ *              ejecuta el trabajo y retira su descriptor de epoll.
+ ******************************************************************************/
+static void evloop_task_main(void* arg);
+
+/*******************************************************************************
+ * FUNCION: static void evloop_run(evloop_loop_t* loop, coro_t* co)
+ * ARGS_IN: evloop_loop_t* loop - bucle.
+ *          coro_t* co - corrutina que se reanuda.
+ * DESCRIPCION: Reanuda una corrutina y la destruye si ha terminado.
+ ******************************************************************************/
+static void evloop_run(evloop_loop_t* loop, coro_t* co);
+
+/*******************************************************************************
+ * FUNCION: static void evloop_wake(evloop_task_t* task, int result)
+ * ARGS_IN: evloop_task_t* task - corrutina que espera.
+ *          int result - resultado de la espera (0 o errno).
+ * DESCRIPCION: Termina la espera de la corrutina y la reanuda.
+ ******************************************************************************/
+static void evloop_wake(evloop_task_t* task, int result);
+
+/*******************************************************************************
+ * FUNCION: static void evloop_expire(twheel_timer_t* timer, void* arg)
+ * ARGS_IN: twheel_timer_t* timer - limite vencido de una espera.
+ *          void* arg - bucle (evloop_loop_t*).
+ * DESCRIPCION: Despierta a la corrutina cuya espera ha expirado.
+ ******************************************************************************/
+static void evloop_expire(twheel_timer_t* timer, void* arg);
+
+/*******************************************************************************
+ * FUNCION: static void evloop_spawn(evloop_loop_t* loop, evloop_job_t* job)
+ * ARGS_IN: evloop_loop_t* loop - bucle.
+ *          evloop_job_t* job - trabajo que se ejecuta.
+ * DESCRIPCION: Crea la corrutina de un trabajo y la ejecuta hasta su primera
+ *              espera.
+ ******************************************************************************/
+static void evloop_spawn(evloop_loop_t* loop, evloop_job_t* job);
+
+/*******************************************************************************
+ * FUNCION: static void* evloop_main(void* arg)
+ * ARGS_IN: void* arg - bucle (evloop_loop_t*) que ejecuta el hilo.
+ * DESCRIPCION: Hilo de un bucle de eventos.
+ * ARGS_OUT: void* - NULL.
+ ******************************************************************************/
+static void* evloop_main(void* arg);
+
+static void evloop_unlink(evloop_loop_t* loop, evloop_task_t* task)
+{
+    if (task->prev) {
+        task->prev->next = task->next;
+    } else {
+        loop->head = task->next;
+    }
+    if (task->next) {
+        task->next->prev = task->prev;
+    }
+    twheel_cancel(&loop->wheel, &task->timer);
+    task->prev = NULL;
+    task->next = NULL;
+}
+
+static void evloop_task_main(void* arg)
+{
+    evloop_job_t job = *(evloop_job_t*)arg;
+    evloop_task_t task;
+
+    memset(&task, 0, sizeof(task));
+    task.co = coro_self();
+    task.loop = evloop_self;
+    task.fd = -1;
+    coro_set_data(task.co, &task);
+
+    job.func(job.arg);
+
+    // Si el trabajo ha pasado el descriptor a otro hilo sigue abierto y no
+    // debe volver a despertar a esta corrutina. Los que cierra el trabajo ya
+    // se han retirado con evloop_forget.
+    if (task.fd != -1) {
+        epoll_ctl(task.loop->epfd, EPOLL_CTL_DEL, task.fd, NULL);
+    }
+}
+
+static void evloop_run(evloop_loop_t* loop, coro_t* co)
+{
+    evloop_t* el = loop->el;
+
+    if (!coro_resume(co)) {
+        return;
+    }
+
+    coro_destroy(co);
+    atomic_store_explicit(
+      &loop->stacks, coro_pool_mapped(loop->pool), memory_order_relaxed);
+    loop->active--;
+    atomic_fetch_sub_explicit(&el->active_cnt, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&el->done_cnt, 1, memory_order_relaxed);
+}
+
+static void evloop_wake(evloop_task_t* task, int result)
+{
+    evloop_unlink(task->loop, task);
+    task->waiting = 0;
+    task->result = result;
+    evloop_run(task->loop, task->co);
+}
+
+static void evloop_expire(twheel_timer_t* timer, void* arg)
+{
+    evloop_loop_t* loop = (evloop_loop_t*)arg;
+    evloop_task_t* task = NULL;
+
+    task = (evloop_task_t*)((char*)timer - offsetof(evloop_task_t, timer));
+    atomic_fetch_add_explicit(&loop->el->timeout_cnt, 1, memory_order_relaxed);
+    evloop_wake(task, ETIMEDOUT);
+}
+
+static void evloop_spawn(evloop_loop_t* loop, evloop_job_t* job)
+{
+    evloop_t* el = loop->el;
+    coro_t* co = NULL;
+    size_t active, max;
+
+    co = coro_create(loop->pool, evloop_task_main, job);
+    if (!co) {
+        // Sin pila el trabajo se ejecuta en el hilo del bucle: sus esperas
+        // fallan con EWOULDBLOCK y termina enseguida
+        job->func(job->arg);
+        atomic_fetch_add_explicit(&el->done_cnt, 1, memory_order_relaxed);
+        return;
+    }
+    atomic_store_explicit(
+      &loop->stacks, coro_pool_mapped(loop->pool), memory_order_relaxed);
+
+    loop->active++;
+    active =
+      atomic_fetch_add_explicit(&el->active_cnt, 1, memory_order_relaxed) + 1;
+    max = atomic_load_explicit(&el->max_active, memory_order_relaxed);
+    while (active > max && !atomic_compare_exchange_weak_explicit(
+                             &el->max_active,
+                             &max,
+                             active,
+                             memory_order_relaxed,
+                             memory_order_relaxed))
+        ;
+
+    // La corrutina copia el trabajo antes de su primera espera
+    evloop_run(loop, co);
+}
+
+static void* evloop_main(void* arg)
+{
+    evloop_loop_t* loop = (evloop_loop_t*)arg;
+    evloop_t* el = loop->el;
+    struct epoll_event events[EVLOOP_MAX_EVENTS];
+    evloop_task_t* task = NULL;
+    evloop_job_t job;
+    uint64_t value;
+    sigset_t set;
+    bool stopping = false;
+    int n, i;
+
+    // Bloqueamos las señales que interrumpen el hilo principal.
+    sigemptyset(&set);
+    sigaddset(&set, SIGINT);
+    sigaddset(&set, SIGTERM);
+    sigaddset(&set, SIGHUP);
+    sigaddset(&set, SIGUSR2);
+    pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+    evloop_self = loop;
+
+    // Las pilas y la memoria de las conexiones salen del nodo del bucle
+    if (loop->cpu != -1) {
+        syscall(SYS_set_mempolicy, MPOL_LOCAL, NULL, 0);
+    }
+    loop->pool = coro_pool_create(el->stack_size, EVLOOP_MAX_CACHED);
+    twheel_init(&loop->wheel, twheel_clock());
+
+    while (1) {
+        n = epoll_wait(loop->epfd,
+                       events,
+                       EVLOOP_MAX_EVENTS,
+                       twheel_timeout(&loop->wheel, twheel_clock()));
+
+        for (i = 0; i < n; i++) {
+            task = (evloop_task_t*)events[i].data.ptr;
+            if (!task) {
+                // Aviso de trabajos nuevos o de destruccion
+                if (read(loop->evfd, &value, sizeof(value)) == -1) {
+                    continue;
+                }
+            } else if (task->waiting &&
+                       (events[i].events &
+                        (task->waiting | EPOLLERR | EPOLLHUP | EPOLLRDHUP))) {
+                evloop_wake(task, 0);
+            }
+        }
+
+        // Esperas expiradas
+        twheel_advance(&loop->wheel, twheel_clock(), evloop_expire, loop);
+
+        // Al destruir el grupo se cancelan todas las esperas para que las
+        // corrutinas cierren sus conexiones, y se termina cuando no queda
+        // ninguna
+        if (atomic_load_explicit(&el->stop, memory_order_acquire)) {
+            stopping = true;
+            while (loop->head) {
+                evloop_wake(loop->head, ECANCELED);
+            }
+        }
+        if (stopping) {
+            if (!loop->active) {
+                break;
+            }
+            continue;
+        }
+
+        while (mpmc_pop(loop->queue, &job)) {
+            evloop_spawn(loop, &job);
+        }
+    }
+
+    coro_pool_destroy(loop->pool);
+    loop->pool = NULL;
+
+    return NULL;
+}
+
+evloop_t* evloop_create(const evloop_opts_t* opts)
+{
+    evloop_t* el = NULL;
+    evloop_loop_t* loop = NULL;
+    const topology_cpu_t* cpu = NULL;
+    struct epoll_event ev;
+    pthread_attr_t attr;
+    cpu_set_t cpus;
+    size_t i, queue_size;
+    long num;
+    int ret;
+
+    if (!opts) {
+        return NULL;
+    }
+
+    num = opts->num_loops;
+    if (num <= 0) {
+        num = sysconf(_SC_NPROCESSORS_ONLN);
+        if (num <= 0) {
+            num = 1;
+        }
+    }
+    queue_size = opts->queue_size ? opts->queue_size : EVLOOP_QUEUE_SIZE;
+
+    el = (evloop_t*)calloc(1, sizeof(evloop_t));
+    if (!el) {
+        return NULL;
+    }
+    el->loops = (evloop_loop_t*)calloc((size_t)num, sizeof(evloop_loop_t));
+    if (!el->loops) {
+        free(el);
+        return NULL;
+    }
+    el->stack_size = opts->stack_size ? opts->stack_size : EVLOOP_STACK_SIZE;
+    atomic_init(&el->next, 0);
+    atomic_init(&el->stop, false);
+    atomic_init(&el->active_cnt, 0);
+    atomic_init(&el->max_active, 0);
+    atomic_init(&el->done_cnt, 0);
+    atomic_init(&el->rejected_cnt, 0);
+    atomic_init(&el->timeout_cnt, 0);
+
+    for (i = 0; i < (size_t)num; i++) {
+        loop = &el->loops[i];
+        loop->el = el;
+        loop->cpu = -1;
+        atomic_init(&loop->stacks, 0);
+        loop->epfd = epoll_create1(EPOLL_CLOEXEC);
+        loop->evfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        loop->queue = mpmc_create(queue_size, sizeof(evloop_job_t));
+        if (loop->epfd == -1 || loop->evfd == -1 || !loop->queue) {
+            break;
+        }
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.ptr = NULL;
+        if (epoll_ctl(loop->epfd, EPOLL_CTL_ADD, loop->evfd, &ev)) {
+            break;
+        }
+
+        // Un bucle por core fisico alternando nodos
+        pthread_attr_init(&attr);
+        if (opts->topology) {
+            cpu = topology_spread(opts->topology, opts->cpu_offset + i);
+            if (cpu) {
+                loop->cpu = cpu->id;
+                CPU_ZERO(&cpus);
+                CPU_SET(cpu->id, &cpus);
+                pthread_attr_setaffinity_np(&attr, sizeof(cpus), &cpus);
+            }
+        }
+        ret = pthread_create(&loop->thread, &attr, evloop_main, loop);
+        pthread_attr_destroy(&attr);
+        if (ret) {
+            break;
+        }
+        el->num_loops++;
+    }
+
+    if (el->num_loops < (size_t)num) {
+        // Cerramos lo que se haya creado del bucle que ha fallado
+        if (loop->epfd != -1) {
+            close(loop->epfd);
+        }
+        if (loop->evfd != -1) {
+            close(loop->evfd);
+        }
+        mpmc_destroy(loop->queue);
+        evloop_destroy(el);
+        return NULL;
+    }
+
+    return el;
+}
+
+void evloop_destroy(evloop_t* el)
+{
+    evloop_loop_t* loop = NULL;
+    uint64_t value = 1;
+    size_t i;
+
+    if (!el) {
+        return;
+    }
+
+    atomic_store_explicit(&el->stop, true, memory_order_release);
+    for (i = 0; i < el->num_loops; i++) {
+        if (write(el->loops[i].evfd, &value, sizeof(value)) == -1) {
+            continue;
+        }
+    }
+
+    for (i = 0; i < el->num_loops; i++) {
+        loop = &el->loops[i];
+        pthread_join(loop->thread, NULL);
+        close(loop->epfd);
+        close(loop->evfd);
+        mpmc_destroy(loop->queue);
+    }
+
+    free(el->loops);
+    free(el);
+}
+
+bool evloop_submit(evloop_t* el, evloop_func_t func, void* arg)
+{
+    evloop_loop_t* loop = NULL;
+    evloop_job_t job;
+    uint64_t value = 1;
+    size_t i, first;
+
+    if (!el || !func || atomic_load_explicit(&el->stop, memory_order_relaxed)) {
+        return false;
+    }
+
+    job.func = func;
+    job.arg = arg;
+
+    // Por turnos; si la cola del elegido esta llena probamos los siguientes
+    first = atomic_fetch_add_explicit(&el->next, 1, memory_order_relaxed);
+    for (i = 0; i < el->num_loops; i++) {
+        loop = &el->loops[(first + i) % el->num_loops];
+        if (mpmc_push(loop->queue, &job)) {
+            if (write(loop->evfd, &value, sizeof(value)) == -1) {
+                // El contador del eventfd ya es distinto de cero
+            }
+            return true;
+        }
+    }
+
+    atomic_fetch_add_explicit(&el->rejected_cnt, 1, memory_order_relaxed);
+
+    return false;
+}
+
+int evloop_wait(int fd, uint32_t events, uint64_t deadline)
+{
+    coro_t* co = coro_self();
+    evloop_task_t* task = NULL;
+    evloop_loop_t* loop = NULL;
+    struct epoll_event ev;
+
+    task = co ? (evloop_task_t*)coro_get_data(co) : NULL;
+    if (!task || task->loop != evloop_self) {
+        errno = EWOULDBLOCK;
+        return -1;
+    }
+    loop = task->loop;
+    if (atomic_load_explicit(&loop->el->stop, memory_order_relaxed)) {
+        errno = ECANCELED;
+        return -1;
+    }
+    if (deadline && deadline <= twheel_clock()) {
+        atomic_fetch_add_explicit(&loop->el->timeout_cnt, 1, memory_order_relaxed);
+        errno = ETIMEDOUT;
+        return -1;
+    }
+
+    if (task->fd != fd) {
+        if (task->fd != -1) {
+            epoll_ctl(loop->epfd, EPOLL_CTL_DEL, task->fd, NULL);
+        }
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        ev.data.ptr = task;
+        if (epoll_ctl(loop->epfd, EPOLL_CTL_ADD, fd, &ev) &&
+            (errno != EEXIST ||
+             epoll_ctl(loop->epfd, EPOLL_CTL_MOD, fd, &ev))) {
+            task->fd = -1;
+            return -1;
+        }
+        task->fd = fd;
+    }
+
+    task->waiting = events;
+    task->prev = NULL;
+    task->next = loop->head;
+    if (loop->head) {
+        loop->head->prev = task;
+    }
+    loop->head = task;
+    if (deadline) {
+        twheel_arm(&loop->wheel, &task->timer, deadline);
+    }
+
+    coro_yield();
+
+    if (task->result) {
+        errno = task->result;
+        return -1;
+    }
+
+    return 0;
+}
+
+void evloop_forget(int fd)
+{
+    coro_t* co = coro_self();
+    evloop_task_t* task = co ? (evloop_task_t*)coro_get_data(co) : NULL;
+
+    if (!task || task->loop != evloop_self || task->fd != fd) {
+        return;
+    }
+
+    epoll_ctl(task->loop->epfd, EPOLL_CTL_DEL, fd, NULL);
+    task->fd = -1;
+}
+
+bool evloop_inside()
+{
+    return evloop_self != NULL;
+}
+
+void evloop_get_stats(evloop_t* el, evloop_stats_t* stats)
+{
+    size_t i;
+
+    if (!el || !stats) {
+        return;
+    }
+
+    memset(stats, 0, sizeof(evloop_stats_t));
+    stats->num_loops = el->num_loops;
+    stats->active = atomic_load(&el->active_cnt);
+    stats->max_active = atomic_load(&el->max_active);
+    stats->completed = atomic_load(&el->done_cnt);
+    stats->rejected = atomic_load(&el->rejected_cnt);
+    stats->timeouts = atomic_load(&el->timeout_cnt);
+    for (i = 0; i < el->num_loops; i++) {
+        stats->stacks += atomic_load(&el->loops[i].stacks);
+    }
+}
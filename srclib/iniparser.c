@@ -244,6 +244,9 @@ struct ini* read_ini(struct read_ini** read_inip, char* filename)
     read_ini->tmp = malloc(sizeof(*read_ini->tmp) * 4);
     read_ini->tmp_cap = 4;
     read_ini->fin = fopen(filename, "r");
+    if (!read_ini->fin) {
+        return NULL;
+    }
 
     ini = parse_ini(read_ini);
 
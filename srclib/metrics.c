@@ -0,0 +1,915 @@
+/*****************************************************************************
+ * ARCHIVO: metrics.c
+ * DESCRIPCION: Implementacion de las metricas del servidor.
+ *
+ * NOTA: Cada hilo tiene una copia (metrics_slab_t) con todos los contadores
+ * y los histogramas que ha usado, de la que es el unico escritor: actualizar
+ * es una lectura y una escritura relajadas, sin lock ni compartir lineas de
+ * cache. Las copias estan en una lista en la que solo se insertan con CAS y
+ * cuando un hilo termina otro reutiliza su copia, asi que los valores nunca
+ * bajan. Al consultar se suman todas; un histograma puede leerse a medio
+ * actualizar (el total y los intervalos difieren en alguna observacion).
+ *
+ * Un histograma tiene METRICS_SUB intervalos por potencia de 2: el valor v
+ * con bit mas alto e cae en el intervalo (e - METRICS_SUB_BITS + 1) *
+ * METRICS_SUB + los METRICS_SUB_BITS bits siguientes a e. Los valores
+ * menores que METRICS_SUB tienen un intervalo cada uno.
+ *
+ * FECHA CREACION: 19 Octubre de 2026
+ * AUTORES: Javier Mateos Najari, Adrian Sebastian Gil
+ *****************************************************************************/
+#include <errno.h>      // errno
+#include <pthread.h>    // pthread_create
+#include <signal.h>     // pthread_sigmask
+#include <stdarg.h>     // va_list
+#include <stdatomic.h>  // atomic_uint_fast64_t
+#include <stdlib.h>     // calloc
+#include <string.h>     // strdup
+#include <sys/socket.h> // shutdown
+#include <unistd.h>     // close
+
+#include "metrics.h"
+#include "socket.h"
+
+#define METRICS_SUB_BITS 3                   // Bits de cada subintervalo
+#define METRICS_SUB (1 << METRICS_SUB_BITS)  // Subintervalos por potencia de 2
+#define METRICS_MAX_BITS 40                  // Valores hasta 2^40 us (~12 dias)
+#define METRICS_BUCKETS ((METRICS_MAX_BITS - METRICS_SUB_BITS + 1) * METRICS_SUB)
+#define METRICS_LE_BITS 26     // Intervalos publicados: 1 us ... 2^26 us (67 s)
+#define METRICS_MAX_COLLECTORS 16  // Maximo de funciones de consulta
+#define METRICS_MAX_HANDLERS 8     // Maximo de paths propios del puerto
+#define METRICS_CACHE_LINE 64      // Tamanio de una linea de cache
+#define METRICS_REQUEST_SIZE 2048  // Maximo de una consulta al puerto
+#define METRICS_IO_TIMEOUT 2000    // Limite de lectura y escritura (ms)
+#define METRICS_OUT_SIZE 16384     // Tamanio inicial del texto de consulta
+
+// Percentiles que se publican de cada histograma
+static const double quantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+
+// Histograma de un hilo
+typedef struct metrics_hist {
+    atomic_uint_fast64_t count;                    // Observaciones
+    atomic_uint_fast64_t sum;                      // Suma de los valores (us)
+    atomic_uint_fast64_t buckets[METRICS_BUCKETS]; // Observaciones por intervalo
+} metrics_hist_t;
+
+// Copia de las metricas de un hilo
+typedef struct metrics_slab {
+    // Contadores
+    _Alignas(METRICS_CACHE_LINE)
+      atomic_uint_fast64_t counters[METRICS_MAX_COUNTERS];
+    // Histogramas (NULL hasta la primera observacion)
+    _Atomic(metrics_hist_t*) hists[METRICS_MAX_HISTOGRAMS];
+    atomic_bool owned;         // La usa un hilo vivo
+    struct metrics_slab* next; // Siguiente copia de la lista
+} metrics_slab_t;
+
+// Descripcion de una metrica registrada
+typedef struct metrics_desc {
+    char* name;   // Nombre
+    char* help;   // Descripcion
+    char* labels; // Etiquetas (NULL: ninguna)
+} metrics_desc_t;
+
+// Funcion de consulta registrada
+typedef struct metrics_func {
+    metrics_collect_t func; // Funcion
+    void* arg;              // Argumento
+} metrics_func_t;
+
+// Path propio del puerto de administracion
+typedef struct metrics_route {
+    char* path;            // Path
+    metrics_handle_t func; // Funcion que responde
+    void* arg;             // Argumento
+} metrics_route_t;
+
+// Texto de una consulta
+struct metrics_out {
+    char* buf;        // Texto
+    size_t len;       // Longitud del texto
+    size_t size;      // Tamanio de buf
+    const char* last; // Ultima metrica escrita (para HELP y TYPE)
+    bool failed;      // No hay memoria
+};
+
+// Estado de las metricas
+typedef struct metrics {
+    pthread_once_t once;        // Crea key
+    pthread_key_t key;          // Libera la copia al terminar un hilo
+    _Atomic(metrics_slab_t*) slabs; // Lista de copias
+    size_t num_counters;        // Contadores registrados
+    size_t num_hists;           // Histogramas registrados
+    size_t num_funcs;           // Funciones de consulta registradas
+    metrics_desc_t counters[METRICS_MAX_COUNTERS];   // Contadores
+    metrics_desc_t hists[METRICS_MAX_HISTOGRAMS];    // Histogramas
+    metrics_func_t funcs[METRICS_MAX_COLLECTORS];    // Funciones de consulta
+    size_t num_routes;          // Paths propios registrados
+    metrics_route_t routes[METRICS_MAX_HANDLERS];    // Paths propios
+    int listen_fd;              // Socket del puerto de administracion
+    char* path;                 // Path de las metricas
+    pthread_t thread;           // Hilo del puerto de administracion
+    atomic_bool serving;        // El hilo esta lanzado
+} metrics_t;
+
+static metrics_t state = { .once = PTHREAD_ONCE_INIT, .listen_fd = -1 };
+
+// Copia del hilo
+static _Thread_local metrics_slab_t* metrics_self = NULL;
+
+/*******************************************************************************
+ * FUNCION: static void metrics_key()
+ * DESCRIPCION: Crea la clave que libera la copia de un hilo al terminar.
+ ******************************************************************************/
+static void metrics_key();
+
+/*******************************************************************************
+ * FUNCION: static void metrics_release(void* arg)
+ * ARGS_IN: void* arg - copia (metrics_slab_t*) del hilo que termina.
+ * DESCRIPCION: Deja la copia libre para otro hilo, con sus valores.
+ ******************************************************************************/
+static void metrics_release(void* arg);
+
+/*******************************************************************************
+ * FUNCION: static metrics_slab_t* metrics_slab()
+ * DESCRIPCION: Obtiene la copia del hilo. La primera vez reutiliza una libre
+ *              o crea una nueva.
+ * ARGS_OUT: metrics_slab_t* - copia o NULL si no hay memoria.
+ ******************************************************************************/
+static metrics_slab_t* metrics_slab();
+
+/*******************************************************************************
+ * FUNCION: static int metrics_register(metrics_desc_t* descs,
+ *                                      size_t* num,
+ *                                      size_t max,
+ *                                      const char* name,
+ *                                      const char* help,
+ *                                      const char* labels)
+ * ARGS_IN: metrics_desc_t* descs - registro.
+ *          size_t* num - metricas registradas.
+ *          size_t max - maximo de metricas.
+ *          const char* name - nombre de la metrica.
+ *          const char* help - descripcion de la metrica.
+ *          const char* labels - (opcional) etiquetas.
+ * DESCRIPCION: Copia la descripcion de una metrica en el registro.
+ * ARGS_OUT: int - identificador o -1 en caso de error.
+ ******************************************************************************/
+static int metrics_register(metrics_desc_t* descs,
+                            size_t* num,
+                            size_t max,
+                            const char* name,
+                            const char* help,
+                            const char* labels);
+
+/*******************************************************************************
+ * FUNCION: static size_t metrics_bucket(uint64_t value)
+ * ARGS_IN: uint64_t value - valor observado.
+ * DESCRIPCION: Obtiene el intervalo de un valor.
+ * ARGS_OUT: size_t - indice del intervalo.
+ ******************************************************************************/
+static size_t metrics_bucket(uint64_t value);
+
+/*******************************************************************************
+ * FUNCION: static uint64_t metrics_upper(size_t bucket)
+ * ARGS_IN: size_t bucket - indice del intervalo.
+ * DESCRIPCION: Obtiene el limite superior (excluido) de un intervalo.
+ * ARGS_OUT: uint64_t - limite superior.
+ ******************************************************************************/
+static uint64_t metrics_upper(size_t bucket);
+
+/*******************************************************************************
+ * FUNCION: static void metrics_printf(metrics_out_t* out,
+ *                                     const char* format, ...)
+ * ARGS_IN: metrics_out_t* out - texto de la consulta.
+ *          const char* format - formato de printf.
+ * DESCRIPCION: Anade texto a la consulta, ampliando el buffer si hace falta.
+ ******************************************************************************/
+static void metrics_printf(metrics_out_t* out, const char* format, ...);
+
+/*******************************************************************************
+ * FUNCION: static void metrics_header(metrics_out_t* out,
+ *                                     const char* name,
+ *                                     const char* help,
+ *                                     const char* type)
+ * ARGS_IN: metrics_out_t* out - texto de la consulta.
+ *          const char* name - nombre de la metrica.
+ *          const char* help - descripcion de la metrica.
+ *          const char* type - tipo de Prometheus.
+ * DESCRIPCION: Escribe HELP y TYPE si la metrica es distinta de la anterior.
+ ******************************************************************************/
+static void metrics_header(metrics_out_t* out,
+                           const char* name,
+                           const char* help,
+                           const char* type);
+
+/*******************************************************************************
+ * FUNCION: static void metrics_render_hists(metrics_out_t* out)
+ * ARGS_IN: metrics_out_t* out - texto de la consulta.
+ * DESCRIPCION: Escribe los intervalos, la suma y el total de los
+ *              histogramas y despues sus percentiles.
+ ******************************************************************************/
+static void metrics_render_hists(metrics_out_t* out);
+
+/*******************************************************************************
+ * FUNCION: static const char* metrics_reason(int status)
+ * ARGS_IN: int status - codigo de estado HTTP.
+ * DESCRIPCION: Obtiene la linea de estado de un codigo.
+ * ARGS_OUT: const char* - codigo y texto ("200 OK").
+ ******************************************************************************/
+static const char* metrics_reason(int status);
+
+/*******************************************************************************
+ * FUNCION: static void metrics_answer(int fd)
+ * ARGS_IN: int fd - conexion con el cliente.
+ * DESCRIPCION: Lee una consulta y responde con las metricas o un error.
+ ******************************************************************************/
+static void metrics_answer(int fd);
+
+/*******************************************************************************
+ * FUNCION: static void* metrics_main(void* arg)
+ * ARGS_IN: void* arg - no se usa.
+ * DESCRIPCION: Hilo del puerto de administracion.
+ * ARGS_OUT: void* - NULL.
+ ******************************************************************************/
+static void* metrics_main(void* arg);
+
+static void metrics_key()
+{
+    pthread_key_create(&state.key, metrics_release);
+}
+
+static void metrics_release(void* arg)
+{
+    metrics_slab_t* slab = (metrics_slab_t*)arg;
+
+    atomic_store_explicit(&slab->owned, false, memory_order_release);
+}
+
+static metrics_slab_t* metrics_slab()
+{
+    metrics_slab_t* slab = NULL;
+    bool expected;
+
+    if (metrics_self) {
+        return metrics_self;
+    }
+
+    // Buscamos la copia de un hilo que ya ha terminado
+    for (slab = atomic_load_explicit(&state.slabs, memory_order_acquire); slab;
+         slab = slab->next) {
+        expected = false;
+        if (atomic_compare_exchange_strong_explicit(&slab->owned,
+                                                    &expected,
+                                                    true,
+                                                    memory_order_acquire,
+                                                    memory_order_relaxed)) {
+            break;
+        }
+    }
+
+    if (!slab) {
+        slab = (metrics_slab_t*)aligned_alloc(METRICS_CACHE_LINE,
+                                              sizeof(metrics_slab_t));
+        if (!slab) {
+            return NULL;
+        }
+        // Con todos los bits a 0 los contadores valen 0 y los punteros NULL
+        memset(slab, 0, sizeof(metrics_slab_t));
+        atomic_init(&slab->owned, true);
+        slab->next = atomic_load_explicit(&state.slabs, memory_order_relaxed);
+        while (!atomic_compare_exchange_weak_explicit(&state.slabs,
+                                                      &slab->next,
+                                                      slab,
+                                                      memory_order_release,
+                                                      memory_order_relaxed))
+            ;
+    }
+
+    pthread_once(&state.once, metrics_key);
+    pthread_setspecific(state.key, slab);
+    metrics_self = slab;
+
+    return slab;
+}
+
+static int metrics_register(metrics_desc_t* descs,
+                            size_t* num,
+                            size_t max,
+                            const char* name,
+                            const char* help,
+                            const char* labels)
+{
+    metrics_desc_t* desc = NULL;
+
+    if (!name || !help || *num == max) {
+        return -1;
+    }
+
+    desc = &descs[*num];
+    desc->name = strdup(name);
+    desc->help = strdup(help);
+    desc->labels = labels && *labels ? strdup(labels) : NULL;
+    if (!desc->name || !desc->help || (labels && *labels && !desc->labels)) {
+        free(desc->name);
+        free(desc->help);
+        free(desc->labels);
+        memset(desc, 0, sizeof(metrics_desc_t));
+        return -1;
+    }
+
+    return (int)(*num)++;
+}
+
+static size_t metrics_bucket(uint64_t value)
+{
+    int e;
+
+    if (value < METRICS_SUB) {
+        return (size_t)value;
+    }
+    if (value >= (uint64_t)1 << METRICS_MAX_BITS) {
+        return METRICS_BUCKETS - 1;
+    }
+
+    e = 63 - __builtin_clzll(value);
+
+    return (size_t)(e - METRICS_SUB_BITS + 1) * METRICS_SUB +
+           ((value >> (e - METRICS_SUB_BITS)) & (METRICS_SUB - 1));
+}
+
+static uint64_t metrics_upper(size_t bucket)
+{
+    size_t b = bucket / METRICS_SUB, sub = bucket % METRICS_SUB;
+
+    if (bucket < METRICS_SUB) {
+        return bucket + 1;
+    }
+
+    return ((uint64_t)(METRICS_SUB + sub + 1)) << (b - 1);
+}
+
+static void metrics_printf(metrics_out_t* out, const char* format, ...)
+{
+    va_list ap;
+    char* buf = NULL;
+    int n;
+
+    if (out->failed) {
+        return;
+    }
+
+    while (1) {
+        va_start(ap, format);
+        n = vsnprintf(out->buf + out->len, out->size - out->len, format, ap);
+        va_end(ap);
+        if (n < 0) {
+            out->failed = true;
+            return;
+        }
+        if ((size_t)n < out->size - out->len) {
+            out->len += n;
+            return;
+        }
+
+        buf = (char*)realloc(out->buf, out->size * 2);
+        if (!buf) {
+            out->failed = true;
+            return;
+        }
+        out->buf = buf;
+        out->size *= 2;
+    }
+}
+
+static void metrics_header(metrics_out_t* out,
+                           const char* name,
+                           const char* help,
+                           const char* type)
+{
+    if (out->last && !strcmp(out->last, name)) {
+        return;
+    }
+
+    out->last = name;
+    metrics_printf(out, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+static void metrics_render_hists(metrics_out_t* out)
+{
+    metrics_slab_t* slab = NULL;
+    metrics_hist_t* hist = NULL;
+    metrics_desc_t* desc = NULL;
+    uint64_t buckets[METRICS_BUCKETS];
+    uint64_t values[METRICS_MAX_HISTOGRAMS][sizeof(quantiles) /
+                                            sizeof(quantiles[0])];
+    uint64_t count, sum, cumulative, rank;
+    const char* sep = NULL;
+    const char* last = NULL;
+    char name[256];
+    size_t id, i, k, q;
+
+    memset(values, 0, sizeof(values));
+    for (id = 0; id < state.num_hists; id++) {
+        desc = &state.hists[id];
+        memset(buckets, 0, sizeof(buckets));
+        count = 0;
+        sum = 0;
+        for (slab = atomic_load_explicit(&state.slabs, memory_order_acquire);
+             slab;
+             slab = slab->next) {
+            hist = atomic_load_explicit(&slab->hists[id], memory_order_acquire);
+            if (!hist) {
+                continue;
+            }
+            count += atomic_load_explicit(&hist->count, memory_order_relaxed);
+            sum += atomic_load_explicit(&hist->sum, memory_order_relaxed);
+            for (i = 0; i < METRICS_BUCKETS; i++) {
+                buckets[i] +=
+                  atomic_load_explicit(&hist->buckets[i], memory_order_relaxed);
+            }
+        }
+
+        // Las series aparecen con su primera observacion
+        if (!count) {
+            continue;
+        }
+        metrics_header(out, desc->name, desc->help, "histogram");
+        sep = desc->labels ? "," : "";
+
+        // Los limites en potencias de 2 coinciden con limites de intervalos
+        cumulative = 0;
+        for (i = 0, k = 0; k <= METRICS_LE_BITS; k++) {
+            while (i < METRICS_BUCKETS && metrics_upper(i) <= (uint64_t)1 << k) {
+                cumulative += buckets[i++];
+            }
+            metrics_printf(out,
+                           "%s_bucket{%s%sle=\"%.9g\"} %llu\n",
+                           desc->name,
+                           desc->labels ? desc->labels : "",
+                           sep,
+                           (double)((uint64_t)1 << k) / 1e6,
+                           (unsigned long long)cumulative);
+        }
+        metrics_printf(out,
+                       "%s_bucket{%s%sle=\"+Inf\"} %llu\n",
+                       desc->name,
+                       desc->labels ? desc->labels : "",
+                       sep,
+                       (unsigned long long)count);
+        metrics_printf(out,
+                       "%s_sum%s%s%s %.6f\n",
+                       desc->name,
+                       desc->labels ? "{" : "",
+                       desc->labels ? desc->labels : "",
+                       desc->labels ? "}" : "",
+                       (double)sum / 1e6);
+        metrics_printf(out,
+                       "%s_count%s%s%s %llu\n",
+                       desc->name,
+                       desc->labels ? "{" : "",
+                       desc->labels ? desc->labels : "",
+                       desc->labels ? "}" : "",
+                       (unsigned long long)count);
+
+        // Percentiles: limite superior del intervalo en el que cae el rango
+        for (q = 0; q < sizeof(quantiles) / sizeof(quantiles[0]); q++) {
+            rank = (uint64_t)(quantiles[q] * count + 0.5);
+            rank = rank ? rank : 1;
+            cumulative = 0;
+            for (i = 0; i < METRICS_BUCKETS; i++) {
+                cumulative += buckets[i];
+                if (cumulative >= rank) {
+                    values[id][q] = metrics_upper(i);
+                    break;
+                }
+            }
+        }
+    }
+
+    // Los percentiles son otra familia, que va detras de los histogramas
+    for (id = 0; id < state.num_hists; id++) {
+        desc = &state.hists[id];
+        if (!values[id][0]) {
+            continue;
+        }
+        snprintf(name, sizeof(name), "%s_quantile", desc->name);
+        if (!last || strcmp(desc->name, last)) {
+            last = desc->name;
+            metrics_printf(out,
+                           "# HELP %s Percentiles 50, 90, 99 y 99.9 de %s\n"
+                           "# TYPE %s gauge\n",
+                           name,
+                           desc->name,
+                           name);
+        }
+        for (q = 0; q < sizeof(quantiles) / sizeof(quantiles[0]); q++) {
+            metrics_printf(out,
+                           "%s{%s%squantile=\"%g\"} %.9g\n",
+                           name,
+                           desc->labels ? desc->labels : "",
+                           desc->labels ? "," : "",
+                           quantiles[q],
+                           (double)values[id][q] / 1e6);
+        }
+    }
+    out->last = NULL;
+}
+
+static const char* metrics_reason(int status)
+{
+    switch (status) {
+    case 200:
+        return "200 OK";
+    case 400:
+        return "400 Bad Request";
+    case 404:
+        return "404 Not Found";
+    case 405:
+        return "405 Method Not Allowed";
+    case 503:
+        return "503 Service Unavailable";
+    default:
+        return "500 Internal Server Error";
+    }
+}
+
+static void metrics_answer(int fd)
+{
+    char request[METRICS_REQUEST_SIZE], header[256];
+    const char* type = "text/plain; charset=utf-8";
+    char* body = NULL;
+    char* end = NULL;
+    char* target = NULL;
+    char* query = "";
+    size_t offset = 0, len = 0, i;
+    ssize_t bytes;
+    uint64_t deadline = socket_deadline(METRICS_IO_TIMEOUT);
+    int n, status = 404;
+
+    // Solo importa la primera linea
+    while (offset < sizeof(request) - 1) {
+        bytes = socket_recv(
+          fd, request + offset, sizeof(request) - 1 - offset, deadline);
+        if (bytes <= 0) {
+            return;
+        }
+        offset += bytes;
+        request[offset] = '\0';
+        if ((end = strstr(request, "\r\n"))) {
+            break;
+        }
+    }
+    if (!end) {
+        return;
+    }
+
+    // Path y parametros de "GET path?query HTTP/1.1"
+    target = request + 4;
+    target[strcspn(target, " \r")] = '\0';
+    if (strchr(target, '?')) {
+        query = strchr(target, '?');
+        *query++ = '\0';
+    }
+
+    if (strncmp(request, "GET ", 4)) {
+        status = 405;
+    } else if (!strcmp(target, state.path)) {
+        body = metrics_render(&len);
+        status = body ? 200 : 500;
+        type = "text/plain; version=0.0.4; charset=utf-8";
+    } else {
+        for (i = 0; i < state.num_routes; i++) {
+            if (!strcmp(target, state.routes[i].path)) {
+                status = state.routes[i].func(
+                  query, &body, &len, state.routes[i].arg);
+                len = body ? len : 0;
+                break;
+            }
+        }
+    }
+
+    n = snprintf(header,
+                 sizeof(header),
+                 "HTTP/1.1 %s\r\n"
+                 "Content-Type: %s\r\n"
+                 "Content-Length: %zu\r\n"
+                 "Connection: close\r\n\r\n",
+                 metrics_reason(status),
+                 type,
+                 len);
+    deadline = socket_deadline(METRICS_IO_TIMEOUT);
+    if (!socket_write(fd, header, n, deadline) && body) {
+        socket_write(fd, body, len, deadline);
+    }
+
+    free(body);
+}
+
+static void* metrics_main(void* arg)
+{
+    struct sockaddr_in peer;
+    int fd;
+
+    (void)arg;
+
+    while (1) {
+        fd = socket_accept(state.listen_fd, &peer);
+        if (fd == -1) {
+            // shutdown de metrics_destroy o error del socket
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            break;
+        }
+        metrics_answer(fd);
+        close(fd);
+    }
+
+    return NULL;
+}
+
+int metrics_counter(const char* name, const char* help, const char* labels)
+{
+    return metrics_register(state.counters,
+                            &state.num_counters,
+                            METRICS_MAX_COUNTERS,
+                            name,
+                            help,
+                            labels);
+}
+
+int metrics_histogram(const char* name, const char* help, const char* labels)
+{
+    return metrics_register(state.hists,
+                            &state.num_hists,
+                            METRICS_MAX_HISTOGRAMS,
+                            name,
+                            help,
+                            labels);
+}
+
+int metrics_collector(metrics_collect_t func, void* arg)
+{
+    if (!func || state.num_funcs == METRICS_MAX_COLLECTORS) {
+        return -1;
+    }
+
+    state.funcs[state.num_funcs].func = func;
+    state.funcs[state.num_funcs].arg = arg;
+    state.num_funcs++;
+
+    return 0;
+}
+
+int metrics_handler(const char* path, metrics_handle_t func, void* arg)
+{
+    metrics_route_t* route = NULL;
+
+    if (!path || !func || state.num_routes == METRICS_MAX_HANDLERS ||
+        atomic_load(&state.serving)) {
+        return -1;
+    }
+
+    route = &state.routes[state.num_routes];
+    route->path = strdup(path);
+    if (!route->path) {
+        return -1;
+    }
+    route->func = func;
+    route->arg = arg;
+    state.num_routes++;
+
+    return 0;
+}
+
+void metrics_add(int id, uint64_t value)
+{
+    metrics_slab_t* slab = NULL;
+    atomic_uint_fast64_t* counter = NULL;
+
+    if (id < 0 || !(slab = metrics_slab())) {
+        return;
+    }
+
+    // Solo escribe este hilo: no hace falta una suma atomica
+    counter = &slab->counters[id];
+    atomic_store_explicit(
+      counter,
+      atomic_load_explicit(counter, memory_order_relaxed) + value,
+      memory_order_relaxed);
+}
+
+void metrics_observe(int id, uint64_t us)
+{
+    metrics_slab_t* slab = NULL;
+    metrics_hist_t* hist = NULL;
+    atomic_uint_fast64_t* bucket = NULL;
+
+    if (id < 0 || !(slab = metrics_slab())) {
+        return;
+    }
+
+    hist = atomic_load_explicit(&slab->hists[id], memory_order_relaxed);
+    if (!hist) {
+        hist = (metrics_hist_t*)calloc(1, sizeof(metrics_hist_t));
+        if (!hist) {
+            return;
+        }
+        atomic_store_explicit(&slab->hists[id], hist, memory_order_release);
+    }
+
+    bucket = &hist->buckets[metrics_bucket(us)];
+    atomic_store_explicit(
+      bucket,
+      atomic_load_explicit(bucket, memory_order_relaxed) + 1,
+      memory_order_relaxed);
+    atomic_store_explicit(
+      &hist->sum,
+      atomic_load_explicit(&hist->sum, memory_order_relaxed) + us,
+      memory_order_relaxed);
+    atomic_store_explicit(
+      &hist->count,
+      atomic_load_explicit(&hist->count, memory_order_relaxed) + 1,
+      memory_order_relaxed);
+}
+
+uint64_t metrics_sum(int id)
+{
+    metrics_slab_t* slab = NULL;
+    uint64_t sum = 0;
+
+    if (id < 0) {
+        return 0;
+    }
+
+    for (slab = atomic_load_explicit(&state.slabs, memory_order_acquire); slab;
+         slab = slab->next) {
+        sum += atomic_load_explicit(&slab->counters[id], memory_order_relaxed);
+    }
+
+    return sum;
+}
+
+void metrics_emit(metrics_out_t* out,
+                  metrics_type_t type,
+                  const char* name,
+                  const char* help,
+                  const char* labels,
+                  double value)
+{
+    metrics_header(
+      out, name, help, type == METRICS_COUNTER ? "counter" : "gauge");
+    metrics_printf(out,
+                   "%s%s%s%s %.17g\n",
+                   name,
+                   labels ? "{" : "",
+                   labels ? labels : "",
+                   labels ? "}" : "",
+                   value);
+}
+
+void metrics_escape(char* dst, size_t size, const char* value)
+{
+    size_t len = 0;
+
+    for (; *value && len + 3 <= size; value++) {
+        if (*value == '"' || *value == '\\') {
+            dst[len++] = '\\';
+            dst[len++] = *value;
+        } else if (*value == '\n') {
+            dst[len++] = '\\';
+            dst[len++] = 'n';
+        } else {
+            dst[len++] = *value;
+        }
+    }
+    if (size) {
+        dst[len] = '\0';
+    }
+}
+
+char* metrics_render(size_t* len)
+{
+    metrics_out_t out = { 0 };
+    metrics_desc_t* desc = NULL;
+    size_t id;
+
+    out.size = METRICS_OUT_SIZE;
+    out.buf = (char*)malloc(out.size);
+    if (!out.buf) {
+        return NULL;
+    }
+    out.buf[0] = '\0';
+
+    for (id = 0; id < state.num_counters; id++) {
+        desc = &state.counters[id];
+        metrics_header(&out, desc->name, desc->help, "counter");
+        metrics_printf(&out,
+                       "%s%s%s%s %llu\n",
+                       desc->name,
+                       desc->labels ? "{" : "",
+                       desc->labels ? desc->labels : "",
+                       desc->labels ? "}" : "",
+                       (unsigned long long)metrics_sum((int)id));
+    }
+    metrics_render_hists(&out);
+    for (id = 0; id < state.num_funcs; id++) {
+        state.funcs[id].func(&out, state.funcs[id].arg);
+    }
+
+    if (out.failed) {
+        free(out.buf);
+        return NULL;
+    }
+
+    *len = out.len;
+
+    return out.buf;
+}
+
+int metrics_serve(char* host, char* port, const char* path)
+{
+    sigset_t set, old;
+
+    if (!port || !path || atomic_load(&state.serving)) {
+        return -1;
+    }
+
+    state.path = strdup(path);
+    if (!state.path) {
+        return -1;
+    }
+    state.listen_fd = socket_init(host, port, SOMAXCONN);
+    if (state.listen_fd == -1) {
+        free(state.path);
+        state.path = NULL;
+        return -1;
+    }
+
+    // Las seniales las atiende el hilo principal
+    sigfillset(&set);
+    pthread_sigmask(SIG_BLOCK, &set, &old);
+    if (pthread_create(&state.thread, NULL, metrics_main, NULL)) {
+        pthread_sigmask(SIG_SETMASK, &old, NULL);
+        close(state.listen_fd);
+        state.listen_fd = -1;
+        free(state.path);
+        state.path = NULL;
+        return -1;
+    }
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    atomic_store(&state.serving, true);
+
+    return 0;
+}
+
+void metrics_stop()
+{
+    if (!atomic_load(&state.serving)) {
+        return;
+    }
+
+    // shutdown despierta a accept, close no
+    shutdown(state.listen_fd, SHUT_RDWR);
+    pthread_join(state.thread, NULL);
+    close(state.listen_fd);
+    state.listen_fd = -1;
+    free(state.path);
+    state.path = NULL;
+    atomic_store(&state.serving, false);
+}
+
+void metrics_destroy()
+{
+    metrics_slab_t* slab = NULL;
+    size_t i;
+
+    metrics_stop();
+
+    while ((slab = atomic_load_explicit(&state.slabs, memory_order_acquire))) {
+        atomic_store_explicit(&state.slabs, slab->next, memory_order_relaxed);
+        for (i = 0; i < METRICS_MAX_HISTOGRAMS; i++) {
+            free(atomic_load_explicit(&slab->hists[i], memory_order_relaxed));
+        }
+        free(slab);
+    }
+    metrics_self = NULL;
+
+    for (i = 0; i < state.num_counters; i++) {
+        free(state.counters[i].name);
+        free(state.counters[i].help);
+        free(state.counters[i].labels);
+    }
+    for (i = 0; i < state.num_hists; i++) {
+        free(state.hists[i].name);
+        free(state.hists[i].help);
+        free(state.hists[i].labels);
+    }
+    state.num_counters = 0;
+    state.num_hists = 0;
+    state.num_funcs = 0;
+    for (i = 0; i < state.num_routes; i++) {
+        free(state.routes[i].path);
+    }
+    state.num_routes = 0;
+}
@@ -0,0 +1,195 @@
+/*****************************************************************************
+ * ARCHIVO: mpmc.c
+ * DESCRIPCION: Implementacion de la cola acotada sin bloqueos MPMC.
+ *
+ * REFERENCIA: https://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+ *
+ * NOTA: Cada celda guarda un numero de secuencia que indica si esta libre
+ * para el productor de la vuelta actual o si contiene un elemento para el
+ * consumidor. Productores y consumidores solo compiten por su propio indice
+ * (tail y head), que estan en lineas de cache distintas para evitar el
+ * falso compartir entre ambos extremos.
+ *
+ * FECHA CREACION: 19 Octubre de 2026
+ * AUTORES: Javier Mateos Najari, Adrian Sebastian Gil
+ *****************************************************************************/
+#include <stdatomic.h> // atomic_size_t
+#include <stdint.h>    // intptr_t
+#include <stdlib.h>    // aligned_alloc
+#include <string.h>    // memcpy
+
+#include "mpmc.h"
+
+#define MPMC_CACHE_LINE 64 // Tamanio de una linea de cache
+
+// Celda del buffer circular. El elemento va a continuacion de la secuencia.
+typedef struct mpmc_cell {
+    atomic_size_t seq; // Secuencia que indica el estado de la celda
+} mpmc_cell_t;
+
+// Cola MPMC
+struct mpmc {
+    // Indice de insercion (productores)
+    _Alignas(MPMC_CACHE_LINE) atomic_size_t tail;
+    // Indice de extraccion (consumidores)
+    _Alignas(MPMC_CACHE_LINE) atomic_size_t head;
+    // Datos de solo lectura tras la creacion
+    _Alignas(MPMC_CACHE_LINE) size_t mask; // Capacidad - 1
+    size_t elem_size;                      // Tamanio de un elemento
+    size_t stride;                         // Tamanio de una celda
+    unsigned char* cells;                  // Buffer circular
+};
+
+/*******************************************************************************
+ * FUNCION: static mpmc_cell_t* mpmc_cell(mpmc_t* q, size_t pos)
+ * ARGS_IN: mpmc_t* q - cola.
+ *          size_t pos - posicion (sin aplicar la mascara).
+ * DESCRIPCION: Obtiene la celda correspondiente a una posicion.
+ * ARGS_OUT: mpmc_cell_t* - celda.
+ ******************************************************************************/
+static mpmc_cell_t* mpmc_cell(mpmc_t* q, size_t pos);
+
+static mpmc_cell_t* mpmc_cell(mpmc_t* q, size_t pos)
+{
+    return (mpmc_cell_t*)(q->cells + (pos & q->mask) * q->stride);
+}
+
+mpmc_t* mpmc_create(size_t capacity, size_t elem_size)
+{
+    mpmc_t* q = NULL;
+    size_t size = 2, i;
+
+    if (!elem_size) {
+        return NULL;
+    }
+
+    while (size < capacity) {
+        size <<= 1;
+    }
+
+    q = (mpmc_t*)aligned_alloc(MPMC_CACHE_LINE, sizeof(mpmc_t));
+    if (!q) {
+        return NULL;
+    }
+    memset(q, 0, sizeof(mpmc_t));
+
+    q->mask = size - 1;
+    q->elem_size = elem_size;
+    q->stride = sizeof(mpmc_cell_t) + elem_size;
+    q->stride = (q->stride + sizeof(void*) - 1) & ~(sizeof(void*) - 1);
+    q->cells = (unsigned char*)aligned_alloc(
+      MPMC_CACHE_LINE,
+      (size * q->stride + MPMC_CACHE_LINE - 1) & ~(size_t)(MPMC_CACHE_LINE - 1));
+    if (!q->cells) {
+        free(q);
+        return NULL;
+    }
+
+    for (i = 0; i < size; i++) {
+        atomic_init(&mpmc_cell(q, i)->seq, i);
+    }
+    atomic_init(&q->tail, 0);
+    atomic_init(&q->head, 0);
+
+    return q;
+}
+
+void mpmc_destroy(mpmc_t* q)
+{
+    if (!q) {
+        return;
+    }
+
+    free(q->cells);
+    free(q);
+}
+
+bool mpmc_push(mpmc_t* q, const void* elem)
+{
+    mpmc_cell_t* cell = NULL;
+    size_t pos, seq;
+    intptr_t diff;
+
+    pos = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    while (1) {
+        cell = mpmc_cell(q, pos);
+        seq = atomic_load_explicit(&cell->seq, memory_order_acquire);
+        diff = (intptr_t)seq - (intptr_t)pos;
+        if (diff == 0) {
+            // Celda libre, intentamos reservarla
+            if (atomic_compare_exchange_weak_explicit(&q->tail,
+                                                      &pos,
+                                                      pos + 1,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // La celda aun contiene el elemento de la vuelta anterior
+            return false;
+        } else {
+            // Otro productor ha avanzado, recargamos la posicion
+            pos = atomic_load_explicit(&q->tail, memory_order_relaxed);
+        }
+    }
+
+    memcpy(cell + 1, elem, q->elem_size);
+    atomic_store_explicit(&cell->seq, pos + 1, memory_order_release);
+
+    return true;
+}
+
+bool mpmc_pop(mpmc_t* q, void* elem)
+{
+    mpmc_cell_t* cell = NULL;
+    size_t pos, seq;
+    intptr_t diff;
+
+    pos = atomic_load_explicit(&q->head, memory_order_relaxed);
+    while (1) {
+        cell = mpmc_cell(q, pos);
+        seq = atomic_load_explicit(&cell->seq, memory_order_acquire);
+        diff = (intptr_t)seq - (intptr_t)(pos + 1);
+        if (diff == 0) {
+            // Celda con elemento, intentamos reservarla
+            if (atomic_compare_exchange_weak_explicit(&q->head,
+                                                      &pos,
+                                                      pos + 1,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // Cola vacia
+            return false;
+        } else {
+            // Otro consumidor ha avanzado, recargamos la posicion
+            pos = atomic_load_explicit(&q->head, memory_order_relaxed);
+        }
+    }
+
+    memcpy(elem, cell + 1, q->elem_size);
+    // Liberamos la celda para el productor de la siguiente vuelta
+    atomic_store_explicit(&cell->seq, pos + q->mask + 1, memory_order_release);
+
+    return true;
+}
+
+size_t mpmc_size(mpmc_t* q)
+{
+    size_t tail, head;
+
+    if (!q) {
+        return 0;
+    }
+
+    head = atomic_load_explicit(&q->head, memory_order_relaxed);
+    tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+
+    return tail > head ? tail - head : 0;
+}
+
+size_t mpmc_capacity(mpmc_t* q)
+{
+    return q ? q->mask + 1 : 0;
+}
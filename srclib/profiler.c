@@ -0,0 +1,756 @@
+/*****************************************************************************
+ * ARCHIVO: profiler.c
+ * DESCRIPCION: Implementacion del perfilador de CPU por muestreo.
+ *
+ * NOTA: Se abre un evento de reloj de CPU por hilo (pid = tid, cpu = -1):
+ * perf_event_open solo sigue a todo un proceso con eventos por CPU, que
+ * piden mas privilegios que los de un proceso normal. Cada evento escribe
+ * sus muestras (tid y pila) en un buffer circular compartido con el kernel,
+ * que se vacia cada PROFILER_DRAIN_MS para que no se llene. Las direcciones
+ * se guardan en crudo y se traducen al terminar: con /proc/self/maps se
+ * encuentra el fichero y el desplazamiento de cada una, y con los segmentos
+ * PT_LOAD y la tabla de simbolos (.symtab o, si no esta, .dynsym) del ELF la
+ * funcion. Los hilos creados durante el muestreo no se muestrean.
+ *
+ * FECHA CREACION: 19 Octubre de 2026
+ * AUTORES: Javier Mateos Najari, Adrian Sebastian Gil
+ *****************************************************************************/
+#include <dirent.h>              // opendir
+#include <elf.h>                 // Elf64_Ehdr
+#include <errno.h>               // errno
+#include <fcntl.h>               // open
+#include <linux/perf_event.h>    // perf_event_attr
+#include <stdatomic.h>           // atomic_bool
+#include <stdbool.h>             // bool
+#include <stdio.h>               // snprintf
+#include <stdlib.h>              // qsort
+#include <string.h>              // memcpy
+#include <sys/ioctl.h>           // ioctl
+#include <sys/mman.h>            // mmap
+#include <sys/stat.h>            // fstat
+#include <sys/syscall.h>         // SYS_perf_event_open
+#include <time.h>                // nanosleep
+#include <unistd.h>              // syscall
+
+#include "profiler.h"
+
+#define PROFILER_MAX_THREADS 512  // Hilos muestreados como maximo
+#define PROFILER_RING_PAGES 64    // Paginas de datos del buffer de cada hilo
+#define PROFILER_MAX_DEPTH 128    // Marcos de pila por muestra
+#define PROFILER_MAX_MODULES 128  // Proyecciones ejecutables del proceso
+#define PROFILER_DRAIN_MS 50      // Periodo de lectura de los buffers
+#define PROFILER_LINE_SIZE 8192   // Longitud maxima de una pila en texto
+#define PROFILER_PATH_SIZE 512    // Longitud maxima de una ruta
+
+// Hilo muestreado
+typedef struct profiler_thread {
+    int fd;        // Evento del hilo
+    char* ring;    // Pagina de control y datos del buffer circular
+    char comm[16]; // Nombre del hilo
+} profiler_thread_t;
+
+// Muestras en crudo: indice del hilo, profundidad y direcciones
+typedef struct profiler_raw {
+    uint64_t* data; // Muestras seguidas
+    size_t len;     // Elementos usados
+    size_t size;    // Elementos reservados
+} profiler_raw_t;
+
+// Simbolo de funcion de un ELF
+typedef struct profiler_sym {
+    uint64_t addr;    // Direccion virtual en el ELF
+    uint64_t size;    // Tamanio (0: hasta el siguiente)
+    const char* name; // Nombre (dentro del fichero proyectado)
+} profiler_sym_t;
+
+// Proyeccion ejecutable del proceso y los simbolos de su fichero
+typedef struct profiler_module {
+    uint64_t start;       // Inicio de la proyeccion
+    uint64_t end;         // Fin de la proyeccion
+    uint64_t offset;      // Desplazamiento en el fichero
+    char path[PROFILER_PATH_SIZE]; // Fichero o nombre ([vdso])
+    const char* base;     // Nombre del fichero sin directorio
+    char* file;           // Fichero proyectado (NULL: sin simbolos)
+    size_t file_size;     // Tamanio del fichero
+    const Elf64_Phdr* phdrs; // Segmentos
+    size_t num_phdrs;     // Numero de segmentos
+    profiler_sym_t* syms; // Simbolos ordenados por direccion
+    size_t num_syms;      // Numero de simbolos
+} profiler_module_t;
+
+// Solo un muestreo a la vez
+static atomic_bool busy = false;
+// Muestreos cortados y rechazados (ver profiler_enable)
+static atomic_bool disabled = false;
+
+/*******************************************************************************
+ * FUNCION: static size_t profiler_threads(profiler_thread_t* threads,
+ *                                         unsigned frequency)
+ * ARGS_IN: profiler_thread_t* threads - hilos abiertos.
+ *          unsigned frequency - muestras por segundo.
+ * DESCRIPCION: Abre y proyecta un evento deshabilitado por cada hilo del
+ *              proceso salvo el que llama.
+ * ARGS_OUT: size_t - hilos abiertos (0 con errno del primer fallo).
+ ******************************************************************************/
+static size_t profiler_threads(profiler_thread_t* threads, unsigned frequency);
+
+/*******************************************************************************
+ * FUNCION: static void profiler_drain(profiler_thread_t* thread,
+ *                                     uint64_t index,
+ *                                     profiler_raw_t* raw,
+ *                                     profiler_stats_t* stats)
+ * ARGS_IN: profiler_thread_t* thread - hilo.
+ *          uint64_t index - indice del hilo.
+ *          profiler_raw_t* raw - muestras en crudo.
+ *          profiler_stats_t* stats - resumen del muestreo.
+ * DESCRIPCION: Lee los registros pendientes del buffer del hilo.
+ ******************************************************************************/
+static void profiler_drain(profiler_thread_t* thread,
+                           uint64_t index,
+                           profiler_raw_t* raw,
+                           profiler_stats_t* stats);
+
+/*******************************************************************************
+ * FUNCION: static void profiler_copy(const char* data,
+ *                                    uint64_t pos,
+ *                                    void* dst,
+ *                                    size_t len)
+ * ARGS_IN: const char* data - datos del buffer circular.
+ *          uint64_t pos - posicion sin reducir.
+ *          void* dst - destino.
+ *          size_t len - bytes que se copian.
+ * DESCRIPCION: Copia bytes del buffer circular dando la vuelta al final.
+ ******************************************************************************/
+static void profiler_copy(const char* data, uint64_t pos, void* dst, size_t len);
+
+/*******************************************************************************
+ * FUNCION: static size_t profiler_modules(profiler_module_t* modules)
+ * ARGS_IN: profiler_module_t* modules - proyecciones leidas.
+ * DESCRIPCION: Lee de /proc/self/maps las proyecciones ejecutables y carga
+ *              los simbolos de sus ficheros.
+ * ARGS_OUT: size_t - numero de proyecciones.
+ ******************************************************************************/
+static size_t profiler_modules(profiler_module_t* modules);
+
+/*******************************************************************************
+ * FUNCION: static void profiler_load(profiler_module_t* module)
+ * ARGS_IN: profiler_module_t* module - proyeccion con path.
+ * DESCRIPCION: Proyecta el ELF de la proyeccion y ordena sus simbolos de
+ *              funcion. Si el fichero no es un ELF de 64 bits valido la
+ *              proyeccion se queda sin simbolos.
+ ******************************************************************************/
+static void profiler_load(profiler_module_t* module);
+
+/*******************************************************************************
+ * FUNCION: static const char* profiler_symbol(profiler_module_t* modules,
+ *                                             size_t num,
+ *                                             uint64_t addr,
+ *                                             char* buf,
+ *                                             size_t size)
+ * ARGS_IN: profiler_module_t* modules - proyecciones.
+ *          size_t num - numero de proyecciones.
+ *          uint64_t addr - direccion del proceso.
+ *          char* buf - buffer para nombres compuestos.
+ *          size_t size - tamanio de buf.
+ * DESCRIPCION: Traduce una direccion a su funcion, a [fichero] si no hay
+ *              simbolo o a [unknown] si no esta en ninguna proyeccion.
+ * ARGS_OUT: const char* - nombre del marco.
+ ******************************************************************************/
+static const char* profiler_symbol(profiler_module_t* modules,
+                                   size_t num,
+                                   uint64_t addr,
+                                   char* buf,
+                                   size_t size);
+
+/*******************************************************************************
+ * FUNCION: static int profiler_cmp_sym(const void* a, const void* b)
+ * ARGS_IN: const void* a - simbolo.
+ *          const void* b - simbolo.
+ * DESCRIPCION: Ordena simbolos por direccion.
+ * ARGS_OUT: int - negativo, 0 o positivo como strcmp.
+ ******************************************************************************/
+static int profiler_cmp_sym(const void* a, const void* b);
+
+/*******************************************************************************
+ * FUNCION: static int profiler_cmp_line(const void* a, const void* b)
+ * ARGS_IN: const void* a - pila en texto.
+ *          const void* b - pila en texto.
+ * DESCRIPCION: Ordena pilas alfabeticamente para agruparlas.
+ * ARGS_OUT: int - negativo, 0 o positivo como strcmp.
+ ******************************************************************************/
+static int profiler_cmp_line(const void* a, const void* b);
+
+/*******************************************************************************
+ * FUNCION: static char* profiler_fold(profiler_thread_t* threads,
+ *                                     profiler_raw_t* raw,
+ *                                     size_t* len)
+ * ARGS_IN: profiler_thread_t* threads - hilos muestreados.
+ *          profiler_raw_t* raw - muestras en crudo.
+ *          size_t* len - longitud del texto.
+ * DESCRIPCION: Traduce las muestras y agrupa las pilas iguales.
+ * ARGS_OUT: char* - texto en formato folded o NULL si no hay memoria.
+ ******************************************************************************/
+static char* profiler_fold(profiler_thread_t* threads,
+                           profiler_raw_t* raw,
+                           size_t* len);
+
+int profiler_run(unsigned seconds,
+                 unsigned frequency,
+                 char** out,
+                 size_t* len,
+                 profiler_stats_t* stats)
+{
+    profiler_thread_t* threads = NULL;
+    profiler_raw_t raw = { 0 };
+    profiler_stats_t local = { 0 };
+    struct timespec now, end, pause = { 0, PROFILER_DRAIN_MS * 1000000L };
+    size_t num, i;
+    int err = 0;
+
+    if (!out || !len || !seconds || seconds > PROFILER_MAX_SECONDS ||
+        !frequency || frequency > PROFILER_MAX_FREQUENCY) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (atomic_exchange(&busy, true)) {
+        errno = EBUSY;
+        return -1;
+    }
+    if (atomic_load(&disabled)) {
+        atomic_store(&busy, false);
+        errno = ECANCELED;
+        return -1;
+    }
+
+    threads = (profiler_thread_t*)calloc(PROFILER_MAX_THREADS,
+                                         sizeof(profiler_thread_t));
+    if (!threads) {
+        atomic_store(&busy, false);
+        errno = ENOMEM;
+        return -1;
+    }
+    num = profiler_threads(threads, frequency);
+    if (!num) {
+        err = errno;
+        free(threads);
+        atomic_store(&busy, false);
+        errno = err;
+        return -1;
+    }
+    local.threads = num;
+
+    for (i = 0; i < num; i++) {
+        ioctl(threads[i].fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    end.tv_sec += seconds;
+    do {
+        nanosleep(&pause, NULL);
+        for (i = 0; i < num; i++) {
+            profiler_drain(&threads[i], i, &raw, &local);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (atomic_load(&disabled)) {
+            err = ECANCELED;
+            break;
+        }
+    } while (now.tv_sec < end.tv_sec ||
+             (now.tv_sec == end.tv_sec && now.tv_nsec < end.tv_nsec));
+    for (i = 0; i < num; i++) {
+        ioctl(threads[i].fd, PERF_EVENT_IOC_DISABLE, 0);
+        profiler_drain(&threads[i], i, &raw, &local);
+        munmap(threads[i].ring,
+               (PROFILER_RING_PAGES + 1) * (size_t)sysconf(_SC_PAGESIZE));
+        close(threads[i].fd);
+    }
+
+    // Un muestreo cortado no resuelve simbolos, que es lo mas lento
+    *out = err ? NULL : profiler_fold(threads, &raw, len);
+    if (!err && !*out) {
+        err = ENOMEM;
+    }
+    free(raw.data);
+    free(threads);
+    if (stats) {
+        *stats = local;
+    }
+    atomic_store(&busy, false);
+
+    errno = err;
+    return err ? -1 : 0;
+}
+
+static size_t profiler_threads(profiler_thread_t* threads, unsigned frequency)
+{
+    struct perf_event_attr attr;
+    struct dirent* entry;
+    DIR* dir;
+    char path[64];
+    size_t num = 0, page = (size_t)sysconf(_SC_PAGESIZE);
+    pid_t self = (pid_t)syscall(SYS_gettid), tid;
+    ssize_t bytes;
+    int fd, err = 0;
+    char* ring;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_SOFTWARE;
+    attr.config = PERF_COUNT_SW_CPU_CLOCK;
+    attr.freq = 1;
+    attr.sample_freq = frequency;
+    attr.sample_type = PERF_SAMPLE_TID | PERF_SAMPLE_CALLCHAIN;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.exclude_callchain_kernel = 1;
+
+    dir = opendir("/proc/self/task");
+    if (!dir) {
+        return 0;
+    }
+    while ((entry = readdir(dir)) && num < PROFILER_MAX_THREADS) {
+        tid = (pid_t)atoi(entry->d_name);
+        if (tid <= 0 || tid == self) {
+            continue;
+        }
+        fd = (int)syscall(
+          SYS_perf_event_open, &attr, tid, -1, -1, PERF_FLAG_FD_CLOEXEC);
+        if (fd == -1) {
+            // El hilo puede haber terminado entre readdir y la apertura
+            if (!err && errno != ESRCH) {
+                err = errno;
+            }
+            continue;
+        }
+        ring = (char*)mmap(NULL,
+                           (PROFILER_RING_PAGES + 1) * page,
+                           PROT_READ | PROT_WRITE,
+                           MAP_SHARED,
+                           fd,
+                           0);
+        if (ring == MAP_FAILED) {
+            if (!err) {
+                err = errno;
+            }
+            close(fd);
+            continue;
+        }
+
+        threads[num].fd = fd;
+        threads[num].ring = ring;
+        strcpy(threads[num].comm, "?");
+        snprintf(path, sizeof(path), "/proc/self/task/%d/comm", (int)tid);
+        fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd != -1) {
+            bytes = read(fd, threads[num].comm, sizeof(threads[num].comm) - 1);
+            if (bytes > 0) {
+                threads[num].comm[bytes] = '\0';
+                threads[num].comm[strcspn(threads[num].comm, "\n")] = '\0';
+            }
+            close(fd);
+        }
+        num++;
+    }
+    closedir(dir);
+
+    if (!num) {
+        errno = err ? err : ESRCH;
+    }
+
+    return num;
+}
+
+static void profiler_drain(profiler_thread_t* thread,
+                           uint64_t index,
+                           profiler_raw_t* raw,
+                           profiler_stats_t* stats)
+{
+    struct perf_event_mmap_page* meta =
+      (struct perf_event_mmap_page*)thread->ring;
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    const char* data = thread->ring + page;
+    struct perf_event_header header;
+    uint64_t record[PROFILER_MAX_DEPTH + 8];
+    uint64_t head, tail, nr, depth, i, *grown;
+    size_t need;
+
+    head = *(volatile __u64*)&meta->data_head;
+    // Los datos del kernel se leen despues de data_head
+    atomic_thread_fence(memory_order_acquire);
+    tail = meta->data_tail;
+
+    while (tail < head) {
+        profiler_copy(data, tail, &header, sizeof(header));
+        if (header.size < sizeof(header)) {
+            break;
+        }
+        if (header.type == PERF_RECORD_SAMPLE &&
+            header.size <= sizeof(header) + sizeof(record)) {
+            // pid, tid, nr y las direcciones
+            profiler_copy(data,
+                          tail + sizeof(header),
+                          record,
+                          header.size - sizeof(header));
+            nr = record[1];
+            if (nr > (header.size - sizeof(header)) / sizeof(uint64_t) - 2) {
+                nr = (header.size - sizeof(header)) / sizeof(uint64_t) - 2;
+            }
+            need = raw->len + 2 + nr;
+            if (need > raw->size) {
+                grown = (uint64_t*)realloc(
+                  raw->data, (need > 2 * raw->size ? need : 2 * raw->size) *
+                               sizeof(uint64_t));
+                if (!grown) {
+                    stats->lost++;
+                    tail += header.size;
+                    continue;
+                }
+                raw->data = grown;
+                raw->size = need > 2 * raw->size ? need : 2 * raw->size;
+            }
+            raw->data[raw->len] = index;
+            for (i = 0, depth = 0; i < nr; i++) {
+                // Los marcadores de contexto (PERF_CONTEXT_USER...) no son
+                // direcciones
+                if (record[2 + i] >= (uint64_t)PERF_CONTEXT_MAX) {
+                    continue;
+                }
+                raw->data[raw->len + 2 + depth++] = record[2 + i];
+            }
+            raw->data[raw->len + 1] = depth;
+            raw->len += 2 + depth;
+            stats->samples++;
+        } else if (header.type == PERF_RECORD_LOST) {
+            // id y numero de registros perdidos
+            profiler_copy(data, tail + sizeof(header), record, 16);
+            stats->lost += record[1];
+        }
+        tail += header.size;
+    }
+
+    // El kernel puede reutilizar el espacio despues de leerlo
+    atomic_thread_fence(memory_order_release);
+    meta->data_tail = tail;
+}
+
+static void profiler_copy(const char* data, uint64_t pos, void* dst, size_t len)
+{
+    size_t size = PROFILER_RING_PAGES * (size_t)sysconf(_SC_PAGESIZE);
+    size_t off = (size_t)(pos % size);
+    size_t first = len < size - off ? len : size - off;
+
+    memcpy(dst, data + off, first);
+    memcpy((char*)dst + first, data, len - first);
+}
+
+static size_t profiler_modules(profiler_module_t* modules)
+{
+    FILE* maps;
+    char line[PROFILER_PATH_SIZE + 128], perms[8];
+    unsigned long long start, end, offset;
+    size_t num = 0;
+    int path_at;
+    char* path;
+
+    maps = fopen("/proc/self/maps", "re");
+    if (!maps) {
+        return 0;
+    }
+    while (num < PROFILER_MAX_MODULES && fgets(line, sizeof(line), maps)) {
+        path_at = 0;
+        if (sscanf(line,
+                   "%llx-%llx %7s %llx %*s %*s %n",
+                   &start,
+                   &end,
+                   perms,
+                   &offset,
+                   &path_at) < 4 ||
+            perms[2] != 'x' || !path_at) {
+            continue;
+        }
+        path = line + path_at;
+        path[strcspn(path, "\n")] = '\0';
+        if (!*path) {
+            continue;
+        }
+
+        memset(&modules[num], 0, sizeof(modules[num]));
+        modules[num].start = start;
+        modules[num].end = end;
+        modules[num].offset = offset;
+        snprintf(modules[num].path, sizeof(modules[num].path), "%s", path);
+        modules[num].base = strrchr(modules[num].path, '/')
+                              ? strrchr(modules[num].path, '/') + 1
+                              : modules[num].path;
+        if (modules[num].path[0] == '/') {
+            profiler_load(&modules[num]);
+        }
+        num++;
+    }
+    fclose(maps);
+
+    return num;
+}
+
+static void profiler_load(profiler_module_t* module)
+{
+    int fd;
+    struct stat st;
+    const Elf64_Ehdr* ehdr;
+    const Elf64_Shdr* shdrs;
+    const Elf64_Shdr* symtab = NULL;
+    const Elf64_Shdr* strtab;
+    const Elf64_Sym* syms;
+    size_t i, num;
+    char* file;
+
+    fd = open(module->path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return;
+    }
+    if (fstat(fd, &st) || (size_t)st.st_size < sizeof(Elf64_Ehdr)) {
+        close(fd);
+        return;
+    }
+    file = (char*)mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (file == MAP_FAILED) {
+        return;
+    }
+    module->file = file;
+    module->file_size = (size_t)st.st_size;
+
+    // Cabecera, segmentos y secciones dentro del fichero
+    ehdr = (const Elf64_Ehdr*)file;
+    if (memcmp(ehdr->e_ident, ELFMAG, SELFMAG) ||
+        ehdr->e_ident[EI_CLASS] != ELFCLASS64 ||
+        ehdr->e_phoff + (uint64_t)ehdr->e_phnum * sizeof(Elf64_Phdr) >
+          module->file_size ||
+        ehdr->e_shoff + (uint64_t)ehdr->e_shnum * sizeof(Elf64_Shdr) >
+          module->file_size) {
+        return;
+    }
+    module->phdrs = (const Elf64_Phdr*)(file + ehdr->e_phoff);
+    module->num_phdrs = ehdr->e_phnum;
+    shdrs = (const Elf64_Shdr*)(file + ehdr->e_shoff);
+    for (i = 0; i < ehdr->e_shnum; i++) {
+        if (shdrs[i].sh_type == SHT_SYMTAB) {
+            symtab = &shdrs[i];
+            break;
+        }
+        if (shdrs[i].sh_type == SHT_DYNSYM) {
+            symtab = &shdrs[i];
+        }
+    }
+    if (!symtab || symtab->sh_link >= ehdr->e_shnum ||
+        symtab->sh_offset + symtab->sh_size > module->file_size) {
+        return;
+    }
+    strtab = &shdrs[symtab->sh_link];
+    if (strtab->sh_offset + strtab->sh_size > module->file_size ||
+        !strtab->sh_size) {
+        return;
+    }
+
+    syms = (const Elf64_Sym*)(file + symtab->sh_offset);
+    num = symtab->sh_size / sizeof(Elf64_Sym);
+    module->syms = (profiler_sym_t*)malloc((num ? num : 1) *
+                                           sizeof(profiler_sym_t));
+    if (!module->syms) {
+        return;
+    }
+    for (i = 0; i < num; i++) {
+        if (ELF64_ST_TYPE(syms[i].st_info) != STT_FUNC || !syms[i].st_value ||
+            syms[i].st_name >= strtab->sh_size) {
+            continue;
+        }
+        module->syms[module->num_syms].addr = syms[i].st_value;
+        module->syms[module->num_syms].size = syms[i].st_size;
+        module->syms[module->num_syms].name =
+          file + strtab->sh_offset + syms[i].st_name;
+        module->num_syms++;
+    }
+    // El ultimo byte de la tabla de cadenas debe cerrar el ultimo nombre
+    if (file[strtab->sh_offset + strtab->sh_size - 1] != '\0') {
+        module->num_syms = 0;
+    }
+    qsort(module->syms,
+          module->num_syms,
+          sizeof(profiler_sym_t),
+          profiler_cmp_sym);
+}
+
+static const char* profiler_symbol(profiler_module_t* modules,
+                                   size_t num,
+                                   uint64_t addr,
+                                   char* buf,
+                                   size_t size)
+{
+    profiler_module_t* module = NULL;
+    uint64_t file_off, vaddr = 0;
+    size_t i, lo, hi, mid;
+    bool found = false;
+
+    for (i = 0; i < num; i++) {
+        if (addr >= modules[i].start && addr < modules[i].end) {
+            module = &modules[i];
+            break;
+        }
+    }
+    if (!module) {
+        return "[unknown]";
+    }
+
+    // Direccion del proceso -> desplazamiento en el fichero -> direccion
+    // virtual del ELF, que es la de los simbolos
+    file_off = addr - module->start + module->offset;
+    for (i = 0; i < module->num_phdrs; i++) {
+        if (module->phdrs[i].p_type == PT_LOAD &&
+            file_off >= module->phdrs[i].p_offset &&
+            file_off < module->phdrs[i].p_offset + module->phdrs[i].p_filesz) {
+            vaddr = file_off - module->phdrs[i].p_offset +
+                    module->phdrs[i].p_vaddr;
+            found = true;
+            break;
+        }
+    }
+
+    if (found && module->num_syms && vaddr >= module->syms[0].addr) {
+        // Ultimo simbolo que empieza antes de la direccion
+        lo = 0;
+        hi = module->num_syms;
+        while (hi - lo > 1) {
+            mid = lo + (hi - lo) / 2;
+            if (module->syms[mid].addr <= vaddr) {
+                lo = mid;
+            } else {
+                hi = mid;
+            }
+        }
+        if (!module->syms[lo].size ||
+            vaddr < module->syms[lo].addr + module->syms[lo].size) {
+            return module->syms[lo].name;
+        }
+    }
+
+    snprintf(buf, size, "[%s]", module->base);
+
+    return buf;
+}
+
+static int profiler_cmp_sym(const void* a, const void* b)
+{
+    const profiler_sym_t* x = (const profiler_sym_t*)a;
+    const profiler_sym_t* y = (const profiler_sym_t*)b;
+
+    return (x->addr > y->addr) - (x->addr < y->addr);
+}
+
+static int profiler_cmp_line(const void* a, const void* b)
+{
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+static char* profiler_fold(profiler_thread_t* threads,
+                           profiler_raw_t* raw,
+                           size_t* len)
+{
+    profiler_module_t* modules = NULL;
+    char** lines = NULL;
+    char* out = NULL;
+    char* grown;
+    char line[PROFILER_LINE_SIZE], name[PROFILER_PATH_SIZE + 2];
+    const char* frame;
+    size_t num_modules, num_lines = 0, pos, off, i, j, count, size, used;
+    uint64_t depth, addr;
+
+    modules = (profiler_module_t*)calloc(PROFILER_MAX_MODULES,
+                                         sizeof(profiler_module_t));
+    lines = (char**)malloc((raw->len ? raw->len : 1) * sizeof(char*));
+    if (!modules || !lines) {
+        free(modules);
+        free(lines);
+        return NULL;
+    }
+    num_modules = profiler_modules(modules);
+
+    for (pos = 0; pos < raw->len; pos += 2 + depth) {
+        depth = raw->data[pos + 1];
+        off = (size_t)snprintf(
+          line, sizeof(line), "%s", threads[raw->data[pos]].comm);
+        // Los nombres no pueden llevar los separadores del formato
+        for (i = 0; i < off; i++) {
+            if (line[i] == ';' || line[i] == ' ') {
+                line[i] = '_';
+            }
+        }
+        // De la raiz a la hoja. Salvo la hoja, las direcciones son de
+        // retorno: se resta 1 para caer dentro de la llamada.
+        for (j = depth; j > 0 && off < sizeof(line) - 1; j--) {
+            addr = raw->data[pos + 1 + j];
+            if (j > 1) {
+                addr--;
+            }
+            frame = profiler_symbol(
+              modules, num_modules, addr, name, sizeof(name));
+            off += (size_t)snprintf(
+              line + off, sizeof(line) - off, ";%s", frame);
+        }
+        if (off >= sizeof(line)) {
+            off = sizeof(line) - 1;
+        }
+        line[off] = '\0';
+        lines[num_lines] = strdup(line);
+        if (lines[num_lines]) {
+            num_lines++;
+        }
+    }
+    qsort(lines, num_lines, sizeof(char*), profiler_cmp_line);
+
+    // Una linea por pila distinta con su numero de muestras
+    size = 4096;
+    used = 0;
+    out = (char*)malloc(size);
+    for (i = 0; out && i < num_lines; i += count) {
+        for (count = 1; i + count < num_lines &&
+                        !strcmp(lines[i], lines[i + count]);
+             count++) {
+        }
+        while (out && used + strlen(lines[i]) + 32 > size) {
+            size *= 2;
+            grown = (char*)realloc(out, size);
+            if (!grown) {
+                free(out);
+                out = NULL;
+            } else {
+                out = grown;
+            }
+        }
+        if (out) {
+            used += (size_t)sprintf(out + used, "%s %zu\n", lines[i], count);
+        }
+    }
+    if (out) {
+        out[used] = '\0';
+        *len = used;
+    }
+
+    for (i = 0; i < num_lines; i++) {
+        free(lines[i]);
+    }
+    free(lines);
+    for (i = 0; i < num_modules; i++) {
+        free(modules[i].syms);
+        if (modules[i].file) {
+            munmap(modules[i].file, modules[i].file_size);
+        }
+    }
+    free(modules);
+
+    return out;
+}
+
+void profiler_enable(bool enable)
+{
+    atomic_store(&disabled, !enable);
+}
@@ -0,0 +1,213 @@
+/*****************************************************************************
+ * ARCHIVO: sflight.c
+ * DESCRIPCION: Implementacion de la agrupacion de peticiones concurrentes
+ * identicas (single-flight).
+ *
+ * REFERENCIA: https://pkg.go.dev/golang.org/x/sync/singleflight
+ *
+ * NOTA: Las ejecuciones en curso se guardan en una tabla hash protegida por
+ * un unico mutex que solo se toma para registrar, buscar y retirar llamadas,
+ * nunca mientras se ejecuta la funcion de trabajo ni mientras se copia el
+ * resultado. El resultado compartido pertenece a la llamada, que cuenta sus
+ * referencias, y no cambia una vez publicado.
+ *
+ * FECHA CREACION: 19 Octubre de 2026
+ * AUTORES: Javier Mateos Najari, Adrian Sebastian Gil
+ *****************************************************************************/
+#include <pthread.h>
+#include <stdlib.h> // malloc
+#include <string.h> // strcmp
+
+#include "sflight.h"
+
+#define SFLIGHT_BUCKETS 64 // Numero de cubetas de la tabla de llamadas
+
+// Ejecucion en curso para una clave
+typedef struct sflight_call {
+    char* key;                 // Clave de la ejecucion
+    int status;                // Codigo devuelto por la funcion de trabajo
+    char* data;                // Resultado compartido con los que esperan
+    size_t len;                // Longitud del resultado
+    size_t refs;               // Hilos que mantienen la referencia
+    size_t waiters;            // Hilos esperando el resultado
+    bool done;                 // Indica que el resultado esta disponible
+    pthread_cond_t done_cond;  // Indica que la ejecucion ha terminado
+    struct sflight_call* next; // Siguiente llamada de la cubeta
+} sflight_call_t;
+
+// Grupo de ejecuciones
+struct sflight {
+    sflight_call_t* buckets[SFLIGHT_BUCKETS]; // Llamadas en curso
+    pthread_mutex_t mutex;                    // Sincroniza el acceso a la tabla
+};
+
+/*******************************************************************************
+ * FUNCION: static size_t sflight_hash(const char* key)
+ * ARGS_IN: const char* key - clave de la que se obtiene el hash.
+ * DESCRIPCION: Calcula la cubeta de una clave (FNV-1a).
+ * ARGS_OUT: size_t - indice de la cubeta.
+ ******************************************************************************/
+static size_t sflight_hash(const char* key);
+
+/*******************************************************************************
+ * FUNCION: static void sflight_call_release(sflight_call_t* call)
+ * ARGS_IN: sflight_call_t* call - llamada de la que se suelta la referencia.
+ * DESCRIPCION: Suelta una referencia de la llamada y la libera si era la
+ *              ultima. Debe llamarse con el mutex del grupo tomado.
+ ******************************************************************************/
+static void sflight_call_release(sflight_call_t* call);
+
+static size_t sflight_hash(const char* key)
+{
+    size_t hash = 2166136261u;
+
+    while (*key) {
+        hash ^= (unsigned char)*key++;
+        hash *= 16777619u;
+    }
+
+    return hash % SFLIGHT_BUCKETS;
+}
+
+static void sflight_call_release(sflight_call_t* call)
+{
+    if (--call->refs > 0) {
+        return;
+    }
+
+    pthread_cond_destroy(&(call->done_cond));
+    free(call->data);
+    free(call->key);
+    free(call);
+}
+
+sflight_t* sflight_create()
+{
+    sflight_t* sf = NULL;
+
+    sf = (sflight_t*)calloc(1, sizeof(sflight_t));
+    if (!sf) {
+        return NULL;
+    }
+
+    pthread_mutex_init(&(sf->mutex), NULL);
+
+    return sf;
+}
+
+void sflight_destroy(sflight_t* sf)
+{
+    if (!sf) {
+        return;
+    }
+
+    pthread_mutex_destroy(&(sf->mutex));
+    free(sf);
+}
+
+int sflight_do(sflight_t* sf,
+               const char* key,
+               sflight_func_t func,
+               void* arg,
+               char** data,
+               size_t* len,
+               bool* shared)
+{
+    size_t bucket, waiters;
+    int status;
+    char* result = NULL;
+    sflight_call_t* call = NULL;
+    sflight_call_t** prev = NULL;
+
+    *data = NULL;
+    *len = 0;
+    if (shared) {
+        *shared = false;
+    }
+
+    if (!sf || !key) {
+        return func(arg, data, len);
+    }
+
+    bucket = sflight_hash(key);
+
+    pthread_mutex_lock(&(sf->mutex));
+    for (call = sf->buckets[bucket]; call; call = call->next) {
+        if (!strcmp(call->key, key)) {
+            break;
+        }
+    }
+
+    if (call) {
+        // Ya hay una ejecucion en curso, esperamos a su resultado
+        call->refs++;
+        call->waiters++;
+        while (!call->done) {
+            pthread_cond_wait(&(call->done_cond), &(sf->mutex));
+        }
+        pthread_mutex_unlock(&(sf->mutex));
+
+        // El resultado publicado no cambia y nuestra referencia lo mantiene,
+        // asi que se copia sin el mutex
+        status = call->status;
+        if (call->data) {
+            *data = (char*)malloc(call->len + 1);
+            if (*data) {
+                memcpy(*data, call->data, call->len);
+                (*data)[call->len] = '\0';
+                *len = call->len;
+            }
+        }
+
+        pthread_mutex_lock(&(sf->mutex));
+        sflight_call_release(call);
+        pthread_mutex_unlock(&(sf->mutex));
+        if (shared) {
+            *shared = true;
+        }
+        return status;
+    }
+
+    // Somos los primeros, registramos la llamada
+    call = (sflight_call_t*)calloc(1, sizeof(sflight_call_t));
+    if (!call || !(call->key = strdup(key))) {
+        pthread_mutex_unlock(&(sf->mutex));
+        free(call);
+        return func(arg, data, len);
+    }
+    call->refs = 1;
+    pthread_cond_init(&(call->done_cond), NULL);
+    call->next = sf->buckets[bucket];
+    sf->buckets[bucket] = call;
+    pthread_mutex_unlock(&(sf->mutex));
+
+    status = func(arg, data, len);
+
+    pthread_mutex_lock(&(sf->mutex));
+    // Retiramos la llamada de la tabla para que las siguientes peticiones
+    // vuelvan a ejecutar la funcion. Desde aqui no se unen mas hilos.
+    for (prev = &(sf->buckets[bucket]); *prev != call; prev = &(*prev)->next)
+        ;
+    *prev = call->next;
+    waiters = call->waiters;
+    pthread_mutex_unlock(&(sf->mutex));
+
+    // Solo copiamos el resultado si alguien lo esta esperando
+    if (waiters && *data) {
+        result = (char*)malloc(*len + 1);
+        if (result) {
+            memcpy(result, *data, *len);
+        }
+    }
+
+    pthread_mutex_lock(&(sf->mutex));
+    call->status = status;
+    call->data = result;
+    call->len = result ? *len : 0;
+    call->done = true;
+    pthread_cond_broadcast(&(call->done_cond));
+    sflight_call_release(call);
+    pthread_mutex_unlock(&(sf->mutex));
+
+    return status;
+}
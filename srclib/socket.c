@@ -6,15 +6,69 @@
  * FECHA CREACION: 25 Marzo de 2021
  * AUTORES: Javier Mateos Najari, Adrian Sebastian Gil
  *****************************************************************************/
+#define _GNU_SOURCE     // accept4
 #include <arpa/inet.h>  // inet_ntop
+#include <errno.h>      // errno
+#include <limits.h>     // INT_MAX
 #include <netdb.h>      // addrinfo, getaddrinfo
+#include <poll.h>       // poll
 #include <string.h>     // memset
+#include <sys/epoll.h>  // EPOLLIN
 #include <sys/socket.h> // getaddrinfo, socket, setsockopt, bind, listen, accept
 #include <unistd.h>     // close
 
+#include "evloop.h"
 #include "socket.h"
+#include "twheel.h"
+
+/*******************************************************************************
+ * FUNCION: static int socket_wait(int sock_fd, uint32_t events,
+ *                                 uint64_t deadline)
+ * ARGS_IN: int sock_fd - Descriptor de fichero del socket.
+ *          uint32_t events - EPOLLIN o EPOLLOUT.
+ *          uint64_t deadline - Instante limite (0: sin limite).
+ * DESCRIPCION: Espera a que el socket este listo. En el hilo de un bucle de
+ *              eventos cede la corrutina; en cualquier otro hilo usa poll.
+ * ARGS_OUT: int - 0 si esta listo o -1 en caso de error o de expirar la
+ *                 espera (errno ETIMEDOUT).
+ ******************************************************************************/
+static int socket_wait(int sock_fd, uint32_t events, uint64_t deadline);
+
+static int socket_wait(int sock_fd, uint32_t events, uint64_t deadline)
+{
+    struct pollfd pfd;
+    uint64_t now;
+    int ms, ret;
+
+    if (evloop_inside()) {
+        return evloop_wait(sock_fd, events, deadline);
+    }
+
+    // EPOLLIN y EPOLLOUT valen lo mismo que POLLIN y POLLOUT
+    pfd.fd = sock_fd;
+    pfd.events = (short)events;
+    while (1) {
+        ms = -1;
+        if (deadline) {
+            now = twheel_clock();
+            if (now >= deadline) {
+                errno = ETIMEDOUT;
+                return -1;
+            }
+            ms = deadline - now > INT_MAX ? INT_MAX : (int)(deadline - now);
+        }
 
-int socket_init(char* port, int backlog)
+        ret = poll(&pfd, 1, ms);
+        if (ret > 0) {
+            return 0;
+        }
+        if (ret == -1 && errno != EINTR) {
+            return -1;
+        }
+    }
+}
+
+int socket_init(char* host, char* port, int backlog)
 {
     int sock_fd; // Escucha en sock_fd
     struct addrinfo hints, *servinfo, *p;
@@ -27,14 +81,16 @@ int socket_init(char* port, int backlog)
     hints.ai_socktype = SOCK_STREAM;
     hints.ai_flags = AI_PASSIVE; // use my IP
 
-    rv = getaddrinfo(NULL, port, &hints, &servinfo);
+    rv = getaddrinfo(host, port, &hints, &servinfo);
     if (rv != 0) {
         return -1;
     }
 
     // Loop a traves de todos los resultados y bindeamos el primero que podemos
     for (p = servinfo; p != NULL; p = p->ai_next) {
-        sock_fd = socket(p->ai_family, p->ai_socktype, p->ai_protocol);
+        // Los scripts no deben heredar el socket del servidor
+        sock_fd = socket(
+          p->ai_family, p->ai_socktype | SOCK_CLOEXEC, p->ai_protocol);
         if (sock_fd == -1) {
             continue;
         }
@@ -65,53 +121,97 @@ int socket_init(char* port, int backlog)
     return sock_fd;
 }
 
-int socket_accept(int sock_fd)
+int socket_accept(int sock_fd, struct sockaddr_in* peer)
 {
     int new_fd;
     socklen_t sin_size;
-    struct sockaddr their_addr; // informacion de la direccion del cliente
+    struct sockaddr_storage their_addr; // direccion del cliente
 
     sin_size = sizeof their_addr;
-    // Aceptamos una nueva conexion
-    new_fd = accept(sock_fd, &their_addr, &sin_size);
+    // Aceptamos una nueva conexion. Los scripts no deben heredar el socket
+    // del cliente porque lo mantendrian abierto tras cerrar la conexion.
+    new_fd = accept4(
+      sock_fd, (struct sockaddr*)&their_addr, &sin_size, SOCK_CLOEXEC);
     if (new_fd == -1) {
         return -1;
     }
 
+    if (their_addr.ss_family == AF_INET) {
+        memcpy(peer, &their_addr, sizeof(struct sockaddr_in));
+    } else {
+        memset(peer, 0, sizeof(struct sockaddr_in));
+    }
+
     return new_fd;
 }
 
 int socket_send(int sock_fd,
                 char* response_header,
                 char* response_body,
-                int response_body_len)
+                int response_body_len,
+                int timeout_ms)
+{
+    // Un unico limite para la respuesta entera
+    uint64_t deadline = socket_deadline(timeout_ms);
+
+    // Enviamos la cabecera de la respuesta
+    if (socket_write(
+          sock_fd, response_header, strlen(response_header), deadline)) {
+        return -1;
+    }
+
+    // Enviamos el cuerpo de la cabecera
+    if (response_body_len > 0 &&
+        socket_write(sock_fd, response_body, response_body_len, deadline)) {
+        // TODO: Revisar error ya que la cabecera ha sido enviada
+        return -1;
+    }
+
+    return 0;
+}
+
+ssize_t socket_recv(int sock_fd, char* buf, size_t len, uint64_t deadline)
 {
     ssize_t bytes;
-    ssize_t offset;
-
-    offset = 0;
-    do {
-        // Enviamos la cabecera de la respuesta
-        bytes = send(sock_fd,
-                     response_header + offset,
-                     strlen(response_header) - offset,
-                     0);
-        if (bytes == -1) {
+
+    while (1) {
+        // Nunca bloqueamos en recv: la espera la hace socket_wait con limite
+        bytes = recv(sock_fd, buf, len, MSG_DONTWAIT);
+        if (bytes >= 0) {
+            return bytes;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        if ((errno != EAGAIN && errno != EWOULDBLOCK) ||
+            socket_wait(sock_fd, EPOLLIN, deadline)) {
             return -1;
         }
-        offset += bytes;
-    } while (offset < (ssize_t)strlen(response_header));
-    offset = 0;
-    do {
-        // Enviamos el cuerpo de la cabecera
-        bytes =
-          send(sock_fd, response_body + offset, response_body_len - offset, 0);
-        if (bytes == -1) {
-            // TODO: Revisar error ya que la cabecera ha sido enviada
+    }
+}
+
+int socket_write(int sock_fd, const char* buf, size_t len, uint64_t deadline)
+{
+    ssize_t bytes;
+    size_t offset = 0;
+
+    while (offset < len) {
+        bytes = send(
+          sock_fd, buf + offset, len - offset, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (bytes >= 0) {
+            offset += bytes;
+        } else if (errno == EINTR) {
+            continue;
+        } else if ((errno != EAGAIN && errno != EWOULDBLOCK) ||
+                   socket_wait(sock_fd, EPOLLOUT, deadline)) {
             return -1;
         }
-        offset += bytes;
-    } while (offset < response_body_len);
+    }
 
     return 0;
 }
+
+uint64_t socket_deadline(int timeout_ms)
+{
+    return timeout_ms > 0 ? twheel_clock() + (uint64_t)timeout_ms : 0;
+}
@@ -0,0 +1,335 @@
+/*****************************************************************************
+ * ARCHIVO: topology.c
+ * DESCRIPCION: Implementacion del descubrimiento de la topologia de CPUs.
+ *
+ * REFERENCIA: https://www.kernel.org/doc/Documentation/ABI/stable/sysfs-devices-system-cpu
+ *
+ * FECHA CREACION: 19 Octubre de 2026
+ * AUTORES: Javier Mateos Najari, Adrian Sebastian Gil
+ *****************************************************************************/
+#include <dirent.h> // opendir, readdir
+#include <stdlib.h> // malloc, qsort
+#include <string.h> // strncmp
+
+#include "topology.h"
+
+#define TOPOLOGY_SYSFS "/sys/devices/system" // Raiz de la topologia en sysfs
+#define TOPOLOGY_MAX_PATH 256                  // Tamanio maximo de una ruta
+#define TOPOLOGY_MAX_LIST 4096                 // Tamanio maximo de una lista
+
+/*******************************************************************************
+ * FUNCION: static int topology_read_int(const char* path, int def)
+ * ARGS_IN: const char* path - fichero de sysfs.
+ *          int def - valor si no se puede leer.
+ * DESCRIPCION: Lee un entero de un fichero de sysfs.
+ * ARGS_OUT: int - valor leido.
+ ******************************************************************************/
+static int topology_read_int(const char* path, int def);
+
+/*******************************************************************************
+ * FUNCION: static int topology_read_list(const char* path,
+ *                                        int** ids,
+ *                                        size_t* num)
+ * ARGS_IN: const char* path - fichero de sysfs con una lista de CPUs.
+ *          int** ids - donde se devuelve el array de CPUs (malloc).
+ *          size_t* num - donde se devuelve el numero de CPUs.
+ * DESCRIPCION: Lee una lista de CPUs con el formato de sysfs ("0-3,8,10-11").
+ * ARGS_OUT: int - 0 si se ha leido o -1 en caso de error.
+ ******************************************************************************/
+static int topology_read_list(const char* path, int** ids, size_t* num);
+
+/*******************************************************************************
+ * FUNCION: static topology_cpu_t* topology_find(topology_t* topo, int id)
+ * ARGS_IN: topology_t* topo - topologia.
+ *          int id - numero de la CPU.
+ * DESCRIPCION: Busca una CPU por su numero.
+ * ARGS_OUT: topology_cpu_t* - CPU o NULL si no esta en linea.
+ ******************************************************************************/
+static topology_cpu_t* topology_find(topology_t* topo, int id);
+
+/*******************************************************************************
+ * FUNCION: static void topology_read_nodes(topology_t* topo)
+ * ARGS_IN: topology_t* topo - topologia con las CPUs ya leidas.
+ * DESCRIPCION: Asigna cada CPU a su nodo NUMA.
+ ******************************************************************************/
+static void topology_read_nodes(topology_t* topo);
+
+/*******************************************************************************
+ * FUNCION: static int topology_build_spread(topology_t* topo)
+ * ARGS_IN: topology_t* topo - topologia completa.
+ * DESCRIPCION: Calcula el orden de reparto de hilos: un hilo por core fisico
+ *              alternando nodos y, cuando no quedan cores, los hermanos SMT.
+ * ARGS_OUT: int - 0 si se ha calculado o -1 en caso de error.
+ ******************************************************************************/
+static int topology_build_spread(topology_t* topo);
+
+// CPUs de la topologia que se esta ordenando (qsort no admite contexto)
+static _Thread_local const topology_cpu_t* topology_sorting = NULL;
+
+static int topology_cmp_spread(const void* a, const void* b)
+{
+    const topology_cpu_t* x = &topology_sorting[*(const size_t*)a];
+    const topology_cpu_t* y = &topology_sorting[*(const size_t*)b];
+
+    if (x->sibling != y->sibling) {
+        return x->sibling - y->sibling;
+    }
+    if (x->rank != y->rank) {
+        return x->rank - y->rank;
+    }
+    if (x->node != y->node) {
+        return x->node - y->node;
+    }
+    return x->id - y->id;
+}
+
+static int topology_read_int(const char* path, int def)
+{
+    FILE* file = NULL;
+    int value;
+
+    file = fopen(path, "r");
+    if (!file) {
+        return def;
+    }
+    if (fscanf(file, "%d", &value) != 1) {
+        value = def;
+    }
+    fclose(file);
+
+    return value;
+}
+
+static int topology_read_list(const char* path, int** ids, size_t* num)
+{
+    FILE* file = NULL;
+    char list[TOPOLOGY_MAX_LIST];
+    char* token = NULL;
+    char* save = NULL;
+    int first, last, i;
+    int* tmp = NULL;
+    size_t cap = 0;
+
+    *ids = NULL;
+    *num = 0;
+
+    file = fopen(path, "r");
+    if (!file) {
+        return -1;
+    }
+    if (!fgets(list, sizeof(list), file)) {
+        fclose(file);
+        return -1;
+    }
+    fclose(file);
+
+    for (token = strtok_r(list, ",\n", &save); token;
+         token = strtok_r(NULL, ",\n", &save)) {
+        switch (sscanf(token, "%d-%d", &first, &last)) {
+            case 1:
+                last = first;
+                break;
+            case 2:
+                break;
+            default:
+                continue;
+        }
+        for (i = first; i <= last; i++) {
+            if (*num == cap) {
+                cap = cap ? cap * 2 : 16;
+                tmp = (int*)realloc(*ids, cap * sizeof(int));
+                if (!tmp) {
+                    free(*ids);
+                    *ids = NULL;
+                    *num = 0;
+                    return -1;
+                }
+                *ids = tmp;
+            }
+            (*ids)[(*num)++] = i;
+        }
+    }
+
+    return 0;
+}
+
+static topology_cpu_t* topology_find(topology_t* topo, int id)
+{
+    size_t i;
+
+    for (i = 0; i < topo->num_cpus; i++) {
+        if (topo->cpus[i].id == id) {
+            return &topo->cpus[i];
+        }
+    }
+
+    return NULL;
+}
+
+static void topology_read_nodes(topology_t* topo)
+{
+    char path[TOPOLOGY_MAX_PATH];
+    topology_cpu_t* cpu = NULL;
+    struct dirent* entry = NULL;
+    DIR* dir = NULL;
+    int* ids = NULL;
+    size_t num, i;
+    int node;
+
+    topo->num_nodes = 1;
+    dir = opendir(TOPOLOGY_SYSFS "/node");
+    if (!dir) {
+        return;
+    }
+
+    while ((entry = readdir(dir))) {
+        if (strncmp(entry->d_name, "node", 4) ||
+            sscanf(entry->d_name + 4, "%d", &node) != 1) {
+            continue;
+        }
+        snprintf(
+          path, sizeof(path), TOPOLOGY_SYSFS "/node/node%d/cpulist", node);
+        if (topology_read_list(path, &ids, &num) == -1) {
+            continue;
+        }
+        for (i = 0; i < num; i++) {
+            cpu = topology_find(topo, ids[i]);
+            if (cpu) {
+                cpu->node = node;
+            }
+        }
+        free(ids);
+        if (node + 1 > (int)topo->num_nodes) {
+            topo->num_nodes = node + 1;
+        }
+    }
+    closedir(dir);
+}
+
+static int topology_build_spread(topology_t* topo)
+{
+    size_t* cores = NULL;
+    size_t i, j;
+
+    // Posicion de cada core dentro de su nodo
+    cores = (size_t*)calloc(topo->num_nodes, sizeof(size_t));
+    topo->spread = (size_t*)malloc(topo->num_cpus * sizeof(size_t));
+    if (!cores || !topo->spread) {
+        free(cores);
+        return -1;
+    }
+    for (i = 0; i < topo->num_cpus; i++) {
+        if (!topo->cpus[i].sibling) {
+            topo->cpus[i].rank = cores[topo->cpus[i].node]++;
+        }
+    }
+    for (i = 0; i < topo->num_cpus; i++) {
+        for (j = 0; topo->cpus[i].sibling && j < topo->num_cpus; j++) {
+            if (!topo->cpus[j].sibling &&
+                topo->cpus[j].core == topo->cpus[i].core) {
+                topo->cpus[i].rank = topo->cpus[j].rank;
+            }
+        }
+        topo->spread[i] = i;
+    }
+    free(cores);
+
+    topology_sorting = topo->cpus;
+    qsort(topo->spread, topo->num_cpus, sizeof(size_t), topology_cmp_spread);
+    topology_sorting = NULL;
+
+    return 0;
+}
+
+topology_t* topology_discover()
+{
+    topology_t* topo = NULL;
+    topology_cpu_t* cpu = NULL;
+    char path[TOPOLOGY_MAX_PATH];
+    int* ids = NULL;
+    int* core_ids = NULL;
+    size_t num, i, j;
+
+    topo = (topology_t*)calloc(1, sizeof(topology_t));
+    if (!topo) {
+        return NULL;
+    }
+
+    if (topology_read_list(TOPOLOGY_SYSFS "/cpu/online", &ids, &num) == -1 ||
+        !num) {
+        free(ids);
+        free(topo);
+        return NULL;
+    }
+    topo->cpus = (topology_cpu_t*)calloc(num, sizeof(topology_cpu_t));
+    core_ids = (int*)malloc(num * sizeof(int));
+    if (!topo->cpus || !core_ids) {
+        free(core_ids);
+        free(ids);
+        topology_destroy(topo);
+        return NULL;
+    }
+    topo->num_cpus = num;
+
+    // Socket y core de cada CPU. El core_id solo es unico dentro del socket.
+    for (i = 0; i < num; i++) {
+        cpu = &topo->cpus[i];
+        cpu->id = ids[i];
+        snprintf(path,
+                 sizeof(path),
+                 TOPOLOGY_SYSFS "/cpu/cpu%d/topology/physical_package_id",
+                 cpu->id);
+        cpu->package = topology_read_int(path, 0);
+        snprintf(path,
+                 sizeof(path),
+                 TOPOLOGY_SYSFS "/cpu/cpu%d/topology/core_id",
+                 cpu->id);
+        core_ids[i] = topology_read_int(path, cpu->id);
+
+        cpu->core = -1;
+        for (j = 0; j < i; j++) {
+            if (topo->cpus[j].package == cpu->package &&
+                core_ids[j] == core_ids[i]) {
+                // Hermano SMT de un core ya visto
+                cpu->core = topo->cpus[j].core;
+                cpu->sibling++;
+            }
+        }
+        if (cpu->core == -1) {
+            cpu->core = topo->num_cores++;
+        }
+        if (cpu->package + 1 > (int)topo->num_packages) {
+            topo->num_packages = cpu->package + 1;
+        }
+    }
+    free(core_ids);
+    free(ids);
+
+    topology_read_nodes(topo);
+    if (topology_build_spread(topo) == -1) {
+        topology_destroy(topo);
+        return NULL;
+    }
+
+    return topo;
+}
+
+void topology_destroy(topology_t* topo)
+{
+    if (!topo) {
+        return;
+    }
+
+    free(topo->spread);
+    free(topo->cpus);
+    free(topo);
+}
+
+const topology_cpu_t* topology_spread(const topology_t* topo, size_t idx)
+{
+    if (!topo || !topo->num_cpus) {
+        return NULL;
+    }
+
+    return &topo->cpus[topo->spread[idx % topo->num_cpus]];
+}
@@ -6,183 +6,801 @@
  *
  * MODIFICACIONES: Se ha añadido un límite al tamanio de la cola de trabajo.
  * Además, se ha mantenido la referencia a los threads para sincronizar la
- * finalizacion del pool de hilos.
+ * finalizacion del pool de hilos. La cola de trabajo es una cola MPMC sin
+ * bloqueos reservada al crear el pool (ver mpmc.c), de modo que encolar y
+ * desencolar no reservan memoria ni toman ningun mutex. Los hilos sin
+ * trabajo (y los productores con la cola llena) duermen en un eventcount
+ * (ver evcount.c), de modo que cada trabajo despierta como mucho a un hilo.
+ * En el modo de robo de trabajo cada hilo tiene ademas una cola de Chase-Lev
+ * (ver wsdeque.c) para los trabajos que aniade el propio hilo, y la cola MPMC
+ * queda para los trabajos que llegan de fuera del pool.
  *
- * NOTA: Las condiciones de espera en las funciones estan rodeadas por bucles
- * que comprueban si las condiciones de espera verdaderamente deben
- * interrumpirse.
+ * El numero de hilos es elastico entre un minimo y un maximo: cada trabajo
+ * lleva el instante en que se encolo y, si al sacarlo ha esperado mas que el
+ * objetivo, se crea un hilo mas. Como con todos los hilos bloqueados nadie
+ * saca trabajos, un hilo monitor revisa la cola cada intervalo objetivo
+ * mientras haya trabajos esperando y crece si no ha avanzado. Los hilos por
+ * encima del minimo terminan tras pasar un tiempo dormidos sin trabajo.
+ * El minimo y el maximo se pueden cambiar con el pool en marcha (ver
+ * tpool_resize) dentro de los huecos reservados al crearlo.
  *
- * https://www.man7.org/linux/man-pages/man3/pthread_cond_broadcast.3p.html#top_of_page
+ * Los hilos se pueden fijar a un core o a un nodo NUMA (ver topology.c). Un
+ * hilo fijado usa la politica de memoria MPOL_LOCAL y reserva el mismo su
+ * cola propia, de modo que su pila, su arena de malloc y su cola quedan en
+ * la memoria de su nodo.
+ *
+ * Para controlar la sobrecarga se puede aplicar CoDel al sacar los trabajos
+ * (ver tpool_codel_drop). El estado de CoDel esta protegido por un mutex que
+ * solo se toma cuando la espera en cola supera el objetivo.
+ *
+ * NOTA: Antes de dormir, un hilo sin trabajo espera activamente durante un
+ * numero de iteraciones que se adapta a lo que ha ocurrido antes: se duplica
+ * si la espera activa encontro trabajo y se reduce a la mitad si el hilo
+ * acabo durmiendo. Asi, con trafico sostenido los hilos no llegan a dormir y
+ * con trafico escaso no malgastan CPU.
  *
  * FECHA CREACION: 4 Marzo de 2021
  * AUTORES: Javier Mateos Najari, Adrian Sebastian Gil
  *****************************************************************************/
+#define _GNU_SOURCE          // pthread_attr_setaffinity_np
+#include <linux/mempolicy.h> // MPOL_LOCAL
 #include <pthread.h>
-#include <signal.h> // sigaddset, sigemptyset
-#include <stdlib.h> // malloc
+#include <sched.h>       // sched_yield, CPU_SET
+#include <signal.h>      // sigaddset, sigemptyset
+#include <stdatomic.h>   // atomic_size_t
+#include <stdint.h>      // uint64_t
+#include <stdlib.h>      // malloc
+#include <sys/syscall.h> // SYS_set_mempolicy
+#include <time.h>        // clock_gettime
+#include <unistd.h>      // syscall
 
+#include "evcount.h"
+#include "mpmc.h"
+#include "probes.h"
+#include "topology.h"
 #include "tpool.h"
+#include "wsdeque.h"
+
+#define TPOOL_SPIN_MIN 16   // Minimo de iteraciones de espera activa
+#define TPOOL_SPIN_MAX 4096 // Maximo de iteraciones de espera activa
+#define TPOOL_TARGET_MS 5   // Espera en cola por defecto antes de crecer
+#define TPOOL_IDLE_MS 10000 // Reposo por defecto antes de retirar un hilo
+#define TPOOL_CODEL_INTERVAL_MS 100 // Intervalo por defecto de CoDel
+
+// Estado del hueco de un hilo
+enum { TPOOL_SLOT_FREE, TPOOL_SLOT_RUNNING, TPOOL_SLOT_EXITED };
+
+// Pausa dentro de la espera activa
+#if defined(__x86_64__) || defined(__i386__)
+#define tpool_cpu_relax() __builtin_ia32_pause()
+#elif defined(__aarch64__)
+#define tpool_cpu_relax() __asm__ __volatile__("yield")
+#else
+#define tpool_cpu_relax() sched_yield()
+#endif
 
-// Contenedor de trabajo
+// Contenedor de trabajo (se copia por valor en la cola)
 typedef struct tpool_work {
-    thread_func_t func;      // Funcion trabajo
-    void* arg;               // Argumentos de la funcion
-    struct tpool_work* next; // Siguiente trabajo de la cola de trabajos
+    thread_func_t func; // Funcion trabajo
+    void* arg;          // Argumentos de la funcion
+    uint64_t added;     // Instante en que se encolo (ns)
 } tpool_work_t;
 
+// Hilo del pool
+typedef struct tpool_thread {
+    tpool_t* tm;                // Pool al que pertenece el hilo
+    pthread_t thread;           // Referencia al thread
+    atomic_int state;           // Estado del hueco (TPOOL_SLOT_*)
+    _Atomic(wsdeque_t*) local;  // Cola propia (solo en TPOOL_MODE_STEAL)
+    unsigned seed;              // Semilla para elegir a quien robar
+    int cpu;                    // CPU a la que se fija (-1: ninguna)
+    int node;                   // Nodo al que se fija (-1: ninguno)
+} tpool_thread_t;
+
 // Contenedor de hilos
 struct tpool {
-    pthread_t* threads;         // Mantiene la referencia a todos los threads
-    tpool_work_t* work_first;   // Primer elemento de la cola de trabajos
-    tpool_work_t* work_last;    // Ultimo elemento de la cola de trabajos
-    pthread_mutex_t work_mutex; // Sincroniza el acceso a la cola de trabajo
-    pthread_cond_t work_cond;   // Indica que hay trabajo que procesar
-    pthread_cond_t gap_cond;    // Indica que hay sitio en la cola
-    size_t num_threads;         // Indica cuantos threads estan vivos
-    size_t queue_size;          // Indica el tamanio max de la cola de trabajo
-    size_t work_cnt;            // Indica el tamanio actual de la cola
-    bool stop;                  // Para los hilos
+    tpool_thread_t* workers;    // Huecos de todos los threads posibles
+    size_t num_slots;           // Huecos reservados (limite del maximo)
+    atomic_size_t used_slots;   // Huecos que han tenido un hilo alguna vez
+    tpool_mode_t mode;          // Modo de reparto del trabajo
+    tpool_affinity_t affinity;  // Fijacion de los hilos a CPUs
+    const topology_t* topo;     // Topologia para fijar los hilos
+    size_t queue_size;          // Capacidad de cada cola
+    mpmc_t* queue;              // Cola de trabajos (global en modo robo)
+    evcount_t work_ec;          // Indica que hay trabajo que procesar
+    evcount_t gap_ec;           // Indica que hay sitio en la cola
+    atomic_size_t min_threads;  // Hilos que siempre estan vivos
+    atomic_size_t max_threads;  // Maximo de hilos vivos
+    uint64_t target_ns;         // Espera en cola a partir de la que se crece
+    int idle_ms;                // Reposo tras el que se retira un hilo
+    pthread_mutex_t grow_mutex; // Sincroniza la creacion y retirada de hilos
+    pthread_t monitor;          // Hilo que vigila la cola (si es elastico)
+    bool monitored;             // Se ha lanzado el monitor
+    evcount_t backlog_ec;       // Indica que hay trabajos esperando
+    atomic_size_t live_cnt;     // Indica cuantos threads estan vivos
+    _Atomic uint64_t last_pop;  // Instante del ultimo trabajo extraido
+    atomic_size_t grown_cnt;    // Indica cuantos hilos se han creado de mas
+    atomic_size_t retired_cnt;  // Indica cuantos hilos se han retirado
+    atomic_size_t max_work_cnt; // Indica el tamanio maximo alcanzado
+    atomic_size_t active_cnt;   // Indica cuantos hilos ejecutan un trabajo
+    atomic_size_t done_cnt;     // Indica cuantos trabajos se han terminado
+    atomic_size_t rejected_cnt; // Indica cuantos trabajos se han rechazado
+    atomic_size_t stolen_cnt;   // Indica cuantos trabajos se han robado
+    atomic_size_t dropped_cnt;  // Indica cuantos trabajos ha descartado CoDel
+    atomic_bool timed;          // Los trabajos guardan cuando se encolaron
+    thread_func_t shed;         // Funcion para los trabajos descartados
+    uint64_t codel_target;      // Espera en cola aceptable (ns)
+    uint64_t codel_interval;    // Intervalo de CoDel (ns)
+    pthread_mutex_t codel_mutex;   // Sincroniza el estado de CoDel
+    atomic_bool codel_armed;       // Hay espera por encima del objetivo
+    bool codel_dropping;           // CoDel esta descartando
+    uint64_t codel_first_above;    // Fin del primer intervalo sobre objetivo
+    uint64_t codel_drop_next;      // Siguiente descarte
+    uint64_t codel_count;          // Descartes en el estado actual
+    uint64_t codel_last_count;     // Descartes del estado anterior
+    atomic_bool stop;           // Para los hilos
 };
 
+// Hilo del pool que ejecuta el codigo actual (NULL fuera de los pools)
+static _Thread_local tpool_thread_t* tpool_self = NULL;
+
+/*******************************************************************************
+ * FUNCION: static uint64_t tpool_now()
+ * DESCRIPCION: Obtiene el instante actual del reloj monotono.
+ * ARGS_OUT: uint64_t - instante actual en nanosegundos.
+ ******************************************************************************/
+static uint64_t tpool_now();
+
+/*******************************************************************************
+ * FUNCION: static bool tpool_spawn(tpool_thread_t* slot)
+ * ARGS_IN: tpool_thread_t* slot - hueco libre en el que se lanza el hilo.
+ * DESCRIPCION: Lanza un hilo en un hueco. Si el hueco tenia un hilo retirado
+ *              lo recoge antes. Debe llamarse con grow_mutex tomado o antes
+ *              de que el pool este en uso.
+ * ARGS_OUT: bool - true si se ha lanzado el hilo.
+ ******************************************************************************/
+static bool tpool_spawn(tpool_thread_t* slot);
+
+/*******************************************************************************
+ * FUNCION: static void tpool_place(tpool_t* tm, size_t idx, size_t offset)
+ * ARGS_IN: tpool_t* tm - Pool de hilos.
+ *          size_t idx - hueco del hilo.
+ *          size_t offset - posicion del primer hilo en el reparto.
+ * DESCRIPCION: Elige la CPU o el nodo al que se fija el hilo de un hueco.
+ ******************************************************************************/
+static void tpool_place(tpool_t* tm, size_t idx, size_t offset);
+
+/*******************************************************************************
+ * FUNCION: static void tpool_thread_init(tpool_thread_t* self)
+ * ARGS_IN: tpool_thread_t* self - Hilo que arranca.
+ * DESCRIPCION: Prepara el hilo antes de procesar trabajos: bloquea las
+ *              seniales, fija la politica de memoria local si esta fijado y
+ *              reserva su cola propia.
+ ******************************************************************************/
+static void tpool_thread_init(tpool_thread_t* self);
+
+/*******************************************************************************
+ * FUNCION: static void tpool_grow(tpool_t* tm)
+ * ARGS_IN: tpool_t* tm - Pool de hilos que crece.
+ * DESCRIPCION: Lanza un hilo mas si no se ha llegado al maximo.
+ ******************************************************************************/
+static void tpool_grow(tpool_t* tm);
+
+/*******************************************************************************
+ * FUNCION: static size_t tpool_queued(tpool_t* tm)
+ * ARGS_IN: tpool_t* tm - Pool de hilos.
+ * DESCRIPCION: Obtiene el numero aproximado de trabajos en todas las colas.
+ * ARGS_OUT: size_t - numero de trabajos esperando.
+ ******************************************************************************/
+static size_t tpool_queued(tpool_t* tm);
+
+/*******************************************************************************
+ * FUNCION: static void* tpool_monitor(void* arg)
+ * ARGS_IN: void* arg - Pool de hilos que se vigila.
+ * DESCRIPCION: Duerme mientras no haya trabajos esperando. Si los hay, cada
+ *              intervalo objetivo comprueba si algun hilo ha sacado trabajo
+ *              y, si no, lanza un hilo mas.
+ * ARGS_OUT: void* - NULL.
+ ******************************************************************************/
+static void* tpool_monitor(void* arg);
+
+/*******************************************************************************
+ * FUNCION: static uint64_t tpool_codel_next(tpool_t* tm, uint64_t t,
+ *                                          uint64_t count)
+ * ARGS_IN: tpool_t* tm - Pool de hilos.
+ *          uint64_t t - instante de referencia (ns).
+ *          uint64_t count - numero de descartes.
+ * DESCRIPCION: Ley de control de CoDel: t + intervalo / sqrt(count).
+ * ARGS_OUT: uint64_t - instante del siguiente descarte (ns).
+ ******************************************************************************/
+static uint64_t tpool_codel_next(tpool_t* tm, uint64_t t, uint64_t count);
+
+/*******************************************************************************
+ * FUNCION: static bool tpool_codel_drop(tpool_t* tm, uint64_t now,
+ *                                       uint64_t sojourn)
+ * ARGS_IN: tpool_t* tm - Pool de hilos.
+ *          uint64_t now - instante actual (ns).
+ *          uint64_t sojourn - tiempo que ha esperado el trabajo (ns).
+ * DESCRIPCION: Decide si se descarta el trabajo recien sacado (RFC 8289).
+ * ARGS_OUT: bool - true si se debe descartar.
+ ******************************************************************************/
+static bool tpool_codel_drop(tpool_t* tm, uint64_t now, uint64_t sojourn);
+
 /*******************************************************************************
- * FUNCION: static tpool_work_t* tpool_work_create(thread_func_t func,
- *                                                void* arg)
- * ARGS_IN: thread_func_t func - funcion de trabajo que ejecutara el hilo.
- *          void* arg - argumento de la funcion de trabajo.
- * DESCRIPCION: Crea e inicializa un trabajo.
- * ARGS_OUT: tpool_work_t* - trabajo inicializado.
+ * FUNCION: static bool tpool_retire(tpool_thread_t* self)
+ * ARGS_IN: tpool_thread_t* self - Hilo que se retira.
+ * DESCRIPCION: Retira al hilo si hay mas hilos vivos que el minimo.
+ * ARGS_OUT: bool - true si el hilo debe terminar.
  ******************************************************************************/
-static tpool_work_t* tpool_work_create(thread_func_t func, void* arg);
+static bool tpool_retire(tpool_thread_t* self);
 
 /*******************************************************************************
- * FUNCION: static void tpool_work_destroy(tpool_work_t* work);
- * ARGS_IN: tpool_work_t* work - trabajo que se destruye.
- * DESCRIPCION: Libera y destruye un trabajo y sus recursos asociados.
+ * FUNCION: static bool tpool_get_work(tpool_thread_t* self,
+ *                                     tpool_work_t* work)
+ * ARGS_IN: tpool_thread_t* self - Hilo que obtiene el trabajo.
+ *          tpool_work_t* work - donde se copia el trabajo extraido.
+ * DESCRIPCION: Obtiene un trabajo de la cola propia del hilo, de la cola de
+ *              trabajos del pool o, en modo robo, de la cola de otro hilo.
+ *              Si lo saca de la cola del pool avisa a un productor que espera
+ *              sitio, si lo hay.
+ * ARGS_OUT: bool - true si se ha extraido un trabajo.
  ******************************************************************************/
-static void tpool_work_destroy(tpool_work_t* work);
+static bool tpool_get_work(tpool_thread_t* self, tpool_work_t* work);
 
 /*******************************************************************************
- * FUNCION: static tpool_work_t* tpool_get_work(tpool_t* tm);
- * ARGS_IN: tpool_t* tm - Pool de hilos del que se obtiene el trabajo.
- * DESCRIPCION: Obtiene un trabajo de la cola de trabajos de un pool de hilos.
- * ARGS_OUT: tpool_work_t* - trabajo extraido de la cola de trabajo.
+ * FUNCION: static bool tpool_steal_work(tpool_thread_t* self,
+ *                                       tpool_work_t* work)
+ * ARGS_IN: tpool_thread_t* self - Hilo que roba el trabajo.
+ *          tpool_work_t* work - donde se copia el trabajo robado.
+ * DESCRIPCION: Recorre las colas del resto de hilos empezando por una al
+ *              azar y roba el trabajo mas antiguo de la primera que no este
+ *              vacia.
+ * ARGS_OUT: bool - true si se ha robado un trabajo.
  ******************************************************************************/
-static tpool_work_t* tpool_get_work(tpool_t* tm);
+static bool tpool_steal_work(tpool_thread_t* self, tpool_work_t* work);
+
+/*******************************************************************************
+ * FUNCION: static bool tpool_wait_work(tpool_thread_t* self,
+ *                                      tpool_work_t* work,
+ *                                      unsigned* spin)
+ * ARGS_IN: tpool_thread_t* self - Hilo que obtiene el trabajo.
+ *          tpool_work_t* work - donde se copia el trabajo extraido.
+ *          unsigned* spin - iteraciones de espera activa del hilo.
+ * DESCRIPCION: Espera activamente a que haya trabajo y, si no llega, duerme
+ *              al hilo hasta que se le avise. Ajusta la espera activa.
+ * ARGS_OUT: bool - true si se ha extraido un trabajo o false si se debe
+ *                  parar o retirar el hilo.
+ ******************************************************************************/
+static bool tpool_wait_work(tpool_thread_t* self,
+                            tpool_work_t* work,
+                            unsigned* spin);
+
+/*******************************************************************************
+ * FUNCION: static void tpool_free(tpool_t* tm)
+ * ARGS_IN: tpool_t* tm - Pool de hilos que se libera.
+ * DESCRIPCION: Libera la memoria del pool de hilos y de sus colas. Los hilos
+ *              deben haber terminado.
+ ******************************************************************************/
+static void tpool_free(tpool_t* tm);
 
 /*******************************************************************************
  * FUNCION: static void* tpool_worker(void* arg);
  * ARGS_IN: void* arg - contiene los argumentos de la funcion
  * DESCRIPCION: Funcion que es ejecutada por todos los hilos y donde el trabajo
- *              es realizado por los mismos. Esta funcion espera hasta que haya 
+ *              es realizado por los mismos. Esta funcion espera hasta que haya
  *              trabajo que procesar y lo procesa.
  * ARGS_OUT: void* - NULL si todo ha ido correctamente.
  ******************************************************************************/
 static void* tpool_worker(void* arg);
 
-static tpool_work_t* tpool_work_create(thread_func_t func, void* arg)
+/*******************************************************************************
+ * FUNCION: static bool tpool_push_work(tpool_t* tm, tpool_work_t* work)
+ * ARGS_IN: tpool_t* tm - pool de hilos al que se aniade el trabajo.
+ *          tpool_work_t* work - trabajo que se aniade.
+ * DESCRIPCION: Encola un trabajo sin bloquear y avisa a un hilo dormido. En
+ *              modo robo, si lo llama un hilo del pool, el trabajo va a la
+ *              cola propia del hilo mientras quepa.
+ * ARGS_OUT: bool - true si se ha encolado o false si la cola esta llena.
+ ******************************************************************************/
+static bool tpool_push_work(tpool_t* tm, tpool_work_t* work);
+
+static uint64_t tpool_now()
 {
-    tpool_work_t* work = NULL;
+    struct timespec ts;
 
-    if (!func) {
-        return NULL;
-    }
+    clock_gettime(CLOCK_MONOTONIC, &ts);
 
-    work = (tpool_work_t*)malloc(sizeof(tpool_work_t));
-    if (!work) {
-        return NULL;
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void tpool_place(tpool_t* tm, size_t idx, size_t offset)
+{
+    const topology_cpu_t* cpu = NULL;
+    tpool_thread_t* slot = &tm->workers[idx];
+
+    slot->cpu = -1;
+    slot->node = -1;
+    if (tm->affinity == TPOOL_AFFINITY_NONE || !tm->topo) {
+        return;
     }
-    work->func = func;
-    work->arg = arg;
-    work->next = NULL;
 
-    return work;
+    // Un hilo por core fisico alternando nodos y despues los hermanos SMT
+    cpu = topology_spread(tm->topo, offset + idx);
+    if (!cpu) {
+        return;
+    }
+    slot->node = cpu->node;
+    if (tm->affinity == TPOOL_AFFINITY_CORE) {
+        slot->cpu = cpu->id;
+    }
 }
 
-static void tpool_work_destroy(tpool_work_t* work)
+static void tpool_thread_init(tpool_thread_t* self)
 {
-    if (!work) {
-        return;
+    tpool_t* tm = self->tm;
+    sigset_t set;
+
+    // Bloqueamos las señales que interrumpen el hilo principal.
+    sigemptyset(&set);
+    sigaddset(&set, SIGINT);
+    sigaddset(&set, SIGTERM);
+    sigaddset(&set, SIGHUP);
+    sigaddset(&set, SIGUSR2);
+    pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+    tpool_self = self;
+
+    // La memoria que toque el hilo a partir de ahora sale de su nodo
+    if (self->node != -1) {
+        syscall(SYS_set_mempolicy, MPOL_LOCAL, NULL, 0);
+    }
+
+    // La cola propia la reserva el hilo para que quede en su nodo. Si no
+    // hay memoria, sus trabajos van a la cola global.
+    if (tm->mode == TPOOL_MODE_STEAL && !atomic_load(&self->local)) {
+        atomic_store(&self->local,
+                     wsdeque_create(tm->queue_size, sizeof(tpool_work_t)));
     }
-    
-    free(work);
 }
 
-// Extrae de la cola de trabajos el siguiente trabajo a procesar por los hilos
-static tpool_work_t* tpool_get_work(tpool_t* tm)
+static bool tpool_spawn(tpool_thread_t* slot)
 {
-    tpool_work_t* work = NULL;
+    tpool_t* tm = slot->tm;
+    const topology_t* topo = tm->topo;
+    pthread_attr_t attr;
+    cpu_set_t cpus;
+    size_t i, used;
+    int ret;
 
-    if (!tm) {
-        return NULL;
+    if (atomic_load(&slot->state) == TPOOL_SLOT_EXITED) {
+        pthread_join(slot->thread, NULL);
+        atomic_store(&slot->state, TPOOL_SLOT_FREE);
     }
 
-    work = tm->work_first;
-    if (!work) {
-        return NULL;
+    // Fijamos el hilo antes de arrancarlo para que su pila quede en su nodo
+    pthread_attr_init(&attr);
+    if (slot->node != -1) {
+        CPU_ZERO(&cpus);
+        for (i = 0; i < topo->num_cpus; i++) {
+            if (slot->cpu == -1 ? topo->cpus[i].node == slot->node
+                                : topo->cpus[i].id == slot->cpu) {
+                CPU_SET(topo->cpus[i].id, &cpus);
+            }
+        }
+        pthread_attr_setaffinity_np(&attr, sizeof(cpus), &cpus);
+    }
+    ret = pthread_create(&slot->thread, &attr, tpool_worker, slot);
+    pthread_attr_destroy(&attr);
+    if (ret) {
+        return false;
     }
+    atomic_store(&slot->state, TPOOL_SLOT_RUNNING);
+    atomic_fetch_add(&tm->live_cnt, 1);
 
-    // Reorganizamos la cola de trabajos del pool de hilos
-    if (!work->next) {
-        // Ultimo trabajo
-        tm->work_first = NULL;
-        tm->work_last = NULL;
-    } else {
-        tm->work_first = work->next;
+    // Los recorridos de las colas propias llegan hasta el ultimo hueco usado
+    used = (size_t)(slot - tm->workers) + 1;
+    if (used > atomic_load(&tm->used_slots)) {
+        atomic_store(&tm->used_slots, used);
     }
 
-    // Avisamos de que hay espacio en la cola
-    tm->work_cnt--;
-    pthread_cond_signal(&(tm->gap_cond));
+    return true;
+}
 
-    return work;
+static void tpool_grow(tpool_t* tm)
+{
+    size_t i, max;
+
+    if (atomic_load_explicit(&tm->live_cnt, memory_order_relaxed) >=
+        atomic_load_explicit(&tm->max_threads, memory_order_relaxed)) {
+        return;
+    }
+
+    pthread_mutex_lock(&(tm->grow_mutex));
+    max = atomic_load(&tm->max_threads);
+    if (!atomic_load(&tm->stop) && atomic_load(&tm->live_cnt) < max) {
+        for (i = 0; i < max; i++) {
+            if (atomic_load(&tm->workers[i].state) != TPOOL_SLOT_RUNNING) {
+                if (tpool_spawn(&tm->workers[i])) {
+                    atomic_fetch_add_explicit(
+                      &tm->grown_cnt, 1, memory_order_relaxed);
+                }
+                break;
+            }
+        }
+    }
+    pthread_mutex_unlock(&(tm->grow_mutex));
 }
 
-// Se encarga de esperar a que haya trabajos y los procesa.
-static void* tpool_worker(void* arg)
+static size_t tpool_queued(tpool_t* tm)
+{
+    size_t i, queued, used;
+
+    queued = mpmc_size(tm->queue);
+    used = atomic_load_explicit(&tm->used_slots, memory_order_acquire);
+    for (i = 0; i < used; i++) {
+        queued += wsdeque_size(atomic_load_explicit(&tm->workers[i].local,
+                                                    memory_order_relaxed));
+    }
+
+    return queued;
+}
+
+static void* tpool_monitor(void* arg)
 {
     tpool_t* tm = arg;
-    tpool_work_t* work = NULL;
+    struct timespec interval;
+    unsigned key;
     sigset_t set;
 
-    // Bloqueamos las señales que interrumpen el hilo principal.
     sigemptyset(&set);
     sigaddset(&set, SIGINT);
     sigaddset(&set, SIGTERM);
+    sigaddset(&set, SIGHUP);
+    sigaddset(&set, SIGUSR2);
     pthread_sigmask(SIG_BLOCK, &set, NULL);
 
-    // Mantenemos el hilo corriendo hasta que deba parar
-    while (1) {
-        pthread_mutex_lock(&(tm->work_mutex));
+    interval.tv_sec = tm->target_ns / 1000000000;
+    interval.tv_nsec = tm->target_ns % 1000000000;
+
+    while (!atomic_load(&tm->stop)) {
+        // Dormimos hasta que un trabajo tenga que esperar en la cola
+        key = evcount_prepare_wait(&tm->backlog_ec);
+        if (atomic_load(&tm->stop)) {
+            evcount_cancel_wait(&tm->backlog_ec);
+            break;
+        }
+        if (!tpool_queued(tm)) {
+            evcount_wait(&tm->backlog_ec, key);
+            continue;
+        }
+        evcount_cancel_wait(&tm->backlog_ec);
+
+        // Si en un intervalo nadie ha sacado trabajo la cola esta atascada
+        nanosleep(&interval, NULL);
+        if (tpool_queued(tm) &&
+            atomic_load(&tm->active_cnt) >= atomic_load(&tm->live_cnt) &&
+            tpool_now() - atomic_load(&tm->last_pop) > tm->target_ns) {
+            tpool_grow(tm);
+        }
+    }
+
+    return NULL;
+}
+
+static uint64_t tpool_codel_next(tpool_t* tm, uint64_t t, uint64_t count)
+{
+    uint64_t x, y, n = count * 1000000;
+
+    // Raiz entera de count * 10^6 por el metodo de Newton
+    x = n;
+    y = (x + 1) / 2;
+    while (y < x) {
+        x = y;
+        y = (x + n / x) / 2;
+    }
+
+    return t + tm->codel_interval * 1000 / x;
+}
+
+static bool tpool_codel_drop(tpool_t* tm, uint64_t now, uint64_t sojourn)
+{
+    bool ok_to_drop = false, drop = false;
+    uint64_t delta;
+
+    // Con la cola vacia detras no se descarta aunque el trabajo haya esperado
+    if ((sojourn < tm->codel_target || !mpmc_size(tm->queue)) &&
+        !atomic_load_explicit(&tm->codel_armed, memory_order_relaxed)) {
+        return false;
+    }
+
+    pthread_mutex_lock(&(tm->codel_mutex));
+    if (sojourn < tm->codel_target || !mpmc_size(tm->queue)) {
+        tm->codel_first_above = 0;
+    } else if (!tm->codel_first_above) {
+        tm->codel_first_above = now + tm->codel_interval;
+    } else if (now >= tm->codel_first_above) {
+        ok_to_drop = true;
+    }
+
+    if (tm->codel_dropping) {
+        if (!ok_to_drop) {
+            tm->codel_dropping = false;
+        } else if (now >= tm->codel_drop_next) {
+            drop = true;
+            tm->codel_count++;
+            tm->codel_drop_next =
+              tpool_codel_next(tm, tm->codel_drop_next, tm->codel_count);
+        }
+    } else if (ok_to_drop) {
+        // Si se vuelve a descartar poco despues se retoma el ritmo anterior
+        drop = true;
+        tm->codel_dropping = true;
+        delta = tm->codel_count - tm->codel_last_count;
+        tm->codel_count = 1;
+        if (delta > 1 &&
+            now - tm->codel_drop_next < 16 * tm->codel_interval) {
+            tm->codel_count = delta;
+        }
+        tm->codel_drop_next = tpool_codel_next(tm, now, tm->codel_count);
+        tm->codel_last_count = tm->codel_count;
+    }
+    atomic_store_explicit(&tm->codel_armed,
+                          tm->codel_first_above || tm->codel_dropping,
+                          memory_order_relaxed);
+    pthread_mutex_unlock(&(tm->codel_mutex));
+
+    return drop;
+}
+
+static bool tpool_retire(tpool_thread_t* self)
+{
+    tpool_t* tm = self->tm;
+    bool retired = false;
+
+    pthread_mutex_lock(&(tm->grow_mutex));
+    if (!atomic_load(&tm->stop) &&
+        atomic_load(&tm->live_cnt) > atomic_load(&tm->min_threads)) {
+        atomic_fetch_sub(&tm->live_cnt, 1);
+        atomic_store(&self->state, TPOOL_SLOT_EXITED);
+        atomic_fetch_add_explicit(&tm->retired_cnt, 1, memory_order_relaxed);
+        retired = true;
+    }
+    pthread_mutex_unlock(&(tm->grow_mutex));
+
+    return retired;
+}
+
+// Extrae de la cola de trabajos el siguiente trabajo a procesar por los hilos
+static bool tpool_get_work(tpool_thread_t* self, tpool_work_t* work)
+{
+    tpool_t* tm = self->tm;
+
+    wsdeque_t* local = atomic_load_explicit(&self->local, memory_order_relaxed);
+
+    // Primero lo mas reciente de la cola propia, que suele estar en la cache
+    if (local && wsdeque_pop(local, work)) {
+        return true;
+    }
+
+    if (mpmc_pop(tm->queue, work)) {
+        // Avisamos de que hay espacio en la cola
+        evcount_notify_one(&tm->gap_ec);
+        return true;
+    }
+
+    return tm->mode == TPOOL_MODE_STEAL && tpool_steal_work(self, work);
+}
+
+static bool tpool_steal_work(tpool_thread_t* self, tpool_work_t* work)
+{
+    tpool_t* tm = self->tm;
+    wsdeque_t* local = NULL;
+    size_t i, victim, used;
+
+    // xorshift32
+    self->seed ^= self->seed << 13;
+    self->seed ^= self->seed >> 17;
+    self->seed ^= self->seed << 5;
+
+    used = atomic_load_explicit(&tm->used_slots, memory_order_acquire);
+    victim = self->seed % used;
+    for (i = 0; i < used; i++, victim++) {
+        if (victim == used) {
+            victim = 0;
+        }
+        if (&tm->workers[victim] == self) {
+            continue;
+        }
+        local = atomic_load_explicit(&tm->workers[victim].local,
+                                     memory_order_acquire);
+        if (local && wsdeque_steal(local, work)) {
+            atomic_fetch_add_explicit(&tm->stolen_cnt, 1, memory_order_relaxed);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static bool tpool_wait_work(tpool_thread_t* self,
+                            tpool_work_t* work,
+                            unsigned* spin)
+{
+    tpool_t* tm = self->tm;
+    unsigned i, key;
+
+    while (!atomic_load_explicit(&tm->stop, memory_order_relaxed)) {
+        // Espera activa antes de dormir
+        for (i = 0; i < *spin; i++) {
+            tpool_cpu_relax();
+            if (tpool_get_work(self, work)) {
+                if (*spin < TPOOL_SPIN_MAX) {
+                    *spin *= 2;
+                }
+                return true;
+            }
+        }
+        if (*spin > TPOOL_SPIN_MIN) {
+            *spin /= 2;
+        }
+
         // Espera hasta que haya trabajos o se deba parar los hilos
-        while (!tm->work_first && !tm->stop) {
-            // Espramos hasta que llegue la senial de que hay trabajo
-            pthread_cond_wait(&(tm->work_cond), &(tm->work_mutex));
+        key = evcount_prepare_wait(&tm->work_ec);
+        if (atomic_load(&tm->stop)) {
+            evcount_cancel_wait(&tm->work_ec);
+            break;
+        }
+        if (tpool_get_work(self, work)) {
+            evcount_cancel_wait(&tm->work_ec);
+            return true;
+        }
+        if (atomic_load_explicit(&tm->live_cnt, memory_order_relaxed) <=
+            atomic_load_explicit(&tm->min_threads, memory_order_relaxed)) {
+            evcount_wait(&tm->work_ec, key);
+        } else if (!evcount_wait_for(&tm->work_ec, key, tm->idle_ms) &&
+                   tpool_retire(self)) {
+            // Sobra un hilo y este lleva idle_ms sin trabajo
+            break;
+        }
+        if (tpool_get_work(self, work)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static bool tpool_push_work(tpool_t* tm, tpool_work_t* work)
+{
+    size_t size, max;
+
+    wsdeque_t* local = NULL;
+
+    if (tpool_self && tpool_self->tm == tm) {
+        local = atomic_load_explicit(&tpool_self->local, memory_order_relaxed);
+    }
+    if (local && wsdeque_push(local, work)) {
+        size = wsdeque_size(local);
+    } else if (mpmc_push(tm->queue, work)) {
+        size = mpmc_size(tm->queue);
+    } else {
+        return false;
+    }
+    PROBE2(tpool_enqueue, tm, work->arg);
+
+    // Si el trabajo tiene que esperar avisamos al monitor
+    if (size > 1 &&
+        atomic_load_explicit(&tm->max_threads, memory_order_relaxed) >
+          atomic_load_explicit(&tm->min_threads, memory_order_relaxed)) {
+        evcount_notify_one(&tm->backlog_ec);
+    }
+
+    max = atomic_load_explicit(&tm->max_work_cnt, memory_order_relaxed);
+    while (size > max &&
+           !atomic_compare_exchange_weak_explicit(&tm->max_work_cnt,
+                                                  &max,
+                                                  size,
+                                                  memory_order_relaxed,
+                                                  memory_order_relaxed))
+        ;
+
+    // Avisamos de que hay trabajo a un unico hilo dormido, si lo hay
+    evcount_notify_one(&tm->work_ec);
+
+    return true;
+}
+
+static void tpool_free(tpool_t* tm)
+{
+    size_t i;
+
+    if (tm->workers) {
+        for (i = 0; i < tm->num_slots; i++) {
+            wsdeque_destroy(atomic_load(&tm->workers[i].local));
         }
-        // Comprobamos si hay que parar el hilo
-        if (tm->stop) {
-            pthread_mutex_unlock(&(tm->work_mutex));
+    }
+
+    pthread_mutex_destroy(&(tm->grow_mutex));
+    pthread_mutex_destroy(&(tm->codel_mutex));
+    mpmc_destroy(tm->queue);
+    free(tm->workers);
+    free(tm);
+}
+
+// Se encarga de esperar a que haya trabajos y los procesa.
+static void* tpool_worker(void* arg)
+{
+    tpool_thread_t* self = arg;
+    tpool_t* tm = self->tm;
+    tpool_work_t work;
+    unsigned spin = TPOOL_SPIN_MIN;
+    uint64_t now, sojourn;
+
+    tpool_thread_init(self);
+
+    // Mantenemos el hilo corriendo hasta que deba parar
+    while (!atomic_load_explicit(&tm->stop, memory_order_relaxed)) {
+        if (!tpool_get_work(self, &work) && !tpool_wait_work(self, &work, &spin)) {
             break;
         }
-        // Extraemos un trabajo de la cola de trabajos
-        work = tpool_get_work(tm);
-        pthread_mutex_unlock(&(tm->work_mutex));
-
-        if (work) {
-            // El trabajo es ejecutado por el hilo
-            work->func(work->arg);
-            tpool_work_destroy(work);
+
+        if (atomic_load_explicit(&tm->timed, memory_order_relaxed)) {
+            now = tpool_now();
+            sojourn = now - work.added;
+
+            // Si el trabajo ha esperado mas que el objetivo y aun quedan
+            // otros detras faltan hilos. El hilo nuevo repite la comprobacion
+            // con el siguiente trabajo, asi que se crece mientras dure el
+            // atasco.
+            if (atomic_load_explicit(&tm->max_threads, memory_order_relaxed) >
+                atomic_load_explicit(&tm->min_threads, memory_order_relaxed)) {
+                atomic_store_explicit(&tm->last_pop, now, memory_order_relaxed);
+                if (sojourn > tm->target_ns && mpmc_size(tm->queue)) {
+                    tpool_grow(tm);
+                }
+            }
+
+            // Si la espera se mantiene por encima del objetivo, descartamos
+            if (tm->shed && tpool_codel_drop(tm, now, sojourn)) {
+                tm->shed(work.arg);
+                atomic_fetch_add_explicit(
+                  &tm->dropped_cnt, 1, memory_order_relaxed);
+                continue;
+            }
         }
+
+        // El trabajo es ejecutado por el hilo
+        atomic_fetch_add_explicit(&tm->active_cnt, 1, memory_order_relaxed);
+        PROBE3(tpool_dequeue, tm, work.arg, work.added);
+        work.func(work.arg);
+        atomic_fetch_sub_explicit(&tm->active_cnt, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&tm->done_cnt, 1, memory_order_relaxed);
     }
 
     return NULL;
 }
 
 tpool_t* tpool_create(int num)
+{
+    tpool_opts_t opts = { 0 };
+
+    opts.num_threads = num;
+
+    return tpool_create_opts(&opts);
+}
+
+tpool_t* tpool_create_opts(const tpool_opts_t* opts)
 {
     tpool_t* tm = NULL;
-    int i;
+    size_t i, max;
+    int num;
 
-    if (!num) {
+    if (!opts) {
+        return NULL;
+    }
+
+    num = opts->num_threads;
+    if (num <= 0) {
         num = 1;
     }
 
@@ -191,24 +809,75 @@ tpool_t* tpool_create(int num)
         return NULL;
     }
 
-    tm->num_threads = num;
-    tm->queue_size = num * num;
+    tm->mode = opts->mode;
+    tm->affinity = opts->affinity;
+    tm->topo = opts->topology;
+    max = opts->max_threads > num ? (size_t)opts->max_threads : (size_t)num;
+    atomic_init(&tm->min_threads, num);
+    atomic_init(&tm->max_threads, max);
+    tm->num_slots =
+      opts->limit_threads > 0 && (size_t)opts->limit_threads > max
+        ? (size_t)opts->limit_threads
+        : max;
+    tm->target_ns = (uint64_t)(opts->target_ms > 0 ? opts->target_ms
+                                                   : TPOOL_TARGET_MS) *
+                    1000000;
+    tm->idle_ms = opts->idle_ms > 0 ? opts->idle_ms : TPOOL_IDLE_MS;
+    if (opts->shed && opts->codel_target_ms > 0) {
+        tm->shed = opts->shed;
+        tm->codel_target = (uint64_t)opts->codel_target_ms * 1000000;
+        tm->codel_interval = (uint64_t)(opts->codel_interval_ms > 0
+                                          ? opts->codel_interval_ms
+                                          : TPOOL_CODEL_INTERVAL_MS) *
+                             1000000;
+    }
+    atomic_init(&tm->timed, tm->shed || max > (size_t)num);
 
-    // Inicializamos los atributos de los hilos
-    pthread_mutex_init(&(tm->work_mutex), NULL);
-    pthread_cond_init(&(tm->work_cond), NULL);
-    pthread_cond_init(&(tm->gap_cond), NULL);
+    // Inicializamos la cola de trabajo. Su capacidad se redondea a la
+    // siguiente potencia de dos.
+    tm->queue_size = opts->queue_size ? opts->queue_size : (size_t)num * num;
+    tm->queue = mpmc_create(tm->queue_size, sizeof(tpool_work_t));
+    tm->workers =
+      (tpool_thread_t*)calloc(tm->num_slots, sizeof(tpool_thread_t));
+    if (!tm->queue || !tm->workers) {
+        tpool_free(tm);
+        return NULL;
+    }
+
+    for (i = 0; i < tm->num_slots; i++) {
+        tm->workers[i].tm = tm;
+        tm->workers[i].seed = i + 1;
+        atomic_init(&tm->workers[i].state, TPOOL_SLOT_FREE);
+        atomic_init(&tm->workers[i].local, NULL);
+        tpool_place(tm, i, opts->cpu_offset);
+    }
 
-    // Inicializamos la cola de trabajo
-    tm->work_first = NULL;
-    tm->work_last = NULL;
-    tm->work_cnt = 0;
-    tm->stop = false;
+    // Inicializamos los atributos de los hilos
+    evcount_init(&tm->work_ec);
+    evcount_init(&tm->gap_ec);
+    evcount_init(&tm->backlog_ec);
+    pthread_mutex_init(&(tm->grow_mutex), NULL);
+    pthread_mutex_init(&(tm->codel_mutex), NULL);
+    atomic_init(&tm->codel_armed, false);
+    atomic_init(&tm->dropped_cnt, 0);
+    atomic_init(&tm->live_cnt, 0);
+    atomic_init(&tm->used_slots, 0);
+    atomic_init(&tm->last_pop, tpool_now());
+    atomic_init(&tm->grown_cnt, 0);
+    atomic_init(&tm->retired_cnt, 0);
+    atomic_init(&tm->max_work_cnt, 0);
+    atomic_init(&tm->active_cnt, 0);
+    atomic_init(&tm->done_cnt, 0);
+    atomic_init(&tm->rejected_cnt, 0);
+    atomic_init(&tm->stolen_cnt, 0);
+    atomic_init(&tm->stop, false);
 
-    // Creamos los hilos
-    tm->threads = (pthread_t*)malloc(num * sizeof(pthread_t));
-    for (i = 0; i < num; i++) {
-        pthread_create(&tm->threads[i], NULL, tpool_worker, tm);
+    // Creamos los hilos minimos, el resto se crean bajo demanda
+    for (i = 0; i < (size_t)num; i++) {
+        tpool_spawn(&tm->workers[i]);
+    }
+    if (max > (size_t)num) {
+        tm->monitored = !pthread_create(&tm->monitor, NULL, tpool_monitor, tm);
     }
 
     return tm;
@@ -217,72 +886,174 @@ tpool_t* tpool_create(int num)
 void tpool_destroy(tpool_t* tm)
 {
     size_t i;
-    tpool_work_t* work = NULL;
-    tpool_work_t* next = NULL;
+    tpool_work_t work;
 
     if (!tm) {
         return;
     }
 
-    // Liberamos todos los trabajos de la cola de trabajos
-    pthread_mutex_lock(&(tm->work_mutex));
-    work = tm->work_first;
-    while (work) {
-        next = work->next;
-        tpool_work_destroy(work);
-        work = next;
+    // Enviamos la senial a todos los hilos para que terminen
+    atomic_store(&tm->stop, true);
+    evcount_notify_all(&tm->work_ec);
+    evcount_notify_all(&tm->gap_ec);
+    evcount_notify_all(&tm->backlog_ec);
+    if (tm->monitored) {
+        pthread_join(tm->monitor, NULL);
     }
 
-    // Enviamos la senial a todos los hilos para que terminen
-    tm->stop = true;
-    pthread_cond_broadcast(&(tm->work_cond));
-    pthread_mutex_unlock(&(tm->work_mutex));
+    // Esperamos a que acabe cualquier creacion de hilos en curso, tras ella
+    // ya no se crean ni se retiran hilos
+    pthread_mutex_lock(&(tm->grow_mutex));
+    pthread_mutex_unlock(&(tm->grow_mutex));
 
-    // Esperamos a que terminen todos los hilos
-    for (i = 0; i < tm->num_threads; i++) {
-        pthread_join(tm->threads[i], NULL);
+    // Esperamos a que terminen todos los hilos, tambien los retirados
+    for (i = 0; i < tm->num_slots; i++) {
+        if (atomic_load(&tm->workers[i].state) != TPOOL_SLOT_FREE) {
+            pthread_join(tm->workers[i].thread, NULL);
+        }
     }
 
-    // Liberamos todos los atributos de los hilos
-    pthread_mutex_destroy(&(tm->work_mutex));
-    pthread_cond_destroy(&(tm->work_cond));
-    pthread_cond_destroy(&(tm->gap_cond));
+    // Descartamos los trabajos que queden en las colas de trabajos
+    while (mpmc_pop(tm->queue, &work))
+        ;
 
-    free(tm->threads);
-    free(tm);
+    tpool_free(tm);
 }
 
 // Aniade un trabajo al pool de hilos
 bool tpool_add_work(tpool_t* tm, thread_func_t func, void* arg)
 {
-    tpool_work_t* work = NULL;
+    tpool_work_t work;
+    unsigned key;
+
+    if (!tm || !func) {
+        return false;
+    }
+
+    work.func = func;
+    work.arg = arg;
+    work.added =
+      atomic_load_explicit(&tm->timed, memory_order_relaxed) ? tpool_now() : 0;
+
+    // Insertamos el trabajo en la cola de trabajos
+    while (!tpool_push_work(tm, &work)) {
+        // Esperamos hasta que haya espacio en la cola de trabajo
+        key = evcount_prepare_wait(&tm->gap_ec);
+        if (atomic_load(&tm->stop)) {
+            evcount_cancel_wait(&tm->gap_ec);
+            return false;
+        }
+        if (tpool_push_work(tm, &work)) {
+            evcount_cancel_wait(&tm->gap_ec);
+            break;
+        }
+        evcount_wait(&tm->gap_ec, key);
+    }
+
+    return true;
+}
+
+// Aniade un trabajo al pool de hilos sin esperar a que haya sitio
+bool tpool_try_add_work(tpool_t* tm, thread_func_t func, void* arg)
+{
+    tpool_work_t work;
+
+    if (!tm || !func) {
+        return false;
+    }
+
+    work.func = func;
+    work.arg = arg;
+    work.added =
+      atomic_load_explicit(&tm->timed, memory_order_relaxed) ? tpool_now() : 0;
+    if (!tpool_push_work(tm, &work)) {
+        atomic_fetch_add_explicit(&tm->rejected_cnt, 1, memory_order_relaxed);
+        return false;
+    }
+
+    return true;
+}
+
+bool tpool_resize(tpool_t* tm, int num_threads, int max_threads)
+{
+    size_t i, min, max;
 
     if (!tm) {
         return false;
     }
 
-    work = tpool_work_create(func, arg);
-    if (!work) {
+    min = num_threads > 0 ? (size_t)num_threads : 1;
+    max = max_threads > 0 && (size_t)max_threads > min ? (size_t)max_threads
+                                                       : min;
+    if (max > tm->num_slots) {
         return false;
     }
 
-    // Insertamos el trabajo en la cola de trabajos
-    pthread_mutex_lock(&(tm->work_mutex));
-    while (tm->work_cnt >= tm->queue_size) {
-        // Esperamos hasta que haya espacio en la cola de trabajo
-        pthread_cond_wait(&(tm->gap_cond), &(tm->work_mutex));
+    pthread_mutex_lock(&(tm->grow_mutex));
+    if (atomic_load(&tm->stop)) {
+        pthread_mutex_unlock(&(tm->grow_mutex));
+        return false;
     }
-    tm->work_cnt++;
-    if (tm->work_first == NULL) {
-        tm->work_first = work;
-        tm->work_last = tm->work_first;
-    } else {
-        tm->work_last->next = work;
-        tm->work_last = work;
+    atomic_store(&tm->min_threads, min);
+    atomic_store(&tm->max_threads, max);
+
+    // Un pool que pasa a ser elastico necesita el instante de encolado de
+    // los trabajos y el monitor
+    if (max > min) {
+        atomic_store(&tm->timed, true);
+        if (!tm->monitored) {
+            tm->monitored =
+              !pthread_create(&tm->monitor, NULL, tpool_monitor, tm);
+        }
+    }
+
+    // Lanzamos los hilos que faltan hasta el nuevo minimo
+    for (i = 0; i < max && atomic_load(&tm->live_cnt) < min; i++) {
+        if (atomic_load(&tm->workers[i].state) != TPOOL_SLOT_RUNNING) {
+            tpool_spawn(&tm->workers[i]);
+        }
+    }
+    pthread_mutex_unlock(&(tm->grow_mutex));
+
+    // Los hilos que duermen sin plazo vuelven a comprobar si sobran
+    evcount_notify_all(&tm->work_ec);
+
+    return true;
+}
+
+void tpool_get_stats(tpool_t* tm, tpool_stats_t* stats)
+{
+    if (!tm || !stats) {
+        return;
+    }
+
+    stats->num_threads = atomic_load(&tm->live_cnt);
+    stats->min_threads = atomic_load(&tm->min_threads);
+    stats->max_threads = atomic_load(&tm->max_threads);
+    stats->queue_size = mpmc_capacity(tm->queue);
+    stats->queued = tpool_queued(tm);
+    stats->max_queued = atomic_load(&tm->max_work_cnt);
+    stats->active = atomic_load(&tm->active_cnt);
+    stats->completed = atomic_load(&tm->done_cnt);
+    stats->rejected = atomic_load(&tm->rejected_cnt);
+    stats->dropped = atomic_load(&tm->dropped_cnt);
+    stats->stolen = atomic_load(&tm->stolen_cnt);
+    stats->grown = atomic_load(&tm->grown_cnt);
+    stats->retired = atomic_load(&tm->retired_cnt);
+}
+
+bool tpool_get_placement(tpool_t* tm, size_t idx, int* cpu, int* node)
+{
+    if (!tm || idx >= atomic_load(&tm->max_threads)) {
+        return false;
+    }
+
+    if (cpu) {
+        *cpu = tm->workers[idx].cpu;
+    }
+    if (node) {
+        *node = tm->workers[idx].node;
     }
-    // Avisamos de que hay trabajo que procesar
-    pthread_cond_broadcast(&(tm->work_cond));
-    pthread_mutex_unlock(&(tm->work_mutex));
 
     return true;
 }
@@ -0,0 +1,209 @@
+/*****************************************************************************
+ * ARCHIVO: trace.c
+ * DESCRIPCION: Implementacion de la traza de peticiones en formato Chrome
+ * Trace Event.
+ *
+ * NOTA: El fichero es un array JSON de eventos. Los spans de una peticion se
+ * formatean en la pila de quien la atiende y se escriben juntos bajo un
+ * mutex en un FILE con buffer, asi que solo hay una llamada al sistema cada
+ * muchas peticiones trazadas. Si el proceso termina sin trace_destroy falta
+ * el ']' final, que los visores de trazas aceptan.
+ *
+ * FECHA CREACION: 19 Octubre de 2026
+ * AUTORES: Javier Mateos Najari, Adrian Sebastian Gil
+ *****************************************************************************/
+#include <pthread.h>     // pthread_mutex_lock
+#include <stdatomic.h>   // atomic_uint_fast64_t
+#include <stdio.h>       // fopen
+#include <sys/syscall.h> // SYS_gettid
+#include <time.h>        // clock_gettime
+#include <unistd.h>      // getpid
+
+#include "trace.h"
+
+#define TRACE_FILE_BUF (64 * 1024) // Buffer del fichero
+
+// Estado de la traza
+typedef struct trace {
+    pthread_mutex_t mutex;        // Protege el fichero
+    FILE* file;                   // Fichero de la traza (NULL: sin iniciar)
+    unsigned sample;              // Una de cada sample peticiones (0: ninguna)
+    int pid;                      // Proceso de los eventos
+    uint64_t origin;              // Instante de trace_init (ns)
+    atomic_uint_fast64_t next_id; // Ultimo identificador de peticion
+} trace_t;
+
+static trace_t state = { .mutex = PTHREAD_MUTEX_INITIALIZER };
+
+// Estado del generador aleatorio del hilo (0: sin sembrar)
+static _Thread_local uint64_t trace_rand = 0;
+
+// Identificador del hilo en el sistema (0: sin consultar)
+static _Thread_local long trace_tid = 0;
+
+int trace_init(const trace_opts_t* opts)
+{
+    if (!opts || !opts->path || !opts->sample) {
+        return -1;
+    }
+
+    state.file = fopen(opts->path, "we");
+    if (!state.file) {
+        return -1;
+    }
+    setvbuf(state.file, NULL, _IOFBF, TRACE_FILE_BUF);
+
+    state.pid = (int)getpid();
+    state.origin = trace_now();
+    atomic_init(&state.next_id, 0);
+    fprintf(state.file,
+            "[{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":0,"
+            "\"args\":{\"name\":\"server\"}}",
+            state.pid);
+    state.sample = opts->sample;
+
+    return 0;
+}
+
+void trace_destroy()
+{
+    pthread_mutex_lock(&state.mutex);
+    state.sample = 0;
+    if (state.file) {
+        fputs("\n]\n", state.file);
+        fclose(state.file);
+        state.file = NULL;
+    }
+    pthread_mutex_unlock(&state.mutex);
+}
+
+bool trace_enabled()
+{
+    return state.sample != 0;
+}
+
+uint64_t trace_begin()
+{
+    if (!state.sample) {
+        return 0;
+    }
+
+    // Se sortea cada peticion en lugar de contar, porque con un pool de
+    // muchos hilos cada uno atiende pocas y no llegaria a la cuenta
+    if (!trace_rand) {
+        trace_rand = (trace_now() ^ ((uint64_t)trace_thread() << 32)) | 1;
+    }
+    trace_rand ^= trace_rand << 13;
+    trace_rand ^= trace_rand >> 7;
+    trace_rand ^= trace_rand << 17;
+    if (trace_rand % state.sample) {
+        return 0;
+    }
+
+    return atomic_fetch_add_explicit(&state.next_id, 1, memory_order_relaxed) +
+           1;
+}
+
+uint64_t trace_now()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+long trace_thread()
+{
+    if (!trace_tid) {
+        trace_tid = syscall(SYS_gettid);
+    }
+
+    return trace_tid;
+}
+
+void trace_buf_init(trace_buf_t* buf, uint64_t id)
+{
+    buf->id = id;
+    buf->len = 0;
+}
+
+void trace_span(trace_buf_t* buf,
+                const char* name,
+                uint64_t start,
+                uint64_t end,
+                const char* args)
+{
+    int len;
+    size_t left = sizeof(buf->data) - buf->len;
+
+    if (!start || !end || end < start || start < state.origin) {
+        return;
+    }
+
+    // Chrome espera ts y dur en microsegundos; los decimales conservan los ns
+    len = snprintf(buf->data + buf->len,
+                   left,
+                   ",\n{\"name\":\"%s\",\"cat\":\"http\",\"ph\":\"X\","
+                   "\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%llu%s%s%s}",
+                   name,
+                   (double)(start - state.origin) / 1000,
+                   (double)(end - start) / 1000,
+                   state.pid,
+                   (unsigned long long)buf->id,
+                   args ? ",\"args\":{" : "",
+                   args ? args : "",
+                   args ? "}" : "");
+    // Si no cabe se descarta el span entero para no cortar el JSON
+    if (len > 0 && (size_t)len < left) {
+        buf->len += len;
+    } else {
+        buf->data[buf->len] = '\0';
+    }
+}
+
+void trace_flush(trace_buf_t* buf)
+{
+    if (!buf->len) {
+        return;
+    }
+
+    pthread_mutex_lock(&state.mutex);
+    if (state.file) {
+        fwrite(buf->data, 1, buf->len, state.file);
+    }
+    pthread_mutex_unlock(&state.mutex);
+    buf->len = 0;
+}
+
+void trace_escape(char* dst, size_t size, const char* value)
+{
+    const unsigned char* c;
+    size_t i = 0;
+
+    if (!size) {
+        return;
+    }
+
+    for (c = (const unsigned char*)value; *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            if (i + 2 >= size) {
+                break;
+            }
+            dst[i++] = '\\';
+            dst[i++] = (char)*c;
+        } else if (*c < 0x20 || *c >= 0x7f) {
+            if (i + 6 >= size) {
+                break;
+            }
+            snprintf(dst + i, 7, "\\u%04x", *c);
+            i += 6;
+        } else {
+            if (i + 1 >= size) {
+                break;
+            }
+            dst[i++] = (char)*c;
+        }
+    }
+    dst[i] = '\0';
+}
@@ -0,0 +1,213 @@
+/*****************************************************************************
+ * ARCHIVO: twheel.c
+ * DESCRIPCION: Implementacion de la rueda de temporizadores jerarquica.
+ *
+ * NOTA: Un temporizador que vence dentro de menos de 64 ms va a la ranura de
+ * su instante en el nivel 0. Los demas van al nivel l mas bajo cuyo alcance
+ * (64^(l+1) ms) cubre el plazo, en la ranura (expires >> 6l) & 63. Cada vez
+ * que el reloj cruza un multiplo de 64^l ms la ranura actual del nivel l se
+ * vacia recolocando sus temporizadores, que bajan de nivel a medida que se
+ * acercan. Un temporizador baja como mucho TWHEEL_LEVELS - 1 veces.
+ *
+ * Las ranuras son listas simplemente enlazadas en las que cada nodo guarda
+ * la direccion del enlace que le apunta, de modo que se puede desarmar sin
+ * saber en que ranura esta.
+ *
+ * FECHA CREACION: 19 Octubre de 2026
+ * AUTORES: Javier Mateos Najari, Adrian Sebastian Gil
+ *****************************************************************************/
+#include <string.h> // memset
+#include <time.h>   // clock_gettime
+
+#include "twheel.h"
+
+#define TWHEEL_MASK (TWHEEL_SLOTS - 1) // Mascara del indice de una ranura
+
+// Plazo maximo que cubre la rueda (ms)
+#define TWHEEL_MAX_DELTA ((uint64_t)1 << (TWHEEL_BITS * TWHEEL_LEVELS))
+
+/*******************************************************************************
+ * FUNCION: static void twheel_link(twheel_t* tw, twheel_timer_t* timer)
+ * ARGS_IN: twheel_t* tw - rueda.
+ *          twheel_timer_t* timer - temporizador desarmado.
+ * DESCRIPCION: Coloca el temporizador en la ranura que le corresponde segun
+ *              lo que falta para que venza (no puede haber vencido ya).
+ ******************************************************************************/
+static void twheel_link(twheel_t* tw, twheel_timer_t* timer);
+
+/*******************************************************************************
+ * FUNCION: static void twheel_unlink(twheel_timer_t* timer)
+ * ARGS_IN: twheel_timer_t* timer - temporizador armado.
+ * DESCRIPCION: Saca el temporizador de su ranura.
+ ******************************************************************************/
+static void twheel_unlink(twheel_timer_t* timer);
+
+/*******************************************************************************
+ * FUNCION: static void twheel_cascade(twheel_t* tw, int level)
+ * ARGS_IN: twheel_t* tw - rueda.
+ *          int level - nivel cuya ranura actual se vacia.
+ * DESCRIPCION: Recoloca los temporizadores de la ranura actual de un nivel.
+ ******************************************************************************/
+static void twheel_cascade(twheel_t* tw, int level);
+
+static void twheel_link(twheel_t* tw, twheel_timer_t* timer)
+{
+    twheel_timer_t** slot = NULL;
+    uint64_t delta;
+    int level;
+
+    // Al recolocar, lo que vence en el instante actual va a la ranura que
+    // se procesa justo despues
+    delta = timer->expires - tw->now;
+    if (delta >= TWHEEL_MAX_DELTA) {
+        timer->expires = tw->now + TWHEEL_MAX_DELTA - 1;
+        delta = TWHEEL_MAX_DELTA - 1;
+    }
+
+    for (level = 0; level < TWHEEL_LEVELS - 1; level++) {
+        if (delta < (uint64_t)1 << (TWHEEL_BITS * (level + 1))) {
+            break;
+        }
+    }
+
+    slot = &tw->slots[level]
+                     [(timer->expires >> (TWHEEL_BITS * level)) & TWHEEL_MASK];
+    timer->next = *slot;
+    if (*slot) {
+        (*slot)->pprev = &timer->next;
+    }
+    timer->pprev = slot;
+    *slot = timer;
+}
+
+static void twheel_unlink(twheel_timer_t* timer)
+{
+    *timer->pprev = timer->next;
+    if (timer->next) {
+        timer->next->pprev = timer->pprev;
+    }
+    timer->next = NULL;
+    timer->pprev = NULL;
+}
+
+static void twheel_cascade(twheel_t* tw, int level)
+{
+    twheel_timer_t** slot = NULL;
+    twheel_timer_t* timer = NULL;
+
+    slot =
+      &tw->slots[level][(tw->now >> (TWHEEL_BITS * level)) & TWHEEL_MASK];
+    while ((timer = *slot)) {
+        twheel_unlink(timer);
+        twheel_link(tw, timer);
+    }
+}
+
+uint64_t twheel_clock()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+void twheel_init(twheel_t* tw, uint64_t now)
+{
+    memset(tw, 0, sizeof(twheel_t));
+    tw->now = now;
+}
+
+void twheel_arm(twheel_t* tw, twheel_timer_t* timer, uint64_t expires)
+{
+    if (timer->pprev) {
+        twheel_unlink(timer);
+    } else {
+        tw->count++;
+    }
+    // El instante actual ya se ha procesado
+    timer->expires = expires > tw->now ? expires : tw->now + 1;
+    twheel_link(tw, timer);
+}
+
+void twheel_cancel(twheel_t* tw, twheel_timer_t* timer)
+{
+    if (!timer->pprev) {
+        return;
+    }
+
+    twheel_unlink(timer);
+    tw->count--;
+}
+
+void twheel_advance(twheel_t* tw, uint64_t now, twheel_func_t func, void* arg)
+{
+    twheel_timer_t** slot = NULL;
+    twheel_timer_t* timer = NULL;
+    int level;
+
+    while (tw->now < now) {
+        // Sin temporizadores no hay nada que recolocar ni que vencer
+        if (!tw->count) {
+            tw->now = now;
+            break;
+        }
+
+        tw->now++;
+        // Primero los niveles altos, para que lo que baje a un nivel cuya
+        // ranura tambien toca ahora se recoloque otra vez
+        for (level = TWHEEL_LEVELS - 1; level > 0; level--) {
+            if (!(tw->now & (((uint64_t)1 << (TWHEEL_BITS * level)) - 1))) {
+                twheel_cascade(tw, level);
+            }
+        }
+
+        slot = &tw->slots[0][tw->now & TWHEEL_MASK];
+        while ((timer = *slot)) {
+            twheel_unlink(timer);
+            tw->count--;
+            func(timer, arg);
+        }
+    }
+}
+
+int twheel_timeout(twheel_t* tw, uint64_t now)
+{
+    uint64_t next = UINT64_MAX, at, base;
+    int level, d;
+
+    if (!tw->count) {
+        return -1;
+    }
+    if (tw->now >= now + INT32_MAX) {
+        return INT32_MAX;
+    }
+
+    // Nivel 0: el instante exacto del primer temporizador
+    for (d = 1; d < TWHEEL_SLOTS; d++) {
+        if (tw->slots[0][(tw->now + d) & TWHEEL_MASK]) {
+            next = tw->now + d;
+            break;
+        }
+    }
+
+    // Resto de niveles: el primer cruce en el que hay que recolocar
+    for (level = 1; level < TWHEEL_LEVELS; level++) {
+        base = tw->now >> (TWHEEL_BITS * level);
+        for (d = 1; d <= TWHEEL_SLOTS; d++) {
+            if (tw->slots[level][(base + d) & TWHEEL_MASK]) {
+                at = (base + d) << (TWHEEL_BITS * level);
+                if (at < next) {
+                    next = at;
+                }
+                break;
+            }
+        }
+    }
+
+    if (next <= now) {
+        return 0;
+    }
+
+    return next - now > INT32_MAX ? INT32_MAX : (int)(next - now);
+}
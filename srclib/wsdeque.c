@@ -0,0 +1,174 @@
+/*****************************************************************************
+ * ARCHIVO: wsdeque.c
+ * DESCRIPCION: Implementacion de la cola doble acotada para robo de trabajo.
+ *
+ * REFERENCIA: https://fzn.fr/readings/ppopp13.pdf
+ *
+ * NOTA: Es la version C11 de la cola de Chase-Lev sin crecimiento. bottom
+ * solo lo modifica el propietario y top se avanza con CAS, tanto al robar
+ * como al extraer el ultimo elemento. Un ladron copia el elemento antes de
+ * reservarlo con el CAS, por lo que la copia puede solaparse con una
+ * insercion del propietario en la misma celda; en ese caso top ya ha
+ * avanzado, el CAS falla y la copia se descarta.
+ *
+ * FECHA CREACION: 19 Octubre de 2026
+ * AUTORES: Javier Mateos Najari, Adrian Sebastian Gil
+ *****************************************************************************/
+#include <stdatomic.h> // atomic_size_t
+#include <stdint.h>    // intptr_t
+#include <stdlib.h>    // aligned_alloc
+#include <string.h>    // memcpy
+
+#include "wsdeque.h"
+
+#define WSDEQUE_CACHE_LINE 64 // Tamanio de una linea de cache
+#define WSDEQUE_MAX_ELEM 64   // Tamanio maximo de un elemento
+
+// Cola de robo de trabajo
+struct wsdeque {
+    // Extremo de los ladrones
+    _Alignas(WSDEQUE_CACHE_LINE) atomic_size_t top;
+    // Extremo del propietario
+    _Alignas(WSDEQUE_CACHE_LINE) atomic_size_t bottom;
+    // Datos de solo lectura tras la creacion
+    _Alignas(WSDEQUE_CACHE_LINE) size_t mask; // Capacidad - 1
+    size_t elem_size;                         // Tamanio de un elemento
+    unsigned char* buf;                       // Buffer circular
+};
+
+wsdeque_t* wsdeque_create(size_t capacity, size_t elem_size)
+{
+    wsdeque_t* q = NULL;
+    size_t size = 2;
+
+    if (!elem_size || elem_size > WSDEQUE_MAX_ELEM) {
+        return NULL;
+    }
+
+    while (size < capacity) {
+        size <<= 1;
+    }
+
+    q = (wsdeque_t*)aligned_alloc(WSDEQUE_CACHE_LINE, sizeof(wsdeque_t));
+    if (!q) {
+        return NULL;
+    }
+    memset(q, 0, sizeof(wsdeque_t));
+
+    q->mask = size - 1;
+    q->elem_size = elem_size;
+    q->buf = (unsigned char*)malloc(size * elem_size);
+    if (!q->buf) {
+        free(q);
+        return NULL;
+    }
+
+    atomic_init(&q->top, 0);
+    atomic_init(&q->bottom, 0);
+
+    return q;
+}
+
+void wsdeque_destroy(wsdeque_t* q)
+{
+    if (!q) {
+        return;
+    }
+
+    free(q->buf);
+    free(q);
+}
+
+bool wsdeque_push(wsdeque_t* q, const void* elem)
+{
+    size_t b, t;
+
+    b = atomic_load_explicit(&q->bottom, memory_order_relaxed);
+    t = atomic_load_explicit(&q->top, memory_order_acquire);
+    if (b - t > q->mask) {
+        // Cola llena
+        return false;
+    }
+
+    memcpy(q->buf + (b & q->mask) * q->elem_size, elem, q->elem_size);
+    atomic_store_explicit(&q->bottom, b + 1, memory_order_release);
+
+    return true;
+}
+
+bool wsdeque_pop(wsdeque_t* q, void* elem)
+{
+    size_t b, t;
+    intptr_t diff;
+    bool found = true;
+
+    // Reservamos el ultimo elemento antes de mirar a los ladrones
+    b = atomic_load_explicit(&q->bottom, memory_order_relaxed) - 1;
+    atomic_store_explicit(&q->bottom, b, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    t = atomic_load_explicit(&q->top, memory_order_relaxed);
+
+    diff = (intptr_t)(b - t);
+    if (diff < 0) {
+        // Cola vacia
+        atomic_store_explicit(&q->bottom, b + 1, memory_order_relaxed);
+        return false;
+    }
+
+    memcpy(elem, q->buf + (b & q->mask) * q->elem_size, q->elem_size);
+    if (diff == 0) {
+        // Ultimo elemento, competimos con los ladrones por el
+        found = atomic_compare_exchange_strong_explicit(&q->top,
+                                                        &t,
+                                                        t + 1,
+                                                        memory_order_seq_cst,
+                                                        memory_order_relaxed);
+        atomic_store_explicit(&q->bottom, b + 1, memory_order_relaxed);
+    }
+
+    return found;
+}
+
+bool wsdeque_steal(wsdeque_t* q, void* elem)
+{
+    unsigned char tmp[WSDEQUE_MAX_ELEM];
+    size_t b, t;
+
+    t = atomic_load_explicit(&q->top, memory_order_acquire);
+    while (1) {
+        atomic_thread_fence(memory_order_seq_cst);
+        b = atomic_load_explicit(&q->bottom, memory_order_acquire);
+        if ((intptr_t)(b - t) <= 0) {
+            // Cola vacia
+            return false;
+        }
+
+        memcpy(tmp, q->buf + (t & q->mask) * q->elem_size, q->elem_size);
+        if (atomic_compare_exchange_strong_explicit(&q->top,
+                                                    &t,
+                                                    t + 1,
+                                                    memory_order_seq_cst,
+                                                    memory_order_acquire)) {
+            break;
+        }
+        // Otro hilo se ha llevado el elemento, reintentamos con el siguiente
+    }
+
+    memcpy(elem, tmp, q->elem_size);
+
+    return true;
+}
+
+size_t wsdeque_size(wsdeque_t* q)
+{
+    size_t b, t;
+
+    if (!q) {
+        return 0;
+    }
+
+    t = atomic_load_explicit(&q->top, memory_order_relaxed);
+    b = atomic_load_explicit(&q->bottom, memory_order_relaxed);
+
+    return (intptr_t)(b - t) > 0 ? b - t : 0;
+}
@@ -0,0 +1,192 @@
+/*****************************************************************************
+ * ARCHIVO: acclog_dump.c
+ * DESCRIPCION: Convierte ficheros del log de accesos (ver acclog.h) a JSON
+ * lines, un objeto por peticion ordenado por hora de llegada. Los huecos de
+ * bloques sin llenar se ignoran. Los ficheros deben venir de una maquina con
+ * el mismo orden de bytes.
+ *
+ * USO: ./acclog_dump fichero [fichero ...]
+ *      ./acclog_dump access.log.2 access.log.1 access.log
+ *
+ * FECHA CREACION: 19 Octubre de 2026
+ * AUTORES: Javier Mateos Najari, Adrian Sebastian Gil
+ *****************************************************************************/
+#include <arpa/inet.h> // inet_ntop
+#include <stdio.h>     // printf
+#include <stdlib.h>    // qsort
+#include <string.h>    // memcmp
+#include <time.h>      // gmtime_r
+
+#include "acclog.h"
+
+// Nombre de cada metodo, en el orden de ACCLOG_OTHER, ACCLOG_GET...
+static const char* methods[] = { "-", "GET", "POST", "OPTIONS" };
+
+/*******************************************************************************
+ * FUNCION: static int dump_load(const char* path,
+ *                               acclog_record_t** records,
+ *                               size_t* count,
+ *                               size_t* size)
+ * ARGS_IN: const char* path - fichero del log.
+ *          acclog_record_t** records - registros leidos hasta ahora.
+ *          size_t* count - numero de registros.
+ *          size_t* size - capacidad de records.
+ * DESCRIPCION: Anade los registros validos del fichero a records.
+ * ARGS_OUT: int - 0 o -1 si el fichero no se puede leer o no es del log.
+ ******************************************************************************/
+static int dump_load(const char* path,
+                     acclog_record_t** records,
+                     size_t* count,
+                     size_t* size);
+
+/*******************************************************************************
+ * FUNCION: static int dump_cmp(const void* a, const void* b)
+ * ARGS_IN: const void* a - registro.
+ *          const void* b - registro.
+ * DESCRIPCION: Compara dos registros por hora de llegada.
+ * ARGS_OUT: int - <0, 0 o >0 como strcmp.
+ ******************************************************************************/
+static int dump_cmp(const void* a, const void* b);
+
+/*******************************************************************************
+ * FUNCION: static void dump_print(const acclog_record_t* record)
+ * ARGS_IN: const acclog_record_t* record - registro.
+ * DESCRIPCION: Escribe el registro como una linea JSON.
+ ******************************************************************************/
+static void dump_print(const acclog_record_t* record);
+
+int main(int argc, char** argv)
+{
+    acclog_record_t* records = NULL;
+    size_t count = 0, size = 0, i;
+    int j, status = EXIT_SUCCESS;
+
+    if (argc < 2) {
+        fprintf(stderr, "Uso: %s fichero [fichero ...]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    for (j = 1; j < argc; j++) {
+        if (dump_load(argv[j], &records, &count, &size)) {
+            status = EXIT_FAILURE;
+        }
+    }
+
+    qsort(records, count, sizeof(acclog_record_t), dump_cmp);
+    for (i = 0; i < count; i++) {
+        dump_print(&records[i]);
+    }
+
+    free(records);
+
+    return status;
+}
+
+static int dump_load(const char* path,
+                     acclog_record_t** records,
+                     size_t* count,
+                     size_t* size)
+{
+    FILE* file = NULL;
+    acclog_header_t header;
+    acclog_record_t record;
+    acclog_record_t* tmp = NULL;
+
+    file = fopen(path, "rb");
+    if (!file) {
+        perror(path);
+        return -1;
+    }
+    if (fread(&header, sizeof(header), 1, file) != 1 ||
+        memcmp(header.magic, ACCLOG_MAGIC, sizeof(header.magic)) ||
+        header.record_size != ACCLOG_RECORD_SIZE) {
+        fprintf(stderr, "%s: no es un fichero del log de accesos\n", path);
+        fclose(file);
+        return -1;
+    }
+
+    while (fread(&record, sizeof(record), 1, file) == 1) {
+        if (!record.time_us) {
+            continue;
+        }
+        if (*count == *size) {
+            *size = *size ? *size * 2 : 1024;
+            tmp = (acclog_record_t*)realloc(*records,
+                                            *size * sizeof(acclog_record_t));
+            if (!tmp) {
+                fprintf(stderr, "%s: sin memoria\n", path);
+                fclose(file);
+                return -1;
+            }
+            *records = tmp;
+        }
+        (*records)[(*count)++] = record;
+    }
+
+    fclose(file);
+
+    return 0;
+}
+
+static int dump_cmp(const void* a, const void* b)
+{
+    uint64_t ta = ((const acclog_record_t*)a)->time_us;
+    uint64_t tb = ((const acclog_record_t*)b)->time_us;
+
+    return ta < tb ? -1 : ta > tb;
+}
+
+static void dump_print(const acclog_record_t* record)
+{
+    char addr[INET_ADDRSTRLEN], date[32];
+    struct in_addr in;
+    struct tm tm;
+    time_t secs = (time_t)(record->time_us / 1000000);
+    size_t i, len;
+    unsigned char c;
+
+    in.s_addr = record->addr;
+    inet_ntop(AF_INET, &in, addr, sizeof(addr));
+    gmtime_r(&secs, &tm);
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", &tm);
+
+    printf("{\"time\":\"%s.%06uZ\",\"addr\":\"%s\",\"port\":%u,"
+           "\"method\":\"%s\",\"path\":\"",
+           date,
+           (unsigned)(record->time_us % 1000000),
+           addr,
+           (unsigned)ntohs(record->port),
+           record->method < sizeof(methods) / sizeof(methods[0])
+             ? methods[record->method]
+             : "-");
+
+    // El path es lo que envia el cliente: se escapa todo lo que no es ASCII
+    // imprimible
+    len = record->path_len < ACCLOG_PATH_SIZE ? record->path_len
+                                              : ACCLOG_PATH_SIZE;
+    for (i = 0; i < len; i++) {
+        c = (unsigned char)record->path[i];
+        if (c == '"' || c == '\\') {
+            printf("\\%c", c);
+        } else if (c < 0x20 || c >= 0x7f) {
+            printf("\\u%04x", c);
+        } else {
+            putchar(c);
+        }
+    }
+
+    printf("\",\"truncated\":%s,\"version\":\"1.%u\",\"status\":%u,"
+           "\"bytes\":%llu,\"wait_us\":%u,\"header_us\":%u,"
+           "\"handler_us\":%u,\"send_us\":%u,\"keepalive\":%s,"
+           "\"deferred\":%s}\n",
+           record->path_len > ACCLOG_PATH_SIZE ? "true" : "false",
+           (unsigned)record->version,
+           (unsigned)record->status,
+           (unsigned long long)record->bytes,
+           (unsigned)record->wait_us,
+           (unsigned)record->header_us,
+           (unsigned)record->handler_us,
+           (unsigned)record->send_us,
+           record->flags & ACCLOG_KEEPALIVE ? "true" : "false",
+           record->flags & ACCLOG_DEFERRED ? "true" : "false");
+}
@@ -0,0 +1,807 @@
+/*****************************************************************************
+ * ARCHIVO: replay.c
+ * DESCRIPCION: Reproduce una captura de trafico (ver capture.h) contra una
+ * instancia del servidor. Cada conexion capturada se abre como una conexion
+ * propia y envia sus peticiones en el mismo orden, cada una cuando llega su
+ * instante (dividido por el multiplicador de ritmo) y despues de recibir la
+ * respuesta de la anterior, como hacia el cliente original. Asi se mantienen
+ * los tamanios de las cabeceras, la proporcion de scripts y los patrones de
+ * keep-alive. Si el servidor cierra la conexion, la siguiente peticion de
+ * esa conexion abre otra.
+ *
+ * La latencia se mide desde el instante programado, de modo que un servidor
+ * que se atasca no la oculta retrasando los envios; el retraso de los envios
+ * se publica aparte como "lag". Al terminar se escribe un objeto JSON.
+ *
+ * USO: ./replay [-h host] [-p puerto] [-x multiplicador] [-T timeout_ms]
+ *               captura
+ *      ./replay -s captura
+ *      -x 2 reproduce al doble de ritmo y -x 0 sin esperas. Con -s solo se
+ *      resume la captura.
+ *
+ * FECHA CREACION: 19 Octubre de 2026
+ * AUTORES: Javier Mateos Najari, Adrian Sebastian Gil
+ *****************************************************************************/
+#include <errno.h>       // errno
+#include <fcntl.h>       // open
+#include <netdb.h>       // getaddrinfo
+#include <netinet/in.h>  // IPPROTO_TCP
+#include <netinet/tcp.h> // TCP_NODELAY
+#include <stdbool.h>     // bool
+#include <stdint.h>      // uint64_t
+#include <stdio.h>       // printf
+#include <stdlib.h>      // qsort
+#include <string.h>      // memcmp
+#include <strings.h>     // strncasecmp
+#include <sys/epoll.h>   // epoll_wait
+#include <sys/socket.h>  // connect
+#include <sys/stat.h>    // fstat
+#include <time.h>        // clock_gettime
+#include <unistd.h>      // getopt
+
+#include "capture.h"
+#include "picohttpparser.h"
+
+#define REPLAY_IN_SIZE 16384 // Buffer de lectura de una conexion
+#define REPLAY_MAX_HEADERS 32 // Cabeceras de una respuesta
+#define REPLAY_MAX_EVENTS 256 // Eventos por llamada a epoll_wait
+
+// Peticion de la captura
+typedef struct replay_req {
+    uint64_t time_ns;  // Instante capturado (ns desde el inicio)
+    uint64_t conn;     // Conexion capturada
+    size_t order;      // Posicion en el fichero (desempate)
+    uint16_t flags;    // CAPTURE_FIRST
+    const char* data;  // Bytes de la peticion
+    size_t len;        // Longitud de la peticion
+} replay_req_t;
+
+// Conexion reproducida
+typedef struct replay_conn {
+    int fd;              // Socket (-1: cerrado)
+    bool connected;      // connect completado
+    uint32_t events;     // Eventos registrados en epoll
+    replay_req_t** reqs; // Peticiones de la conexion por orden
+    size_t num;          // Numero de peticiones
+    size_t next;         // Siguiente peticion por enviar
+    bool waiting;        // Hay una peticion en vuelo
+    uint64_t due;        // Instante programado de la peticion en vuelo (ns)
+    uint64_t sent;       // Envio real de la peticion en vuelo (ns)
+    size_t out_off;      // Bytes enviados de la peticion en vuelo
+    bool body;           // Se esta leyendo un cuerpo
+    uint64_t body_left;  // Bytes que faltan del cuerpo
+    int status;          // Codigo de la respuesta en curso
+    bool close;          // El servidor cierra tras la respuesta
+    size_t in_len;       // Bytes en in
+    char in[REPLAY_IN_SIZE]; // Datos recibidos sin procesar
+} replay_conn_t;
+
+// Estado de la reproduccion
+static struct {
+    struct sockaddr_storage addr; // Direccion del servidor
+    socklen_t addr_len;           // Longitud de addr
+    double speed;                 // Multiplicador de ritmo (0: sin esperas)
+    uint64_t timeout;             // Timeout de respuesta (ns)
+    uint64_t start;               // Inicio de la reproduccion (ns)
+    int epfd;                     // epoll
+    uint64_t* latencies;          // Latencia de cada respuesta (us)
+    uint64_t* lags;               // Retraso de cada envio (us)
+    size_t responses;             // Respuestas recibidas
+    size_t sent;                  // Peticiones enviadas
+    uint64_t status[6];           // Respuestas por clase (1xx ... 5xx)
+    uint64_t err_connect;         // Conexiones fallidas
+    uint64_t err_read;            // Peticiones perdidas por un cierre
+    uint64_t err_timeout;         // Respuestas que no llegan a tiempo
+    uint64_t err_parse;           // Respuestas mal formadas
+    uint64_t reconnects;          // Conexiones reabiertas tras un cierre
+    uint64_t bytes;               // Bytes recibidos
+} rp;
+
+/*******************************************************************************
+ * FUNCION: static uint64_t replay_now()
+ * DESCRIPCION: Obtiene el instante actual en el reloj monotono.
+ * ARGS_OUT: uint64_t - instante actual (ns).
+ ******************************************************************************/
+static uint64_t replay_now();
+
+/*******************************************************************************
+ * FUNCION: static char* replay_load(const char* path,
+ *                                   replay_req_t** reqs,
+ *                                   size_t* num)
+ * ARGS_IN: const char* path - fichero de la captura.
+ *          replay_req_t** reqs - peticiones leidas (se libera con free).
+ *          size_t* num - numero de peticiones.
+ * DESCRIPCION: Lee la captura entera y la ordena por conexion e instante.
+ *              Un registro cortado al final se ignora.
+ * ARGS_OUT: char* - contenido del fichero (se libera con free) o NULL.
+ ******************************************************************************/
+static char* replay_load(const char* path, replay_req_t** reqs, size_t* num);
+
+/*******************************************************************************
+ * FUNCION: static int replay_cmp(const void* a, const void* b)
+ * ARGS_IN: const void* a - peticion.
+ *          const void* b - peticion.
+ * DESCRIPCION: Ordena por conexion, instante y posicion en el fichero.
+ * ARGS_OUT: int - negativo, 0 o positivo como strcmp.
+ ******************************************************************************/
+static int replay_cmp(const void* a, const void* b);
+
+/*******************************************************************************
+ * FUNCION: static int replay_cmp_u64(const void* a, const void* b)
+ * ARGS_IN: const void* a - valor.
+ *          const void* b - valor.
+ * DESCRIPCION: Ordena enteros de 64 bits de menor a mayor.
+ * ARGS_OUT: int - negativo, 0 o positivo como strcmp.
+ ******************************************************************************/
+static int replay_cmp_u64(const void* a, const void* b);
+
+/*******************************************************************************
+ * FUNCION: static void replay_summary(const char* path,
+ *                                     replay_req_t* reqs,
+ *                                     size_t num,
+ *                                     size_t conns)
+ * ARGS_IN: const char* path - fichero de la captura.
+ *          replay_req_t* reqs - peticiones ordenadas.
+ *          size_t num - numero de peticiones.
+ *          size_t conns - numero de conexiones.
+ * DESCRIPCION: Escribe un resumen JSON de la captura sin reproducirla.
+ ******************************************************************************/
+static void replay_summary(const char* path,
+                           replay_req_t* reqs,
+                           size_t num,
+                           size_t conns);
+
+/*******************************************************************************
+ * FUNCION: static int replay_open(replay_conn_t* c)
+ * ARGS_IN: replay_conn_t* c - conexion cerrada.
+ * DESCRIPCION: Empieza un connect no bloqueante.
+ * ARGS_OUT: int - 0 o -1 en caso de error.
+ ******************************************************************************/
+static int replay_open(replay_conn_t* c);
+
+/*******************************************************************************
+ * FUNCION: static void replay_close(replay_conn_t* c)
+ * ARGS_IN: replay_conn_t* c - conexion.
+ * DESCRIPCION: Cierra la conexion. La peticion en vuelo se da por perdida.
+ ******************************************************************************/
+static void replay_close(replay_conn_t* c);
+
+/*******************************************************************************
+ * FUNCION: static int replay_send(replay_conn_t* c, uint64_t now)
+ * ARGS_IN: replay_conn_t* c - conexion.
+ *          uint64_t now - instante actual (ns).
+ * DESCRIPCION: Abre la conexion o envia la siguiente peticion si toca.
+ * ARGS_OUT: int - 0 o -1 si la conexion falla.
+ ******************************************************************************/
+static int replay_send(replay_conn_t* c, uint64_t now);
+
+/*******************************************************************************
+ * FUNCION: static int replay_recv(replay_conn_t* c, uint64_t now)
+ * ARGS_IN: replay_conn_t* c - conexion.
+ *          uint64_t now - instante actual (ns).
+ * DESCRIPCION: Lee lo disponible y registra la respuesta si esta completa.
+ * ARGS_OUT: int - 0, 1 si hay que cerrar sin error o -1 si hay error.
+ ******************************************************************************/
+static int replay_recv(replay_conn_t* c, uint64_t now);
+
+/*******************************************************************************
+ * FUNCION: static void replay_watch(replay_conn_t* c, uint32_t events)
+ * ARGS_IN: replay_conn_t* c - conexion.
+ *          uint32_t events - eventos que se esperan.
+ * DESCRIPCION: Cambia los eventos de la conexion en epoll si hace falta.
+ ******************************************************************************/
+static void replay_watch(replay_conn_t* c, uint32_t events);
+
+/*******************************************************************************
+ * FUNCION: static uint64_t replay_percentile(uint64_t* values,
+ *                                            size_t num,
+ *                                            double q)
+ * ARGS_IN: uint64_t* values - valores ordenados.
+ *          size_t num - numero de valores.
+ *          double q - percentil (0-100).
+ * DESCRIPCION: Obtiene un percentil de una lista ordenada.
+ * ARGS_OUT: uint64_t - valor del percentil (0 si no hay valores).
+ ******************************************************************************/
+static uint64_t replay_percentile(uint64_t* values, size_t num, double q);
+
+int main(int argc, char** argv)
+{
+    int opt, n, k, err, status;
+    const char* host = "127.0.0.1";
+    const char* port = "3490";
+    bool summary = false;
+    char* file;
+    replay_req_t* reqs = NULL;
+    replay_req_t** order = NULL;
+    replay_conn_t* conns = NULL;
+    replay_conn_t* c;
+    size_t num, num_conns, i, j, done;
+    struct addrinfo hints, *res;
+    struct epoll_event events[REPLAY_MAX_EVENTS];
+    uint64_t now, elapsed, sum = 0;
+    socklen_t len;
+
+    rp.speed = 1;
+    rp.timeout = 10000000000ULL;
+    while ((opt = getopt(argc, argv, "h:p:x:T:s")) != -1) {
+        switch (opt) {
+        case 'h':
+            host = optarg;
+            break;
+        case 'p':
+            port = optarg;
+            break;
+        case 'x':
+            rp.speed = atof(optarg);
+            break;
+        case 'T':
+            rp.timeout = strtoull(optarg, NULL, 10) * 1000000ULL;
+            break;
+        case 's':
+            summary = true;
+            break;
+        default:
+            optind = argc;
+            break;
+        }
+    }
+    if (optind != argc - 1 || rp.speed < 0 || !rp.timeout) {
+        fprintf(stderr,
+                "USO: %s [-h host] [-p puerto] [-x multiplicador] "
+                "[-T timeout_ms] captura\n"
+                "     %s -s captura\n",
+                argv[0],
+                argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    file = replay_load(argv[optind], &reqs, &num);
+    if (!file) {
+        return EXIT_FAILURE;
+    }
+
+    // Las peticiones ya estan agrupadas por conexion
+    for (i = 0, num_conns = 0; i < num; i++) {
+        if (!i || reqs[i].conn != reqs[i - 1].conn) {
+            num_conns++;
+        }
+    }
+    if (summary) {
+        replay_summary(argv[optind], reqs, num, num_conns);
+        free(reqs);
+        free(file);
+        return EXIT_SUCCESS;
+    }
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host, port, &hints, &res)) {
+        fprintf(stderr, "No se puede resolver %s:%s\n", host, port);
+        return EXIT_FAILURE;
+    }
+    memcpy(&rp.addr, res->ai_addr, res->ai_addrlen);
+    rp.addr_len = res->ai_addrlen;
+    freeaddrinfo(res);
+
+    order = (replay_req_t**)malloc((num ? num : 1) * sizeof(replay_req_t*));
+    conns = (replay_conn_t*)calloc(num_conns ? num_conns : 1,
+                                   sizeof(replay_conn_t));
+    rp.latencies = (uint64_t*)malloc((num ? num : 1) * sizeof(uint64_t));
+    rp.lags = (uint64_t*)malloc((num ? num : 1) * sizeof(uint64_t));
+    rp.epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (!order || !conns || !rp.latencies || !rp.lags || rp.epfd == -1) {
+        fprintf(stderr, "No hay memoria\n");
+        return EXIT_FAILURE;
+    }
+    for (i = 0, j = 0; i < num; i++) {
+        order[i] = &reqs[i];
+        if (i && reqs[i].conn != reqs[i - 1].conn) {
+            j++;
+        }
+        if (!conns[j].reqs) {
+            conns[j].reqs = &order[i];
+            conns[j].fd = -1;
+        }
+        conns[j].num++;
+    }
+
+    rp.start = replay_now();
+    while (1) {
+        now = replay_now();
+        done = 0;
+        for (i = 0; i < num_conns; i++) {
+            c = &conns[i];
+            if (c->next == c->num && !c->waiting) {
+                if (c->fd != -1) {
+                    replay_close(c);
+                }
+                done++;
+                continue;
+            }
+            if (c->waiting && now - c->sent > rp.timeout) {
+                rp.err_timeout++;
+                replay_close(c);
+            }
+            if (replay_send(c, now)) {
+                rp.err_read += c->waiting;
+                replay_close(c);
+            }
+        }
+        if (done == num_conns) {
+            break;
+        }
+
+        n = epoll_wait(rp.epfd, events, REPLAY_MAX_EVENTS, 1);
+        now = replay_now();
+        for (k = 0; k < n; k++) {
+            c = (replay_conn_t*)events[k].data.ptr;
+            if (c->fd == -1) {
+                continue;
+            }
+            if (!c->connected) {
+                err = 0;
+                len = sizeof(err);
+                getsockopt(c->fd, SOL_SOCKET, SO_ERROR, &err, &len);
+                if (err) {
+                    rp.err_connect++;
+                    replay_close(c);
+                    continue;
+                }
+                c->connected = true;
+            }
+            status = 0;
+            if (events[k].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                status = replay_recv(c, now);
+            }
+            if (status) {
+                replay_close(c);
+            } else if (replay_send(c, now)) {
+                rp.err_read += c->waiting;
+                replay_close(c);
+            }
+        }
+    }
+    elapsed = replay_now() - rp.start;
+
+    qsort(rp.latencies, rp.responses, sizeof(uint64_t), replay_cmp_u64);
+    qsort(rp.lags, rp.sent, sizeof(uint64_t), replay_cmp_u64);
+    for (i = 0; i < rp.responses; i++) {
+        sum += rp.latencies[i];
+    }
+    printf("{\"file\":\"%s\",\"records\":%zu,\"connections\":%zu,"
+           "\"speed\":%g,\"duration_s\":%.3f,\"sent\":%zu,\"responses\":%zu,"
+           "\"rps\":%.1f,\"bytes\":%llu,\"reconnects\":%llu,",
+           argv[optind],
+           num,
+           num_conns,
+           rp.speed,
+           elapsed / 1e9,
+           rp.sent,
+           rp.responses,
+           rp.responses / (elapsed / 1e9),
+           (unsigned long long)rp.bytes,
+           (unsigned long long)rp.reconnects);
+    printf("\"status\":{\"1xx\":%llu,\"2xx\":%llu,\"3xx\":%llu,\"4xx\":%llu,"
+           "\"5xx\":%llu,\"other\":%llu},",
+           (unsigned long long)rp.status[1],
+           (unsigned long long)rp.status[2],
+           (unsigned long long)rp.status[3],
+           (unsigned long long)rp.status[4],
+           (unsigned long long)rp.status[5],
+           (unsigned long long)rp.status[0]);
+    printf("\"errors\":{\"connect\":%llu,\"read\":%llu,\"timeout\":%llu,"
+           "\"parse\":%llu},",
+           (unsigned long long)rp.err_connect,
+           (unsigned long long)rp.err_read,
+           (unsigned long long)rp.err_timeout,
+           (unsigned long long)rp.err_parse);
+    printf("\"lag_us\":{\"p50\":%llu,\"p99\":%llu,\"max\":%llu},",
+           (unsigned long long)replay_percentile(rp.lags, rp.sent, 50),
+           (unsigned long long)replay_percentile(rp.lags, rp.sent, 99),
+           (unsigned long long)replay_percentile(rp.lags, rp.sent, 100));
+    printf("\"latency_us\":{\"mean\":%.1f,\"p50\":%llu,\"p90\":%llu,"
+           "\"p99\":%llu,\"p999\":%llu,\"max\":%llu}}\n",
+           rp.responses ? (double)sum / rp.responses : 0.0,
+           (unsigned long long)replay_percentile(rp.latencies, rp.responses, 50),
+           (unsigned long long)replay_percentile(rp.latencies, rp.responses, 90),
+           (unsigned long long)replay_percentile(rp.latencies, rp.responses, 99),
+           (unsigned long long)replay_percentile(
+             rp.latencies, rp.responses, 99.9),
+           (unsigned long long)replay_percentile(
+             rp.latencies, rp.responses, 100));
+
+    close(rp.epfd);
+    free(rp.latencies);
+    free(rp.lags);
+    free(conns);
+    free(order);
+    free(reqs);
+    free(file);
+
+    return EXIT_SUCCESS;
+}
+
+static uint64_t replay_now()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static char* replay_load(const char* path, replay_req_t** reqs, size_t* num)
+{
+    int fd;
+    struct stat st;
+    char* data = NULL;
+    size_t off, size = 0, got = 0;
+    ssize_t ret;
+    capture_record_t record;
+    replay_req_t* list = NULL;
+
+    fd = open(path, O_RDONLY);
+    if (fd == -1 || fstat(fd, &st)) {
+        fprintf(stderr, "No se puede abrir %s\n", path);
+        if (fd != -1) {
+            close(fd);
+        }
+        return NULL;
+    }
+    data = (char*)malloc(st.st_size ? (size_t)st.st_size : 1);
+    while (data && got < (size_t)st.st_size) {
+        ret = read(fd, data + got, (size_t)st.st_size - got);
+        if (ret <= 0) {
+            break;
+        }
+        got += (size_t)ret;
+    }
+    close(fd);
+    if (!data || got < sizeof(capture_header_t) ||
+        memcmp(data, CAPTURE_MAGIC, strlen(CAPTURE_MAGIC))) {
+        fprintf(stderr, "%s no es una captura\n", path);
+        free(data);
+        return NULL;
+    }
+
+    *num = 0;
+    for (off = sizeof(capture_header_t);
+         off + sizeof(record) <= got;
+         off += sizeof(record) + record.len) {
+        memcpy(&record, data + off, sizeof(record));
+        if (record.len > got - off - sizeof(record)) {
+            break;
+        }
+        if (*num == size) {
+            size = size ? size * 2 : 1024;
+            list = (replay_req_t*)realloc(*num ? *reqs : NULL,
+                                          size * sizeof(replay_req_t));
+            if (!list) {
+                free(*num ? *reqs : NULL);
+                free(data);
+                return NULL;
+            }
+            *reqs = list;
+        }
+        (*reqs)[*num].time_ns = record.time_ns;
+        (*reqs)[*num].conn = record.conn;
+        (*reqs)[*num].order = *num;
+        (*reqs)[*num].flags = record.flags;
+        (*reqs)[*num].data = data + off + sizeof(record);
+        (*reqs)[*num].len = record.len;
+        (*num)++;
+    }
+    if (!*num) {
+        *reqs = NULL;
+    }
+    qsort(*reqs, *num, sizeof(replay_req_t), replay_cmp);
+
+    return data;
+}
+
+static int replay_cmp(const void* a, const void* b)
+{
+    const replay_req_t* x = (const replay_req_t*)a;
+    const replay_req_t* y = (const replay_req_t*)b;
+
+    if (x->conn != y->conn) {
+        return x->conn < y->conn ? -1 : 1;
+    }
+    if (x->time_ns != y->time_ns) {
+        return x->time_ns < y->time_ns ? -1 : 1;
+    }
+
+    return (x->order > y->order) - (x->order < y->order);
+}
+
+static int replay_cmp_u64(const void* a, const void* b)
+{
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+
+    return (x > y) - (x < y);
+}
+
+static void replay_summary(const char* path,
+                           replay_req_t* reqs,
+                           size_t num,
+                           size_t conns)
+{
+    size_t i, get = 0, post = 0, scripts = 0, first = 0, bytes = 0;
+    uint64_t end = 0;
+
+    for (i = 0; i < num; i++) {
+        if (reqs[i].len >= 4 && !memcmp(reqs[i].data, "GET ", 4)) {
+            get++;
+            if (memchr(reqs[i].data, '?', reqs[i].len) &&
+                (char*)memchr(reqs[i].data, '?', reqs[i].len) <
+                  (char*)memchr(reqs[i].data, '\n', reqs[i].len)) {
+                scripts++;
+            }
+        } else if (reqs[i].len >= 5 && !memcmp(reqs[i].data, "POST ", 5)) {
+            post++;
+            scripts++;
+        }
+        first += reqs[i].flags & CAPTURE_FIRST ? 1 : 0;
+        bytes += reqs[i].len;
+        if (reqs[i].time_ns > end) {
+            end = reqs[i].time_ns;
+        }
+    }
+
+    printf("{\"file\":\"%s\",\"records\":%zu,\"connections\":%zu,"
+           "\"first_requests\":%zu,\"duration_s\":%.3f,\"bytes\":%zu,"
+           "\"mean_request_bytes\":%.1f,\"requests_per_connection\":%.2f,"
+           "\"get\":%zu,\"post\":%zu,\"other\":%zu,\"scripts\":%zu}\n",
+           path,
+           num,
+           conns,
+           first,
+           end / 1e9,
+           bytes,
+           num ? (double)bytes / num : 0.0,
+           conns ? (double)num / conns : 0.0,
+           get,
+           post,
+           num - get - post,
+           scripts);
+}
+
+static int replay_open(replay_conn_t* c)
+{
+    int one = 1;
+    struct epoll_event ev;
+
+    c->fd = socket(rp.addr.ss_family,
+                   SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                   0);
+    if (c->fd == -1) {
+        return -1;
+    }
+    setsockopt(c->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    c->connected = false;
+    c->events = EPOLLOUT;
+    ev.events = c->events;
+    ev.data.ptr = c;
+    if ((connect(c->fd, (struct sockaddr*)&rp.addr, rp.addr_len) &&
+         errno != EINPROGRESS) ||
+        epoll_ctl(rp.epfd, EPOLL_CTL_ADD, c->fd, &ev)) {
+        close(c->fd);
+        c->fd = -1;
+        return -1;
+    }
+
+    return 0;
+}
+
+static void replay_close(replay_conn_t* c)
+{
+    if (c->waiting) {
+        // La peticion en vuelo no se repite
+        c->waiting = false;
+    }
+    if (c->fd != -1) {
+        close(c->fd);
+    }
+    c->fd = -1;
+    c->connected = false;
+    c->body = false;
+    c->close = false;
+    c->in_len = 0;
+}
+
+static int replay_send(replay_conn_t* c, uint64_t now)
+{
+    replay_req_t* req;
+    uint64_t due;
+    ssize_t ret;
+
+    if (!c->waiting) {
+        if (c->next == c->num) {
+            return 0;
+        }
+        req = c->reqs[c->next];
+        due = rp.speed > 0 ? rp.start + (uint64_t)(req->time_ns / rp.speed)
+                           : now;
+        if (now < due) {
+            return 0;
+        }
+        if (c->fd == -1) {
+            // Conexion nueva o reabierta tras un cierre del servidor
+            if (!(req->flags & CAPTURE_FIRST) || c->next) {
+                rp.reconnects++;
+            }
+            if (replay_open(c)) {
+                rp.err_connect++;
+                c->next++;
+                return 0;
+            }
+        }
+        if (!c->connected) {
+            return 0;
+        }
+        c->waiting = true;
+        c->due = due;
+        c->sent = now;
+        c->out_off = 0;
+        c->next++;
+        rp.lags[rp.sent++] = (now - due) / 1000;
+    }
+
+    req = c->reqs[c->next - 1];
+    while (c->out_off < req->len) {
+        ret = send(c->fd,
+                   req->data + c->out_off,
+                   req->len - c->out_off,
+                   MSG_NOSIGNAL);
+        if (ret == -1) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                replay_watch(c, EPOLLIN | EPOLLOUT);
+                return 0;
+            }
+            return -1;
+        }
+        c->out_off += (size_t)ret;
+    }
+    replay_watch(c, EPOLLIN);
+
+    return 0;
+}
+
+static int replay_recv(replay_conn_t* c, uint64_t now)
+{
+    ssize_t ret;
+    size_t off, i, take, num_headers, msg_len;
+    int minor, status, pret;
+    const char* msg;
+    struct phr_header headers[REPLAY_MAX_HEADERS];
+
+    while (1) {
+        ret = recv(c->fd, c->in + c->in_len, sizeof(c->in) - c->in_len, 0);
+        if (ret == 0) {
+            if (c->waiting) {
+                rp.err_read++;
+                return -1;
+            }
+            return 1;
+        }
+        if (ret == -1) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return 0;
+            }
+            rp.err_read += c->waiting;
+            return -1;
+        }
+        c->in_len += (size_t)ret;
+        rp.bytes += (uint64_t)ret;
+
+        off = 0;
+        while (1) {
+            if (c->body) {
+                take = c->in_len - off;
+                if (take > c->body_left) {
+                    take = (size_t)c->body_left;
+                }
+                c->body_left -= take;
+                off += take;
+                if (c->body_left) {
+                    break;
+                }
+                c->body = false;
+                c->waiting = false;
+                rp.latencies[rp.responses++] = (now - c->due) / 1000;
+                if (c->status >= 100 && c->status < 600) {
+                    rp.status[c->status / 100]++;
+                } else {
+                    rp.status[0]++;
+                }
+                if (c->close) {
+                    return 1;
+                }
+                continue;
+            }
+            if (off == c->in_len) {
+                break;
+            }
+
+            num_headers = REPLAY_MAX_HEADERS;
+            pret = phr_parse_response(c->in + off,
+                                      c->in_len - off,
+                                      &minor,
+                                      &status,
+                                      &msg,
+                                      &msg_len,
+                                      headers,
+                                      &num_headers,
+                                      0);
+            if (pret == -2) {
+                break;
+            }
+            if (pret == -1 || !c->waiting) {
+                rp.err_parse++;
+                return -1;
+            }
+            off += (size_t)pret;
+            c->body = true;
+            c->body_left = 0;
+            c->status = status;
+            c->close = false;
+            for (i = 0; i < num_headers; i++) {
+                if (headers[i].name_len == strlen("Content-Length") &&
+                    !strncasecmp(headers[i].name,
+                                 "Content-Length",
+                                 headers[i].name_len)) {
+                    c->body_left = strtoull(headers[i].value, NULL, 10);
+                } else if (headers[i].name_len == strlen("Connection") &&
+                           !strncasecmp(headers[i].name,
+                                        "Connection",
+                                        headers[i].name_len) &&
+                           headers[i].value_len >= 5 &&
+                           !strncasecmp(headers[i].value, "close", 5)) {
+                    c->close = true;
+                }
+            }
+        }
+
+        memmove(c->in, c->in + off, c->in_len - off);
+        c->in_len -= off;
+        if (c->in_len == sizeof(c->in)) {
+            rp.err_parse++;
+            return -1;
+        }
+    }
+}
+
+static void replay_watch(replay_conn_t* c, uint32_t events)
+{
+    struct epoll_event ev;
+
+    if (c->events == events) {
+        return;
+    }
+
+    ev.events = events;
+    ev.data.ptr = c;
+    epoll_ctl(rp.epfd, EPOLL_CTL_MOD, c->fd, &ev);
+    c->events = events;
+}
+
+static uint64_t replay_percentile(uint64_t* values, size_t num, double q)
+{
+    size_t rank;
+
+    if (!num) {
+        return 0;
+    }
+
+    rank = (size_t)(q / 100 * num + 0.5);
+    if (rank < 1) {
+        rank = 1;
+    }
+    if (rank > num) {
+        rank = num;
+    }
+
+    return values[rank - 1];
+}
@@ -0,0 +1,4 @@
+import os,sys,time
+print("cerrado", sys.argv[1]); sys.stdout.flush()
+os.close(1); os.close(2)
+time.sleep(float(sys.argv[1].split("=")[1]))
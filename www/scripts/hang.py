@@ -0,0 +1,3 @@
+import time,sys,os
+os.system("sleep 30 &")
+time.sleep(30)
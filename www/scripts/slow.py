@@ -0,0 +1,3 @@
+import time,sys
+time.sleep(2)
+print("hola", sys.argv[1])